@@ -0,0 +1,1496 @@
+// SPDX-License-Identifier: MIT
+// Protocol benchmark: runs the firmware in-process on the host simulator,
+// drives the supervisor UART with scripted workloads and reports latency,
+// throughput and heap use as one JSON object per workload on stdout.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "adc_filter.h"
+#include "binframe.h"
+#include "command_table.h"
+#include "fuel_gauge.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "line_splitter.h"
+#include "sim_internal.h"
+#include "sim_port.h"
+#include "supervisor_config.h"
+#include "telemetry.h"
+#include "tx_queue.h"
+#include "watch.h"
+
+#define BENCH_SUPV_UART UART_NUM_1
+#define BENCH_MAX_CMDS 8
+#define BENCH_REPLY_TIMEOUT_MS 1000
+#define BENCH_SETTLE_MS 600
+// Switch inputs as wired in main.c (lte, wifi, bt), and a gap comfortably
+// past its 30 ms settle window.
+#define BENCH_SWITCH_GPIOS {GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_18}
+#define BENCH_SWITCH_QUIET_MS 60
+// priority_latency: gap between pings, how often a switch flips, and how
+// often the pack readings move.
+#define BENCH_PRIO_PACE_US 2000
+#define BENCH_PRIO_SWITCH_EVERY 50
+#define BENCH_PRIO_WIGGLE_MS 20
+// Pack ADC filtering as configured in main.c: each channel gets half of the
+// 20 kHz conversions.
+#define BENCH_ADC_CHANNEL_HZ 10000
+#define BENCH_ADC_OVERSAMPLE 32
+#define BENCH_ADC_IIR_SHIFT 4
+
+// The fuel gauge run: update period as on ADC wakes.
+#define BENCH_GAUGE_STEP_MS 50
+
+// Telemetry as configured in main.c: the delta engine's deadbands and
+// keyframe interval and the rate it is polled at, against the fixed full
+// dump every 2 s it replaced.
+#define BENCH_TELEMETRY_POLL_MS 500
+#define BENCH_TELEMETRY_KEYFRAME_MS 10000
+#define BENCH_TELEMETRY_DEADBAND_PACK_MV 20
+#define BENCH_TELEMETRY_DEADBAND_PACK_MA 50
+#define BENCH_TELEMETRY_DEADBAND_TEMP_C 0.5f
+#define BENCH_TELEMETRY_DEADBAND_RUNTIME_MIN 5
+#define BENCH_TELEMETRY_FULL_DUMP_MS 2000
+#define BENCH_DISCHARGE_HOURS 6
+// 115200 baud, 8N1.
+#define BENCH_WIRE_BYTES_PER_S 11520
+
+#ifndef BENCH_REVISION
+#define BENCH_REVISION "unknown"
+#endif
+
+void app_main(void);
+
+typedef struct {
+    const char *name;
+    // Commands are issued round-robin; "clear_unread" gets a source argument.
+    const char *cmds[BENCH_MAX_CMDS];
+    // Extra members appended to every other request, if set.
+    const char *args;
+    // Requests in flight before the sender waits for replies.
+    size_t window;
+    // Gap between requests, so a run spans several telemetry periods.
+    unsigned pace_us;
+} workload_t;
+
+static const workload_t g_workloads[] = {
+    {.name = "burst_status", .cmds = {"get_status"}, .window = 8},
+    // What the TUI header bar asks for.
+    {.name = "burst_status_projected",
+     .cmds = {"get_status"},
+     .args = "\"fields\":[\"battery_pct\",\"uptime_s\"]",
+     .window = 8},
+    {.name = "ping_interleaved", .cmds = {"ping", "get_status", "ping", "get_switches"}, .window = 1},
+    {.name = "clear_unread_storm", .cmds = {"clear_unread"}, .window = 8},
+    // The first arm_poweroff stays pending while the supervisor prepares to
+    // cut power; pings must keep being answered meanwhile.
+    {.name = "pings_pending_poweroff",
+     .cmds = {"arm_poweroff", "ping", "ping", "ping", "ping", "ping", "ping", "ping"},
+     .window = 8,
+     .pace_us = 1000},
+    // Every clear_unread moves last_mesh_event_us, so the telemetry task
+    // emits a delta each period while arm_poweroff replies compete with it.
+    {.name = "poweroff_under_telemetry",
+     .cmds = {"clear_unread", "get_status", "clear_unread", "get_status", "arm_poweroff"},
+     .window = 8,
+     .pace_us = 1000},
+};
+
+typedef struct {
+    uint32_t *samples;
+    size_t count;
+} latency_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t progress;
+    size_t requests;
+    uint64_t *sent_ns;
+    uint8_t *cmd_of;
+    bool *pending;
+    size_t inflight;
+    size_t replies;
+    size_t frames;
+    size_t errors;
+    size_t switch_events;
+    latency_t all;
+    latency_t by_cmd[BENCH_MAX_CMDS];
+    // priority_latency only: telemetry seen, when a switch input was last
+    // driven (0 once its event arrived), and the get_stats reply it asks for.
+    size_t telemetry_events;
+    size_t telemetry_bytes;
+    uint64_t switch_drive_ns;
+    latency_t switch_lat;
+    char stats_line[1024];
+    bool stats_ready;
+} bench_run_t;
+
+static bench_run_t g_run = {.lock = PTHREAD_MUTEX_INITIALIZER};
+// Host ends of the two pipes backing the supervisor UART.
+static int g_host_tx_fd;
+static int g_host_rx_fd;
+static bool g_wire_timing;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+// Request ids are "b<index>" so replies map straight back to their slot.
+static bool parse_id(const json_value_t *id, size_t *index) {
+    if (!json_value_is_string(id) || id->len < 2 || id->ptr[0] != 'b') {
+        return false;
+    }
+    char *end;
+    const unsigned long v = strtoul(id->ptr + 1, &end, 10);
+    if (*end != '\0') {
+        return false;
+    }
+    *index = (size_t)v;
+    return true;
+}
+
+static void on_frame(char *line, size_t len, void *ctx) {
+    (void)ctx;
+    const uint64_t t = now_ns();
+    // Parsing decodes the id in place, so the stats reply is kept first.
+    static const char k_stats_prefix[] = "{\"id\":\"stats\"";
+    if (len < sizeof(g_run.stats_line) && strncmp(line, k_stats_prefix, sizeof(k_stats_prefix) - 1) == 0) {
+        pthread_mutex_lock(&g_run.lock);
+        memcpy(g_run.stats_line, line, len + 1);
+        g_run.stats_ready = true;
+        pthread_cond_broadcast(&g_run.progress);
+        pthread_mutex_unlock(&g_run.lock);
+        return;
+    }
+    json_value_t id;
+    json_value_t ok;
+    json_value_t event;
+    const json_field_t fields[] = {{"id", &id}, {"ok", &ok}, {"event", &event}};
+    const json_read_error_t err = json_read_object(line, len, fields, 3, NULL);
+
+    pthread_mutex_lock(&g_run.lock);
+    ++g_run.frames;
+    if (err == JSON_READ_OK && json_value_is_string(&event) && strcmp(event.ptr, "switch") == 0) {
+        ++g_run.switch_events;
+        if (g_run.switch_drive_ns && g_run.switch_lat.samples) {
+            g_run.switch_lat.samples[g_run.switch_lat.count++] = (uint32_t)((t - g_run.switch_drive_ns) / 1000);
+            g_run.switch_drive_ns = 0;
+        }
+    }
+    if (err == JSON_READ_OK && json_value_is_string(&event) && strcmp(event.ptr, "telemetry") == 0) {
+        ++g_run.telemetry_events;
+        g_run.telemetry_bytes += len + 1;
+    }
+    size_t index;
+    if (err == JSON_READ_OK && parse_id(&id, &index) && index < g_run.requests && g_run.pending[index]) {
+        g_run.pending[index] = false;
+        --g_run.inflight;
+        ++g_run.replies;
+        if (ok.type != JSON_TYPE_BOOL || ok.ptr[0] != 't') {
+            ++g_run.errors;
+        }
+        const uint64_t us = (t - g_run.sent_ns[index]) / 1000;
+        const uint32_t sample = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+        g_run.all.samples[g_run.all.count++] = sample;
+        latency_t *per_cmd = &g_run.by_cmd[g_run.cmd_of[index]];
+        per_cmd->samples[per_cmd->count++] = sample;
+        pthread_cond_broadcast(&g_run.progress);
+    }
+    pthread_mutex_unlock(&g_run.lock);
+}
+
+static void *collector_thread(void *arg) {
+    (void)arg;
+    static char line_buf[1024];
+    line_splitter_t splitter;
+    line_splitter_init(&splitter, line_buf, sizeof(line_buf), on_frame, NULL);
+    char chunk[512];
+    while (true) {
+        const ssize_t n = read(g_host_rx_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return NULL;
+        }
+        line_splitter_feed(&splitter, chunk, (size_t)n);
+    }
+}
+
+static bool wait_inflight_below(size_t limit, uint64_t timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t)(timeout_ms / 1000);
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (g_run.inflight >= limit) {
+        if (!sim_cond_wait(&g_run.progress, &g_run.lock, &deadline)) {
+            return g_run.inflight < limit;
+        }
+    }
+    return true;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile over sorted samples.
+static uint32_t percentile(const latency_t *lat, unsigned pct) {
+    if (lat->count == 0) {
+        return 0;
+    }
+    size_t rank = (lat->count * pct + 99) / 100;
+    return lat->samples[rank == 0 ? 0 : rank - 1];
+}
+
+// With `stats`, also the longest reply the command has encoded since boot.
+static void print_latency(FILE *out, const latency_t *lat, const command_stats_t *stats) {
+    fprintf(out, "{\"n\":%zu,\"p50\":%u,\"p99\":%u,\"max\":%u", lat->count, percentile(lat, 50),
+            percentile(lat, 99), lat->count ? lat->samples[lat->count - 1] : 0);
+    if (stats) {
+        fprintf(out, ",\"reply_peak_bytes\":%u", (unsigned)stats->reply_peak);
+    }
+    fputc('}', out);
+}
+
+static size_t workload_cmd_count(const workload_t *wl) {
+    size_t n = 0;
+    while (n < BENCH_MAX_CMDS && wl->cmds[n]) {
+        ++n;
+    }
+    return n;
+}
+
+static void run_workload(const workload_t *wl, size_t requests, bool wire_timing, FILE *out) {
+    const size_t ncmds = workload_cmd_count(wl);
+    // Everything the bench itself needs is allocated before the heap
+    // counters are sampled, so the deltas below are firmware-only.
+    g_run.requests = requests;
+    g_run.sent_ns = __real_calloc(requests, sizeof(*g_run.sent_ns));
+    g_run.cmd_of = __real_calloc(requests, sizeof(*g_run.cmd_of));
+    g_run.pending = __real_calloc(requests, sizeof(*g_run.pending));
+    g_run.all = (latency_t){.samples = __real_calloc(requests, sizeof(uint32_t))};
+    for (size_t c = 0; c < ncmds; ++c) {
+        g_run.by_cmd[c] = (latency_t){.samples = __real_calloc(requests, sizeof(uint32_t))};
+    }
+    g_run.inflight = 0;
+    g_run.replies = 0;
+    g_run.frames = 0;
+    g_run.errors = 0;
+
+    sim_heap_stats_t heap;
+    sim_heap_reset_peak();
+    sim_heap_stats(&heap);
+    const size_t heap_before = heap.in_use;
+    const size_t allocs_before = heap.alloc_calls;
+
+    size_t lost = 0;
+    const uint64_t start = now_ns();
+    char line[256];
+    for (size_t i = 0; i < requests; ++i) {
+        const size_t c = i % ncmds;
+        int len;
+        if (strcmp(wl->cmds[c], "clear_unread") == 0) {
+            len = snprintf(line, sizeof(line), "{\"id\":\"b%zu\",\"cmd\":\"clear_unread\",\"source\":\"bench\"}\n", i);
+        } else if (wl->args) {
+            len = snprintf(line, sizeof(line), "{\"id\":\"b%zu\",\"cmd\":\"%s\",%s}\n", i, wl->cmds[c], wl->args);
+        } else {
+            len = snprintf(line, sizeof(line), "{\"id\":\"b%zu\",\"cmd\":\"%s\"}\n", i, wl->cmds[c]);
+        }
+        pthread_mutex_lock(&g_run.lock);
+        if (!wait_inflight_below(wl->window, BENCH_REPLY_TIMEOUT_MS)) {
+            // Give up on whatever is still outstanding so the run can finish.
+            for (size_t j = 0; j < i; ++j) {
+                if (g_run.pending[j]) {
+                    g_run.pending[j] = false;
+                    ++lost;
+                }
+            }
+            g_run.inflight = 0;
+        }
+        g_run.cmd_of[i] = (uint8_t)c;
+        g_run.pending[i] = true;
+        ++g_run.inflight;
+        g_run.sent_ns[i] = now_ns();
+        pthread_mutex_unlock(&g_run.lock);
+        write_all(g_host_tx_fd, line, (size_t)len);
+        if (wl->pace_us) {
+            usleep(wl->pace_us);
+        }
+    }
+    pthread_mutex_lock(&g_run.lock);
+    wait_inflight_below(1, BENCH_REPLY_TIMEOUT_MS);
+    lost += g_run.inflight;
+    const uint64_t elapsed_ns = now_ns() - start;
+    const size_t frames = g_run.frames;
+    pthread_mutex_unlock(&g_run.lock);
+
+    sim_heap_stats(&heap);
+    const size_t allocs = heap.alloc_calls - allocs_before;
+    const size_t heap_peak = heap.peak;
+
+    qsort(g_run.all.samples, g_run.all.count, sizeof(uint32_t), cmp_u32);
+    for (size_t c = 0; c < ncmds; ++c) {
+        qsort(g_run.by_cmd[c].samples, g_run.by_cmd[c].count, sizeof(uint32_t), cmp_u32);
+    }
+    const double secs = (double)elapsed_ns / 1e9;
+    fprintf(out, "{\"bench\":\"%s\",\"revision\":\"%s\",\"wire_timing\":%s,\"requests\":%zu,\"window\":%zu,",
+            wl->name, BENCH_REVISION, wire_timing ? "true" : "false", requests, wl->window);
+    fprintf(out, "\"replies\":%zu,\"lost\":%zu,\"errors\":%zu,\"elapsed_ms\":%.1f,", g_run.replies, lost,
+            g_run.errors, secs * 1e3);
+    fprintf(out, "\"frames\":%zu,\"frames_per_s\":%.1f,\"latency_us\":", frames, secs > 0 ? frames / secs : 0.0);
+    print_latency(out, &g_run.all, NULL);
+    fprintf(out, ",\"by_cmd\":{");
+    for (size_t c = 0; c < ncmds; ++c) {
+        // A command can repeat in the rotation; report it once.
+        bool seen = false;
+        for (size_t p = 0; p < c; ++p) {
+            seen |= strcmp(wl->cmds[p], wl->cmds[c]) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+        latency_t merged = g_run.by_cmd[c];
+        for (size_t d = c + 1; d < ncmds; ++d) {
+            if (strcmp(wl->cmds[d], wl->cmds[c]) == 0) {
+                memcpy(merged.samples + merged.count, g_run.by_cmd[d].samples,
+                       g_run.by_cmd[d].count * sizeof(uint32_t));
+                merged.count += g_run.by_cmd[d].count;
+            }
+        }
+        qsort(merged.samples, merged.count, sizeof(uint32_t), cmp_u32);
+        fprintf(out, "%s\"%s\":", c ? "," : "", wl->cmds[c]);
+        print_latency(out, &merged, command_table_stats(wl->cmds[c]));
+    }
+    fprintf(out, "},\"heap_in_use_bytes\":%zu,\"heap_peak_bytes\":%zu,\"heap_after_bytes\":%zu,", heap_before,
+            heap_peak, heap.in_use);
+    fprintf(out, "\"allocs\":%zu,\"allocs_per_msg\":%.3f}\n", allocs, frames ? (double)allocs / (double)frames : 0.0);
+    fflush(out);
+
+    fprintf(stderr, "%-26s %6zu req  %8.0f frames/s  p50 %6u us  p99 %6u us  max %7u us  lost %zu  allocs %zu\n",
+            wl->name, requests, secs > 0 ? frames / secs : 0.0, percentile(&g_run.all, 50),
+            percentile(&g_run.all, 99), g_run.all.count ? g_run.all.samples[g_run.all.count - 1] : 0, lost, allocs);
+
+    __real_free(g_run.sent_ns);
+    __real_free(g_run.cmd_of);
+    __real_free(g_run.pending);
+    __real_free(g_run.all.samples);
+    for (size_t c = 0; c < ncmds; ++c) {
+        __real_free(g_run.by_cmd[c].samples);
+    }
+}
+
+static volatile bool g_pack_wiggle;
+
+// Moves the pack readings past telemetry's deadbands every poll, so each
+// telemetry period has a frame to send.
+static void *pack_wiggle_thread(void *arg) {
+    (void)arg;
+    for (int i = 0; g_pack_wiggle; ++i) {
+        sim_adc_set_pack(i & 1 ? 11750 : 11600, i & 1 ? -420 : -1500);
+        usleep(BENCH_PRIO_WIGGLE_MS * 1000);
+    }
+    sim_adc_set_pack(11750, -420);
+    return NULL;
+}
+
+static void send_line(const char *line) {
+    write_all(g_host_tx_fd, line, strlen(line));
+}
+
+// Reads the per-class array `key` of the tx_queue object in a get_stats
+// reply into `out`, in priority order.
+static void stats_classes(const json_value_t *tx_queue, const char *key, uint32_t out[TX_PRIO_COUNT]) {
+    char obj[sizeof(g_run.stats_line)];
+    memcpy(obj, tx_queue->ptr, tx_queue->len);
+    json_value_t array;
+    const json_field_t fields[] = {{key, &array}};
+    memset(out, 0, TX_PRIO_COUNT * sizeof(uint32_t));
+    if (json_read_object(obj, tx_queue->len, fields, 1, NULL) != JSON_READ_OK || array.type != JSON_TYPE_ARRAY) {
+        return;
+    }
+    json_array_iter_t it;
+    json_array_iter_init(&it, &array);
+    json_value_t item;
+    for (int prio = 0; prio < TX_PRIO_COUNT && json_array_next(&it, &item); ++prio) {
+        json_value_to_u32(&item, &out[prio]);
+    }
+}
+
+// Replies, switch events and telemetry sharing the 115200 baud link: a
+// telemetry subscription polled as fast as the firmware allows, with the pack
+// readings moving every poll, keeps the writer busy while pings go out one at
+// a time and a switch input flips every BENCH_PRIO_SWITCH_EVERY requests.
+// Always runs with wire timing on. Reports reply and switch latency as the Pi
+// sees them, and each class's longest wait in the firmware's TX queue.
+static void run_priority_latency(size_t requests, FILE *out) {
+    static const gpio_num_t gpios[] = BENCH_SWITCH_GPIOS;
+    const size_t flips = requests / BENCH_PRIO_SWITCH_EVERY + 1;
+    g_run.requests = requests;
+    g_run.sent_ns = __real_calloc(requests, sizeof(*g_run.sent_ns));
+    g_run.cmd_of = __real_calloc(requests, sizeof(*g_run.cmd_of));
+    g_run.pending = __real_calloc(requests, sizeof(*g_run.pending));
+    g_run.all = (latency_t){.samples = __real_calloc(requests, sizeof(uint32_t))};
+    g_run.by_cmd[0] = (latency_t){.samples = __real_calloc(requests, sizeof(uint32_t))};
+    latency_t switch_lat = {.samples = __real_calloc(flips, sizeof(uint32_t))};
+    g_run.inflight = 0;
+    g_run.replies = 0;
+    g_run.errors = 0;
+
+    sim_uart_set_wire_timing(true);
+    send_line("{\"id\":\"sub\",\"cmd\":\"subscribe\",\"topic\":\"telemetry\",\"min_ms\":0,\"max_ms\":1000}\n");
+    g_pack_wiggle = true;
+    pthread_t wiggle;
+    if (pthread_create(&wiggle, NULL, pack_wiggle_thread, NULL) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+    pthread_mutex_lock(&g_run.lock);
+    g_run.switch_lat = switch_lat;
+    g_run.switch_drive_ns = 0;
+    g_run.telemetry_events = 0;
+    g_run.telemetry_bytes = 0;
+    pthread_mutex_unlock(&g_run.lock);
+
+    size_t lost = 0;
+    int level = gpio_get_level(gpios[0]);
+    const uint64_t start = now_ns();
+    char line[64];
+    for (size_t i = 0; i < requests; ++i) {
+        if (i % BENCH_PRIO_SWITCH_EVERY == BENCH_PRIO_SWITCH_EVERY / 2) {
+            level = !level;
+            pthread_mutex_lock(&g_run.lock);
+            g_run.switch_drive_ns = now_ns();
+            pthread_mutex_unlock(&g_run.lock);
+            sim_gpio_drive(gpios[0], level);
+        }
+        const int len = snprintf(line, sizeof(line), "{\"id\":\"b%zu\",\"cmd\":\"ping\"}\n", i);
+        pthread_mutex_lock(&g_run.lock);
+        if (!wait_inflight_below(1, BENCH_REPLY_TIMEOUT_MS)) {
+            for (size_t j = 0; j < i; ++j) {
+                if (g_run.pending[j]) {
+                    g_run.pending[j] = false;
+                    ++lost;
+                }
+            }
+            g_run.inflight = 0;
+        }
+        g_run.pending[i] = true;
+        ++g_run.inflight;
+        g_run.sent_ns[i] = now_ns();
+        pthread_mutex_unlock(&g_run.lock);
+        write_all(g_host_tx_fd, line, (size_t)len);
+        usleep(BENCH_PRIO_PACE_US);
+    }
+    pthread_mutex_lock(&g_run.lock);
+    wait_inflight_below(1, BENCH_REPLY_TIMEOUT_MS);
+    lost += g_run.inflight;
+    const double secs = (double)(now_ns() - start) / 1e9;
+    const size_t telemetry_events = g_run.telemetry_events;
+    const size_t telemetry_bytes = g_run.telemetry_bytes;
+    g_run.stats_ready = false;
+    pthread_mutex_unlock(&g_run.lock);
+
+    g_pack_wiggle = false;
+    pthread_join(wiggle, NULL);
+    send_line("{\"id\":\"sub\",\"cmd\":\"subscribe\",\"topic\":\"telemetry\"}\n");
+    send_line("{\"id\":\"stats\",\"cmd\":\"get_stats\"}\n");
+    pthread_mutex_lock(&g_run.lock);
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += BENCH_REPLY_TIMEOUT_MS / 1000;
+    while (!g_run.stats_ready && sim_cond_wait(&g_run.progress, &g_run.lock, &deadline)) {
+    }
+    char stats[sizeof(g_run.stats_line)];
+    memcpy(stats, g_run.stats_line, sizeof(stats));
+    const bool have_stats = g_run.stats_ready;
+    switch_lat = g_run.switch_lat;
+    g_run.switch_lat = (latency_t){0};
+    pthread_mutex_unlock(&g_run.lock);
+    sim_uart_set_wire_timing(g_wire_timing);
+
+    uint32_t sent[TX_PRIO_COUNT] = {0};
+    uint32_t wait_max[TX_PRIO_COUNT] = {0};
+    uint32_t dropped[TX_PRIO_COUNT] = {0};
+    json_value_t tx_queue = {0};
+    const json_field_t fields[] = {{"tx_queue", &tx_queue}};
+    if (have_stats && json_read_object(stats, strlen(stats), fields, 1, NULL) == JSON_READ_OK &&
+        tx_queue.type == JSON_TYPE_OBJECT) {
+        stats_classes(&tx_queue, "sent", sent);
+        stats_classes(&tx_queue, "wait_max_us", wait_max);
+        stats_classes(&tx_queue, "dropped", dropped);
+    } else {
+        fprintf(stderr, "priority_latency: no get_stats reply\n");
+    }
+
+    qsort(g_run.all.samples, g_run.all.count, sizeof(uint32_t), cmp_u32);
+    qsort(switch_lat.samples, switch_lat.count, sizeof(uint32_t), cmp_u32);
+    static const char *const k_class_names[TX_PRIO_COUNT] = {"reply", "switch", "poweroff", "event", "telemetry"};
+    fprintf(out, "{\"bench\":\"priority_latency\",\"revision\":\"%s\",\"wire_timing\":true,\"requests\":%zu,",
+            BENCH_REVISION, requests);
+    fprintf(out, "\"lost\":%zu,\"telemetry_events\":%zu,\"telemetry_link_pct\":%.1f,\"reply_latency_us\":", lost,
+            telemetry_events, secs > 0 ? 100.0 * (double)telemetry_bytes / secs / BENCH_WIRE_BYTES_PER_S : 0.0);
+    print_latency(out, &g_run.all, NULL);
+    fprintf(out, ",\"switch_latency_us\":");
+    print_latency(out, &switch_lat, NULL);
+    fprintf(out, ",\"tx_classes\":{");
+    for (int prio = 0; prio < TX_PRIO_COUNT; ++prio) {
+        fprintf(out, "%s\"%s\":{\"sent\":%u,\"wait_max_us\":%u,\"dropped\":%u}", prio ? "," : "",
+                k_class_names[prio], sent[prio], wait_max[prio], dropped[prio]);
+    }
+    fprintf(out, "}}\n");
+    fflush(out);
+    fprintf(stderr,
+            "%-26s %6zu req  reply p50 %6u us p99 %6u us  switch p50 %6u us max %6u us  telemetry %zu (%.1f%% of link)"
+            "  queue wait max reply %u / switch %u / telemetry %u us\n",
+            "priority_latency", requests, percentile(&g_run.all, 50), percentile(&g_run.all, 99),
+            percentile(&switch_lat, 50), switch_lat.count ? switch_lat.samples[switch_lat.count - 1] : 0,
+            telemetry_events, secs > 0 ? 100.0 * (double)telemetry_bytes / secs / BENCH_WIRE_BYTES_PER_S : 0.0,
+            wait_max[TX_PRIO_REPLY], wait_max[TX_PRIO_SWITCH], wait_max[TX_PRIO_TELEMETRY]);
+
+    __real_free(g_run.sent_ns);
+    __real_free(g_run.cmd_of);
+    __real_free(g_run.pending);
+    __real_free(g_run.all.samples);
+    __real_free(g_run.by_cmd[0].samples);
+    __real_free(switch_lat.samples);
+    g_run.by_cmd[0] = (latency_t){0};
+}
+
+typedef struct {
+    const char *name;
+    telemetry_mask_t fields;
+} bench_projection_t;
+
+static const bench_projection_t g_projections[] = {
+    {"all", TELEMETRY_FIELDS_ALL},
+    {"header_bar", TELEMETRY_FIELD_BATTERY_PCT | TELEMETRY_FIELD_UPTIME_S},
+    {"power", TELEMETRY_FIELD_BATTERY_PCT | TELEMETRY_FIELD_PACK_MV | TELEMETRY_FIELD_PACK_MA | TELEMETRY_FIELD_UPTIME_S},
+    {"switches", TELEMETRY_FIELD_SWITCH},
+    {"unread", TELEMETRY_FIELD_UNREAD_EXT | TELEMETRY_FIELD_LAST_MSG_AGE_S},
+};
+
+// Encodes a get_status reply and a telemetry frame for each projection,
+// outside the firmware tasks, and reports time and bytes per encode.
+static void run_projection_encode(size_t iterations, FILE *out) {
+    const supervisor_state_t state = {
+        .battery_pct = 78,
+        .pack_mv = 11750,
+        .pack_ma = -420,
+        .time_to_empty_min = 401,
+        .time_to_full_min = -1,
+        .mcu_temp_c = 36.5f,
+        .heltec = "ok",
+        .mcu = "proto-0.1",
+        .last_mesh_event_us = 1000000,
+        .switches = {.lte = true, .bt = true, .bridge_enable = true, .charger_online = true},
+    };
+    const uint64_t now_us = 3600000000ULL;
+    char buf[512];
+    uint8_t bin[256];
+    for (size_t p = 0; p < sizeof(g_projections) / sizeof(g_projections[0]); ++p) {
+        const bench_projection_t *proj = &g_projections[p];
+        size_t json_len = 0;
+        const uint64_t start = now_ns();
+        for (size_t i = 0; i < iterations; ++i) {
+            json_writer_t w;
+            json_writer_init(&w, buf, sizeof(buf));
+            json_writer_begin_object(&w);
+            json_writer_add_string(&w, "id", "12");
+            json_writer_add_bool(&w, "ok", true);
+            json_writer_key(&w, "status");
+            json_writer_begin_object(&w);
+            telemetry_encode_fields(&w, &state, now_us, proj->fields);
+            json_writer_end_object(&w);
+            json_writer_end_object(&w);
+            json_len = json_writer_end_line(&w);
+        }
+        const uint64_t json_ns = now_ns() - start;
+        size_t bin_len = 0;
+        const uint64_t bin_start = now_ns();
+        for (size_t i = 0; i < iterations; ++i) {
+            const size_t payload = binframe_encode_telemetry(&state, now_us, proj->fields, bin, sizeof(bin));
+            uint8_t wire[BINFRAME_MAX_WIRE];
+            bin_len = binframe_encode(BINFRAME_TYPE_TELEMETRY, bin, payload, wire, sizeof(wire));
+        }
+        const uint64_t bin_ns = now_ns() - bin_start;
+        const double json_per = (double)json_ns / (double)iterations;
+        const double bin_per = (double)bin_ns / (double)iterations;
+        fprintf(out,
+                "{\"bench\":\"projection_encode\",\"revision\":\"%s\",\"projection\":\"%s\",\"fields\":%u,"
+                "\"iterations\":%zu,\"json_bytes\":%zu,\"json_ns\":%.1f,\"binary_bytes\":%zu,\"binary_ns\":%.1f}\n",
+                BENCH_REVISION, proj->name, (unsigned)__builtin_popcount(proj->fields), iterations, json_len, json_per,
+                bin_len, bin_per);
+        fprintf(stderr, "projection %-16s %4zu B json %7.1f ns   %4zu B binary %7.1f ns\n", proj->name, json_len,
+                json_per, bin_len, bin_per);
+    }
+    fflush(out);
+}
+
+typedef struct {
+    watch_field_t field;
+    watch_op_t op;
+    float threshold;
+    float hysteresis;
+} bench_watch_t;
+
+static const bench_watch_t g_trace_watches[] = {
+    {WATCH_FIELD_BATTERY_PCT, WATCH_BELOW, 15.0f, 2.0f},
+    {WATCH_FIELD_BATTERY_PCT, WATCH_BELOW, 5.0f, 2.0f},
+    {WATCH_FIELD_PACK_MV, WATCH_BELOW, 9500.0f, 120.0f},
+    {WATCH_FIELD_PACK_MA, WATCH_BELOW, -2000.0f, 200.0f},
+    {WATCH_FIELD_MCU_TEMP_C, WATCH_ABOVE, 60.0f, 2.0f},
+    {WATCH_FIELD_UNREAD_EXT, WATCH_ABOVE, 5.0f, 0.0f},
+};
+
+static uint32_t trace_noise(uint64_t *rng, uint32_t span) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    return (uint32_t)(*rng % span);
+}
+
+// A full discharge sampled once per state change: battery and pack voltage
+// fall with +-1 % / +-15 mV of noise, current idles near -420 mA with
+// periodic transmit bursts past -2.5 A, the MCU temperature swings through
+// the 60 C threshold and unread messages pile up and get cleared.
+static void make_trace(supervisor_state_t *trace, size_t samples) {
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < samples; ++i) {
+        supervisor_state_t *s = &trace[i];
+        memset(s, 0, sizeof(*s));
+        const int pct = 100 - (int)(100 * i / samples) + (int)trace_noise(&rng, 3) - 1;
+        s->battery_pct = pct < 0 ? 0 : pct > 100 ? 100 : pct;
+        s->pack_mv = 9000 + 36 * s->battery_pct + (int)trace_noise(&rng, 31) - 15;
+        const bool burst = i % 5000 < 50;
+        s->pack_ma = (burst ? -2600 : -420) + (int)trace_noise(&rng, 301) - 150;
+        s->mcu_temp_c = 45.0f + 18.0f * sinf(6.2831853f * (float)i / 20000.0f) +
+                        (float)trace_noise(&rng, 9) * 0.1f - 0.4f;
+        s->unread_ext = (int)(i % 10000 / 997);
+    }
+}
+
+// Feeds synthetic traces through the watch engine directly and reports its
+// cost per state update, and how many alerts hysteresis saves over plain
+// threshold crossings.
+static void run_watch_trace(size_t samples, FILE *out) {
+    const size_t nwatches = sizeof(g_trace_watches) / sizeof(g_trace_watches[0]);
+    supervisor_state_t *trace = __real_malloc(samples * sizeof(*trace));
+    if (!trace) {
+        perror("malloc");
+        exit(1);
+    }
+    make_trace(trace, samples);
+
+    watch_table_t table;
+    watch_table_init(&table);
+    for (size_t i = 0; i < nwatches; ++i) {
+        const bench_watch_t *bw = &g_trace_watches[i];
+        watch_table_add(&table, bw->field, bw->op, bw->threshold, bw->hysteresis, &trace[0]);
+    }
+    size_t alerts[WATCH_MAX] = {0};
+    size_t crossings[WATCH_MAX] = {0};
+    const uint64_t start = now_ns();
+    for (size_t i = 1; i < samples; ++i) {
+        for (watch_mask_t due = watch_table_update(&table, &trace[i]); due; due &= due - 1) {
+            const int slot = __builtin_ctz(due);
+            ++alerts[slot];
+            watch_table_mark_reported(&table, slot);
+        }
+    }
+    const uint64_t elapsed_ns = now_ns() - start;
+
+    // The same predicates without hysteresis, for comparison.
+    for (size_t w = 0; w < nwatches; ++w) {
+        const bench_watch_t *bw = &g_trace_watches[w];
+        bool was = false;
+        for (size_t i = 0; i < samples; ++i) {
+            const float v = watch_field_value(bw->field, &trace[i]);
+            const bool is = bw->op == WATCH_BELOW ? v < bw->threshold : v > bw->threshold;
+            crossings[w] += i > 0 && is != was;
+            was = is;
+        }
+    }
+
+    const size_t updates = samples - 1;
+    size_t total_alerts = 0;
+    size_t total_crossings = 0;
+    fprintf(out, "{\"bench\":\"watch_eval\",\"revision\":\"%s\",\"samples\":%zu,\"watches\":%zu,", BENCH_REVISION,
+            samples, nwatches);
+    fprintf(out, "\"ns_per_update\":%.1f,\"evaluations_per_update\":%.2f,\"by_watch\":{",
+            updates ? (double)elapsed_ns / (double)updates : 0.0,
+            table.updates ? (double)table.evaluations / (double)table.updates : 0.0);
+    for (size_t w = 0; w < nwatches; ++w) {
+        const bench_watch_t *bw = &g_trace_watches[w];
+        fprintf(out, "%s\"%s%s%g\":{\"alerts\":%zu,\"raw_crossings\":%zu}", w ? "," : "", watch_field_name(bw->field),
+                bw->op == WATCH_BELOW ? "<" : ">", bw->threshold, alerts[w], crossings[w]);
+        total_alerts += alerts[w];
+        total_crossings += crossings[w];
+    }
+    fprintf(out, "},\"alerts\":%zu,\"raw_crossings\":%zu}\n", total_alerts, total_crossings);
+    fflush(out);
+    fprintf(stderr, "%-26s %6zu upd  %8.1f ns/update  %.2f evals/update  alerts %zu (raw crossings %zu)\n",
+            "watch_eval", updates, updates ? (double)elapsed_ns / (double)updates : 0.0,
+            table.updates ? (double)table.evaluations / (double)table.updates : 0.0, total_alerts, total_crossings);
+    __real_free(trace);
+}
+
+// Drives the live firmware's switch inputs with bursts of bouncing edges and
+// counts the switch events that reach the Pi. Each window flips one input,
+// flips two at once, or is a glitch that ends where it started; only the
+// first two should produce an event, exactly one each. Fails on any other
+// count.
+static bool run_switch_bounce(size_t windows, FILE *out) {
+    static const gpio_num_t gpios[] = BENCH_SWITCH_GPIOS;
+    const size_t ngpios = sizeof(gpios) / sizeof(gpios[0]);
+    int level[sizeof(gpios) / sizeof(gpios[0])];
+    for (size_t g = 0; g < ngpios; ++g) {
+        level[g] = gpio_get_level(gpios[g]);
+    }
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    size_t edges = 0;
+    size_t expected = 0;
+    pthread_mutex_lock(&g_run.lock);
+    const size_t events_before = g_run.switch_events;
+    pthread_mutex_unlock(&g_run.lock);
+    const uint64_t start = now_ns();
+    for (size_t w = 0; w < windows; ++w) {
+        const size_t kind = w % 3;
+        const size_t first = w % ngpios;
+        const size_t count = kind == 1 ? 2 : 1;
+        for (size_t k = 0; k < count; ++k) {
+            const size_t g = (first + k) % ngpios;
+            // An odd number of edges flips the input; a glitch uses an even one.
+            const size_t bounces = 2 * (1 + trace_noise(&rng, 3)) + (kind == 2 ? 0 : 1);
+            for (size_t b = 0; b < bounces; ++b) {
+                level[g] = !level[g];
+                sim_gpio_drive(gpios[g], level[g]);
+                ++edges;
+                usleep(100 + trace_noise(&rng, 400));
+            }
+        }
+        expected += kind != 2;
+        usleep(BENCH_SWITCH_QUIET_MS * 1000);
+    }
+    const uint64_t elapsed_ns = now_ns() - start;
+    pthread_mutex_lock(&g_run.lock);
+    const size_t events = g_run.switch_events - events_before;
+    pthread_mutex_unlock(&g_run.lock);
+
+    const bool ok = events == expected;
+    fprintf(out,
+            "{\"bench\":\"switch_bounce\",\"revision\":\"%s\",\"windows\":%zu,\"edges\":%zu,"
+            "\"expected_events\":%zu,\"events\":%zu,\"elapsed_ms\":%.1f}\n",
+            BENCH_REVISION, windows, edges, expected, events, (double)elapsed_ns / 1e6);
+    fflush(out);
+    fprintf(stderr, "%-26s %6zu win  %6zu edges  events %zu (expected %zu)  %s\n", "switch_bounce", windows, edges,
+            events, expected, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// A recorded-style pack current stream at the per-channel rate: a -420 mA
+// idle with +-8 codes of noise, a transmit burst to -2.6 A for one second in
+// every four, and a single-sample spike of +600 codes every 37 ms.
+#define BENCH_ADC_IDLE_RAW 1902
+#define BENCH_ADC_BURST_RAW 1198
+#define BENCH_ADC_SPIKE_RAW 600
+
+static uint16_t adc_trace_ideal(size_t i) {
+    return i % (4 * BENCH_ADC_CHANNEL_HZ) >= 2 * BENCH_ADC_CHANNEL_HZ &&
+                   i % (4 * BENCH_ADC_CHANNEL_HZ) < 3 * BENCH_ADC_CHANNEL_HZ
+               ? BENCH_ADC_BURST_RAW
+               : BENCH_ADC_IDLE_RAW;
+}
+
+// Replays the stream through the pack ADC filter and reports its cost per
+// sample, how long a step takes to show (90 % of the way), and the worst
+// error once settled, against the raw noise and spikes.
+static void run_adc_filter(size_t samples, FILE *out) {
+    uint16_t *trace = __real_malloc(samples * sizeof(*trace));
+    if (!trace) {
+        perror("malloc");
+        exit(1);
+    }
+    uint64_t rng = 0xD1B54A32D192ED03ULL;
+    for (size_t i = 0; i < samples; ++i) {
+        int raw = adc_trace_ideal(i) + (int)trace_noise(&rng, 17) - 8;
+        if (i % (BENCH_ADC_CHANNEL_HZ * 37 / 1000) == 0) {
+            raw += BENCH_ADC_SPIKE_RAW;
+        }
+        trace[i] = (uint16_t)raw;
+    }
+
+    const adc_filter_config_t cfg = {.oversample = BENCH_ADC_OVERSAMPLE, .iir_shift = BENCH_ADC_IIR_SHIFT};
+    adc_filter_t f;
+    adc_filter_init(&f, &cfg);
+    const uint64_t start = now_ns();
+    for (size_t i = 0; i < samples; ++i) {
+        adc_filter_push(&f, trace[i]);
+    }
+    const uint64_t elapsed_ns = now_ns() - start;
+
+    // Second pass for the response: outputs are sampled once per block.
+    adc_filter_init(&f, &cfg);
+    const size_t settle = BENCH_ADC_CHANNEL_HZ / 4;
+    size_t steps = 0;
+    size_t step_latency_total = 0;
+    size_t step_at = 0;
+    bool step_open = false;
+    int from = BENCH_ADC_IDLE_RAW;
+    int settled_err = 0;
+    for (size_t i = 0; i < samples; ++i) {
+        if (i > 0 && adc_trace_ideal(i) != adc_trace_ideal(i - 1)) {
+            from = adc_trace_ideal(i - 1);
+            step_at = i;
+            step_open = true;
+        }
+        if (!adc_filter_push(&f, trace[i])) {
+            continue;
+        }
+        const int to = adc_trace_ideal(i);
+        const int value = adc_filter_raw(&f);
+        if (step_open && abs(value - from) * 10 >= abs(to - from) * 9) {
+            step_latency_total += i - step_at;
+            ++steps;
+            step_open = false;
+        }
+        if (i >= settle && i - step_at >= settle && abs(value - to) > settled_err) {
+            settled_err = abs(value - to);
+        }
+    }
+    __real_free(trace);
+
+    const double ns_per_sample = (double)elapsed_ns / (double)samples;
+    const double step_ms = steps ? (double)step_latency_total * 1000.0 / steps / BENCH_ADC_CHANNEL_HZ : 0.0;
+    fprintf(out,
+            "{\"bench\":\"adc_filter\",\"revision\":\"%s\",\"samples\":%zu,\"oversample\":%d,\"iir_shift\":%d,"
+            "\"ns_per_sample\":%.2f,\"steps\":%zu,\"step_90_ms\":%.1f,\"settled_max_err_codes\":%d,"
+            "\"raw_max_err_codes\":%d}\n",
+            BENCH_REVISION, samples, BENCH_ADC_OVERSAMPLE, BENCH_ADC_IIR_SHIFT, ns_per_sample, steps, step_ms,
+            settled_err, BENCH_ADC_SPIKE_RAW + 8);
+    fflush(out);
+    fprintf(stderr, "%-26s %6zu smp  %8.2f ns/sample  step 90%% %.1f ms  settled err %d codes (raw %d)\n",
+            "adc_filter", samples, ns_per_sample, step_ms, settled_err, BENCH_ADC_SPIKE_RAW + 8);
+}
+
+// The firmware's gauge settings and the datasheet curve it uses.
+static const fuel_gauge_ocv_point_t k_bench_ocv[] = {
+    {9810, 0},    {10830, 50},  {11070, 100}, {11310, 200}, {11460, 300},  {11580, 400},
+    {11700, 500}, {11850, 600}, {12030, 700}, {12210, 800}, {12390, 900}, {12600, 1000},
+};
+
+static const fuel_gauge_config_t k_bench_gauge = {
+    .capacity_mah = 5000,
+    .r_internal_mohm = 120,
+    .rest_ma = 50,
+    .rest_ms = 600000,
+    .ocv_shift = 10,
+    .rate_shift = 8,
+    .ocv = k_bench_ocv,
+    .ocv_count = sizeof(k_bench_ocv) / sizeof(k_bench_ocv[0]),
+};
+
+// The simulated pack differs from what the gauge assumes: 2 % less capacity,
+// a curve 15 mV high, 110 mOhm of resistance plus a 60 mOhm polarisation
+// that relaxes over 90 s. Current is measured 1 % high with a 6 mA offset
+// and +-10 mA of noise, voltage with +-8 mV of noise.
+#define BENCH_PACK_MAH 4900.0
+#define BENCH_PACK_OCV_BIAS_MV 15.0
+#define BENCH_PACK_R0_MOHM 110.0
+#define BENCH_PACK_RP_MOHM 60.0
+#define BENCH_PACK_TAU_S 90.0
+
+typedef enum {
+    GAUGE_PHASE_REST_START = 0,
+    GAUGE_PHASE_DISCHARGE,
+    GAUGE_PHASE_REST_EMPTY,
+    GAUGE_PHASE_CHARGE,
+    GAUGE_PHASE_REST_FULL,
+    GAUGE_PHASE_DONE,
+} gauge_phase_t;
+
+static double bench_pack_ocv_mv(double permille) {
+    const size_t n = sizeof(k_bench_ocv) / sizeof(k_bench_ocv[0]);
+    for (size_t i = 1; i < n; ++i) {
+        if (permille <= k_bench_ocv[i].permille) {
+            const double t = (permille - k_bench_ocv[i - 1].permille) /
+                             (double)(k_bench_ocv[i].permille - k_bench_ocv[i - 1].permille);
+            return k_bench_ocv[i - 1].mv + t * (k_bench_ocv[i].mv - k_bench_ocv[i - 1].mv) + BENCH_PACK_OCV_BIAS_MV;
+        }
+    }
+    return k_bench_ocv[n - 1].mv + BENCH_PACK_OCV_BIAS_MV;
+}
+
+// Drives the fuel gauge through a simulated pack: 15 min at rest at 85 %, a
+// bursty discharge (-0.9 A, -2.6 A for 1 s in 4) to 8 %, 20 min at rest, a
+// 1.8 A charge to 95 % and 20 min at rest. The gauge starts from a stale
+// saved estimate of 65 % and is reset and restored halfway through the
+// discharge. Reports the worst charge error once the first rest has
+// corrected it, the time-to-empty and time-to-full error at mid-discharge and
+// mid-charge, and the cost per update. test_fuel_gauge holds the gauge to
+// bounds on the same run.
+static void run_fuel_gauge(FILE *out) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_bench_gauge);
+    fuel_gauge_restore(&g, (int64_t)k_bench_gauge.capacity_mah * 3600000 * 65 / 100);
+
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    const double dt_s = BENCH_GAUGE_STEP_MS / 1000.0;
+    double charge_mah = BENCH_PACK_MAH * 0.85;
+    double vp_mv = 0.0;
+    gauge_phase_t phase = GAUGE_PHASE_REST_START;
+    double phase_s = 0.0;
+    uint64_t now_us = 0;
+    int corrected_err = 0;
+    int max_err = 0;
+    int tte_err_pct = -1;
+    int ttf_err_pct = -1;
+    bool restored = false;
+    size_t updates = 0;
+    uint64_t gauge_ns = 0;
+    while (phase != GAUGE_PHASE_DONE) {
+        const size_t step = updates++;
+        double ma;
+        switch (phase) {
+            case GAUGE_PHASE_DISCHARGE: ma = step % 80 < 20 ? -2600.0 : -900.0; break;
+            case GAUGE_PHASE_CHARGE: ma = 1800.0; break;
+            default: ma = -20.0; break;
+        }
+        charge_mah += ma * dt_s / 3600.0;
+        vp_mv += (ma * BENCH_PACK_RP_MOHM / 1000.0 - vp_mv) * dt_s / BENCH_PACK_TAU_S;
+        const double true_permille = charge_mah * 1000.0 / BENCH_PACK_MAH;
+        const double mv = bench_pack_ocv_mv(true_permille) + ma * BENCH_PACK_R0_MOHM / 1000.0 + vp_mv;
+        const int meas_mv = (int)lround(mv) + (int)trace_noise(&rng, 17) - 8;
+        const int meas_ma = (int)lround(ma * 1.01) + 6 + (int)trace_noise(&rng, 21) - 10;
+        now_us += BENCH_GAUGE_STEP_MS * 1000;
+
+        const uint64_t start = now_ns();
+        fuel_gauge_update(&g, meas_mv, meas_ma, now_us);
+        gauge_ns += now_ns() - start;
+
+        const int err = abs(fuel_gauge_permille(&g) - (int)lround(true_permille));
+        if (phase != GAUGE_PHASE_REST_START && err > max_err) {
+            max_err = err;
+        }
+        if (phase == GAUGE_PHASE_DISCHARGE && true_permille <= 500.0 && tte_err_pct < 0) {
+            const double true_min = charge_mah / (0.25 * 2600.0 + 0.75 * 900.0) * 60.0;
+            tte_err_pct = (int)lround(fabs(fuel_gauge_time_to_empty_min(&g) - true_min) * 100.0 / true_min);
+        }
+        if (phase == GAUGE_PHASE_DISCHARGE && true_permille <= 400.0 && !restored) {
+            const int64_t saved = g.charge_mams;
+            fuel_gauge_init(&g, &k_bench_gauge);
+            fuel_gauge_restore(&g, saved);
+            restored = true;
+        }
+        if (phase == GAUGE_PHASE_CHARGE && true_permille >= 500.0 && ttf_err_pct < 0) {
+            const double true_min = (BENCH_PACK_MAH - charge_mah) / 1800.0 * 60.0;
+            ttf_err_pct = (int)lround(fabs(fuel_gauge_time_to_full_min(&g) - true_min) * 100.0 / true_min);
+        }
+
+        phase_s += dt_s;
+        bool next;
+        switch (phase) {
+            case GAUGE_PHASE_DISCHARGE: next = true_permille <= 80.0; break;
+            case GAUGE_PHASE_CHARGE: next = true_permille >= 950.0; break;
+            case GAUGE_PHASE_REST_START: next = phase_s >= 15 * 60; break;
+            default: next = phase_s >= 20 * 60; break;
+        }
+        if (next) {
+            if (phase == GAUGE_PHASE_REST_START) {
+                corrected_err = err;
+            }
+            phase = (gauge_phase_t)(phase + 1);
+            phase_s = 0.0;
+        }
+    }
+
+    const double ns_per_update = (double)gauge_ns / (double)updates;
+    fprintf(out,
+            "{\"bench\":\"fuel_gauge\",\"revision\":\"%s\",\"updates\":%zu,\"hours\":%.1f,\"ns_per_update\":%.2f,"
+            "\"ocv_updates\":%u,\"corrected_err_permille\":%d,\"max_err_permille\":%d,\"tte_err_pct\":%d,"
+            "\"ttf_err_pct\":%d}\n",
+            BENCH_REVISION, updates, now_us / 3.6e9, ns_per_update, (unsigned)g.ocv_updates, corrected_err, max_err,
+            tte_err_pct, ttf_err_pct);
+    fflush(out);
+    fprintf(stderr, "%-26s %6zu upd  %8.2f ns/update  soc err %d/%d permille  tte %d%%  ttf %d%%\n", "fuel_gauge",
+            updates, ns_per_update, corrected_err, max_err, tte_err_pct, ttf_err_pct);
+}
+
+// Times each kind of field as telemetry writes it. Whether the writers get
+// the values right is test_json_writer's job.
+static void run_number_format(size_t iterations, FILE *out) {
+    // Values as in a telemetry frame; the temperature wanders so the float
+    // path sees fractions, not one cached value.
+    char buf[64];
+    volatile size_t sink = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < iterations; ++i) {
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf));
+        json_writer_int(&w, 11750 - (int)(i & 1023));
+        sink += w.len;
+    }
+    const double int_ns = (double)(now_ns() - start) / (double)iterations;
+    start = now_ns();
+    for (size_t i = 0; i < iterations; ++i) {
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf));
+        json_writer_uint64(&w, 86400ULL * 30 + i);
+        sink += w.len;
+    }
+    const double uint64_ns = (double)(now_ns() - start) / (double)iterations;
+    start = now_ns();
+    for (size_t i = 0; i < iterations; ++i) {
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf));
+        json_writer_number(&w, 36.5f + (float)(i & 255) * 0.0137f);
+        sink += w.len;
+    }
+    const double number_ns = (double)(now_ns() - start) / (double)iterations;
+    start = now_ns();
+    for (size_t i = 0; i < iterations; ++i) {
+        json_writer_t w;
+        json_writer_init(&w, buf, sizeof(buf));
+        json_writer_float(&w, 36.5f + (float)(i & 255) * 0.0137f, TELEMETRY_TEMP_DECIMALS);
+        sink += w.len;
+    }
+    const double float_ns = (double)(now_ns() - start) / (double)iterations;
+    (void)sink;
+
+    fprintf(out,
+            "{\"bench\":\"number_format\",\"revision\":\"%s\",\"iterations\":%zu,\"int_ns\":%.1f,\"uint64_ns\":%.1f,"
+            "\"temp_number_ns\":%.1f,\"temp_fixed_ns\":%.1f,\"temp_decimals\":%d}\n",
+            BENCH_REVISION, iterations, int_ns, uint64_ns, number_ns, float_ns, TELEMETRY_TEMP_DECIMALS);
+    fflush(out);
+    fprintf(stderr, "%-26s int %5.1f ns  uint64 %5.1f ns  temp %6.1f -> %5.1f ns\n", "number_format", int_ns,
+            uint64_ns, number_ns, float_ns);
+}
+
+// Lines as the Pi sends them, from a bare command to a batch.
+static const char *const k_parse_lines[] = {
+    "{\"id\":\"12\",\"cmd\":\"get_status\"}",
+    "{\"id\":\"13\",\"cmd\":\"get_status\",\"fields\":[\"battery_pct\",\"pack_mv\",\"uptime_s\"]}",
+    "{\"id\":\"14\",\"cmd\":\"clear_unread\",\"source\":\"tui\"}",
+    "{\"id\":\"15\",\"cmd\":\"watch\",\"field\":\"pack_ma\",\"op\":\"<\",\"value\":-2000,\"hysteresis\":100}",
+    "{\"id\":\"16\",\"cmd\":\"subscribe\",\"topic\":\"telemetry\",\"min_ms\":250,\"max_ms\":10000}",
+    "[{\"id\":\"17\",\"cmd\":\"get_status\"},{\"id\":\"18\",\"cmd\":\"get_switches\"},"
+    "{\"id\":\"19\",\"cmd\":\"clear_unread\",\"source\":\"tui\"}]",
+};
+
+// Times parsing each line as the firmware does, a batch item by item, on a
+// fresh copy every time since the reader decodes strings in place.
+static bool run_command_parse(size_t iterations, FILE *out) {
+    bool ok = true;
+    char buf[256];
+    for (size_t l = 0; l < sizeof(k_parse_lines) / sizeof(k_parse_lines[0]); ++l) {
+        const char *line = k_parse_lines[l];
+        const size_t len = strlen(line);
+        const bool batch = line[0] == '[';
+        size_t items = 0;
+        json_read_error_t err = JSON_READ_OK;
+        const uint64_t start = now_ns();
+        for (size_t i = 0; i < iterations; ++i) {
+            memcpy(buf, line, len);
+            command_line_t parsed;
+            if (!batch) {
+                err = command_table_parse(buf, len, &parsed, NULL);
+                items = 1;
+                continue;
+            }
+            json_value_t array;
+            err = json_read_array(buf, len, &array, NULL);
+            json_array_iter_t it;
+            json_array_iter_init(&it, &array);
+            json_value_t item;
+            items = 0;
+            while (err == JSON_READ_OK && json_array_next(&it, &item)) {
+                err = command_table_parse((char *)item.ptr, item.len, &parsed, NULL);
+                ++items;
+            }
+        }
+        const double ns = (double)(now_ns() - start) / (double)iterations;
+        if (err != JSON_READ_OK) {
+            fprintf(stderr, "command_parse: line %zu failed: %s\n", l, json_read_error_name(err));
+            ok = false;
+        }
+        fprintf(out,
+                "{\"bench\":\"command_parse\",\"revision\":\"%s\",\"line\":%zu,\"bytes\":%zu,\"items\":%zu,"
+                "\"iterations\":%zu,\"ns\":%.1f,\"ns_per_byte\":%.2f}\n",
+                BENCH_REVISION, l, len, items, iterations, ns, ns / (double)len);
+        fprintf(stderr, "command_parse line %zu  %4zu B  %zu item(s)  %7.1f ns  %5.2f ns/B\n", l, len, items, ns,
+                ns / (double)len);
+    }
+    fflush(out);
+    return ok;
+}
+
+// Lines as the Pi's TUI sends them over a session: status polls, switch
+// reads, pings, unread clears from either source, the odd batch and
+// re-subscribe, some with CRLF endings.
+static const char *const k_replay_lines[] = {
+    "{\"id\":\"%u\",\"cmd\":\"get_status\",\"fields\":[\"battery_pct\",\"uptime_s\"]}\n",
+    "{\"id\":\"%u\",\"cmd\":\"get_status\"}\n",
+    "{\"id\":\"%u\",\"cmd\":\"get_switches\"}\r\n",
+    "{\"id\":\"%u\",\"cmd\":\"ping\"}\n",
+    "{\"id\":\"%u\",\"cmd\":\"clear_unread\",\"source\":\"tui\"}\n",
+    "{\"id\":\"%u\",\"cmd\":\"get_status\",\"fields\":[\"battery_pct\",\"pack_mv\",\"pack_ma\",\"uptime_s\"]}\n",
+    "[{\"id\":\"%u\",\"cmd\":\"get_status\"},{\"id\":\"b\",\"cmd\":\"get_switches\"},{\"id\":\"c\",\"cmd\":\"get_stats\"}]\n",
+    "{\"id\":\"%u\",\"cmd\":\"subscribe\",\"topic\":\"telemetry\",\"min_ms\":500,\"max_ms\":10000}\r\n",
+};
+
+static size_t make_replay(char *buf, size_t cap) {
+    uint64_t rng = 0x5EED;
+    size_t len = 0;
+    for (unsigned id = 1;; ++id) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        // Polls dominate; batches and subscribes are rare.
+        static const uint8_t k_mix[] = {0, 0, 0, 1, 1, 2, 2, 3, 4, 5, 5, 6, 7};
+        const char *fmt = k_replay_lines[k_mix[rng % sizeof(k_mix)]];
+        char line[256];
+        const int n = snprintf(line, sizeof(line), fmt, id);
+        if (len + (size_t)n > cap) {
+            return len;
+        }
+        memcpy(buf + len, line, (size_t)n);
+        len += (size_t)n;
+    }
+}
+
+static void replay_on_line(char *line, size_t len, void *ctx) {
+    (void)line;
+    (void)len;
+    ++*(size_t *)ctx;
+}
+
+// Feeds Pi traffic through line_splitter as io_task does, in reads of
+// `chunk` bytes, and reports CPU time per KB. One byte per read stands in for
+// the old byte-at-a-time reader, leaving out its driver call per byte; 120 is
+// the driver's RX FIFO threshold and SUPV_RX_CHUNK the firmware's read size.
+static void run_rx_replay(const char *path, size_t passes, FILE *out) {
+    static char trace[64 * 1024];
+    size_t trace_len;
+    const char *source = "synthetic";
+    if (path) {
+        FILE *f = fopen(path, "rb");
+        if (!f) {
+            perror(path);
+            return;
+        }
+        trace_len = fread(trace, 1, sizeof(trace), f);
+        fclose(f);
+        source = path;
+    } else {
+        trace_len = make_replay(trace, sizeof(trace));
+    }
+    if (trace_len == 0) {
+        fprintf(stderr, "rx_replay: %s is empty\n", source);
+        return;
+    }
+    static char work[sizeof(trace)];
+    static const size_t k_chunks[] = {1, 32, 120, SUPV_RX_CHUNK};
+    double byte_ns_per_kb = 0;
+    for (size_t c = 0; c < sizeof(k_chunks) / sizeof(k_chunks[0]); ++c) {
+        const size_t chunk = k_chunks[c];
+        char line_buf[SUPV_LINE_BUF];
+        size_t lines = 0;
+        line_splitter_t splitter;
+        line_splitter_init(&splitter, line_buf, sizeof(line_buf), replay_on_line, &lines);
+        uint64_t elapsed = 0;
+        for (size_t p = 0; p < passes; ++p) {
+            // The splitter terminates lines in place, so each pass gets a
+            // fresh copy, outside the timed part.
+            memcpy(work, trace, trace_len);
+            const uint64_t start = now_ns();
+            for (size_t at = 0; at < trace_len; at += chunk) {
+                line_splitter_feed(&splitter, work + at, trace_len - at < chunk ? trace_len - at : chunk);
+            }
+            elapsed += now_ns() - start;
+        }
+        const double ns_per_kb = (double)elapsed / (double)passes / ((double)trace_len / 1024.0);
+        if (chunk == 1) {
+            byte_ns_per_kb = ns_per_kb;
+        }
+        lines /= passes;
+        fprintf(out,
+                "{\"bench\":\"rx_replay\",\"revision\":\"%s\",\"source\":\"%s\",\"bytes\":%zu,\"lines\":%zu,"
+                "\"chunk\":%zu,\"passes\":%zu,\"ns_per_kb\":%.1f,\"overflows\":%u}\n",
+                BENCH_REVISION, source, trace_len, lines, chunk, passes, ns_per_kb, (unsigned)splitter.overflows);
+        fprintf(stderr, "rx_replay chunk %4zu  %6zu B  %5zu lines  %9.1f ns/KB  %5.1fx\n", chunk, trace_len, lines,
+                ns_per_kb, byte_ns_per_kb / ns_per_kb);
+    }
+    fflush(out);
+}
+
+// One sample of a discharge from full to 5 % over BENCH_DISCHARGE_HOURS, as
+// the firmware would see it at time `t_us`: voltage following charge with
+// +-15 mV of ADC noise, current idling near -420 mA with a radio burst every
+// few minutes, the board warming and cooling slowly, messages arriving and
+// getting read, and a switch flipped now and then.
+static void discharge_sample(supervisor_state_t *s, uint64_t t_us, uint64_t span_us, uint64_t *rng) {
+    memset(s, 0, sizeof(*s));
+    const double frac = (double)t_us / (double)span_us;
+    const double pct = 100.0 - 95.0 * frac;
+    s->battery_pct = (int)(pct + 0.5);
+    s->pack_mv = 9600 + (int)(30.0 * pct) + (int)trace_noise(rng, 31) - 15;
+    const uint64_t t_s = t_us / 1000000;
+    const bool burst = t_s % 240 < 3;
+    s->pack_ma = (burst ? -2600 : -420) + (int)trace_noise(rng, 61) - 30;
+    s->time_to_empty_min = (int)((span_us - t_us) / 60000000ULL);
+    s->time_to_full_min = -1;
+    s->mcu_temp_c = 41.0f + 6.0f * sinf(6.2831853f * (float)t_s / 3600.0f) + (float)trace_noise(rng, 5) * 0.1f;
+    s->unread_ext = (int)(t_s % 1800 / 300);
+    s->last_mesh_event_us = (t_s - t_s % 300) * 1000000ULL;
+    snprintf(s->heltec, sizeof(s->heltec), "ok");
+    snprintf(s->mcu, sizeof(s->mcu), "proto-0.1");
+    s->switches = (supervisor_switch_state_t){
+        .lte = true, .wifi = t_s % 7200 < 5400, .bridge_enable = true, .lid_open = true};
+}
+
+static size_t telemetry_json_bytes(const supervisor_state_t *state, uint64_t now_us, telemetry_mask_t mask) {
+    char buf[512];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_writer_begin_object(&w);
+    json_writer_add_string(&w, "event", "telemetry");
+    telemetry_encode_fields(&w, state, now_us, mask);
+    json_writer_end_object(&w);
+    return json_writer_end_line(&w);
+}
+
+static size_t telemetry_binary_bytes(const supervisor_state_t *state, uint64_t now_us, telemetry_mask_t mask) {
+    uint8_t payload[256];
+    uint8_t wire[BINFRAME_MAX_WIRE];
+    const size_t len = binframe_encode_telemetry(state, now_us, mask, payload, sizeof(payload));
+    return binframe_encode(BINFRAME_TYPE_TELEMETRY, payload, len, wire, sizeof(wire));
+}
+
+// Replays a battery discharge through telemetry_delta at the firmware's poll
+// rate and reports the bytes it puts on the wire, in JSON and binary framing,
+// against the full dump every 2 s it replaced.
+static void run_telemetry_replay(FILE *out) {
+    const uint64_t span_us = BENCH_DISCHARGE_HOURS * 3600ULL * 1000000ULL;
+    const telemetry_delta_config_t cfg = {
+        .pack_mv_deadband = BENCH_TELEMETRY_DEADBAND_PACK_MV,
+        .pack_ma_deadband = BENCH_TELEMETRY_DEADBAND_PACK_MA,
+        .runtime_deadband_min = BENCH_TELEMETRY_DEADBAND_RUNTIME_MIN,
+        .mcu_temp_deadband_c = BENCH_TELEMETRY_DEADBAND_TEMP_C,
+        .keyframe_interval_ms = BENCH_TELEMETRY_KEYFRAME_MS,
+    };
+    telemetry_delta_t delta;
+    telemetry_delta_init(&delta, &cfg);
+    uint64_t rng = 0x5EED;
+    size_t samples = 0;
+    size_t delta_frames = 0;
+    size_t delta_json = 0;
+    size_t delta_binary = 0;
+    size_t delta_fields = 0;
+    size_t full_frames = 0;
+    size_t full_json = 0;
+    uint64_t update_ns = 0;
+    for (uint64_t t_us = 0; t_us < span_us; t_us += BENCH_TELEMETRY_POLL_MS * 1000ULL) {
+        supervisor_state_t state;
+        discharge_sample(&state, t_us, span_us, &rng);
+        ++samples;
+        const uint64_t start = now_ns();
+        const telemetry_mask_t mask = telemetry_delta_update(&delta, &state, t_us);
+        update_ns += now_ns() - start;
+        if (mask) {
+            ++delta_frames;
+            delta_fields += (size_t)__builtin_popcount(mask);
+            delta_json += telemetry_json_bytes(&state, t_us, mask);
+            delta_binary += telemetry_binary_bytes(&state, t_us, mask);
+        }
+        if (t_us % (BENCH_TELEMETRY_FULL_DUMP_MS * 1000ULL) == 0) {
+            ++full_frames;
+            full_json += telemetry_json_bytes(&state, t_us, TELEMETRY_FIELDS_ALL);
+        }
+    }
+    const double seconds = (double)span_us / 1e6;
+    const double saved_pct = 100.0 * (1.0 - (double)delta_json / (double)full_json);
+    fprintf(out,
+            "{\"bench\":\"telemetry_replay\",\"revision\":\"%s\",\"hours\":%d,\"samples\":%zu,"
+            "\"ns_per_update\":%.1f,\"full_frames\":%zu,\"full_bytes\":%zu,\"delta_frames\":%zu,"
+            "\"delta_fields_per_frame\":%.2f,\"delta_bytes\":%zu,\"delta_binary_bytes\":%zu,\"saved_pct\":%.1f,"
+            "\"full_link_pct\":%.2f,\"delta_link_pct\":%.2f,\"delta_binary_link_pct\":%.2f}\n",
+            BENCH_REVISION, BENCH_DISCHARGE_HOURS, samples, (double)update_ns / (double)samples, full_frames,
+            full_json, delta_frames, delta_frames ? (double)delta_fields / (double)delta_frames : 0.0, delta_json,
+            delta_binary, saved_pct, 100.0 * (double)full_json / seconds / BENCH_WIRE_BYTES_PER_S,
+            100.0 * (double)delta_json / seconds / BENCH_WIRE_BYTES_PER_S,
+            100.0 * (double)delta_binary / seconds / BENCH_WIRE_BYTES_PER_S);
+    fflush(out);
+    fprintf(stderr, "%-26s full %8zu B in %6zu frames  delta %8zu B json / %8zu B binary in %6zu frames  %.1f%% saved\n",
+            "telemetry_replay", full_json, full_frames, delta_json, delta_binary, delta_frames, saved_pct);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--requests N] [--only NAME] [--wire-timing] [--replay FILE] [--out FILE]\n"
+            "  --requests N  requests per workload (default 2000; encode and watch runs do 100x as many,\n"
+            "                adc_filter 1000x as many samples, switch_bounce 1/20 as many windows,\n"
+            "                priority_latency 1/4 as many requests, always with wire timing;\n"
+            "                fuel_gauge and telemetry_replay each run a fixed six-hour discharge;\n"
+            "                number_format times 100x as many fields; command_parse parses each\n"
+            "                line 100x as many times; rx_replay\n"
+            "                makes requests / 10 passes)\n"
+            "  --only NAME   run a single workload\n"
+            "  --wire-timing model 115200 baud transmit time (default off: firmware cost only)\n"
+            "  --replay FILE Pi traffic captured from the UART for rx_replay (default: a synthetic session)\n"
+            "  --out FILE    write JSON results to FILE instead of stdout\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    size_t requests = 2000;
+    const char *only = NULL;
+    const char *out_path = NULL;
+    const char *replay_path = NULL;
+    bool wire_timing = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--wire-timing") == 0) {
+            wire_timing = true;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (requests == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 1;
+    }
+
+    int to_fw[2];
+    int from_fw[2];
+    if (pipe(to_fw) != 0 || pipe(from_fw) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    sim_cond_init(&g_run.progress);
+    g_host_tx_fd = to_fw[1];
+    g_host_rx_fd = from_fw[0];
+    sim_uart_attach(BENCH_SUPV_UART, to_fw[0], from_fw[1]);
+    g_wire_timing = wire_timing;
+    sim_uart_set_wire_timing(wire_timing);
+    sim_log_set_level(ESP_LOG_ERROR);
+    sim_adc_set_pack(11750, -420);
+
+    pthread_t collector;
+    if (pthread_create(&collector, NULL, collector_thread, NULL) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+    app_main();
+    // Let the boot-time switch event and first telemetry keyframe drain.
+    vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+
+    bool ran = false;
+    for (size_t w = 0; w < sizeof(g_workloads) / sizeof(g_workloads[0]); ++w) {
+        if (only && strcmp(only, g_workloads[w].name) != 0) {
+            continue;
+        }
+        run_workload(&g_workloads[w], requests, wire_timing, out);
+        vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+        ran = true;
+    }
+    if (!only || strcmp(only, "priority_latency") == 0) {
+        run_priority_latency(requests / 4 ? requests / 4 : 1, out);
+        vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+        ran = true;
+    }
+    if (!only || strcmp(only, "projection_encode") == 0) {
+        run_projection_encode(requests * 100, out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "watch_eval") == 0) {
+        run_watch_trace(requests * 100, out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "adc_filter") == 0) {
+        run_adc_filter(requests * 1000, out);
+        ran = true;
+    }
+    bool ok = true;
+    if (!only || strcmp(only, "switch_bounce") == 0) {
+        ok = run_switch_bounce(requests / 20 ? requests / 20 : 1, out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "fuel_gauge") == 0) {
+        run_fuel_gauge(out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "number_format") == 0) {
+        run_number_format(requests * 100, out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "command_parse") == 0) {
+        ok = run_command_parse(requests * 100, out) && ok;
+        ran = true;
+    }
+    if (!only || strcmp(only, "telemetry_replay") == 0) {
+        run_telemetry_replay(out);
+        ran = true;
+    }
+    if (!only || strcmp(only, "rx_replay") == 0) {
+        run_rx_replay(replay_path, requests / 10 ? requests / 10 : 1, out);
+        ran = true;
+    }
+    if (!ran) {
+        fprintf(stderr, "no workload named %s\n", only);
+        return 2;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: MIT
+// Host simulator stand-in for ESP-IDF's esp_adc/adc_cali.h.
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct sim_adc_cali *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage);
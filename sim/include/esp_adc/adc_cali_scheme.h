@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+// Host simulator stand-in for ESP-IDF's esp_adc/adc_cali_scheme.h. The line
+// fitting scheme maps codes linearly onto the attenuation's nominal range.
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_adc/adc_cali.h"
+#include "hal/adc_types.h"
+
+#define ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED 1
+
+typedef struct {
+    adc_unit_t unit_id;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+    uint32_t default_vref;
+} adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *ret_handle);
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle);
@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: MIT
+// Host simulator stand-in for ESP-IDF's esp_attr.h. There is no IRAM or RTC
+// memory on the host, so placement attributes expand to nothing and
+// RTC_NOINIT data starts zeroed like any other static.
+#pragma once
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
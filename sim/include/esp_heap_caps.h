@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MIT
+// Host simulator stand-in for ESP-IDF's esp_heap_caps.h. With
+// CONFIG_HEAP_USE_HOOKS (set for every sim target) the allocator wrappers in
+// port/heap.c call these after each successful allocation and before each
+// free, as the target's heap does.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+#if CONFIG_HEAP_USE_HOOKS
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+#endif
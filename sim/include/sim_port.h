@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+// Simulator-only hooks used by sim_main.c; firmware code never includes this.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_log.h"
+
+// Backs `port` with the given descriptors. Must be called before the
+// firmware's uart_driver_install.
+void sim_uart_attach(uart_port_t port, int rx_fd, int tx_fd);
+
+typedef void (*sim_uart_tx_hook_t)(const uint8_t *data, size_t len, void *ctx);
+
+// Delivers everything the firmware writes to `port` to `hook` instead of a
+// descriptor. Counts as attaching the port.
+void sim_uart_set_tx_hook(uart_port_t port, sim_uart_tx_hook_t hook, void *ctx);
+
+// Feeds bytes into the RX side of `port` as the driver's RX interrupt would.
+// Under virtual time this is how received data arrives; call it from a
+// sim_virtual_call_at callout.
+void sim_uart_inject(uart_port_t port, const void *data, size_t len);
+
+// When enabled (the default) uart_write_bytes blocks for the time the bytes
+// would take on the wire at the configured baud rate, like the real driver
+// with no TX ring buffer.
+void sim_uart_set_wire_timing(bool enabled);
+
+// True once the RX descriptor of `port` reported end-of-file.
+bool sim_uart_rx_closed(uart_port_t port);
+
+void sim_log_set_level(esp_log_level_t level);
+
+// Drives an input pin from outside, as the board would; fires its interrupt
+// handler (in the caller's context) when the change matches the configured
+// edge. Under virtual time call it from a sim_virtual_call_at callout.
+void sim_gpio_drive(gpio_num_t gpio_num, int level);
+
+typedef void (*sim_gpio_output_hook_t)(gpio_num_t gpio_num, int level, void *ctx);
+
+// Reports every level change the firmware makes on an output pin.
+void sim_gpio_set_output_hook(sim_gpio_output_hook_t hook, void *ctx);
+
+// Sets what `channel` of ADC1 reads in continuous mode: `count` raw codes
+// replayed in a loop, one per conversion of that channel. The first call
+// attaches the ADC; until then adc_continuous_new_handle fails as on a board
+// without it. Frames are produced at the configured sample rate, which under
+// virtual time costs a callout per frame.
+void sim_adc_set_stream(adc_channel_t channel, const uint16_t *samples, size_t count);
+void sim_adc_set_level(adc_channel_t channel, uint16_t raw);
+
+// The raw code that the line fitting calibration maps to `mv`.
+uint16_t sim_adc_raw_from_mv(adc_atten_t atten, int mv);
+
+// Holds the pack at a steady voltage and current, through the divider and
+// shunt amplifier front end wired up in src/main.c.
+void sim_adc_set_pack(int pack_mv, int pack_ma);
+
+// Virtual time: tasks run one at a time on a simulated clock that jumps
+// straight to the next timeout, so long stretches of firmware time execute
+// quickly and deterministically. Must be enabled before any task exists;
+// `seed` picks the order in which equal-priority ready tasks run.
+void sim_virtual_time_enable(uint64_t seed);
+
+// Runs `entry` as the ESP-IDF main task and schedules until `duration_us` of
+// firmware time has passed (UINT64_MAX: until nothing is left to run).
+// Returns the virtual time reached.
+uint64_t sim_virtual_run(void (*entry)(void), uint64_t duration_us);
+
+// Schedules `fn(arg)` at virtual time `at_us` in interrupt context: it may
+// only use ISR-safe calls such as sim_uart_inject or sim_virtual_call_at.
+bool sim_virtual_call_at(uint64_t at_us, void (*fn)(void *arg), void *arg);
+
+uint64_t sim_virtual_now_us(void);
+uint64_t sim_virtual_context_switches(void);
+
+// Tasks currently alive and the total stack depth they were created with,
+// which on the target is RAM reserved for them.
+void sim_task_footprint(size_t *tasks, size_t *stack_bytes);
+
+// The allocator itself, bypassing the heap accounting below; for memory the
+// harness needs that should not count as the firmware's.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+typedef struct {
+    // Successful allocations since start.
+    size_t alloc_calls;
+    // Bytes allocated now, and the most since start or sim_heap_reset_peak.
+    size_t in_use;
+    size_t peak;
+} sim_heap_stats_t;
+
+void sim_heap_stats(sim_heap_stats_t *out);
+void sim_heap_reset_peak(void);
@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: MIT
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sim_internal.h"
+#include "sim_port.h"
+
+static const char *TAG = "sim_adc";
+
+#define SIM_ADC_CHANNELS 10
+
+// What each ADC1 channel reads: a recorded stream replayed in a loop.
+typedef struct {
+    uint16_t *samples;
+    size_t count;
+    size_t pos;
+} sim_adc_stream_t;
+
+// The continuous-mode driver: conversion frames are produced at the
+// configured rate into a byte pool and announced with on_conv_done, like the
+// DMA EOF interrupt. A producer thread does this in real time; under virtual
+// time a callout per frame does.
+struct sim_adc_continuous {
+    adc_continuous_handle_cfg_t cfg;
+    adc_digi_pattern_config_t pattern[SIM_ADC_CHANNELS];
+    uint32_t pattern_num;
+    uint32_t sample_freq_hz;
+    adc_continuous_evt_cbs_t cbs;
+    void *user_data;
+    bool running;
+    uint64_t frame_us;
+    uint64_t next_frame_us;
+    size_t pattern_pos;
+    uint8_t *frame;
+    uint8_t *pool;
+    size_t head;
+    size_t count;
+    pthread_t producer;
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+};
+
+static sim_adc_stream_t g_streams[SIM_ADC_CHANNELS];
+static pthread_mutex_t g_stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_attached;
+
+void sim_adc_set_stream(adc_channel_t channel, const uint16_t *samples, size_t count) {
+    if (channel < 0 || channel >= SIM_ADC_CHANNELS || !samples || count == 0) {
+        return;
+    }
+    // The stream is the outside world, not something the firmware allocated,
+    // so it stays out of the heap accounting; hosts may swap it at any time.
+    uint16_t *copy = __real_malloc(count * sizeof(*copy));
+    if (!copy) {
+        return;
+    }
+    memcpy(copy, samples, count * sizeof(*copy));
+    pthread_mutex_lock(&g_stream_lock);
+    __real_free(g_streams[channel].samples);
+    g_streams[channel] = (sim_adc_stream_t){.samples = copy, .count = count};
+    g_attached = true;
+    pthread_mutex_unlock(&g_stream_lock);
+}
+
+void sim_adc_set_level(adc_channel_t channel, uint16_t raw) {
+    sim_adc_set_stream(channel, &raw, 1);
+}
+
+// Nominal full scale of the line fitting scheme for each attenuation.
+static int full_scale_mv(adc_atten_t atten) {
+    switch (atten) {
+        case ADC_ATTEN_DB_0: return 950;
+        case ADC_ATTEN_DB_2_5: return 1250;
+        case ADC_ATTEN_DB_6: return 1750;
+        default: return 3100;
+    }
+}
+
+uint16_t sim_adc_raw_from_mv(adc_atten_t atten, int mv) {
+    const int scale = full_scale_mv(atten);
+    const int clamped = mv < 0 ? 0 : mv > scale ? scale : mv;
+    return (uint16_t)((clamped * 4095 + scale / 2) / scale);
+}
+
+void sim_adc_set_pack(int pack_mv, int pack_ma) {
+    sim_adc_set_level(ADC_CHANNEL_6, sim_adc_raw_from_mv(ADC_ATTEN_DB_12, pack_mv * 22 / 122));
+    sim_adc_set_level(ADC_CHANNEL_7, sim_adc_raw_from_mv(ADC_ATTEN_DB_12, 1650 + pack_ma / 2));
+}
+
+static void produce_frame(struct sim_adc_continuous *adc) {
+    const size_t results = adc->cfg.conv_frame_size / sizeof(adc_digi_output_data_t);
+    adc_digi_output_data_t *out = (adc_digi_output_data_t *)adc->frame;
+    pthread_mutex_lock(&g_stream_lock);
+    for (size_t i = 0; i < results; ++i) {
+        const uint8_t channel = adc->pattern[adc->pattern_pos].channel;
+        adc->pattern_pos = adc->pattern_pos + 1 == adc->pattern_num ? 0 : adc->pattern_pos + 1;
+        sim_adc_stream_t *s = &g_streams[channel < SIM_ADC_CHANNELS ? channel : 0];
+        uint16_t raw = 0;
+        if (s->count) {
+            raw = s->samples[s->pos];
+            s->pos = s->pos + 1 == s->count ? 0 : s->pos + 1;
+        }
+        out[i].val = 0;
+        out[i].type1.data = raw > 4095 ? 4095 : raw;
+        out[i].type1.channel = channel;
+    }
+    pthread_mutex_unlock(&g_stream_lock);
+
+    const size_t size = adc->cfg.conv_frame_size;
+    pthread_mutex_lock(&adc->lock);
+    const bool fits = adc->count + size <= adc->cfg.max_store_buf_size;
+    if (fits) {
+        const size_t cap = adc->cfg.max_store_buf_size;
+        for (size_t i = 0; i < size; ++i) {
+            adc->pool[(adc->head + adc->count + i) % cap] = adc->frame[i];
+        }
+        adc->count += size;
+        sim_wake(&adc->readable);
+    }
+    pthread_mutex_unlock(&adc->lock);
+
+    const adc_continuous_evt_data_t edata = {.conv_frame_buffer = adc->frame, .size = (uint32_t)size};
+    if (fits && adc->cbs.on_conv_done) {
+        adc->cbs.on_conv_done(adc, &edata, adc->user_data);
+    } else if (!fits && adc->cbs.on_pool_ovf) {
+        adc->cbs.on_pool_ovf(adc, &edata, adc->user_data);
+    }
+}
+
+static void frame_callout(void *arg) {
+    struct sim_adc_continuous *adc = arg;
+    if (!adc->running) {
+        return;
+    }
+    produce_frame(adc);
+    adc->next_frame_us += adc->frame_us;
+    sim_virtual_call_at(adc->next_frame_us, frame_callout, adc);
+}
+
+static void *producer_thread(void *arg) {
+    struct sim_adc_continuous *adc = arg;
+    while (adc->running) {
+        const uint64_t now_us = (uint64_t)esp_timer_get_time();
+        if (now_us < adc->next_frame_us) {
+            const uint64_t us = adc->next_frame_us - now_us;
+            struct timespec ts = {.tv_sec = (time_t)(us / 1000000ULL), .tv_nsec = (long)(us % 1000000ULL) * 1000L};
+            while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+            }
+            continue;
+        }
+        produce_frame(adc);
+        adc->next_frame_us += adc->frame_us;
+    }
+    return NULL;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *cfg, adc_continuous_handle_t *ret_handle) {
+    if (!cfg || !ret_handle || cfg->conv_frame_size == 0 || cfg->conv_frame_size % sizeof(adc_digi_output_data_t) ||
+        cfg->max_store_buf_size < cfg->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_attached) {
+        ESP_LOGE(TAG, "No ADC input streams set");
+        return ESP_ERR_NOT_FOUND;
+    }
+    struct sim_adc_continuous *adc = calloc(1, sizeof(*adc));
+    if (!adc) {
+        return ESP_ERR_NO_MEM;
+    }
+    adc->cfg = *cfg;
+    adc->frame = malloc(cfg->conv_frame_size);
+    adc->pool = malloc(cfg->max_store_buf_size);
+    if (!adc->frame || !adc->pool) {
+        free(adc->frame);
+        free(adc->pool);
+        free(adc);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_init(&adc->lock, NULL);
+    sim_cond_init(&adc->readable);
+    *ret_handle = adc;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t adc, const adc_continuous_config_t *config) {
+    if (!adc || !config || config->pattern_num == 0 || config->pattern_num > SIM_ADC_CHANNELS ||
+        config->sample_freq_hz == 0 || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (adc->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memcpy(adc->pattern, config->adc_pattern, config->pattern_num * sizeof(adc->pattern[0]));
+    adc->pattern_num = config->pattern_num;
+    adc->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t adc, const adc_continuous_evt_cbs_t *cbs,
+                                                  void *user_data) {
+    if (!adc || !cbs) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (adc->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    adc->cbs = *cbs;
+    adc->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t adc) {
+    if (!adc || adc->pattern_num == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (adc->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const uint64_t results = adc->cfg.conv_frame_size / sizeof(adc_digi_output_data_t);
+    adc->frame_us = results * 1000000ULL / adc->sample_freq_hz;
+    adc->next_frame_us = (uint64_t)esp_timer_get_time() + adc->frame_us;
+    adc->running = true;
+    if (sim_virtual_time()) {
+        return sim_virtual_call_at(adc->next_frame_us, frame_callout, adc) ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    if (pthread_create(&adc->producer, NULL, producer_thread, adc) != 0) {
+        adc->running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t adc) {
+    if (!adc || !adc->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    adc->running = false;
+    if (!sim_virtual_time()) {
+        pthread_join(adc->producer, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t adc, uint8_t *buf, uint32_t length_max, uint32_t *out_length,
+                              uint32_t timeout_ms) {
+    if (!adc || !buf || !out_length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_deadline_t deadline;
+    sim_deadline(pdMS_TO_TICKS(timeout_ms), &deadline);
+    pthread_mutex_lock(&adc->lock);
+    while (adc->count == 0) {
+        if (timeout_ms == 0 || !sim_block(&adc->readable, &adc->lock, &deadline)) {
+            pthread_mutex_unlock(&adc->lock);
+            *out_length = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    size_t n = adc->count < length_max ? adc->count : length_max;
+    n -= n % sizeof(adc_digi_output_data_t);
+    const size_t cap = adc->cfg.max_store_buf_size;
+    for (size_t i = 0; i < n; ++i) {
+        buf[i] = adc->pool[(adc->head + i) % cap];
+    }
+    adc->head = (adc->head + n) % cap;
+    adc->count -= n;
+    pthread_mutex_unlock(&adc->lock);
+    *out_length = (uint32_t)n;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t adc) {
+    if (!adc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (adc->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(adc->frame);
+    free(adc->pool);
+    free(adc);
+    return ESP_OK;
+}
+
+struct sim_adc_cali {
+    adc_atten_t atten;
+};
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *ret_handle) {
+    if (!config || !ret_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct sim_adc_cali *cali = malloc(sizeof(*cali));
+    if (!cali) {
+        return ESP_ERR_NO_MEM;
+    }
+    cali->atten = config->atten;
+    *ret_handle = cali;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage) {
+    if (!handle || !voltage) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *voltage = (raw * full_scale_mv(handle->atten) + 2047) / 4095;
+    return ESP_OK;
+}
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: MIT
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_internal.h"
+
+// One-shot timers dispatched from a single "esp_timer" task, created with the
+// first timer, that sleeps until the earliest armed deadline.
+#define SIM_ESP_TIMER_PRIORITY 22
+
+struct sim_esp_timer {
+    struct sim_esp_timer *next;
+    esp_timer_cb_t callback;
+    void *arg;
+    bool armed;
+    uint64_t at_us;
+};
+
+static pthread_mutex_t g_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_timer_cond;
+static struct sim_esp_timer *g_timers;
+static TaskHandle_t g_timer_task;
+
+static void deadline_at(uint64_t at_us, sim_deadline_t *deadline) {
+    deadline->forever = at_us == UINT64_MAX;
+    if (deadline->forever) {
+        return;
+    }
+    if (sim_virtual_time()) {
+        deadline->virtual_us = at_us;
+        return;
+    }
+    const uint64_t now_us = (uint64_t)esp_timer_get_time();
+    const uint64_t wait_ns = at_us > now_us ? (at_us - now_us) * 1000ULL : 0;
+    clock_gettime(CLOCK_MONOTONIC, &deadline->real);
+    const uint64_t ns = wait_ns + (uint64_t)deadline->real.tv_nsec;
+    deadline->real.tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline->real.tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+static void timer_task(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_timer_lock);
+    while (true) {
+        const uint64_t now_us = (uint64_t)esp_timer_get_time();
+        struct sim_esp_timer *due = NULL;
+        uint64_t next_us = UINT64_MAX;
+        for (struct sim_esp_timer *t = g_timers; t; t = t->next) {
+            if (!t->armed) {
+                continue;
+            }
+            if (t->at_us <= now_us && (!due || t->at_us < due->at_us)) {
+                due = t;
+            } else if (t->at_us > now_us && t->at_us < next_us) {
+                next_us = t->at_us;
+            }
+        }
+        if (due) {
+            due->armed = false;
+            const esp_timer_cb_t callback = due->callback;
+            void *cb_arg = due->arg;
+            pthread_mutex_unlock(&g_timer_lock);
+            callback(cb_arg);
+            pthread_mutex_lock(&g_timer_lock);
+            continue;
+        }
+        sim_deadline_t deadline;
+        deadline_at(next_us, &deadline);
+        sim_block(&g_timer_cond, &g_timer_lock, &deadline);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+    if (!args || !args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct sim_esp_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    pthread_mutex_lock(&g_timer_lock);
+    timer->next = g_timers;
+    g_timers = timer;
+    const bool start_task = !g_timer_task;
+    if (start_task) {
+        sim_cond_init(&g_timer_cond);
+    }
+    pthread_mutex_unlock(&g_timer_lock);
+    if (start_task && xTaskCreate(timer_task, "esp_timer", 4096, NULL, SIM_ESP_TIMER_PRIORITY, &g_timer_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_timer_lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&g_timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->at_us = (uint64_t)esp_timer_get_time() + timeout_us;
+    sim_wake(&g_timer_cond);
+    pthread_mutex_unlock(&g_timer_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_timer_lock);
+    const bool was_armed = timer->armed;
+    timer->armed = false;
+    pthread_mutex_unlock(&g_timer_lock);
+    return was_armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_timer_lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&g_timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (struct sim_esp_timer **p = &g_timers; *p; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_timer_lock);
+    free(timer);
+    return ESP_OK;
+}
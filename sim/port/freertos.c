@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: MIT
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim_internal.h"
+#include "sim_port.h"
+
+// Tasks alive right now and the stack they would reserve on the target.
+static atomic_size_t g_live_tasks;
+static atomic_size_t g_live_stack_bytes;
+
+struct sim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+    uint8_t *items;
+    // Queue set told about every item sent here, if any.
+    struct sim_queue *set;
+    // Built in caller-owned storage by a *Static constructor.
+    bool is_static;
+};
+
+_Static_assert(sizeof(struct sim_queue) <= sizeof(StaticQueue_t), "StaticQueue_t too small for the shim's queue");
+_Static_assert(sizeof(struct sim_task) <= sizeof(StaticTask_t), "StaticTask_t too small for the shim's task");
+
+static void queue_setup(struct sim_queue *q, size_t length, size_t item_size, uint8_t *items) {
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    sim_cond_init(&q->not_empty);
+    sim_cond_init(&q->not_full);
+    q->item_size = item_size;
+    q->length = length;
+    q->items = items;
+}
+
+static struct sim_queue *queue_new(size_t length, size_t item_size) {
+    struct sim_queue *q = malloc(sizeof(*q));
+    uint8_t *items = item_size > 0 ? calloc(length, item_size) : NULL;
+    if (!q || (item_size > 0 && !items)) {
+        free(q);
+        free(items);
+        return NULL;
+    }
+    queue_setup(q, length, item_size, items);
+    return q;
+}
+
+static struct sim_queue *queue_new_static(size_t length, size_t item_size, uint8_t *items, void *buffer) {
+    struct sim_queue *q = buffer;
+    queue_setup(q, length, item_size, items);
+    q->is_static = true;
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return length ? queue_new(length, item_size) : NULL;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buffer) {
+    if (!length || !buffer || (item_size > 0 && !storage)) {
+        return NULL;
+    }
+    return queue_new_static(length, item_size, item_size > 0 ? storage : NULL, buffer);
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (!q) {
+        return;
+    }
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    if (!q->is_static) {
+        free(q->items);
+        free(q);
+    }
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks_to_wait) {
+    sim_deadline_t deadline;
+    sim_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (ticks_to_wait == 0 || !sim_block(&q->not_full, &q->lock, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    if (q->item_size) {
+        memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    }
+    ++q->count;
+    sim_wake(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    if (q->set) {
+        // Sized for every member to be full, so this never blocks.
+        queue_send(q->set, &q, 0);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks_to_wait) {
+    const BaseType_t sent = queue_send(q, item, ticks_to_wait);
+    sim_preempt_point();
+    return sent;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken) {
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return queue_send(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks_to_wait) {
+    sim_deadline_t deadline;
+    sim_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (ticks_to_wait == 0 || !sim_block(&q->not_empty, &q->lock, &deadline)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    if (q->item_size && item) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    }
+    q->head = (q->head + 1) % q->length;
+    --q->count;
+    sim_wake(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    sim_preempt_point();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    sim_wake(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    sim_preempt_point();
+    return pdPASS;
+}
+
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length) {
+    return length ? queue_new(length, sizeof(QueueSetMemberHandle_t)) : NULL;
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set) {
+    pthread_mutex_lock(&member->lock);
+    const bool ok = !member->set && member->count == 0;
+    if (ok) {
+        member->set = set;
+    }
+    pthread_mutex_unlock(&member->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks_to_wait) {
+    QueueSetMemberHandle_t member = NULL;
+    return xQueueReceive(set, &member, ticks_to_wait) ? member : NULL;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    const UBaseType_t count = (UBaseType_t)q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    struct sim_queue *q = queue_new(max_count, 0);
+    if (q) {
+        q->count = initial_count;
+    }
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                 StaticSemaphore_t *buffer) {
+    if (!buffer) {
+        return NULL;
+    }
+    struct sim_queue *q = queue_new_static(max_count, 0, NULL, buffer);
+    q->count = initial_count;
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    return xSemaphoreCreateCountingStatic(1, 0, buffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    return xQueueReceive(sem, NULL, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return xQueueSend(sem, NULL, 0);
+}
+
+static void task_setup(struct sim_task *task, const char *name) {
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    pthread_mutex_init(&task->lock, NULL);
+    sim_cond_init(&task->cond);
+}
+
+static struct sim_task *task_new(const char *name) {
+    struct sim_task *task = malloc(sizeof(*task));
+    if (task) {
+        task_setup(task, name);
+    }
+    return task;
+}
+
+static void task_exit(struct sim_task *task) {
+    if (task) {
+        atomic_fetch_sub(&g_live_tasks, 1);
+        atomic_fetch_sub(&g_live_stack_bytes, task->stack_depth);
+    }
+    sim_task_exit(task);
+}
+
+static void *task_trampoline(void *arg) {
+    struct sim_task *task = arg;
+    sim_task_started(task);
+    task->fn(task->arg);
+    task_exit(task);
+    return NULL;
+}
+
+static BaseType_t task_start(struct sim_task *task, TaskFunction_t fn, uint32_t stack_depth, void *arg,
+                             UBaseType_t priority, TaskHandle_t *created) {
+    task->fn = fn;
+    task->arg = arg;
+    task->priority = priority;
+    task->stack_depth = stack_depth;
+    atomic_fetch_add(&g_live_tasks, 1);
+    atomic_fetch_add(&g_live_stack_bytes, stack_depth);
+    if (created) {
+        *created = task;
+    }
+    sim_task_added(task);
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    sim_preempt_point();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core_id) {
+    (void)core_id;
+    struct sim_task *task = task_new(name);
+    if (!task) {
+        return pdFAIL;
+    }
+    return task_start(task, fn, stack_depth, arg, priority, created);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                           UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer,
+                                           BaseType_t core_id) {
+    (void)core_id;
+    if (!stack || !buffer) {
+        return NULL;
+    }
+    struct sim_task *task = (struct sim_task *)buffer;
+    task_setup(task, name);
+    TaskHandle_t created = NULL;
+    return task_start(task, fn, stack_depth, arg, priority, &created) == pdPASS ? created : NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *created) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == sim_current_task()) {
+        task_exit(sim_current_task());
+    }
+}
+
+void sim_task_footprint(size_t *tasks, size_t *stack_bytes) {
+    *tasks = atomic_load(&g_live_tasks);
+    *stack_bytes = atomic_load(&g_live_stack_bytes);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim_sleep_us((uint64_t)pdTICKS_TO_MS(ticks) * 1000ULL);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!sim_current_task()) {
+        // A thread that is not a task (e.g. main running app_main outside
+        // virtual time) gets a handle on first use.
+        struct sim_task *task = task_new("main");
+        if (task) {
+            sim_task_started(task);
+        }
+    }
+    return sim_current_task();
+}
+
+static void notify_give(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    ++task->notify;
+    sim_wake(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (!task) {
+        return pdFAIL;
+    }
+    notify_give(task);
+    sim_preempt_point();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    if (task) {
+        notify_give(task);
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    struct sim_task *task = xTaskGetCurrentTaskHandle();
+    sim_deadline_t deadline;
+    sim_deadline(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0) {
+        if (ticks_to_wait == 0 || !sim_block(&task->cond, &task->lock, &deadline)) {
+            break;
+        }
+    }
+    const uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
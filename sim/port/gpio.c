@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: MIT
+#include <pthread.h>
+
+#include "driver/gpio.h"
+#include "sim_port.h"
+
+// Pin levels and interrupt configuration. Inputs float to their pull
+// resistor until sim_gpio_drive sets them.
+typedef struct {
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    int level;
+    gpio_isr_t isr;
+    void *isr_arg;
+} sim_gpio_t;
+
+static sim_gpio_t g_pins[GPIO_NUM_MAX];
+static pthread_mutex_t g_gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_isr_service;
+static sim_gpio_output_hook_t g_output_hook;
+static void *g_output_ctx;
+
+static sim_gpio_t *pin_get(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? &g_pins[gpio_num] : NULL;
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg) {
+    if (!cfg || cfg->pin_bit_mask == 0 || cfg->pin_bit_mask >> GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    for (int i = 0; i < GPIO_NUM_MAX; ++i) {
+        if (!(cfg->pin_bit_mask & (1ULL << i))) {
+            continue;
+        }
+        sim_gpio_t *pin = &g_pins[i];
+        pin->mode = cfg->mode;
+        pin->intr_type = cfg->intr_type;
+        pin->intr_enabled = cfg->intr_type != GPIO_INTR_DISABLE;
+        if (cfg->mode == GPIO_MODE_INPUT) {
+            pin->level = cfg->pull_up_en == GPIO_PULLUP_ENABLE ? 1 : 0;
+        }
+    }
+    pthread_mutex_unlock(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    const bool output = pin->mode == GPIO_MODE_OUTPUT || pin->mode == GPIO_MODE_INPUT_OUTPUT;
+    const bool changed = output && pin->level != (level ? 1 : 0);
+    if (output) {
+        pin->level = level ? 1 : 0;
+    }
+    const sim_gpio_output_hook_t hook = g_output_hook;
+    void *ctx = g_output_ctx;
+    pthread_mutex_unlock(&g_gpio_lock);
+    if (changed && hook) {
+        hook(gpio_num, level ? 1 : 0, ctx);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return 0;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    const int level = pin->level;
+    pthread_mutex_unlock(&g_gpio_lock);
+    return level;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    pin->intr_type = intr_type;
+    pthread_mutex_unlock(&g_gpio_lock);
+    return ESP_OK;
+}
+
+static esp_err_t set_intr_enabled(gpio_num_t gpio_num, bool enabled) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    pin->intr_enabled = enabled;
+    pthread_mutex_unlock(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    return set_intr_enabled(gpio_num, true);
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+    return set_intr_enabled(gpio_num, false);
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    if (g_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&g_gpio_lock);
+    pin->isr = isr_handler;
+    pin->isr_arg = args;
+    // As in ESP-IDF, adding a handler enables the pin's interrupt.
+    pin->intr_enabled = isr_handler != NULL;
+    pthread_mutex_unlock(&g_gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    return gpio_isr_handler_add(gpio_num, NULL, NULL);
+}
+
+void sim_gpio_drive(gpio_num_t gpio_num, int level) {
+    sim_gpio_t *pin = pin_get(gpio_num);
+    if (!pin) {
+        return;
+    }
+    level = level ? 1 : 0;
+    pthread_mutex_lock(&g_gpio_lock);
+    const int old = pin->level;
+    pin->level = level;
+    bool fire = false;
+    if (pin->isr && pin->intr_enabled) {
+        switch (pin->intr_type) {
+            case GPIO_INTR_POSEDGE: fire = !old && level; break;
+            case GPIO_INTR_NEGEDGE: fire = old && !level; break;
+            case GPIO_INTR_ANYEDGE: fire = old != level; break;
+            case GPIO_INTR_LOW_LEVEL: fire = !level; break;
+            case GPIO_INTR_HIGH_LEVEL: fire = level; break;
+            default: break;
+        }
+    }
+    const gpio_isr_t isr = pin->isr;
+    void *arg = pin->isr_arg;
+    pthread_mutex_unlock(&g_gpio_lock);
+    if (fire) {
+        isr(arg);
+    }
+}
+
+void sim_gpio_set_output_hook(sim_gpio_output_hook_t hook, void *ctx) {
+    pthread_mutex_lock(&g_gpio_lock);
+    g_output_hook = hook;
+    g_output_ctx = ctx;
+    pthread_mutex_unlock(&g_gpio_lock);
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+// Heap accounting. Every sim target links with --wrap for the allocator entry
+// points, so every call made by the firmware and the port layer lands here;
+// allocations inside libc itself are not counted.
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
+#include "sim_port.h"
+
+static atomic_size_t g_alloc_calls;
+static atomic_size_t g_heap_in_use;
+static atomic_size_t g_heap_peak;
+
+static void heap_add(void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    atomic_fetch_add(&g_alloc_calls, 1);
+    const size_t now = atomic_fetch_add(&g_heap_in_use, malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+    size_t peak = atomic_load(&g_heap_peak);
+    while (now > peak && !atomic_compare_exchange_weak(&g_heap_peak, &peak, now)) {
+    }
+#if CONFIG_HEAP_USE_HOOKS
+    esp_heap_trace_alloc_hook(ptr, size, MALLOC_CAP_DEFAULT);
+#endif
+}
+
+static void heap_sub(void *ptr) {
+    if (ptr) {
+#if CONFIG_HEAP_USE_HOOKS
+        esp_heap_trace_free_hook(ptr);
+#endif
+        atomic_fetch_sub(&g_heap_in_use, malloc_usable_size(ptr));
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    heap_add(ptr, size);
+    return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    void *ptr = __real_calloc(n, size);
+    heap_add(ptr, n * size);
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    heap_sub(ptr);
+    void *out = __real_realloc(ptr, size);
+    heap_add(out ? out : ptr, size);
+    return out;
+}
+
+void __wrap_free(void *ptr) {
+    heap_sub(ptr);
+    __real_free(ptr);
+}
+
+void sim_heap_stats(sim_heap_stats_t *out) {
+    out->alloc_calls = atomic_load(&g_alloc_calls);
+    out->in_use = atomic_load(&g_heap_in_use);
+    out->peak = atomic_load(&g_heap_peak);
+}
+
+void sim_heap_reset_peak(void) {
+    atomic_store(&g_heap_peak, atomic_load(&g_heap_in_use));
+}
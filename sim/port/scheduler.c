@@ -0,0 +1,350 @@
+// SPDX-License-Identifier: MIT
+// Blocking, wake-up and sleeping for the shims. By default these map onto
+// pthread condition variables and CLOCK_MONOTONIC. With virtual time enabled
+// exactly one task thread runs at any moment: a task that blocks picks the
+// next ready task itself (highest priority first, ties broken by a seeded
+// PRNG) and, when none is ready, jumps the clock straight to the next
+// timeout or scheduled callout. A run is reproducible for a given seed and
+// timeline, and idle firmware time costs nothing.
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim_internal.h"
+#include "sim_port.h"
+
+#define SIM_MAX_TASKS 16
+#define SIM_MAX_CALLOUTS 64
+// Roughly what esp_timer reads when app_main starts on an ESP32.
+#define SIM_VIRTUAL_BOOT_US 300000ULL
+
+typedef struct {
+    uint64_t at_us;
+    void (*fn)(void *arg);
+    void *arg;
+} callout_t;
+
+static bool g_virtual;
+static pthread_mutex_t g_sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_done;
+static _Atomic uint64_t g_now_us = SIM_VIRTUAL_BOOT_US;
+static uint64_t g_end_us;
+static bool g_finished;
+static uint64_t g_rng;
+static uint64_t g_switches;
+static struct sim_task *g_tasks[SIM_MAX_TASKS];
+static size_t g_task_count;
+static struct sim_task *g_running;
+static callout_t g_callouts[SIM_MAX_CALLOUTS];
+static size_t g_callout_count;
+static void (*g_entry)(void);
+// Set while a callout runs on the thread of the task that advanced the clock.
+static bool g_in_callout;
+
+static __thread struct sim_task *t_current;
+
+void sim_virtual_time_enable(uint64_t seed) {
+    g_virtual = true;
+    g_rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    sim_cond_init(&g_done);
+}
+
+bool sim_virtual_time(void) {
+    return g_virtual;
+}
+
+uint64_t sim_virtual_now_us(void) {
+    return atomic_load_explicit(&g_now_us, memory_order_relaxed);
+}
+
+uint64_t sim_virtual_context_switches(void) {
+    pthread_mutex_lock(&g_sched_lock);
+    const uint64_t n = g_switches;
+    pthread_mutex_unlock(&g_sched_lock);
+    return n;
+}
+
+bool sim_virtual_call_at(uint64_t at_us, void (*fn)(void *arg), void *arg) {
+    pthread_mutex_lock(&g_sched_lock);
+    const bool ok = g_callout_count < SIM_MAX_CALLOUTS;
+    if (ok) {
+        g_callouts[g_callout_count++] = (callout_t){.at_us = at_us, .fn = fn, .arg = arg};
+    }
+    pthread_mutex_unlock(&g_sched_lock);
+    return ok;
+}
+
+static uint64_t next_random(void) {
+    // xorshift64*
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 0x2545F4914F6CDD1DULL;
+}
+
+static struct sim_task *pick_ready(void) {
+    struct sim_task *best[SIM_MAX_TASKS];
+    size_t n = 0;
+    for (size_t i = 0; i < g_task_count; ++i) {
+        struct sim_task *t = g_tasks[i];
+        if (t->state != SIM_TASK_READY) {
+            continue;
+        }
+        if (n > 0 && t->priority < best[0]->priority) {
+            continue;
+        }
+        if (n > 0 && t->priority > best[0]->priority) {
+            n = 0;
+        }
+        best[n++] = t;
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    return n == 1 ? best[0] : best[next_random() % n];
+}
+
+// Takes the earliest due callout, preserving insertion order among equals.
+static bool take_due_callout(uint64_t now, callout_t *out) {
+    size_t pick = g_callout_count;
+    for (size_t i = 0; i < g_callout_count; ++i) {
+        if (g_callouts[i].at_us <= now && (pick == g_callout_count || g_callouts[i].at_us < g_callouts[pick].at_us)) {
+            pick = i;
+        }
+    }
+    if (pick == g_callout_count) {
+        return false;
+    }
+    *out = g_callouts[pick];
+    for (size_t i = pick + 1; i < g_callout_count; ++i) {
+        g_callouts[i - 1] = g_callouts[i];
+    }
+    --g_callout_count;
+    return true;
+}
+
+// Nothing is ready: move the clock to the next timeout or callout and fire
+// everything due. Returns false once the run is over.
+static bool advance_clock(void) {
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < g_task_count; ++i) {
+        if (g_tasks[i]->state == SIM_TASK_BLOCKED && g_tasks[i]->wake_at_us < next) {
+            next = g_tasks[i]->wake_at_us;
+        }
+    }
+    for (size_t i = 0; i < g_callout_count; ++i) {
+        if (g_callouts[i].at_us < next) {
+            next = g_callouts[i].at_us;
+        }
+    }
+    if (next == UINT64_MAX || next >= g_end_us) {
+        if (g_end_us != UINT64_MAX) {
+            atomic_store_explicit(&g_now_us, g_end_us, memory_order_relaxed);
+        }
+        return false;
+    }
+    uint64_t now = sim_virtual_now_us();
+    if (next > now) {
+        now = next;
+        atomic_store_explicit(&g_now_us, now, memory_order_relaxed);
+    }
+    for (size_t i = 0; i < g_task_count; ++i) {
+        struct sim_task *t = g_tasks[i];
+        if (t->state == SIM_TASK_BLOCKED && t->wake_at_us <= now) {
+            t->state = SIM_TASK_READY;
+            t->timed_out = true;
+        }
+    }
+    callout_t c;
+    while (take_due_callout(now, &c)) {
+        pthread_mutex_unlock(&g_sched_lock);
+        g_in_callout = true;
+        c.fn(c.arg);
+        g_in_callout = false;
+        pthread_mutex_lock(&g_sched_lock);
+    }
+    return true;
+}
+
+// Hands the CPU to the next ready task. `self` has already left the RUNNING
+// state; returns once it is scheduled again (immediately if it is next).
+static void schedule(struct sim_task *self) {
+    struct sim_task *next;
+    while (!(next = pick_ready())) {
+        if (!advance_clock()) {
+            g_finished = true;
+            g_running = NULL;
+            pthread_cond_broadcast(&g_done);
+            // Parked for good; the thread in sim_virtual_run ends the process.
+            while (true) {
+                pthread_cond_wait(&self->run_cond, &g_sched_lock);
+            }
+        }
+    }
+    next->state = SIM_TASK_RUNNING;
+    g_running = next;
+    if (next == self) {
+        return;
+    }
+    ++g_switches;
+    pthread_cond_signal(&next->run_cond);
+    if (self->state == SIM_TASK_DEAD) {
+        return;
+    }
+    while (g_running != self) {
+        pthread_cond_wait(&self->run_cond, &g_sched_lock);
+    }
+}
+
+void sim_deadline(TickType_t ticks, sim_deadline_t *deadline) {
+    deadline->forever = ticks == portMAX_DELAY;
+    if (deadline->forever) {
+        return;
+    }
+    const uint64_t ms = pdTICKS_TO_MS(ticks);
+    if (g_virtual) {
+        deadline->virtual_us = sim_virtual_now_us() + ms * 1000ULL;
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline->real);
+    const uint64_t ns = ms * 1000000ULL + (uint64_t)deadline->real.tv_nsec;
+    deadline->real.tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline->real.tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+bool sim_block(pthread_cond_t *cond, pthread_mutex_t *mutex, const sim_deadline_t *deadline) {
+    if (!g_virtual) {
+        return sim_cond_wait(cond, mutex, deadline->forever ? NULL : &deadline->real);
+    }
+    struct sim_task *self = t_current;
+    if (!self || !self->scheduled || g_in_callout) {
+        // Only scheduled tasks can block; anything else just polls.
+        return false;
+    }
+    pthread_mutex_unlock(mutex);
+    pthread_mutex_lock(&g_sched_lock);
+    self->state = SIM_TASK_BLOCKED;
+    self->wait_obj = cond;
+    self->wake_at_us = deadline->forever ? UINT64_MAX : deadline->virtual_us;
+    self->timed_out = false;
+    schedule(self);
+    const bool timed_out = self->timed_out;
+    self->wait_obj = NULL;
+    pthread_mutex_unlock(&g_sched_lock);
+    pthread_mutex_lock(mutex);
+    return !timed_out;
+}
+
+void sim_wake(pthread_cond_t *cond) {
+    if (!g_virtual) {
+        pthread_cond_broadcast(cond);
+        return;
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    for (size_t i = 0; i < g_task_count; ++i) {
+        struct sim_task *t = g_tasks[i];
+        if (t->state == SIM_TASK_BLOCKED && t->wait_obj == cond) {
+            t->state = SIM_TASK_READY;
+            t->timed_out = false;
+        }
+    }
+    pthread_mutex_unlock(&g_sched_lock);
+}
+
+void sim_sleep_us(uint64_t us) {
+    struct sim_task *self = t_current;
+    if (!g_virtual || !self || !self->scheduled) {
+        struct timespec ts = {.tv_sec = (time_t)(us / 1000000ULL), .tv_nsec = (long)(us % 1000000ULL) * 1000L};
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        }
+        return;
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    self->state = SIM_TASK_BLOCKED;
+    self->wait_obj = NULL;
+    self->wake_at_us = sim_virtual_now_us() + us;
+    schedule(self);
+    pthread_mutex_unlock(&g_sched_lock);
+}
+
+void sim_preempt_point(void) {
+    struct sim_task *self = t_current;
+    if (!g_virtual || !self || !self->scheduled || g_in_callout) {
+        return;
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    for (size_t i = 0; i < g_task_count; ++i) {
+        if (g_tasks[i]->state == SIM_TASK_READY && g_tasks[i]->priority > self->priority) {
+            self->state = SIM_TASK_READY;
+            schedule(self);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_sched_lock);
+}
+
+struct sim_task *sim_current_task(void) {
+    return t_current;
+}
+
+void sim_task_added(struct sim_task *task) {
+    if (!g_virtual) {
+        return;
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    if (g_task_count == SIM_MAX_TASKS) {
+        fprintf(stderr, "sim: more than %d tasks\n", SIM_MAX_TASKS);
+        abort();
+    }
+    sim_cond_init(&task->run_cond);
+    task->state = SIM_TASK_READY;
+    task->scheduled = true;
+    g_tasks[g_task_count++] = task;
+    pthread_mutex_unlock(&g_sched_lock);
+}
+
+void sim_task_started(struct sim_task *task) {
+    t_current = task;
+    if (!task->scheduled) {
+        return;
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    while (g_running != task) {
+        pthread_cond_wait(&task->run_cond, &g_sched_lock);
+    }
+    pthread_mutex_unlock(&g_sched_lock);
+}
+
+void sim_task_exit(struct sim_task *task) {
+    if (task && task->scheduled) {
+        pthread_mutex_lock(&g_sched_lock);
+        task->state = SIM_TASK_DEAD;
+        schedule(task);
+        pthread_mutex_unlock(&g_sched_lock);
+    }
+    pthread_exit(NULL);
+}
+
+static void main_task(void *arg) {
+    (void)arg;
+    g_entry();
+}
+
+uint64_t sim_virtual_run(void (*entry)(void), uint64_t duration_us) {
+    g_entry = entry;
+    g_end_us = duration_us == UINT64_MAX ? UINT64_MAX : sim_virtual_now_us() + duration_us;
+    // ESP-IDF runs app_main in a priority-1 task of its own.
+    if (xTaskCreate(main_task, "main", 0, NULL, 1, NULL) != pdPASS) {
+        return sim_virtual_now_us();
+    }
+    pthread_mutex_lock(&g_sched_lock);
+    g_running = pick_ready();
+    g_running->state = SIM_TASK_RUNNING;
+    pthread_cond_signal(&g_running->run_cond);
+    while (!g_finished) {
+        pthread_cond_wait(&g_done, &g_sched_lock);
+    }
+    pthread_mutex_unlock(&g_sched_lock);
+    return sim_virtual_now_us();
+}
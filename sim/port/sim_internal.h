@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef enum {
+    SIM_TASK_READY,
+    SIM_TASK_RUNNING,
+    SIM_TASK_BLOCKED,
+    SIM_TASK_DEAD,
+} sim_task_state_t;
+
+struct sim_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t priority;
+    uint32_t stack_depth;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    // Virtual-time scheduling only; guarded by the scheduler lock.
+    bool scheduled;
+    sim_task_state_t state;
+    pthread_cond_t run_cond;
+    const void *wait_obj;
+    uint64_t wake_at_us;
+    bool timed_out;
+};
+
+// An absolute timeout for sim_block, in whichever clock is active.
+typedef struct {
+    bool forever;
+    struct timespec real;
+    uint64_t virtual_us;
+} sim_deadline_t;
+
+// pthread_cond_t initialised to wait against CLOCK_MONOTONIC.
+void sim_cond_init(pthread_cond_t *cond);
+
+// Waits on `cond` until `deadline` (or forever if NULL). Returns false on timeout.
+bool sim_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline);
+
+bool sim_virtual_time(void);
+uint64_t sim_virtual_now_us(void);
+
+// Converts a FreeRTOS timeout into an absolute deadline.
+void sim_deadline(TickType_t ticks, sim_deadline_t *deadline);
+
+// The blocking primitive behind every shim: waits on `cond` (with `mutex`
+// held) until sim_wake(cond) or the deadline. Returns false on timeout. Under
+// virtual time the calling task is descheduled instead and `cond` only
+// identifies what it is waiting for.
+bool sim_block(pthread_cond_t *cond, pthread_mutex_t *mutex, const sim_deadline_t *deadline);
+void sim_wake(pthread_cond_t *cond);
+
+void sim_sleep_us(uint64_t us);
+
+// Called by task-context shims after they may have readied another task;
+// under virtual time a higher-priority ready task runs before this returns.
+void sim_preempt_point(void);
+
+// Task lifecycle hooks used by freertos.c.
+struct sim_task *sim_current_task(void);
+void sim_task_started(struct sim_task *task);
+void sim_task_added(struct sim_task *task);
+void sim_task_exit(struct sim_task *task);
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: MIT
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/queue.h"
+#include "sim_internal.h"
+#include "sim_port.h"
+
+static const char *TAG = "sim_uart";
+
+// One simulated port: a reader thread moves bytes from rx_fd into a ring
+// buffer and posts UART_DATA events, like the ESP-IDF driver's RX ISR. Under
+// virtual time there is no reader thread; bytes arrive via sim_uart_inject.
+typedef struct {
+    int rx_fd;
+    int tx_fd;
+    sim_uart_tx_hook_t tx_hook;
+    void *tx_ctx;
+    int baud;
+    bool attached;
+    bool installed;
+    bool rx_closed;
+    pthread_t rx_thread;
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    uint8_t *ring;
+    size_t ring_size;
+    size_t head;
+    size_t count;
+    QueueHandle_t events;
+} sim_uart_t;
+
+static sim_uart_t g_ports[UART_NUM_MAX];
+static bool g_wire_timing = true;
+
+static sim_uart_t *port_get(uart_port_t port) {
+    return port >= 0 && port < UART_NUM_MAX ? &g_ports[port] : NULL;
+}
+
+void sim_uart_attach(uart_port_t port, int rx_fd, int tx_fd) {
+    sim_uart_t *p = port_get(port);
+    if (!p) {
+        return;
+    }
+    p->rx_fd = rx_fd;
+    p->tx_fd = tx_fd;
+    p->attached = true;
+}
+
+void sim_uart_set_tx_hook(uart_port_t port, sim_uart_tx_hook_t hook, void *ctx) {
+    sim_uart_t *p = port_get(port);
+    if (!p) {
+        return;
+    }
+    p->tx_hook = hook;
+    p->tx_ctx = ctx;
+    p->attached = true;
+}
+
+void sim_uart_set_wire_timing(bool enabled) {
+    g_wire_timing = enabled;
+}
+
+bool sim_uart_rx_closed(uart_port_t port) {
+    sim_uart_t *p = port_get(port);
+    if (!p) {
+        return true;
+    }
+    pthread_mutex_lock(&p->lock);
+    const bool closed = p->rx_closed;
+    pthread_mutex_unlock(&p->lock);
+    return closed;
+}
+
+static void post_event(sim_uart_t *p, uart_event_type_t type, size_t size) {
+    if (!p->events) {
+        return;
+    }
+    const uart_event_t event = {.type = type, .size = size};
+    xQueueSendFromISR(p->events, &event, NULL);
+}
+
+static void rx_push(sim_uart_t *p, const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&p->lock);
+    const size_t room = p->ring_size - p->count;
+    const size_t keep = len < room ? len : room;
+    for (size_t i = 0; i < keep; ++i) {
+        p->ring[(p->head + p->count + i) % p->ring_size] = data[i];
+    }
+    p->count += keep;
+    sim_wake(&p->readable);
+    pthread_mutex_unlock(&p->lock);
+    post_event(p, UART_DATA, keep);
+    if (keep < len) {
+        post_event(p, UART_BUFFER_FULL, 0);
+    }
+}
+
+void sim_uart_inject(uart_port_t port, const void *data, size_t len) {
+    sim_uart_t *p = port_get(port);
+    if (p && p->installed) {
+        rx_push(p, data, len);
+    }
+}
+
+static void *rx_thread(void *arg) {
+    sim_uart_t *p = arg;
+    uint8_t chunk[256];
+    while (true) {
+        const ssize_t n = read(p->rx_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            pthread_mutex_lock(&p->lock);
+            p->rx_closed = true;
+            sim_wake(&p->readable);
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        rx_push(p, chunk, (size_t)n);
+    }
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg) {
+    sim_uart_t *p = port_get(port);
+    if (!p || !cfg || cfg->baud_rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    p->baud = cfg->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts) {
+    (void)tx;
+    (void)rx;
+    (void)rts;
+    (void)cts;
+    return port_get(port) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags) {
+    (void)tx_buffer_size;
+    (void)intr_alloc_flags;
+    sim_uart_t *p = port_get(port);
+    if (!p || rx_buffer_size <= 0 || p->installed) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!p->attached) {
+        ESP_LOGE(TAG, "UART%d has no attached descriptors", port);
+        return ESP_ERR_INVALID_STATE;
+    }
+    p->ring = calloc(1, (size_t)rx_buffer_size);
+    if (!p->ring) {
+        return ESP_ERR_NO_MEM;
+    }
+    p->ring_size = (size_t)rx_buffer_size;
+    pthread_mutex_init(&p->lock, NULL);
+    sim_cond_init(&p->readable);
+    if (queue_size > 0 && uart_queue) {
+        p->events = xQueueCreate((UBaseType_t)queue_size, sizeof(uart_event_t));
+        if (!p->events) {
+            return ESP_ERR_NO_MEM;
+        }
+        *uart_queue = p->events;
+    }
+    if (p->baud == 0) {
+        p->baud = 115200;
+    }
+    p->installed = true;
+    if (sim_virtual_time()) {
+        return ESP_OK;
+    }
+    if (pthread_create(&p->rx_thread, NULL, rx_thread, p) != 0) {
+        return ESP_FAIL;
+    }
+    pthread_detach(p->rx_thread);
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+    sim_uart_t *p = port_get(port);
+    if (!p || !p->installed) {
+        return -1;
+    }
+    sim_deadline_t deadline;
+    sim_deadline(ticks_to_wait, &deadline);
+    uint8_t *out = buf;
+    size_t got = 0;
+    pthread_mutex_lock(&p->lock);
+    while (got < length) {
+        while (p->count > 0 && got < length) {
+            out[got++] = p->ring[p->head];
+            p->head = (p->head + 1) % p->ring_size;
+            --p->count;
+        }
+        if (got == length || ticks_to_wait == 0 || p->rx_closed) {
+            break;
+        }
+        if (!sim_block(&p->readable, &p->lock, &deadline)) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return (int)got;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size) {
+    sim_uart_t *p = port_get(port);
+    if (!p || !p->installed) {
+        return -1;
+    }
+    const uint8_t *data = src;
+    size_t written = 0;
+    if (p->tx_hook) {
+        p->tx_hook(data, size, p->tx_ctx);
+        written = size;
+    }
+    while (written < size) {
+        const ssize_t n = write(p->tx_fd, data + written, size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += (size_t)n;
+    }
+    if (g_wire_timing && written > 0) {
+        // 8N1: ten bit times per byte.
+        sim_sleep_us((uint64_t)written * 10ULL * 1000000ULL / (uint64_t)p->baud);
+    }
+    return (int)written;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size) {
+    sim_uart_t *p = port_get(port);
+    if (!p || !p->installed || !size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&p->lock);
+    *size = p->count;
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port) {
+    sim_uart_t *p = port_get(port);
+    if (!p || !p->installed) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->head = 0;
+    p->count = 0;
+    pthread_mutex_unlock(&p->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks_to_wait) {
+    (void)ticks_to_wait;
+    return port_get(port) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
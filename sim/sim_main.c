@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+// Host simulator entry point: wires the firmware's supervisor UART to a
+// pseudo-terminal (or stdin/stdout) and runs app_main on Linux.
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_port.h"
+
+#define SIM_SUPV_UART UART_NUM_1
+
+void app_main(void);
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--stdio] [--link PATH] [--no-wire-timing] [--linger-ms N] [--log-level 0-5]\n"
+            "  default      expose the supervisor UART on a new pseudo-terminal\n"
+            "  --stdio      read commands from stdin and write frames to stdout\n"
+            "  --link PATH  also symlink the pseudo-terminal to PATH\n"
+            "  --no-wire-timing  do not model 115200 baud transmit time\n"
+            "  --linger-ms N     with --stdio, keep running N ms after EOF (default 500)\n",
+            argv0);
+}
+
+static int open_pty(const char *link_path) {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    const char *slave_path = ptsname(master);
+    // Keep a raw-mode slave descriptor open so the master never sees EOF/EIO
+    // while no client is connected, and so nothing is echoed back.
+    const int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("open pty slave");
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tcsetattr(slave, TCSANOW, &tio);
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(slave_path, link_path) != 0) {
+            perror("symlink");
+        }
+    }
+    fprintf(stderr, "supervisor UART on %s%s%s\n", slave_path, link_path ? " -> " : "", link_path ? link_path : "");
+    return master;
+}
+
+int main(int argc, char **argv) {
+    bool use_stdio = false;
+    const char *link_path = NULL;
+    long linger_ms = 500;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stdio") == 0) {
+            use_stdio = true;
+        } else if (strcmp(argv[i], "--link") == 0 && i + 1 < argc) {
+            link_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-wire-timing") == 0) {
+            sim_uart_set_wire_timing(false);
+        } else if (strcmp(argv[i], "--linger-ms") == 0 && i + 1 < argc) {
+            linger_ms = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            sim_log_set_level((esp_log_level_t)strtol(argv[++i], NULL, 10));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (use_stdio) {
+        setvbuf(stdout, NULL, _IONBF, 0);
+        sim_uart_attach(SIM_SUPV_UART, STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        const int master = open_pty(link_path);
+        if (master < 0) {
+            return 1;
+        }
+        sim_uart_attach(SIM_SUPV_UART, master, master);
+    }
+
+    sim_adc_set_pack(11750, -420);
+    app_main();
+
+    while (!use_stdio || !sim_uart_rx_closed(SIM_SUPV_UART)) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    vTaskDelay(pdMS_TO_TICKS(linger_ms));
+    return 0;
+}
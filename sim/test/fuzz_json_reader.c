@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: MIT
+// Fuzz target for json_reader. With SIM_LIBFUZZER defined it is a libFuzzer
+// entry point (clang -fsanitize=fuzzer); otherwise main() mutates a seed
+// corpus of command lines from a fixed seed, which is what ctest runs.
+// Inputs sit in buffers of exactly their length so the sanitizers catch any
+// read or write past the end.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_reader.h"
+#include "test_util.h"
+
+static void check_value(const char *buf, size_t len, const json_value_t *v) {
+    if (v->type == JSON_TYPE_NONE) {
+        return;
+    }
+    CHECK(v->ptr >= buf && v->ptr + v->len <= buf + len);
+    switch (v->type) {
+        case JSON_TYPE_STRING:
+            // Decoded in place and NUL-terminated over the closing quote at
+            // the latest.
+            CHECK(v->ptr + v->len < buf + len && v->ptr[v->len] == '\0');
+            break;
+        case JSON_TYPE_NUMBER: {
+            uint32_t u;
+            float f;
+            json_value_to_u32(v, &u);
+            json_value_to_float(v, &f);
+            break;
+        }
+        case JSON_TYPE_ARRAY: {
+            CHECK(v->len >= 2 && v->ptr[0] == '[' && v->ptr[v->len - 1] == ']');
+            json_array_iter_t it;
+            json_array_iter_init(&it, v);
+            json_value_t item;
+            while (json_array_next(&it, &item)) {
+                check_value(v->ptr, v->len, &item);
+            }
+            break;
+        }
+        case JSON_TYPE_OBJECT:
+            CHECK(v->len >= 2 && v->ptr[0] == '{' && v->ptr[v->len - 1] == '}');
+            break;
+        default:
+            break;
+    }
+}
+
+// Reads `data` as the firmware reads a received line: as one command object
+// with the keys commands take, and as a batch whose objects are read in turn.
+static void fuzz_one(const uint8_t *data, size_t len) {
+    char *buf = malloc(len ? len : 1);
+    memcpy(buf, data, len);
+    json_value_t cmd, id, source, fields, value;
+    const json_field_t keys[] = {
+        {"cmd", &cmd}, {"id", &id}, {"source", &source}, {"fields", &fields}, {"value", &value},
+    };
+    size_t offset = 0;
+    if (json_read_object(buf, len, keys, sizeof(keys) / sizeof(keys[0]), &offset) == JSON_READ_OK) {
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+            check_value(buf, len, keys[i].out);
+        }
+    } else {
+        CHECK(offset <= len);
+    }
+
+    memcpy(buf, data, len);
+    json_value_t array;
+    if (json_read_array(buf, len, &array, &offset) == JSON_READ_OK) {
+        check_value(buf, len, &array);
+        json_array_iter_t it;
+        json_array_iter_init(&it, &array);
+        json_value_t item;
+        while (json_array_next(&it, &item)) {
+            if (item.type == JSON_TYPE_OBJECT) {
+                CHECK(json_read_object(item.ptr, item.len, keys, 2, NULL) == JSON_READ_OK);
+                check_value(buf, len, &cmd);
+                check_value(buf, len, &id);
+            }
+        }
+    } else {
+        CHECK(offset <= len);
+    }
+    free(buf);
+}
+
+#ifdef SIM_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    fuzz_one(data, size);
+    return 0;
+}
+
+#else
+
+static const char *const k_seeds[] = {
+    "{\"id\":\"1\",\"cmd\":\"get_status\"}",
+    "{\"id\":\"8\",\"cmd\":\"get_status\",\"fields\":[\"battery_pct\",\"uptime_s\"]}",
+    "{\"id\":\"2\",\"cmd\":\"clear_unread\",\"source\":\"tui \\u00e9\\ud83d\\ude00\\n\"}",
+    "{\"id\":\"3\",\"cmd\":\"watch\",\"field\":\"pack_ma\",\"op\":\"<\",\"value\":-2000.5e0,\"hysteresis\":100}",
+    "{\"id\":\"4\",\"cmd\":\"subscribe\",\"topic\":\"telemetry\",\"min_ms\":0,\"max_ms\":10000}",
+    "{\"cmd\":\"ping\",\"x\":{\"a\":[1,2,{\"b\":null}],\"c\":true,\"d\":false},\"id\":\"5\"}",
+    "[{\"id\":\"a\",\"cmd\":\"get_status\"},{\"id\":\"b\",\"cmd\":\"get_switches\"},3,\"x\"]",
+    "  {\"id\" : \"6\" , \"cmd\" : \"set_framing\" , \"mode\" : \"binary\" }\r",
+};
+
+static const char *const k_tokens[] = {
+    "{", "}", "[", "]", "\"", "\\", "\\u", "\\ud800", "\\udc00", "\\u0000", ",", ":", "-", "0", "1e", "e+", ".",
+    "true", "null", "fals", " ", "\n", "\x01", "\xff", "\"cmd\":", "\"id\":", "[[[[[[[[[[[[[[[[[[",
+};
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rnd(uint32_t n) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return (uint32_t)(g_rng % n);
+}
+
+#define FUZZ_MAX_LEN 600
+
+static size_t mutate(uint8_t *buf, size_t len) {
+    const unsigned ops = 1 + rnd(4);
+    for (unsigned op = 0; op < ops; ++op) {
+        const size_t at = len ? rnd((uint32_t)len + 1) : 0;
+        switch (rnd(6)) {
+            case 0:
+                if (at < len) {
+                    buf[at] = (uint8_t)rnd(256);
+                }
+                break;
+            case 1: {
+                // Insert a token.
+                const char *tok = k_tokens[rnd(sizeof(k_tokens) / sizeof(k_tokens[0]))];
+                const size_t n = strlen(tok);
+                if (len + n <= FUZZ_MAX_LEN) {
+                    memmove(buf + at + n, buf + at, len - at);
+                    memcpy(buf + at, tok, n);
+                    len += n;
+                }
+                break;
+            }
+            case 2: {
+                // Delete a run.
+                const size_t n = at < len ? 1 + rnd((uint32_t)(len - at)) % 8 : 0;
+                memmove(buf + at, buf + at + n, len - at - n);
+                len -= n;
+                break;
+            }
+            case 3:
+                len = at;
+                break;
+            case 4: {
+                // Duplicate a run, which nests and repeats structure.
+                const size_t n = at < len ? 1 + rnd((uint32_t)(len - at)) : 0;
+                if (len + n <= FUZZ_MAX_LEN) {
+                    memmove(buf + at + n, buf + at, len - at);
+                    len += n;
+                }
+                break;
+            }
+            default:
+                if (at < len) {
+                    buf[at] ^= (uint8_t)(1u << rnd(8));
+                }
+                break;
+        }
+    }
+    return len;
+}
+
+int main(int argc, char **argv) {
+    const unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    const size_t nseeds = sizeof(k_seeds) / sizeof(k_seeds[0]);
+    uint8_t buf[FUZZ_MAX_LEN];
+    for (size_t s = 0; s < nseeds; ++s) {
+        // The seeds themselves are valid.
+        const size_t len = strlen(k_seeds[s]);
+        memcpy(buf, k_seeds[s], len);
+        json_value_t array;
+        const json_read_error_t err = k_seeds[s][0] == '['
+                                          ? json_read_array((char *)buf, len, &array, NULL)
+                                          : json_read_object((char *)buf, len, NULL, 0, NULL);
+        CHECK(err == JSON_READ_OK);
+        fuzz_one((const uint8_t *)k_seeds[s], len);
+    }
+    for (unsigned long i = 0; i < iterations; ++i) {
+        const char *seed = k_seeds[rnd((uint32_t)nseeds)];
+        size_t len = strlen(seed);
+        memcpy(buf, seed, len);
+        len = mutate(buf, len);
+        fuzz_one(buf, len);
+    }
+    return test_finish("fuzz_json_reader");
+}
+
+#endif
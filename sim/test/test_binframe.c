@@ -0,0 +1,260 @@
+// SPDX-License-Identifier: MIT
+// Host tests for the binary framing: COBS and CRC round-trips including
+// payloads full of zero bytes, corrupted and truncated frames, oversize
+// payloads and short output buffers, and the telemetry TLV records.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binframe.h"
+#include "test_util.h"
+
+static uint64_t g_rng = 0x2545F4914F6CDD1DULL;
+
+static uint8_t rnd_byte(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return (uint8_t)g_rng;
+}
+
+// Encodes, checks the wire form and decodes back, both with and without the
+// trailing delimiter. Returns the wire length.
+static size_t round_trip(binframe_type_t type, const uint8_t *payload, size_t len) {
+    uint8_t wire[BINFRAME_MAX_WIRE];
+    const size_t n = binframe_encode(type, payload, len, wire, sizeof(wire));
+    CHECK(n > 0 && n <= BINFRAME_MAX_WIRE);
+    if (n == 0) {
+        return 0;
+    }
+    // The delimiter is the only zero on the wire.
+    CHECK(wire[n - 1] == 0);
+    CHECK(memchr(wire, 0, n - 1) == NULL);
+    // Type, CRC and one COBS byte per started 254, plus the delimiter.
+    CHECK(n <= 1 + len + 2 + (1 + len + 2) / 254 + 2);
+
+    for (int delimited = 0; delimited < 2; ++delimited) {
+        uint8_t frame[BINFRAME_MAX_WIRE];
+        memcpy(frame, wire, n);
+        uint8_t got_type = 0;
+        const uint8_t *got = NULL;
+        size_t got_len = 0;
+        CHECK(binframe_decode(frame, delimited ? n : n - 1, &got_type, &got, &got_len));
+        CHECK(got_type == (uint8_t)type);
+        CHECK(got_len == len && (len == 0 || memcmp(got, payload, len) == 0));
+    }
+    return n;
+}
+
+static void test_crc(void) {
+    // CRC-16/CCITT-FALSE check value.
+    CHECK(binframe_crc16((const uint8_t *)"123456789", 9) == 0x29B1);
+    CHECK(binframe_crc16(NULL, 0) == 0xFFFF);
+}
+
+static void test_round_trips(void) {
+    uint8_t payload[BINFRAME_MAX_PAYLOAD] = {0};
+    round_trip(BINFRAME_TYPE_JSON, payload, 0);
+    const char *json = "{\"id\":\"1\",\"ok\":true}";
+    round_trip(BINFRAME_TYPE_JSON, (const uint8_t *)json, strlen(json));
+
+    // Zeros everywhere COBS treats specially: alone, leading, trailing, in
+    // runs, and as the whole payload.
+    static const uint8_t k_zeros[][6] = {
+        {0}, {0, 1}, {1, 0}, {0, 0, 0}, {1, 0, 0, 2}, {0, 1, 0, 1, 0, 1},
+    };
+    static const size_t k_zero_lens[] = {1, 2, 2, 3, 4, 6};
+    for (size_t i = 0; i < sizeof(k_zero_lens) / sizeof(k_zero_lens[0]); ++i) {
+        round_trip(BINFRAME_TYPE_SWITCH, k_zeros[i], k_zero_lens[i]);
+    }
+    memset(payload, 0, sizeof(payload));
+    round_trip(BINFRAME_TYPE_TELEMETRY, payload, sizeof(payload));
+
+    // Non-zero runs around the 254-byte COBS block limit, counting the type
+    // byte in front, followed by a zero, by more data or by nothing.
+    for (size_t run = 250; run <= 258; ++run) {
+        memset(payload, 0xA5, run);
+        round_trip(BINFRAME_TYPE_JSON, payload, run);
+        payload[run] = 0;
+        round_trip(BINFRAME_TYPE_JSON, payload, run + 1);
+        payload[run] = 7;
+        round_trip(BINFRAME_TYPE_JSON, payload, run + 1);
+    }
+
+    // No zeros at all costs the most overhead, and must still fit.
+    memset(payload, 0xFF, sizeof(payload));
+    CHECK(round_trip(BINFRAME_TYPE_JSON, payload, sizeof(payload)) <= BINFRAME_MAX_WIRE);
+
+    for (int i = 0; i < 2000; ++i) {
+        const size_t len = (size_t)(rnd_byte() << 8 | rnd_byte()) % (sizeof(payload) + 1);
+        for (size_t b = 0; b < len; ++b) {
+            // Plenty of zeros and 0xFF, which COBS and the CRC care about.
+            const uint8_t r = rnd_byte();
+            payload[b] = r < 64 ? 0 : r < 96 ? 0xFF : rnd_byte();
+        }
+        round_trip((binframe_type_t)(1 + i % 3), payload, len);
+    }
+}
+
+static void test_oversize(void) {
+    static uint8_t payload[BINFRAME_MAX_PAYLOAD + 1];
+    uint8_t wire[BINFRAME_MAX_WIRE + 16];
+    CHECK(binframe_encode(BINFRAME_TYPE_JSON, payload, sizeof(payload), wire, sizeof(wire)) == 0);
+
+    // An output buffer one byte short is refused without writing past it.
+    memset(payload, 'x', 300);
+    const size_t need = binframe_encode(BINFRAME_TYPE_JSON, payload, 300, wire, sizeof(wire));
+    CHECK(need > 0);
+    for (size_t cap = 0; cap < need; ++cap) {
+        memset(wire, 0xEE, sizeof(wire));
+        CHECK(binframe_encode(BINFRAME_TYPE_JSON, payload, 300, wire, cap) == 0);
+        CHECK(wire[cap] == 0xEE);
+    }
+    CHECK(binframe_encode(BINFRAME_TYPE_JSON, payload, 300, wire, need) == need);
+}
+
+static void test_corruption(void) {
+    const char *json = "{\"id\":\"7\",\"ok\":true,\"framing\":\"binary\"}";
+    uint8_t payload[300];
+    for (size_t i = 0; i < sizeof(payload); ++i) {
+        payload[i] = (uint8_t)(i % 5 ? i : 0);
+    }
+    const struct {
+        const uint8_t *data;
+        size_t len;
+    } frames[] = {{(const uint8_t *)json, strlen(json)}, {payload, sizeof(payload)}, {payload, 2}};
+
+    for (size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); ++f) {
+        uint8_t wire[BINFRAME_MAX_WIRE];
+        const size_t n = binframe_encode(BINFRAME_TYPE_JSON, frames[f].data, frames[f].len, wire, sizeof(wire));
+        CHECK(n > 0);
+        uint8_t frame[BINFRAME_MAX_WIRE];
+        uint8_t type;
+        const uint8_t *got;
+        size_t got_len;
+
+        // Every single-bit error before the delimiter is caught.
+        for (size_t byte = 0; byte + 1 < n; ++byte) {
+            for (int bit = 0; bit < 8; ++bit) {
+                memcpy(frame, wire, n);
+                frame[byte] ^= (uint8_t)(1u << bit);
+                if (binframe_decode(frame, n, &type, &got, &got_len)) {
+                    fprintf(stderr, "frame %zu: flip of bit %d in byte %zu decoded\n", f, bit, byte);
+                    CHECK(false);
+                }
+            }
+        }
+        // So is a frame cut short, or with a byte dropped from the middle.
+        for (size_t cut = 0; cut + 1 < n; ++cut) {
+            memcpy(frame, wire, n);
+            CHECK(!binframe_decode(frame, cut, &type, &got, &got_len));
+        }
+        memcpy(frame, wire, n);
+        memmove(frame + n / 2, frame + n / 2 + 1, n - n / 2 - 1);
+        CHECK(!binframe_decode(frame, n - 1, &type, &got, &got_len));
+    }
+
+    // Bytes that cannot be a frame: empty, a bare delimiter, a code running
+    // past the end, a zero inside a block, and too short to hold a CRC.
+    static const uint8_t k_bad[][4] = {{0}, {5, 1, 2, 0}, {3, 0, 1, 0}, {2, 1, 0}, {3, 1, 1, 0}};
+    static const size_t k_bad_lens[] = {1, 4, 4, 3, 4};
+    uint8_t type;
+    const uint8_t *got;
+    size_t got_len;
+    uint8_t frame[8];
+    CHECK(!binframe_decode(frame, 0, &type, &got, &got_len));
+    for (size_t i = 0; i < sizeof(k_bad_lens) / sizeof(k_bad_lens[0]); ++i) {
+        memcpy(frame, k_bad[i], k_bad_lens[i]);
+        CHECK(!binframe_decode(frame, k_bad_lens[i], &type, &got, &got_len));
+    }
+}
+
+static void test_switch_bits(void) {
+    for (unsigned bits = 0; bits < 64; ++bits) {
+        const supervisor_switch_state_t sw = binframe_switch_from_bits((uint8_t)bits);
+        CHECK(binframe_switch_bits(&sw) == bits);
+    }
+}
+
+static void test_telemetry(void) {
+    supervisor_state_t state = {
+        .battery_pct = 78,
+        .pack_mv = 11750,
+        .pack_ma = -2600,
+        .time_to_empty_min = 401,
+        .time_to_full_min = -1,
+        .mcu_temp_c = 36.5f,
+        .unread_ext = 3,
+        .last_mesh_event_us = 1000000,
+        .switches = {.lte = true, .bt = true, .charger_online = true},
+    };
+    // Strings at their longest.
+    snprintf(state.heltec, sizeof(state.heltec), "%s", "disconnected123");
+    snprintf(state.mcu, sizeof(state.mcu), "%s", "proto-0.1");
+    const uint64_t now_us = 3600000000ULL;
+
+    uint8_t payload[256];
+    for (telemetry_mask_t mask = 1; mask <= TELEMETRY_FIELDS_ALL; ++mask) {
+        const size_t len = binframe_encode_telemetry(&state, now_us, mask, payload, sizeof(payload));
+        CHECK(len > 0);
+        binframe_telemetry_t t;
+        CHECK(binframe_decode_telemetry(payload, len, &t));
+        CHECK(t.mask == mask);
+        CHECK(!(mask & TELEMETRY_FIELD_BATTERY_PCT) || t.battery_pct == state.battery_pct);
+        CHECK(!(mask & TELEMETRY_FIELD_PACK_MV) || t.pack_mv == state.pack_mv);
+        CHECK(!(mask & TELEMETRY_FIELD_PACK_MA) || t.pack_ma == state.pack_ma);
+        CHECK(!(mask & TELEMETRY_FIELD_MCU_TEMP_C) || t.mcu_temp_c == state.mcu_temp_c);
+        CHECK(!(mask & TELEMETRY_FIELD_UNREAD_EXT) || t.unread_ext == state.unread_ext);
+        CHECK(!(mask & TELEMETRY_FIELD_LAST_MSG_AGE_S) ||
+              t.last_msg_age_s == telemetry_last_msg_age(&state, now_us));
+        CHECK(!(mask & TELEMETRY_FIELD_HELTEC) || strcmp(t.heltec, state.heltec) == 0);
+        CHECK(!(mask & TELEMETRY_FIELD_MCU) || strcmp(t.mcu, state.mcu) == 0);
+        CHECK(!(mask & TELEMETRY_FIELD_UPTIME_S) || t.uptime_s == now_us / 1000000ULL);
+        CHECK(!(mask & TELEMETRY_FIELD_SWITCH) || binframe_switch_bits(&t.switches) ==
+                                                      binframe_switch_bits(&state.switches));
+        CHECK(!(mask & TELEMETRY_FIELD_TIME_TO_EMPTY_MIN) || t.time_to_empty_min == state.time_to_empty_min);
+        CHECK(!(mask & TELEMETRY_FIELD_TIME_TO_FULL_MIN) || t.time_to_full_min == state.time_to_full_min);
+    }
+
+    // Integers at the extremes of the zigzag varint encoding.
+    static const int k_ints[] = {0, -1, 1, 63, -64, 64, 8191, -8192, INT32_MAX, INT32_MIN};
+    for (size_t i = 0; i < sizeof(k_ints) / sizeof(k_ints[0]); ++i) {
+        state.pack_ma = k_ints[i];
+        const size_t len = binframe_encode_telemetry(&state, UINT64_MAX, TELEMETRY_FIELD_PACK_MA | TELEMETRY_FIELD_UPTIME_S,
+                                                     payload, sizeof(payload));
+        binframe_telemetry_t t;
+        CHECK(binframe_decode_telemetry(payload, len, &t));
+        CHECK(t.pack_ma == k_ints[i]);
+        CHECK(t.uptime_s == UINT64_MAX / 1000000ULL);
+    }
+
+    // Truncated records are refused; a payload cut between records decodes
+    // the records before the cut.
+    const size_t len = binframe_encode_telemetry(&state, now_us, TELEMETRY_FIELDS_ALL, payload, sizeof(payload));
+    for (size_t cut = 0; cut < len; ++cut) {
+        uint8_t *copy = malloc(cut ? cut : 1);
+        memcpy(copy, payload, cut);
+        binframe_telemetry_t t;
+        if (binframe_decode_telemetry(copy, cut, &t)) {
+            CHECK((t.mask & ~TELEMETRY_FIELDS_ALL) == 0 && t.mask != TELEMETRY_FIELDS_ALL);
+        }
+        free(copy);
+    }
+    // Too small a buffer is refused, and unknown field IDs are rejected.
+    CHECK(binframe_encode_telemetry(&state, now_us, TELEMETRY_FIELDS_ALL, payload, len - 1) == 0);
+    const uint8_t unknown[] = {BINFRAME_FIELD_COUNT, 0};
+    binframe_telemetry_t t;
+    CHECK(!binframe_decode_telemetry(unknown, sizeof(unknown), &t));
+}
+
+int main(void) {
+    test_crc();
+    test_round_trips();
+    test_oversize();
+    test_corruption();
+    test_switch_bits();
+    test_telemetry();
+    return test_finish("test_binframe");
+}
@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: MIT
+// Boots the firmware on the simulator and drives its supervisor UART with
+// every registered command name, then with unknown and near-miss names,
+// checking each gets dispatched or refused with unknown_cmd and that only
+// the counters it should touch move.
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "command_table.h"
+#include "json_reader.h"
+#include "sim_port.h"
+#include "test_util.h"
+
+#define TEST_SUPV_UART UART_NUM_1
+#define TEST_REPLY_TIMEOUT_MS 2000
+#define TEST_MAX_NAME 300
+
+void app_main(void);
+
+static int g_to_fw;
+static int g_from_fw;
+static char g_rx[4096];
+static size_t g_rx_len;
+static unsigned g_next_id;
+
+typedef struct {
+    char line[1024];
+    bool ok;
+    char error[32];
+} reply_t;
+
+// Reads frames until the reply carrying `id`, skipping events and
+// telemetry. False on timeout.
+static bool await_reply(const char *id, reply_t *reply) {
+    while (true) {
+        char *nl = memchr(g_rx, '\n', g_rx_len);
+        if (nl) {
+            const size_t len = (size_t)(nl - g_rx);
+            const size_t keep = len < sizeof(reply->line) - 1 ? len : sizeof(reply->line) - 1;
+            memcpy(reply->line, g_rx, keep);
+            reply->line[keep] = '\0';
+            g_rx_len -= len + 1;
+            memmove(g_rx, nl + 1, g_rx_len);
+
+            char scratch[sizeof(reply->line)];
+            memcpy(scratch, reply->line, keep + 1);
+            json_value_t rid, ok, error;
+            const json_field_t fields[] = {{"id", &rid}, {"ok", &ok}, {"error", &error}};
+            if (json_read_object(scratch, keep, fields, 3, NULL) != JSON_READ_OK || !json_value_is_string(&rid) ||
+                strcmp(rid.ptr, id) != 0) {
+                continue;
+            }
+            reply->ok = ok.type == JSON_TYPE_BOOL && ok.ptr[0] == 't';
+            snprintf(reply->error, sizeof(reply->error), "%s", json_value_is_string(&error) ? error.ptr : "");
+            return true;
+        }
+        struct pollfd pfd = {.fd = g_from_fw, .events = POLLIN};
+        if (g_rx_len == sizeof(g_rx) || poll(&pfd, 1, TEST_REPLY_TIMEOUT_MS) <= 0) {
+            return false;
+        }
+        const ssize_t n = read(g_from_fw, g_rx + g_rx_len, sizeof(g_rx) - g_rx_len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        g_rx_len += (size_t)n;
+    }
+}
+
+// Sends {"id":...,"cmd":<cmd_json>[,<args>]} and waits for its reply.
+static bool request(const char *cmd_json, const char *args, reply_t *reply) {
+    char id[16];
+    snprintf(id, sizeof(id), "t%u", g_next_id++);
+    char line[TEST_MAX_NAME * 2 + 256];
+    const int n = snprintf(line, sizeof(line), "{\"id\":\"%s\",\"cmd\":%s%s%s}\n", id, cmd_json, args ? "," : "",
+                           args ? args : "");
+    if (n < 0 || (size_t)n >= sizeof(line) || write(g_to_fw, line, (size_t)n) != n) {
+        return false;
+    }
+    return await_reply(id, reply);
+}
+
+// A value of each type the schemas ask for. The handlers may refuse it;
+// what matters here is that the command was reached.
+static const char *arg_value(json_type_t type) {
+    switch (type) {
+        case JSON_TYPE_STRING:
+            return "\"test\"";
+        case JSON_TYPE_NUMBER:
+            return "99";
+        case JSON_TYPE_BOOL:
+            return "false";
+        case JSON_TYPE_ARRAY:
+            return "[]";
+        case JSON_TYPE_OBJECT:
+            return "{}";
+        default:
+            return "null";
+    }
+}
+
+static void required_args(const command_def_t *def, char *buf, size_t cap) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (size_t a = 0; a < COMMAND_MAX_ARGS && def->args[a].name; ++a) {
+        if (def->args[a].required) {
+            len += (size_t)snprintf(buf + len, cap - len, "%s\"%s\":%s", len ? "," : "", def->args[a].name,
+                                    arg_value(def->args[a].type));
+        }
+    }
+}
+
+static bool has_required_args(const command_def_t *def) {
+    for (size_t a = 0; a < COMMAND_MAX_ARGS && def->args[a].name; ++a) {
+        if (def->args[a].required) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_registered(void) {
+    const size_t count = command_table_count();
+    CHECK(count > 0 && count <= COMMAND_MAX_COMMANDS);
+    CHECK(command_table_at(count) == NULL);
+    for (size_t i = 0; i < count; ++i) {
+        const command_def_t *def = command_table_at(i);
+        CHECK(command_table_lookup(def->name, strlen(def->name)) == def);
+        for (size_t j = 0; j < i; ++j) {
+            CHECK(strcmp(command_table_at(j)->name, def->name) != 0);
+        }
+
+        const command_stats_t before = *command_table_stats(def->name);
+        const uint32_t unknown = command_table_unknown_count();
+        char cmd[TEST_MAX_NAME];
+        char args[256];
+        snprintf(cmd, sizeof(cmd), "\"%s\"", def->name);
+        required_args(def, args, sizeof(args));
+        reply_t reply;
+        if (!request(cmd, args[0] ? args : NULL, &reply)) {
+            fprintf(stderr, "no reply to %s\n", def->name);
+            CHECK(false);
+            continue;
+        }
+        // Handlers may refuse the placeholder values (set_framing answers
+        // bad_args itself); the dispatch count shows the command was reached.
+        if (strcmp(reply.error, "unknown_cmd") == 0) {
+            fprintf(stderr, "%s: %s\n", def->name, reply.line);
+            CHECK(false);
+        }
+        CHECK(command_table_stats(def->name)->dispatched == before.dispatched + 1);
+        CHECK(command_table_stats(def->name)->rejected == before.rejected);
+        CHECK(command_table_unknown_count() == unknown);
+
+        // Without its required arguments it is refused by the schema check.
+        if (has_required_args(def)) {
+            CHECK(request(cmd, NULL, &reply));
+            CHECK_STR(reply.error, "bad_args");
+            CHECK(command_table_stats(def->name)->rejected == before.rejected + 1);
+        }
+    }
+}
+
+// Sends `cmd_json` as a command that must not resolve, and checks it gets
+// unknown_cmd and moves nothing but the unknown counter.
+static void expect_unknown(const char *cmd_json) {
+    const size_t count = command_table_count();
+    command_stats_t before[COMMAND_MAX_COMMANDS];
+    for (size_t i = 0; i < count; ++i) {
+        before[i] = *command_table_stats(command_table_at(i)->name);
+    }
+    const uint32_t unknown = command_table_unknown_count();
+    reply_t reply;
+    if (!request(cmd_json, NULL, &reply)) {
+        fprintf(stderr, "no reply to cmd %s\n", cmd_json);
+        CHECK(false);
+        return;
+    }
+    if (strcmp(reply.error, "unknown_cmd") != 0) {
+        fprintf(stderr, "cmd %s: %s\n", cmd_json, reply.line);
+        CHECK(false);
+    }
+    CHECK(!reply.ok);
+    CHECK(command_table_unknown_count() == unknown + 1);
+    for (size_t i = 0; i < count; ++i) {
+        const command_stats_t *after = command_table_stats(command_table_at(i)->name);
+        CHECK(after->dispatched == before[i].dispatched && after->rejected == before[i].rejected);
+    }
+}
+
+static bool is_registered(const char *name, size_t len) {
+    for (size_t i = 0; i < command_table_count(); ++i) {
+        const char *reg = command_table_at(i)->name;
+        if (strlen(reg) == len && memcmp(reg, name, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void near_miss(const char *name, size_t len) {
+    if (is_registered(name, len)) {
+        return;
+    }
+    CHECK(command_table_lookup(name, len) == NULL);
+    char cmd[TEST_MAX_NAME];
+    snprintf(cmd, sizeof(cmd), "\"%.*s\"", (int)len, name);
+    expect_unknown(cmd);
+}
+
+static void test_near_misses(void) {
+    for (size_t i = 0; i < command_table_count(); ++i) {
+        const char *name = command_table_at(i)->name;
+        const size_t len = strlen(name);
+        char v[TEST_MAX_NAME];
+
+        near_miss(name, len - 1);
+        near_miss(name + 1, len - 1);
+        snprintf(v, sizeof(v), "%s_", name);
+        near_miss(v, len + 1);
+        snprintf(v, sizeof(v), " %s", name);
+        near_miss(v, len + 1);
+        memcpy(v, name, len);
+        v[0] = (char)toupper((unsigned char)v[0]);
+        near_miss(v, len);
+        // Same length, first and last byte, so the same index slot: only the
+        // full compare can tell it apart.
+        if (len >= 3) {
+            memcpy(v, name, len);
+            v[len / 2] = v[len / 2] == 'x' ? 'y' : 'x';
+            near_miss(v, len);
+        }
+
+        // Escapes decoding to a name with extra bytes after it.
+        snprintf(v, sizeof(v), "\"%s\\u0000\"", name);
+        expect_unknown(v);
+        snprintf(v, sizeof(v), "\"%s\\n\"", name);
+        expect_unknown(v);
+    }
+
+    expect_unknown("\"\"");
+    expect_unknown("\"x\"");
+    expect_unknown("\"get\"");
+    char long_name[TEST_MAX_NAME];
+    long_name[0] = '"';
+    memset(long_name + 1, 'g', TEST_MAX_NAME - 3);
+    long_name[TEST_MAX_NAME - 2] = '"';
+    long_name[TEST_MAX_NAME - 1] = '\0';
+    expect_unknown(long_name);
+}
+
+// A cmd that is not a string is not a command at all: no reply, no counter.
+static void test_non_string_cmd(void) {
+    const uint32_t unknown = command_table_unknown_count();
+    reply_t reply;
+    CHECK(!request("42", NULL, &reply));
+    CHECK(command_table_unknown_count() == unknown);
+}
+
+int main(void) {
+    int to_fw[2];
+    int from_fw[2];
+    if (pipe(to_fw) != 0 || pipe(from_fw) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    g_to_fw = to_fw[1];
+    g_from_fw = from_fw[0];
+    sim_uart_attach(TEST_SUPV_UART, to_fw[0], from_fw[1]);
+    sim_uart_set_wire_timing(false);
+    sim_log_set_level(ESP_LOG_NONE);
+    app_main();
+
+    test_registered();
+    test_near_misses();
+    test_non_string_cmd();
+    return test_finish("test_commands");
+}
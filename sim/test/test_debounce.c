@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: MIT
+// Tests for the switch debouncer, driven with synthetic bounce trains the
+// way switches_service drives it: the first edge on an input masks it and
+// opens a window, later edges fold in, and the window closing reports one
+// change mask and the inputs to unmask. Checks single flips, glitches that
+// end where they started, several inputs sharing a window, and randomized
+// bursts each producing exactly one window.
+#include <stdint.h>
+#include <stdio.h>
+
+#include "debounce.h"
+#include "test_util.h"
+
+#define TEST_SETTLE_MS 20
+#define TEST_SETTLE_US (TEST_SETTLE_MS * 1000ULL)
+#define TEST_INPUTS 6
+#define TEST_BURSTS 20000
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rnd(uint64_t n) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng % n;
+}
+
+static void test_idle(void) {
+    debouncer_t d;
+    debounce_init(&d, TEST_SETTLE_MS, 0x5);
+    CHECK(d.stable == 0x5 && d.masked == 0 && d.deadline_us == 0);
+    debounce_mask_t unmask = 0xFF;
+    CHECK(debounce_settle(&d, 0x5, 1000000, &unmask) == 0 && unmask == 0);
+    // With no window open even moved levels are not sampled.
+    CHECK(debounce_settle(&d, 0x0, 2000000, &unmask) == 0 && unmask == 0);
+    CHECK(d.stable == 0x5 && d.windows == 0);
+    CHECK(debounce_interrupts(&d, 0, 3000000) == 0);
+}
+
+static void test_single_flip(void) {
+    debouncer_t d;
+    debounce_init(&d, TEST_SETTLE_MS, 0x0);
+    const uint64_t t0 = 1000000;
+    CHECK(debounce_interrupts(&d, 0x4, t0) == t0 + TEST_SETTLE_US);
+    CHECK(d.masked == 0x4 && d.interrupts == 1);
+
+    // Before the deadline nothing is sampled or unmasked.
+    debounce_mask_t unmask = 0xFF;
+    CHECK(debounce_settle(&d, 0x4, t0 + TEST_SETTLE_US - 1, &unmask) == 0 && unmask == 0);
+    CHECK(d.masked == 0x4);
+
+    CHECK(debounce_settle(&d, 0x4, t0 + TEST_SETTLE_US, &unmask) == 0x4);
+    CHECK(unmask == 0x4 && d.stable == 0x4 && d.masked == 0 && d.deadline_us == 0);
+    CHECK(d.windows == 1 && d.changes == 1);
+    // Closed: a late timer finds nothing.
+    CHECK(debounce_settle(&d, 0x0, t0 + 2 * TEST_SETTLE_US, &unmask) == 0 && unmask == 0);
+}
+
+static void test_glitch(void) {
+    debouncer_t d;
+    debounce_init(&d, TEST_SETTLE_MS, 0x2);
+    const uint64_t t0 = 5000000;
+    debounce_interrupts(&d, 0x2, t0);
+    debounce_mask_t unmask;
+    CHECK(debounce_settle(&d, 0x2, t0 + TEST_SETTLE_US, &unmask) == 0);
+    CHECK(unmask == 0x2 && d.windows == 1 && d.changes == 0 && d.stable == 0x2);
+}
+
+static void test_shared_window(void) {
+    debouncer_t d;
+    debounce_init(&d, TEST_SETTLE_MS, 0x0);
+    const uint64_t t0 = 1000000;
+    CHECK(debounce_interrupts(&d, 0x1, t0) == t0 + TEST_SETTLE_US);
+    // Another input partway through joins the open window, which is not
+    // pushed out; a masked input interrupting again is not counted.
+    CHECK(debounce_interrupts(&d, 0x8, t0 + 5000) == t0 + TEST_SETTLE_US);
+    CHECK(debounce_interrupts(&d, 0x9, t0 + 6000) == t0 + TEST_SETTLE_US);
+    CHECK(d.masked == 0x9 && d.interrupts == 2);
+
+    // Both flipped; an input that did not interrupt but reads differently
+    // is reported too, though its interrupt was never masked.
+    debounce_mask_t unmask;
+    CHECK(debounce_settle(&d, 0x19, t0 + TEST_SETTLE_US, &unmask) == 0x19);
+    CHECK(unmask == 0x9 && d.stable == 0x19 && d.windows == 1 && d.changes == 1);
+
+    // An edge between sampling and unmasking raised no interrupt; the
+    // service loop feeds it back in, opening the next window.
+    const uint64_t t1 = t0 + TEST_SETTLE_US;
+    const debounce_mask_t moved = (0x11 ^ d.stable) & unmask;
+    CHECK(moved == 0x8);
+    CHECK(debounce_interrupts(&d, moved, t1) == t1 + TEST_SETTLE_US);
+    CHECK(debounce_settle(&d, 0x11, t1 + TEST_SETTLE_US, &unmask) == 0x8);
+    CHECK(unmask == 0x8 && d.stable == 0x11 && d.windows == 2);
+}
+
+// Bursts of bouncing edges shorter than the settle time, separated by quiet:
+// each must give one window, reporting exactly the inputs whose level ended
+// different and unmasking exactly the ones that bounced.
+static void test_bounce_trains(void) {
+    debouncer_t d;
+    debounce_mask_t raw = (debounce_mask_t)rnd(1u << TEST_INPUTS);
+    debounce_init(&d, TEST_SETTLE_MS, raw);
+    uint64_t now = 1000000;
+    unsigned long bad = 0;
+    uint32_t flips = 0;
+    for (uint32_t burst = 0; burst < TEST_BURSTS; ++burst) {
+        const debounce_mask_t before = raw;
+        debounce_mask_t bounced = 0;
+        uint64_t deadline = 0;
+        // Up to a dozen edges on one to three inputs, the last well inside
+        // the window the first one opens.
+        debounce_mask_t inputs[3];
+        const unsigned ninputs = 1 + (unsigned)rnd(3);
+        for (unsigned i = 0; i < ninputs; ++i) {
+            inputs[i] = 1u << rnd(TEST_INPUTS);
+        }
+        const unsigned edges = 1 + (unsigned)rnd(12);
+        for (unsigned e = 0; e < edges; ++e) {
+            const debounce_mask_t bit = inputs[rnd(ninputs)];
+            raw ^= bit;
+            // The ISR only fires while the input is unmasked.
+            if (!(d.masked & bit)) {
+                const uint64_t got = debounce_interrupts(&d, bit, now);
+                if (deadline == 0) {
+                    deadline = now + TEST_SETTLE_US;
+                }
+                if (got != deadline) {
+                    ++bad;
+                }
+            }
+            bounced |= bit;
+            now += 100 + rnd(TEST_SETTLE_US / 16);
+        }
+        CHECK(d.masked == bounced);
+
+        debounce_mask_t unmask;
+        const uint32_t windows = d.windows;
+        if (debounce_settle(&d, raw, deadline - 1, &unmask) != 0 || unmask != 0) {
+            ++bad;
+        }
+        const debounce_mask_t changed = debounce_settle(&d, raw, deadline, &unmask);
+        if (changed != (raw ^ before) || unmask != bounced || d.windows != windows + 1 || d.stable != raw) {
+            if (bad++ < 5) {
+                fprintf(stderr, "burst %u: changed %#x want %#x, unmask %#x want %#x\n", burst, changed,
+                        raw ^ before, unmask, bounced);
+            }
+        }
+        flips += changed != 0;
+        now = deadline + TEST_SETTLE_US + rnd(10 * TEST_SETTLE_US);
+    }
+    CHECK(bad == 0);
+    CHECK(d.windows == TEST_BURSTS && d.changes == flips);
+    // Both flips and glitches came up.
+    CHECK(flips > TEST_BURSTS / 4 && flips < TEST_BURSTS);
+}
+
+int main(void) {
+    test_idle();
+    test_single_flip();
+    test_glitch();
+    test_shared_window();
+    test_bounce_trains();
+    return test_finish("test_debounce");
+}
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: MIT
+// Boots the firmware under virtual time and sends arm_poweroff requests mixed
+// with pings, checking the replies come back in order and in full: pings are
+// answered while an arm waits out the preparation, an arm past the table's
+// capacity is refused busy, waiting arms are all answered when the handshake
+// reaches armed or is cancelled, and nothing answered times out later.
+#include <stdio.h>
+#include <string.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "pending.h"
+#include "sim_port.h"
+#include "test_util.h"
+
+#define TEST_SUPV_UART UART_NUM_1
+#define TEST_MAX_REPLIES 32
+#define TEST_RUN_US 10000000ULL
+
+void app_main(void);
+
+typedef struct {
+    uint64_t at_us;
+    const char *line;
+} sent_t;
+
+// Five arms against a four-entry table, pings between and after them, then
+// a cancel once armed and a cancel while two new arms are preparing.
+static const sent_t k_sent[] = {
+    {1000000, "{\"id\":\"a0\",\"cmd\":\"arm_poweroff\"}"},
+    {1000000, "{\"id\":\"p0\",\"cmd\":\"ping\"}"},
+    {1000000, "{\"id\":\"a1\",\"cmd\":\"arm_poweroff\"}"},
+    {1000000, "{\"id\":\"a2\",\"cmd\":\"arm_poweroff\"}"},
+    {1000000, "{\"id\":\"a3\",\"cmd\":\"arm_poweroff\"}"},
+    {1000000, "{\"id\":\"a4\",\"cmd\":\"arm_poweroff\"}"},
+    {1000000, "{\"id\":\"p1\",\"cmd\":\"ping\"}"},
+    {1100000, "{\"id\":\"p2\",\"cmd\":\"ping\"}"},
+    {2000000, "{\"id\":\"c0\",\"cmd\":\"cancel_poweroff\"}"},
+    {3000000, "{\"id\":\"b0\",\"cmd\":\"arm_poweroff\"}"},
+    {3000000, "{\"id\":\"b1\",\"cmd\":\"arm_poweroff\"}"},
+    {3100000, "{\"id\":\"c1\",\"cmd\":\"cancel_poweroff\"}"},
+    {3100000, "{\"id\":\"p3\",\"cmd\":\"ping\"}"},
+};
+#define TEST_SENT (sizeof(k_sent) / sizeof(k_sent[0]))
+
+typedef struct {
+    uint64_t at_us;
+    char line[128];
+} reply_t;
+
+static size_t g_next_sent;
+static char g_tx[1024];
+static size_t g_tx_len;
+static reply_t g_replies[TEST_MAX_REPLIES];
+static size_t g_reply_count;
+
+static void send_callout(void *arg) {
+    (void)arg;
+    const uint64_t now = sim_virtual_now_us();
+    while (g_next_sent < TEST_SENT && k_sent[g_next_sent].at_us <= now) {
+        char line[128];
+        const int n = snprintf(line, sizeof(line), "%s\n", k_sent[g_next_sent++].line);
+        sim_uart_inject(TEST_SUPV_UART, line, (size_t)n);
+    }
+    if (g_next_sent < TEST_SENT) {
+        sim_virtual_call_at(k_sent[g_next_sent].at_us, send_callout, NULL);
+    }
+}
+
+// Keeps the replies, with when they went out; events and telemetry are
+// skipped.
+static void tx_hook(const uint8_t *data, size_t len, void *ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i] != '\n') {
+            if (g_tx_len < sizeof(g_tx) - 1) {
+                g_tx[g_tx_len++] = (char)data[i];
+            }
+            continue;
+        }
+        g_tx[g_tx_len] = '\0';
+        if (strncmp(g_tx, "{\"id\":", 6) == 0 && g_reply_count < TEST_MAX_REPLIES) {
+            reply_t *r = &g_replies[g_reply_count++];
+            r->at_us = sim_virtual_now_us();
+            const size_t keep = g_tx_len < sizeof(r->line) - 1 ? g_tx_len : sizeof(r->line) - 1;
+            memcpy(r->line, g_tx, keep);
+            r->line[keep] = '\0';
+        }
+        g_tx_len = 0;
+    }
+}
+
+// Index of the one reply to `id`, or -1.
+static int reply_index(const char *id) {
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "{\"id\":\"%s\",", id);
+    int found = -1;
+    for (size_t i = 0; i < g_reply_count; ++i) {
+        if (strncmp(g_replies[i].line, prefix, strlen(prefix)) == 0) {
+            if (found >= 0) {
+                fprintf(stderr, "%s answered twice: %s\n", id, g_replies[i].line);
+                CHECK(false);
+            }
+            found = (int)i;
+        }
+    }
+    if (found < 0) {
+        fprintf(stderr, "%s not answered\n", id);
+        CHECK(false);
+    }
+    return found;
+}
+
+static const char *reply_line(int index) {
+    return index >= 0 ? g_replies[index].line : "";
+}
+
+// Checks the replies to `ids` arrived in that order with the given lines.
+static void expect_in_order(const char *const *ids, const char *const *lines, size_t count) {
+    int prev = -1;
+    for (size_t i = 0; i < count; ++i) {
+        const int index = reply_index(ids[i]);
+        CHECK_STR(reply_line(index), lines[i]);
+        if (index >= 0 && index <= prev) {
+            fprintf(stderr, "%s answered before %s\n", ids[i], ids[i - 1]);
+            CHECK(false);
+        }
+        prev = index > prev ? index : prev;
+    }
+}
+
+static void test_arm_with_pings(void) {
+    // The pings and the refusal go out while the arms wait for preparation
+    // to end; the arms are then answered oldest first.
+    static const char *const ids[] = {"p0", "a4", "p1", "p2", "a0", "a1", "a2", "a3"};
+    static const char *const lines[] = {
+        "{\"id\":\"p0\",\"ok\":true,\"uptime_s\":1}",
+        "{\"id\":\"a4\",\"ok\":false,\"error\":\"busy\"}",
+        "{\"id\":\"p1\",\"ok\":true,\"uptime_s\":1}",
+        "{\"id\":\"p2\",\"ok\":true,\"uptime_s\":1}",
+        "{\"id\":\"a0\",\"ok\":true,\"poweroff_ok\":true}",
+        "{\"id\":\"a1\",\"ok\":true,\"poweroff_ok\":true}",
+        "{\"id\":\"a2\",\"ok\":true,\"poweroff_ok\":true}",
+        "{\"id\":\"a3\",\"ok\":true,\"poweroff_ok\":true}",
+    };
+    _Static_assert(PENDING_MAX == 4, "a4 is meant to find the table full");
+    expect_in_order(ids, lines, sizeof(ids) / sizeof(ids[0]));
+
+    const int p2 = reply_index("p2");
+    const int a0 = reply_index("a0");
+    if (p2 >= 0 && a0 >= 0) {
+        CHECK(g_replies[p2].at_us < 1250000);
+        CHECK(g_replies[a0].at_us >= 1250000 && g_replies[a0].at_us < 1300000);
+    }
+}
+
+static void test_cancel(void) {
+    // Arms waiting when the handshake is cancelled get the reason.
+    static const char *const ids[] = {"c0", "c1", "p3", "b0", "b1"};
+    static const char *const lines[] = {
+        "{\"id\":\"c0\",\"ok\":true}",
+        "{\"id\":\"c1\",\"ok\":true}",
+        "{\"id\":\"p3\",\"ok\":true,\"uptime_s\":3}",
+        "{\"id\":\"b0\",\"ok\":false,\"error\":\"cancelled\"}",
+        "{\"id\":\"b1\",\"ok\":false,\"error\":\"cancelled\"}",
+    };
+    expect_in_order(ids, lines, sizeof(ids) / sizeof(ids[0]));
+}
+
+static void test_no_late_replies(void) {
+    // The run goes on past every reply timeout: a request answered once is
+    // not answered again with a timeout.
+    CHECK(g_reply_count == TEST_SENT);
+    for (size_t i = 0; i < g_reply_count; ++i) {
+        if (strstr(g_replies[i].line, "timeout")) {
+            fprintf(stderr, "late reply: %s\n", g_replies[i].line);
+            CHECK(false);
+        }
+    }
+}
+
+int main(void) {
+    sim_virtual_time_enable(1);
+    sim_uart_set_tx_hook(TEST_SUPV_UART, tx_hook, NULL);
+    sim_uart_set_wire_timing(false);
+    sim_log_set_level(ESP_LOG_NONE);
+    sim_virtual_call_at(k_sent[0].at_us, send_callout, NULL);
+    const uint64_t end_us = sim_virtual_run(app_main, TEST_RUN_US);
+    CHECK(end_us >= TEST_RUN_US);
+
+    test_arm_with_pings();
+    test_cancel();
+    test_no_late_replies();
+    return test_finish("test_deferred_replies");
+}
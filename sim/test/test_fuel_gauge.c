@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: MIT
+// Tests for the pack fuel gauge: OCV table lookup, seeding from the first
+// voltage, exact coulomb counting with the sub-millisecond remainder carried,
+// clamping at empty and full, the rest correction and the time estimates.
+// Then a simulated pack that differs from what the gauge assumes is taken
+// through rest, a bursty discharge, a charge and rest again, and the charge
+// and time estimates must stay within bounds throughout.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuel_gauge.h"
+#include "test_util.h"
+
+#define MAMS_PER_MAH 3600000LL
+
+// The firmware's gauge settings and the datasheet curve it uses (main.c).
+static const fuel_gauge_ocv_point_t k_ocv[] = {
+    {9810, 0},    {10830, 50},  {11070, 100}, {11310, 200}, {11460, 300},  {11580, 400},
+    {11700, 500}, {11850, 600}, {12030, 700}, {12210, 800}, {12390, 900}, {12600, 1000},
+};
+
+static const fuel_gauge_config_t k_cfg = {
+    .capacity_mah = 5000,
+    .r_internal_mohm = 120,
+    .rest_ma = 50,
+    .rest_ms = 600000,
+    .ocv_shift = 10,
+    .rate_shift = 8,
+    .ocv = k_ocv,
+    .ocv_count = sizeof(k_ocv) / sizeof(k_ocv[0]),
+};
+
+static void test_init(void) {
+    fuel_gauge_t g;
+    fuel_gauge_config_t cfg = k_cfg;
+    CHECK(fuel_gauge_init(&g, &cfg));
+    CHECK(!fuel_gauge_ready(&g));
+    CHECK(fuel_gauge_time_to_empty_min(&g) == -1 && fuel_gauge_time_to_full_min(&g) == -1);
+    cfg.capacity_mah = 0;
+    CHECK(!fuel_gauge_init(&g, &cfg));
+    cfg = k_cfg;
+    cfg.ocv_count = 0;
+    CHECK(!fuel_gauge_init(&g, &cfg));
+    cfg = k_cfg;
+    cfg.ocv_shift = 16;
+    CHECK(!fuel_gauge_init(&g, &cfg));
+    cfg = k_cfg;
+    cfg.rate_shift = 16;
+    CHECK(!fuel_gauge_init(&g, &cfg));
+}
+
+static void test_ocv_table(void) {
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 9000) == 0);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 9810) == 0);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 11700) == 500);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 11640) == 450);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 12599) == 999);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 12600) == 1000);
+    CHECK(fuel_gauge_ocv_permille(&k_cfg, 14000) == 1000);
+    // Monotonic across the whole table.
+    int32_t prev = 0;
+    for (int32_t mv = 9000; mv <= 13000; ++mv) {
+        const int32_t p = fuel_gauge_ocv_permille(&k_cfg, mv);
+        CHECK(p >= prev);
+        prev = p;
+    }
+}
+
+static void test_seed(void) {
+    // The first update seeds from the voltage the pack would show at rest:
+    // 11460 mV under a 1 A load with 120 mOhm is 11580 mV open circuit.
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_update(&g, 11460, -1000, 1000000);
+    CHECK(fuel_gauge_ready(&g) && fuel_gauge_permille(&g) == 400 && fuel_gauge_pct(&g) == 40);
+
+    // A restored charge is kept instead, clamped to the capacity.
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_restore(&g, 5000 * MAMS_PER_MAH * 2);
+    CHECK(fuel_gauge_permille(&g) == 1000);
+    fuel_gauge_update(&g, 9000, 0, 1000000);
+    CHECK(fuel_gauge_permille(&g) == 1000);
+    fuel_gauge_restore(&g, -1);
+    CHECK(g.charge_mams == 0);
+}
+
+static void test_coulomb_count(void) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    const int64_t start = 2500 * MAMS_PER_MAH;
+    fuel_gauge_restore(&g, start);
+
+    // An hour at -1000 mA in 50 ms steps takes exactly 1000 mAh.
+    uint64_t now = 1000000;
+    fuel_gauge_update(&g, 11500, -1000, now);
+    for (int i = 0; i < 72000; ++i) {
+        now += 50000;
+        fuel_gauge_update(&g, 11500, -1000, now);
+    }
+    CHECK(g.charge_mams == start - 1000 * MAMS_PER_MAH);
+
+    // Steps of 1.5 ms lose nothing to rounding: the half milliseconds carry.
+    const int64_t before = g.charge_mams;
+    for (int i = 0; i < 1000; ++i) {
+        now += 1500;
+        fuel_gauge_update(&g, 11500, -1000, now);
+    }
+    CHECK(g.charge_mams == before - 1000LL * 1500);
+
+    // A ramp integrates by trapezoid: 0 to 200 mA over 1 s is 100 mA*s.
+    const int64_t ramp = g.charge_mams;
+    fuel_gauge_update(&g, 11500, 0, now);
+    fuel_gauge_update(&g, 11500, 200, now + 1000000);
+    CHECK(g.charge_mams == ramp + 100000);
+
+    // Time going backwards adds nothing.
+    const int64_t still = g.charge_mams;
+    fuel_gauge_update(&g, 11500, 200, now);
+    CHECK(g.charge_mams == still);
+}
+
+static void test_clamp(void) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_restore(&g, 10 * MAMS_PER_MAH);
+    uint64_t now = 0;
+    fuel_gauge_update(&g, 10000, -3000, now);
+    for (int i = 0; i < 100; ++i) {
+        now += 1000000;
+        fuel_gauge_update(&g, 10000, -3000, now);
+    }
+    CHECK(g.charge_mams == 0 && fuel_gauge_permille(&g) == 0);
+    CHECK(fuel_gauge_time_to_empty_min(&g) == 0);
+
+    fuel_gauge_restore(&g, 4999 * MAMS_PER_MAH);
+    fuel_gauge_update(&g, 12500, 3000, now);
+    for (int i = 0; i < 100; ++i) {
+        now += 1000000;
+        fuel_gauge_update(&g, 12500, 3000, now);
+    }
+    CHECK(g.charge_mams == 5000 * MAMS_PER_MAH && fuel_gauge_pct(&g) == 100);
+}
+
+static void test_rest_correction(void) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_restore(&g, 3000 * MAMS_PER_MAH);
+    // The pack reads 40 % at rest; nothing moves for the first ten minutes.
+    uint64_t now = 0;
+    fuel_gauge_update(&g, 11580, 0, now);
+    while (now < 600000000ULL - 1000000) {
+        now += 1000000;
+        fuel_gauge_update(&g, 11580, 0, now);
+    }
+    CHECK(g.ocv_updates == 0 && fuel_gauge_permille(&g) == 600);
+    // Then it is pulled towards the voltage, a little each update.
+    for (int i = 0; i < 10000; ++i) {
+        now += 1000000;
+        fuel_gauge_update(&g, 11580, 0, now);
+    }
+    CHECK(g.ocv_updates > 9000);
+    CHECK(abs(fuel_gauge_permille(&g) - 400) <= 2);
+
+    // Current above the rest band restarts the wait.
+    const uint32_t ocv_updates = g.ocv_updates;
+    now += 1000000;
+    fuel_gauge_update(&g, 11500, -500, now);
+    now += 1000000;
+    fuel_gauge_update(&g, 11580, 0, now);
+    CHECK(g.ocv_updates == ocv_updates);
+}
+
+static void test_time_estimates(void) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_restore(&g, 2000 * MAMS_PER_MAH);
+    uint64_t now = 0;
+    fuel_gauge_update(&g, 11500, -1000, now);
+    CHECK(fuel_gauge_time_to_empty_min(&g) == 120);
+    CHECK(fuel_gauge_time_to_full_min(&g) == -1);
+
+    // The averaged rate follows a change of current gradually.
+    now += 50000;
+    fuel_gauge_update(&g, 11500, 1500, now);
+    CHECK(fuel_gauge_time_to_empty_min(&g) > 120);
+    for (int i = 0; i < 4000; ++i) {
+        now += 50000;
+        fuel_gauge_update(&g, 11500, 1500, now);
+    }
+    CHECK(fuel_gauge_time_to_empty_min(&g) == -1);
+    const int64_t left = g.capacity_mams - g.charge_mams;
+    CHECK(fuel_gauge_time_to_full_min(&g) == (int32_t)(left / 1500 / 60000));
+
+    // Within the rest band neither applies.
+    for (int i = 0; i < 8000; ++i) {
+        now += 50000;
+        fuel_gauge_update(&g, 11500, 20, now);
+    }
+    CHECK(fuel_gauge_time_to_empty_min(&g) == -1 && fuel_gauge_time_to_full_min(&g) == -1);
+}
+
+// The simulated pack: 2 % less capacity than configured, a curve 15 mV high,
+// 110 mOhm of resistance plus a 60 mOhm polarisation that relaxes over 90 s.
+// Current is measured 1 % high with a 6 mA offset and +-10 mA of noise,
+// voltage with +-8 mV of noise.
+#define PACK_MAH 4900.0
+#define PACK_OCV_BIAS_MV 15.0
+#define PACK_R0_MOHM 110.0
+#define PACK_RP_MOHM 60.0
+#define PACK_TAU_S 90.0
+#define PACK_STEP_MS 50
+// Once the first rest has corrected the stale starting estimate.
+#define PACK_MAX_ERR_PERMILLE 30
+#define PACK_MAX_TIME_ERR_PCT 10
+
+typedef enum {
+    PHASE_REST_START = 0,
+    PHASE_DISCHARGE,
+    PHASE_REST_EMPTY,
+    PHASE_CHARGE,
+    PHASE_REST_FULL,
+    PHASE_DONE,
+} phase_t;
+
+static uint64_t g_rng = 0x2545F4914F6CDD1DULL;
+
+static uint32_t noise(uint32_t span) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return (uint32_t)(g_rng % span);
+}
+
+static double pack_ocv_mv(double permille) {
+    const size_t n = sizeof(k_ocv) / sizeof(k_ocv[0]);
+    for (size_t i = 1; i < n; ++i) {
+        if (permille <= k_ocv[i].permille) {
+            const double t =
+                (permille - k_ocv[i - 1].permille) / (double)(k_ocv[i].permille - k_ocv[i - 1].permille);
+            return k_ocv[i - 1].mv + t * (k_ocv[i].mv - k_ocv[i - 1].mv) + PACK_OCV_BIAS_MV;
+        }
+    }
+    return k_ocv[n - 1].mv + PACK_OCV_BIAS_MV;
+}
+
+// 15 min at rest at 85 %, a bursty discharge (-0.9 A, -2.6 A for 1 s in 4)
+// to 8 %, 20 min at rest, a 1.8 A charge to 95 % and 20 min at rest. The
+// gauge starts from a stale saved estimate of 65 % and is reset and restored
+// halfway through the discharge.
+static void test_simulated_pack(void) {
+    fuel_gauge_t g;
+    fuel_gauge_init(&g, &k_cfg);
+    fuel_gauge_restore(&g, (int64_t)k_cfg.capacity_mah * MAMS_PER_MAH * 65 / 100);
+
+    const double dt_s = PACK_STEP_MS / 1000.0;
+    double charge_mah = PACK_MAH * 0.85;
+    double vp_mv = 0.0;
+    phase_t phase = PHASE_REST_START;
+    double phase_s = 0.0;
+    uint64_t now_us = 0;
+    int corrected_err = -1;
+    int max_err = 0;
+    int tte_err_pct = -1;
+    int ttf_err_pct = -1;
+    bool restored = false;
+    for (size_t step = 0; phase != PHASE_DONE; ++step) {
+        double ma;
+        switch (phase) {
+            case PHASE_DISCHARGE: ma = step % 80 < 20 ? -2600.0 : -900.0; break;
+            case PHASE_CHARGE: ma = 1800.0; break;
+            default: ma = -20.0; break;
+        }
+        charge_mah += ma * dt_s / 3600.0;
+        vp_mv += (ma * PACK_RP_MOHM / 1000.0 - vp_mv) * dt_s / PACK_TAU_S;
+        const double true_permille = charge_mah * 1000.0 / PACK_MAH;
+        const double mv = pack_ocv_mv(true_permille) + ma * PACK_R0_MOHM / 1000.0 + vp_mv;
+        now_us += PACK_STEP_MS * 1000;
+        fuel_gauge_update(&g, (int32_t)lround(mv) + (int32_t)noise(17) - 8,
+                          (int32_t)lround(ma * 1.01) + 6 + (int32_t)noise(21) - 10, now_us);
+
+        const int err = abs(fuel_gauge_permille(&g) - (int)lround(true_permille));
+        if (phase != PHASE_REST_START && err > max_err) {
+            max_err = err;
+        }
+        if (phase == PHASE_DISCHARGE && true_permille <= 500.0 && tte_err_pct < 0) {
+            const double true_min = charge_mah / (0.25 * 2600.0 + 0.75 * 900.0) * 60.0;
+            tte_err_pct = (int)lround(fabs(fuel_gauge_time_to_empty_min(&g) - true_min) * 100.0 / true_min);
+        }
+        if (phase == PHASE_DISCHARGE && true_permille <= 400.0 && !restored) {
+            const int64_t saved = g.charge_mams;
+            fuel_gauge_init(&g, &k_cfg);
+            fuel_gauge_restore(&g, saved);
+            restored = true;
+        }
+        if (phase == PHASE_CHARGE && true_permille >= 500.0 && ttf_err_pct < 0) {
+            const double true_min = (PACK_MAH - charge_mah) / 1800.0 * 60.0;
+            ttf_err_pct = (int)lround(fabs(fuel_gauge_time_to_full_min(&g) - true_min) * 100.0 / true_min);
+        }
+
+        phase_s += dt_s;
+        bool next;
+        switch (phase) {
+            case PHASE_DISCHARGE: next = true_permille <= 80.0; break;
+            case PHASE_CHARGE: next = true_permille >= 950.0; break;
+            case PHASE_REST_START: next = phase_s >= 15 * 60; break;
+            default: next = phase_s >= 20 * 60; break;
+        }
+        if (next) {
+            if (phase == PHASE_REST_START) {
+                corrected_err = err;
+            }
+            phase = (phase_t)(phase + 1);
+            phase_s = 0.0;
+        }
+    }
+    printf("simulated pack: %.1f h, soc err %d/%d permille, tte %d%%, ttf %d%%, %u ocv updates\n", now_us / 3.6e9,
+           corrected_err, max_err, tte_err_pct, ttf_err_pct, (unsigned)g.ocv_updates);
+    CHECK(corrected_err >= 0 && corrected_err <= PACK_MAX_ERR_PERMILLE);
+    CHECK(max_err <= PACK_MAX_ERR_PERMILLE);
+    CHECK(tte_err_pct >= 0 && tte_err_pct <= PACK_MAX_TIME_ERR_PCT);
+    CHECK(ttf_err_pct >= 0 && ttf_err_pct <= PACK_MAX_TIME_ERR_PCT);
+    CHECK(g.ocv_updates > 0);
+}
+
+int main(void) {
+    test_init();
+    test_ocv_table();
+    test_seed();
+    test_coulomb_count();
+    test_clamp();
+    test_rest_correction();
+    test_time_estimates();
+    test_simulated_pack();
+    return test_finish("test_fuel_gauge");
+}
@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: MIT
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "json_writer.h"
+#include "telemetry.h"
+#include "test_util.h"
+
+static char g_buf[256];
+
+static void begin(json_writer_t *w) {
+    json_writer_init(w, g_buf, sizeof(g_buf));
+}
+
+// Ends the line and returns it without the newline ("" if it overflowed).
+static const char *finish(json_writer_t *w) {
+    const size_t len = json_writer_end_line(w);
+    if (len > 0) {
+        w->buf[len - 1] = '\0';
+    }
+    return w->buf;
+}
+
+static const char *number(double v) {
+    json_writer_t w;
+    begin(&w);
+    json_writer_number(&w, v);
+    return finish(&w);
+}
+
+static const char *fixed(int32_t v, unsigned decimals) {
+    json_writer_t w;
+    begin(&w);
+    json_writer_fixed(&w, v, decimals);
+    return finish(&w);
+}
+
+static const char *float_at(float v, unsigned decimals) {
+    json_writer_t w;
+    begin(&w);
+    json_writer_float(&w, v, decimals);
+    return finish(&w);
+}
+
+static const char *string(const char *s) {
+    json_writer_t w;
+    begin(&w);
+    json_writer_string(&w, s);
+    return finish(&w);
+}
+
+static void test_objects(void) {
+    json_writer_t w;
+    begin(&w);
+    json_writer_begin_object(&w);
+    json_writer_add_string(&w, "id", "7");
+    json_writer_add_bool(&w, "ok", true);
+    json_writer_key(&w, "status");
+    json_writer_begin_object(&w);
+    json_writer_add_int(&w, "pack_mv", 11750);
+    json_writer_add_null(&w, "battery_pct");
+    json_writer_add_bool(&w, "lid", false);
+    json_writer_end_object(&w);
+    json_writer_add_uint64(&w, "uptime_s", 3605);
+    json_writer_key(&w, "empty");
+    json_writer_begin_object(&w);
+    json_writer_end_object(&w);
+    json_writer_key(&w, "wait");
+    json_writer_begin_array(&w);
+    json_writer_int(&w, 12);
+    json_writer_begin_array(&w);
+    json_writer_end_array(&w);
+    json_writer_begin_object(&w);
+    json_writer_end_object(&w);
+    json_writer_string(&w, "x");
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    const size_t len = json_writer_end_line(&w);
+    CHECK_STR(g_buf, "{\"id\":\"7\",\"ok\":true,\"status\":{\"pack_mv\":11750,\"battery_pct\":null,\"lid\":false},"
+                     "\"uptime_s\":3605,\"empty\":{},\"wait\":[12,[],{},\"x\"]}\n");
+    CHECK(len == strlen(g_buf));
+}
+
+static void test_escaping(void) {
+    CHECK_STR(string("plain"), "\"plain\"");
+    CHECK_STR(string(""), "\"\"");
+    CHECK_STR(string(NULL), "null");
+    CHECK_STR(string("a\"b\\c"), "\"a\\\"b\\\\c\"");
+    CHECK_STR(string("\b\f\n\r\t"), "\"\\b\\f\\n\\r\\t\"");
+    CHECK_STR(string("\x01\x1f x"), "\"\\u0001\\u001f x\"");
+    // Everything from 0x20 up passes through, UTF-8 and DEL included.
+    CHECK_STR(string("/\x7f\xc3\xa9"), "\"/\x7f\xc3\xa9\"");
+
+    json_writer_t w;
+    begin(&w);
+    json_writer_begin_object(&w);
+    json_writer_add_int(&w, "k\"\n", 1);
+    json_writer_end_object(&w);
+    CHECK_STR(finish(&w), "{\"k\\\"\\n\":1}");
+}
+
+static void test_overflow(void) {
+    const char *line = "{\"id\":\"12\",\"ok\":true}";
+    const size_t need = strlen(line) + 2; // newline and NUL
+    char buf[64];
+    for (size_t cap = 0; cap <= need; ++cap) {
+        memset(buf, 'x', sizeof(buf));
+        json_writer_t w;
+        json_writer_init(&w, buf, cap);
+        json_writer_begin_object(&w);
+        json_writer_add_string(&w, "id", "12");
+        json_writer_add_bool(&w, "ok", true);
+        json_writer_end_object(&w);
+        const size_t len = json_writer_end_line(&w);
+        if (cap == need) {
+            CHECK(len == need - 1);
+            CHECK(memcmp(buf, line, need - 2) == 0 && buf[need - 2] == '\n' && buf[need - 1] == '\0');
+        } else {
+            // Nothing partial is ever handed out, nor written past `cap`.
+            CHECK(len == 0);
+            CHECK(w.overflow);
+            CHECK(cap == 0 || buf[0] == '\0');
+            CHECK(buf[cap] == 'x');
+        }
+    }
+
+    // Once latched, later output that would fit is still refused.
+    json_writer_t w;
+    json_writer_init(&w, buf, 8);
+    json_writer_string(&w, "too long for eight");
+    json_writer_int(&w, 1);
+    CHECK(json_writer_end_line(&w) == 0);
+}
+
+static void test_integers(void) {
+    json_writer_t w;
+    const int ints[] = {0, 7, -7, 10, 99, 100, -100, 12345, 1000000000, INT_MAX, INT_MIN, INT_MIN + 1};
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+        char want[16];
+        snprintf(want, sizeof(want), "%d", ints[i]);
+        begin(&w);
+        json_writer_int(&w, ints[i]);
+        CHECK_STR(finish(&w), want);
+    }
+    const uint64_t wide[] = {0, 9, 4294967295ULL, 4294967296ULL, 999999999999999999ULL, 1000000000000000000ULL,
+                             18446744073709551615ULL};
+    for (size_t i = 0; i < sizeof(wide) / sizeof(wide[0]); ++i) {
+        char want[24];
+        snprintf(want, sizeof(want), "%llu", (unsigned long long)wide[i]);
+        begin(&w);
+        json_writer_uint64(&w, wide[i]);
+        CHECK_STR(finish(&w), want);
+    }
+}
+
+// cJSON's print_number: %d when integral and in int range, else the shorter
+// of %1.15g and %1.17g that reads back the same.
+static void test_numbers(void) {
+    CHECK_STR(number(0.0), "0");
+    CHECK_STR(number(-0.0), "0");
+    CHECK_STR(number(42.0), "42");
+    CHECK_STR(number(-2000.0), "-2000");
+    CHECK_STR(number(36.5), "36.5");
+    CHECK_STR(number(0.1), "0.1");
+    CHECK_STR(number(1.0 / 3.0), "0.33333333333333331");
+    // Within DBL_EPSILON counts as reading back the same, as in cJSON.
+    CHECK_STR(number(0.1 + 0.2), "0.3");
+    CHECK_STR(number(36.6f), "36.5999984741211");
+    CHECK_STR(number(3e9), "3000000000");
+    CHECK_STR(number(1e300), "1e+300");
+    CHECK_STR(number(1e-5), "1e-05");
+    CHECK_STR(number(NAN), "null");
+    CHECK_STR(number(INFINITY), "null");
+    CHECK_STR(number(-INFINITY), "null");
+}
+
+static void test_fixed(void) {
+    CHECK_STR(fixed(365, 1), "36.5");
+    CHECK_STR(fixed(360, 1), "36");
+    CHECK_STR(fixed(-5, 1), "-0.5");
+    CHECK_STR(fixed(0, 1), "0");
+    CHECK_STR(fixed(-0, 3), "0");
+    CHECK_STR(fixed(1005, 3), "1.005");
+    CHECK_STR(fixed(1050, 3), "1.05");
+    CHECK_STR(fixed(-100, 2), "-1");
+    CHECK_STR(fixed(7, 0), "7");
+    CHECK_STR(fixed(INT32_MAX, 9), "2.147483647");
+    CHECK_STR(fixed(INT32_MIN, 9), "-2.147483648");
+    CHECK_STR(fixed(INT32_MIN, 0), "-2147483648");
+    // Clamped to JSON_WRITER_MAX_DECIMALS.
+    CHECK_STR(fixed(15, 12), "0.000000015");
+
+    // Every tenth matches what the double path prints for the same value.
+    for (int32_t v = -2000; v <= 2000; ++v) {
+        char want[32];
+        snprintf(want, sizeof(want), "%s", number(v / 10.0));
+        CHECK_STR(fixed(v, 1), want);
+    }
+}
+
+static void test_float(void) {
+    CHECK_STR(float_at(36.5f, 1), "36.5");
+    CHECK_STR(float_at(36.449f, 1), "36.4");
+    CHECK_STR(float_at(36.451f, 1), "36.5");
+    CHECK_STR(float_at(36.96f, 1), "37");
+    CHECK_STR(float_at(-0.04f, 1), "0");
+    CHECK_STR(float_at(-0.06f, 1), "-0.1");
+    CHECK_STR(float_at(-12.25f, 1), "-12.3");
+    CHECK_STR(float_at(2.5f, 0), "3");
+    CHECK_STR(float_at(0.125f, 2), "0.13");
+    CHECK_STR(float_at(NAN, 1), "null");
+    CHECK_STR(float_at(-INFINITY, 1), "null");
+    // Out of fixed-point range: the double path takes over.
+    CHECK_STR(float_at(1e10f, 1), "10000000000");
+    CHECK_STR(float_at(-3e9f, 0), "-3000000000");
+
+    json_writer_t w;
+    begin(&w);
+    json_writer_begin_object(&w);
+    json_writer_add_float(&w, "t", 36.54f, 1);
+    json_writer_add_fixed(&w, "v", 11750, 3);
+    json_writer_end_object(&w);
+    CHECK_STR(finish(&w), "{\"t\":36.5,\"v\":11.75}");
+}
+
+// Sweeps compare against a reference into their own buffers, leaving g_buf
+// alone, and count mismatches rather than report each one.
+static unsigned long g_sweep_bad;
+
+static void sweep_expect(const char *what, const char *got, const char *want) {
+    if (strcmp(got, want) != 0 && g_sweep_bad++ < 5) {
+        fprintf(stderr, "%s gave %s, want %s\n", what, got, want);
+    }
+}
+
+static void sweep_end(json_writer_t *w, char *buf) {
+    const size_t n = json_writer_end_line(w);
+    buf[n ? n - 1 : 0] = '\0';
+}
+
+static void sweep_int(int v) {
+    char got[32];
+    char want[32];
+    json_writer_t w;
+    json_writer_init(&w, got, sizeof(got));
+    json_writer_int(&w, v);
+    sweep_end(&w, got);
+    snprintf(want, sizeof(want), "%d", v);
+    sweep_expect("int", got, want);
+}
+
+static void sweep_uint64(uint64_t v) {
+    char got[32];
+    char want[32];
+    json_writer_t w;
+    json_writer_init(&w, got, sizeof(got));
+    json_writer_uint64(&w, v);
+    sweep_end(&w, got);
+    snprintf(want, sizeof(want), "%llu", (unsigned long long)v);
+    sweep_expect("uint64", got, want);
+}
+
+static void sweep_fixed(int32_t v, unsigned decimals) {
+    static const double pow10[] = {1, 10, 100, 1000, 10000};
+    char got[32];
+    char want[32];
+    json_writer_t w;
+    json_writer_init(&w, got, sizeof(got));
+    json_writer_fixed(&w, v, decimals);
+    sweep_end(&w, got);
+    json_writer_init(&w, want, sizeof(want));
+    json_writer_number(&w, v / pow10[decimals]);
+    sweep_end(&w, want);
+    sweep_expect("fixed", got, want);
+}
+
+// The integer writers against printf around every power of ten and the
+// 32-bit and 10^18 boundaries, where the digit count changes.
+static void test_integer_sweep(void) {
+    g_sweep_bad = 0;
+    for (int v = -100000; v <= 100000; ++v) {
+        sweep_int(v);
+    }
+    sweep_int(INT_MIN);
+    sweep_int(INT_MIN + 1);
+    sweep_int(INT_MAX);
+    uint64_t p = 1;
+    for (int k = 0; k < 20; ++k, p *= 10) {
+        for (int d = -1; d <= 1; ++d) {
+            sweep_uint64(p + (uint64_t)d);
+            if (p + (uint64_t)d <= INT_MAX) {
+                sweep_int((int)(p + (uint64_t)d));
+                sweep_int(-(int)(p + (uint64_t)d));
+            }
+        }
+    }
+    for (uint64_t v = UINT32_MAX - 1000ULL; v <= UINT32_MAX + 1000ULL; ++v) {
+        sweep_uint64(v);
+    }
+    for (uint64_t v = 1000000000000000000ULL - 1000ULL; v <= 1000000000000000000ULL + 1000ULL; ++v) {
+        sweep_uint64(v);
+    }
+    sweep_uint64(UINT64_MAX);
+    CHECK(g_sweep_bad == 0);
+}
+
+// The fixed-point writer against the double path for every raw value within
+// +-20000 at zero to four decimals, and at the temperature's decimals over
+// the sensor's range and beyond.
+static void test_fixed_sweep(void) {
+    g_sweep_bad = 0;
+    for (unsigned decimals = 0; decimals <= 4; ++decimals) {
+        for (int32_t v = -20000; v <= 20000; ++v) {
+            sweep_fixed(v, decimals);
+        }
+    }
+    for (int32_t v = -10000; v <= 10000; ++v) {
+        sweep_fixed(v, TELEMETRY_TEMP_DECIMALS);
+    }
+    CHECK(g_sweep_bad == 0);
+}
+
+// Readings on a 1/1024 grid from -100 to 200 degrees: each must print as the
+// nearest tenth, halves away from zero, and parse back to exactly it.
+static void test_float_round_trip(void) {
+    g_sweep_bad = 0;
+    for (int32_t k = -102400; k <= 204800; ++k) {
+        const float t = (float)k / 1024.0f;
+        char got[32];
+        char want[32];
+        json_writer_t w;
+        json_writer_init(&w, got, sizeof(got));
+        json_writer_float(&w, t, TELEMETRY_TEMP_DECIMALS);
+        sweep_end(&w, got);
+        const double tenths = round((double)t * 10.0);
+        json_writer_init(&w, want, sizeof(want));
+        json_writer_number(&w, tenths / 10.0);
+        sweep_end(&w, want);
+        sweep_expect("float", got, want);
+        if (strtod(got, NULL) != tenths / 10.0 && g_sweep_bad++ < 5) {
+            fprintf(stderr, "%s does not parse back to %.1f\n", got, tenths / 10.0);
+        }
+    }
+    CHECK(g_sweep_bad == 0);
+}
+
+int main(void) {
+    test_objects();
+    test_escaping();
+    test_overflow();
+    test_integers();
+    test_numbers();
+    test_fixed();
+    test_float();
+    test_integer_sweep();
+    test_fixed_sweep();
+    test_float_round_trip();
+    return test_finish("test_json_writer");
+}
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+// Tests for the deferred-reply table: requests taken oldest first, slots
+// reused once freed, a full table refusing more, deadlines expiring in any
+// slot order, and sequence numbers wrapping without upsetting the order.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pending.h"
+#include "test_util.h"
+
+static void test_add_take(void) {
+    pending_table_t t;
+    pending_init(&t);
+    pending_entry_t e;
+    CHECK(!pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK(pending_next_deadline(&t) == 0);
+
+    CHECK(pending_add(&t, PENDING_POWEROFF, "a", 5000));
+    CHECK(pending_add(&t, PENDING_POWEROFF, NULL, 3000));
+    CHECK(pending_next_deadline(&t) == 3000);
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK(e.has_id && e.kind == PENDING_POWEROFF && e.deadline_us == 5000);
+    CHECK_STR(e.id, "a");
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK(!e.has_id && e.deadline_us == 3000);
+    CHECK_STR(e.id, "");
+    CHECK(!pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK(pending_next_deadline(&t) == 0);
+
+    // Ids must leave room for their terminator.
+    char id[PENDING_ID_MAX + 1];
+    memset(id, 'x', PENDING_ID_MAX);
+    id[PENDING_ID_MAX] = '\0';
+    CHECK(!pending_add(&t, PENDING_POWEROFF, id, 1000));
+    id[PENDING_ID_MAX - 1] = '\0';
+    CHECK(pending_add(&t, PENDING_POWEROFF, id, 1000));
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK_STR(e.id, id);
+}
+
+static void test_busy_and_reuse(void) {
+    pending_table_t t;
+    pending_init(&t);
+    char id[8];
+    for (int i = 0; i < PENDING_MAX; ++i) {
+        snprintf(id, sizeof(id), "r%d", i);
+        CHECK(pending_add(&t, PENDING_POWEROFF, id, 1000));
+    }
+    CHECK(!pending_add(&t, PENDING_POWEROFF, "busy", 1000));
+
+    // A freed slot is reused, and the newcomer still comes out last even
+    // though it sits in the lowest slot.
+    pending_entry_t e;
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK_STR(e.id, "r0");
+    CHECK(pending_add(&t, PENDING_POWEROFF, "r4", 1000));
+    CHECK(t.entries[0].in_use && strcmp(t.entries[0].id, "r4") == 0);
+    CHECK(!pending_add(&t, PENDING_POWEROFF, "busy", 1000));
+    for (int i = 1; i <= PENDING_MAX; ++i) {
+        snprintf(id, sizeof(id), "r%d", i);
+        CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+        CHECK_STR(e.id, id);
+    }
+    CHECK(!pending_take(&t, PENDING_POWEROFF, &e));
+}
+
+static void test_timeout(void) {
+    pending_table_t t;
+    pending_init(&t);
+    CHECK(pending_add(&t, PENDING_POWEROFF, "late", 9000));
+    CHECK(pending_add(&t, PENDING_POWEROFF, "early", 2000));
+    CHECK(pending_add(&t, PENDING_POWEROFF, "mid", 5000));
+    CHECK(pending_next_deadline(&t) == 2000);
+
+    pending_entry_t e;
+    CHECK(!pending_take_expired(&t, 1999, &e));
+    CHECK(pending_take_expired(&t, 2000, &e));
+    CHECK_STR(e.id, "early");
+    CHECK(!pending_take_expired(&t, 2000, &e));
+    CHECK(pending_next_deadline(&t) == 5000);
+
+    // Everything past its deadline comes out, one call each.
+    CHECK(pending_take_expired(&t, 10000, &e));
+    CHECK(pending_take_expired(&t, 10000, &e));
+    CHECK(!pending_take_expired(&t, 10000, &e));
+    CHECK(pending_next_deadline(&t) == 0);
+
+    // An answered request no longer times out.
+    CHECK(pending_add(&t, PENDING_POWEROFF, "answered", 3000));
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK(!pending_take_expired(&t, 4000, &e));
+    CHECK(pending_next_deadline(&t) == 0);
+}
+
+static void test_seq_wrap(void) {
+    pending_table_t t;
+    pending_init(&t);
+    t.next_seq = UINT32_MAX - 1;
+    CHECK(pending_add(&t, PENDING_POWEROFF, "s0", 1000));
+    CHECK(pending_add(&t, PENDING_POWEROFF, "s1", 1000));
+    CHECK(pending_add(&t, PENDING_POWEROFF, "s2", 1000));
+    CHECK(t.entries[2].seq == 0);
+    pending_entry_t e;
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK_STR(e.id, "s0");
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK_STR(e.id, "s1");
+    CHECK(pending_take(&t, PENDING_POWEROFF, &e));
+    CHECK_STR(e.id, "s2");
+}
+
+int main(void) {
+    test_add_take();
+    test_busy_and_reuse();
+    test_timeout();
+    test_seq_wrap();
+    return test_finish("test_pending");
+}
@@ -0,0 +1,274 @@
+// SPDX-License-Identifier: MIT
+// Tests for the poweroff handshake state machine: every transition with the
+// actions, reason and next deadline it produces, arms and cancels in each
+// state, the poweroff_ok timeout and drop, the heartbeat deadline against the
+// overall halt cut-off, and timer events that arrive early or stale.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "poweroff.h"
+#include "test_util.h"
+
+#define MS(ms) ((uint64_t)(ms) * 1000ULL)
+
+static const poweroff_config_t k_cfg = {
+    .prepare_ms = 250,
+    .poweroff_ok_timeout_ms = 10000,
+    .heartbeat_loss_ms = 3000,
+    .halt_timeout_ms = 60000,
+    .min_battery_pct = 3,
+};
+
+static poweroff_output_t post(poweroff_fsm_t *fsm, poweroff_event_type_t type, int level, uint64_t now_us) {
+    const poweroff_event_t ev = {.type = type, .level = level, .battery_pct = 50};
+    return poweroff_handle(fsm, &ev, now_us);
+}
+
+static poweroff_output_t arm(poweroff_fsm_t *fsm, int battery_pct, uint64_t now_us) {
+    const poweroff_event_t ev = {.type = POWEROFF_EVENT_ARM, .battery_pct = battery_pct};
+    return poweroff_handle(fsm, &ev, now_us);
+}
+
+static poweroff_output_t timer(poweroff_fsm_t *fsm, uint64_t now_us) {
+    return post(fsm, POWEROFF_EVENT_TIMER, 0, now_us);
+}
+
+static bool reason_is(const poweroff_output_t *out, const char *want) {
+    return want ? out->reason && strcmp(out->reason, want) == 0 : out->reason == NULL;
+}
+
+// Output of an event that changes nothing.
+static bool quiet(const poweroff_output_t *out) {
+    return out->actions == 0 && !out->transitioned && out->reason == NULL;
+}
+
+// Takes a fresh machine to halting at `now`, via preparing and armed.
+static void to_halting(poweroff_fsm_t *fsm, uint64_t now_us) {
+    poweroff_init(fsm, &k_cfg, false);
+    arm(fsm, 50, now_us - MS(1250));
+    timer(fsm, now_us - MS(1000));
+    post(fsm, POWEROFF_EVENT_POWEROFF_OK, 1, now_us);
+    CHECK(fsm->state == POWEROFF_HALTING);
+}
+
+static void test_full_handshake(void) {
+    poweroff_fsm_t fsm;
+    poweroff_init(&fsm, &k_cfg, false);
+    CHECK(fsm.state == POWEROFF_IDLE);
+    uint64_t now = MS(1000);
+
+    poweroff_output_t out = arm(&fsm, 50, now);
+    CHECK(fsm.state == POWEROFF_PREPARING && out.transitioned && reason_is(&out, NULL));
+    CHECK(out.actions == POWEROFF_ACTION_CHARGERS_OFF);
+    CHECK(out.deadline_us == now + MS(250));
+
+    now += MS(250);
+    out = timer(&fsm, now);
+    CHECK(fsm.state == POWEROFF_ARMED && out.transitioned);
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_OK);
+    CHECK(out.deadline_us == now + MS(10000));
+
+    now += MS(4000);
+    out = post(&fsm, POWEROFF_EVENT_POWEROFF_OK, 1, now);
+    CHECK(fsm.state == POWEROFF_HALTING && out.transitioned);
+    CHECK(out.actions == POWEROFF_ACTION_HEARTBEAT_ON);
+    CHECK(out.deadline_us == now + MS(3000));
+
+    // Heartbeats push the deadline out.
+    now += MS(1000);
+    out = post(&fsm, POWEROFF_EVENT_HEARTBEAT, 1, now);
+    CHECK(quiet(&out) && out.deadline_us == now + MS(3000));
+    const uint64_t last_beat = now;
+
+    // The timer set before that heartbeat fires early and is ignored.
+    out = timer(&fsm, last_beat + MS(2000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_HALTING);
+    CHECK(out.deadline_us == last_beat + MS(3000));
+
+    out = timer(&fsm, last_beat + MS(3000));
+    CHECK(fsm.state == POWEROFF_OFF && out.transitioned && reason_is(&out, "heartbeat_lost"));
+    CHECK(out.actions == (POWEROFF_ACTION_HEARTBEAT_OFF | POWEROFF_ACTION_CUT_RAIL));
+    CHECK(out.deadline_us == 0);
+    CHECK(fsm.transitions == 4);
+
+    // Off is final: cancels, heartbeats and poweroff_ok changes are ignored,
+    // an arm is answered at once.
+    out = post(&fsm, POWEROFF_EVENT_CANCEL, 0, now + MS(5000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_OFF);
+    out = post(&fsm, POWEROFF_EVENT_POWEROFF_OK, 0, now + MS(5000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_OFF);
+    out = arm(&fsm, 50, now + MS(5000));
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_OK && !out.transitioned && fsm.state == POWEROFF_OFF);
+}
+
+static void test_arm_refused_or_direct(void) {
+    poweroff_fsm_t fsm;
+    poweroff_init(&fsm, &k_cfg, false);
+    poweroff_output_t out = arm(&fsm, 2, MS(1000));
+    CHECK(fsm.state == POWEROFF_IDLE && !out.transitioned && reason_is(&out, "battery_low"));
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_ERROR && out.deadline_us == 0);
+
+    // At the minimum, or with the charge unknown, the arm goes ahead.
+    out = arm(&fsm, 3, MS(1000));
+    CHECK(fsm.state == POWEROFF_PREPARING);
+    poweroff_init(&fsm, &k_cfg, false);
+    out = arm(&fsm, -1, MS(1000));
+    CHECK(fsm.state == POWEROFF_PREPARING);
+
+    // poweroff_ok already high when preparation ends skips armed.
+    poweroff_init(&fsm, &k_cfg, true);
+    arm(&fsm, 50, MS(1000));
+    out = timer(&fsm, MS(1250));
+    CHECK(fsm.state == POWEROFF_HALTING && out.transitioned);
+    CHECK(out.actions == (POWEROFF_ACTION_REPLY_OK | POWEROFF_ACTION_HEARTBEAT_ON));
+    CHECK(out.deadline_us == MS(1250) + MS(3000));
+}
+
+static void test_arm_again(void) {
+    poweroff_fsm_t fsm;
+    poweroff_init(&fsm, &k_cfg, false);
+    arm(&fsm, 50, MS(1000));
+
+    // While preparing the reply waits for armed; the deadline stays put.
+    poweroff_output_t out = arm(&fsm, 50, MS(1100));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_PREPARING && out.deadline_us == MS(1250));
+
+    timer(&fsm, MS(1250));
+    CHECK(fsm.state == POWEROFF_ARMED);
+    out = arm(&fsm, 50, MS(2000));
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_OK && !out.transitioned && fsm.state == POWEROFF_ARMED);
+    CHECK(out.deadline_us == MS(1250) + MS(10000));
+    // Even below the minimum: it is already safe.
+    out = arm(&fsm, 1, MS(2000));
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_OK && fsm.state == POWEROFF_ARMED);
+
+    to_halting(&fsm, MS(5000));
+    out = arm(&fsm, 50, MS(6000));
+    CHECK(out.actions == POWEROFF_ACTION_REPLY_OK && !out.transitioned && fsm.state == POWEROFF_HALTING);
+    CHECK(out.deadline_us == MS(5000) + MS(3000));
+}
+
+static void test_cancel(void) {
+    poweroff_fsm_t fsm;
+    poweroff_init(&fsm, &k_cfg, false);
+    poweroff_output_t out = post(&fsm, POWEROFF_EVENT_CANCEL, 0, MS(1000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE);
+
+    // From preparing the waiting arm is refused.
+    arm(&fsm, 50, MS(1000));
+    out = post(&fsm, POWEROFF_EVENT_CANCEL, 0, MS(1100));
+    CHECK(fsm.state == POWEROFF_IDLE && out.transitioned && reason_is(&out, "cancelled"));
+    CHECK(out.actions == (POWEROFF_ACTION_REPLY_ERROR | POWEROFF_ACTION_CHARGERS_ON));
+    CHECK(out.deadline_us == 0);
+    // The preparation timer still fires, and finds nothing to do.
+    out = timer(&fsm, MS(1250));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE && out.deadline_us == 0);
+
+    // From armed the arm was already answered.
+    arm(&fsm, 50, MS(2000));
+    timer(&fsm, MS(2250));
+    out = post(&fsm, POWEROFF_EVENT_CANCEL, 0, MS(3000));
+    CHECK(fsm.state == POWEROFF_IDLE && out.transitioned && reason_is(&out, "cancelled"));
+    CHECK(out.actions == POWEROFF_ACTION_CHARGERS_ON && out.deadline_us == 0);
+    out = timer(&fsm, MS(2250) + MS(10000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE);
+
+    // From halting the heartbeat interrupt goes off too.
+    to_halting(&fsm, MS(20000));
+    out = post(&fsm, POWEROFF_EVENT_CANCEL, 0, MS(21000));
+    CHECK(fsm.state == POWEROFF_IDLE && out.transitioned && reason_is(&out, "cancelled"));
+    CHECK(out.actions == (POWEROFF_ACTION_HEARTBEAT_OFF | POWEROFF_ACTION_CHARGERS_ON));
+    CHECK(out.deadline_us == 0);
+    // Neither halting deadline cuts the rail afterwards.
+    out = timer(&fsm, MS(20000) + MS(3000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE);
+    out = timer(&fsm, MS(20000) + MS(60000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE);
+    // Nor do heartbeats do anything outside halting.
+    out = post(&fsm, POWEROFF_EVENT_HEARTBEAT, 1, MS(90000));
+    CHECK(quiet(&out) && out.deadline_us == 0);
+
+    // A fresh arm after a cancel starts its own preparation, which a timer
+    // event short of it does not end.
+    arm(&fsm, 50, MS(100000));
+    out = timer(&fsm, MS(100100));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_PREPARING && out.deadline_us == MS(100250));
+}
+
+static void test_poweroff_ok(void) {
+    poweroff_fsm_t fsm;
+    poweroff_init(&fsm, &k_cfg, false);
+    arm(&fsm, 50, MS(1000));
+    timer(&fsm, MS(1250));
+
+    // The Pi never raises poweroff_ok.
+    poweroff_output_t out = timer(&fsm, MS(1250) + MS(9999));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_ARMED);
+    out = timer(&fsm, MS(1250) + MS(10000));
+    CHECK(fsm.state == POWEROFF_IDLE && out.transitioned && reason_is(&out, "poweroff_ok_timeout"));
+    CHECK(out.actions == POWEROFF_ACTION_CHARGERS_ON && out.deadline_us == 0);
+
+    // poweroff_ok outside armed only records the level.
+    out = post(&fsm, POWEROFF_EVENT_POWEROFF_OK, 1, MS(20000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE && fsm.poweroff_ok);
+    out = post(&fsm, POWEROFF_EVENT_POWEROFF_OK, 0, MS(20000));
+    CHECK(quiet(&out) && !fsm.poweroff_ok);
+
+    // Dropping it again while halting aborts.
+    to_halting(&fsm, MS(30000));
+    out = post(&fsm, POWEROFF_EVENT_POWEROFF_OK, 0, MS(31000));
+    CHECK(fsm.state == POWEROFF_IDLE && out.transitioned && reason_is(&out, "poweroff_ok_dropped"));
+    CHECK(out.actions == (POWEROFF_ACTION_HEARTBEAT_OFF | POWEROFF_ACTION_CHARGERS_ON));
+    CHECK(out.deadline_us == 0);
+    out = timer(&fsm, MS(30000) + MS(3000));
+    CHECK(quiet(&out) && fsm.state == POWEROFF_IDLE);
+}
+
+static void test_halt_deadline(void) {
+    // A heartbeat that never stops: the rail is cut at the halt deadline.
+    poweroff_fsm_t fsm;
+    const uint64_t start = MS(10000);
+    to_halting(&fsm, start);
+    poweroff_output_t out = {0};
+    uint64_t now = start;
+    for (; now + MS(1000) < start + MS(60000); now += MS(1000)) {
+        out = post(&fsm, POWEROFF_EVENT_HEARTBEAT, 1, now + MS(1000));
+        CHECK(quiet(&out));
+        out = timer(&fsm, now + MS(1000));
+        CHECK(quiet(&out) && fsm.state == POWEROFF_HALTING);
+    }
+    // The last heartbeat leaves the halt deadline as the earlier one.
+    CHECK(out.deadline_us == start + MS(60000));
+    out = timer(&fsm, start + MS(60000) - 1);
+    CHECK(quiet(&out) && fsm.state == POWEROFF_HALTING);
+    out = timer(&fsm, start + MS(60000));
+    CHECK(fsm.state == POWEROFF_OFF && reason_is(&out, "halt_timeout"));
+    CHECK(out.actions == (POWEROFF_ACTION_HEARTBEAT_OFF | POWEROFF_ACTION_CUT_RAIL));
+    CHECK(out.deadline_us == 0);
+
+    // With both deadlines passed at once, heartbeat loss is the reason.
+    to_halting(&fsm, start);
+    out = timer(&fsm, start + MS(70000));
+    CHECK(fsm.state == POWEROFF_OFF && reason_is(&out, "heartbeat_lost"));
+}
+
+static void test_names(void) {
+    CHECK_STR(poweroff_state_name(POWEROFF_IDLE), "idle");
+    CHECK_STR(poweroff_state_name(POWEROFF_PREPARING), "preparing");
+    CHECK_STR(poweroff_state_name(POWEROFF_ARMED), "armed");
+    CHECK_STR(poweroff_state_name(POWEROFF_HALTING), "halting");
+    CHECK_STR(poweroff_state_name(POWEROFF_OFF), "off");
+    CHECK_STR(poweroff_state_name(POWEROFF_STATE_COUNT), "unknown");
+}
+
+int main(void) {
+    test_full_handshake();
+    test_arm_refused_or_direct();
+    test_arm_again();
+    test_cancel();
+    test_poweroff_ok();
+    test_halt_deadline();
+    test_names();
+    return test_finish("test_poweroff");
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MIT
+// Torn-snapshot stress test for the seqlock guarding supervisor state: one
+// writer thread publishes states whose every field derives from a single
+// counter while reader threads take snapshots as main.c does, checking each
+// is one whole state and that no reader ever sees time run backwards.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seqlock.h"
+#include "supervisor_state.h"
+#include "test_util.h"
+
+#define TEST_READERS 3
+#define TEST_WRITES 400000
+
+static supervisor_state_t g_state;
+static seqlock_t g_seq;
+static pthread_mutex_t g_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool g_done;
+
+typedef struct {
+    unsigned long snapshots;
+    unsigned long retries;
+    unsigned long torn;
+    unsigned long backwards;
+} reader_stats_t;
+
+// Writes field by field, as a state update does, so an unguarded copy can
+// catch the struct half old and half new.
+static void fill(volatile supervisor_state_t *s, unsigned n) {
+    s->battery_pct = (int)(n % 101);
+    s->pack_mv = (int)n;
+    s->pack_ma = -(int)n;
+    s->time_to_empty_min = (int)(n * 3);
+    s->time_to_full_min = (int)(n ^ 0x5555);
+    s->mcu_temp_c = (float)(n % 100000);
+    s->unread_ext = (int)(n & 0xFF);
+    for (size_t i = 0; i + 1 < sizeof(s->heltec); ++i) {
+        s->heltec[i] = (char)('a' + (n + i) % 26);
+    }
+    s->poweroff_armed = n & 1;
+    s->last_mesh_event_us = (uint64_t)n * 1000003ULL;
+    s->switches.lte = n & 2;
+    s->switches.wifi = n & 4;
+    s->switches.bt = n & 8;
+    s->switches.lid_open = n & 16;
+}
+
+static bool whole(const supervisor_state_t *s) {
+    const unsigned n = (unsigned)s->pack_mv;
+    supervisor_state_t want;
+    memset(&want, 0, sizeof(want));
+    fill(&want, n);
+    return s->battery_pct == want.battery_pct && s->pack_ma == want.pack_ma &&
+           s->time_to_empty_min == want.time_to_empty_min && s->time_to_full_min == want.time_to_full_min &&
+           s->mcu_temp_c == want.mcu_temp_c && s->unread_ext == want.unread_ext &&
+           memcmp(s->heltec, want.heltec, sizeof(want.heltec)) == 0 && s->poweroff_armed == want.poweroff_armed &&
+           s->last_mesh_event_us == want.last_mesh_event_us && s->switches.lte == want.switches.lte &&
+           s->switches.wifi == want.switches.wifi && s->switches.bt == want.switches.bt &&
+           s->switches.lid_open == want.switches.lid_open;
+}
+
+static void *writer(void *arg) {
+    (void)arg;
+    for (unsigned n = 1; n <= TEST_WRITES; ++n) {
+        pthread_mutex_lock(&g_write_lock);
+        seqlock_write_begin(&g_seq);
+        fill(&g_state, n);
+        seqlock_write_end(&g_seq);
+        pthread_mutex_unlock(&g_write_lock);
+    }
+    atomic_store(&g_done, true);
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    reader_stats_t *stats = arg;
+    int last = 0;
+    while (!atomic_load(&g_done)) {
+        supervisor_state_t snap;
+        unsigned begin;
+        do {
+            begin = seqlock_read_begin(&g_seq);
+            memcpy(&snap, (const void *)&g_state, sizeof(snap));
+            ++stats->retries;
+        } while (seqlock_read_retry(&g_seq, begin));
+        --stats->retries;
+        ++stats->snapshots;
+        stats->torn += !whole(&snap);
+        stats->backwards += snap.pack_mv < last;
+        last = snap.pack_mv;
+    }
+    return NULL;
+}
+
+int main(void) {
+    fill(&g_state, 0);
+    pthread_t readers[TEST_READERS];
+    reader_stats_t stats[TEST_READERS];
+    memset(stats, 0, sizeof(stats));
+    for (int i = 0; i < TEST_READERS; ++i) {
+        CHECK(pthread_create(&readers[i], NULL, reader, &stats[i]) == 0);
+    }
+    pthread_t w;
+    CHECK(pthread_create(&w, NULL, writer, NULL) == 0);
+    pthread_join(w, NULL);
+    reader_stats_t total = {0};
+    for (int i = 0; i < TEST_READERS; ++i) {
+        pthread_join(readers[i], NULL);
+        total.snapshots += stats[i].snapshots;
+        total.retries += stats[i].retries;
+        total.torn += stats[i].torn;
+        total.backwards += stats[i].backwards;
+    }
+    printf("%lu snapshots, %lu retries, %lu torn, %lu backwards\n", total.snapshots, total.retries, total.torn,
+           total.backwards);
+    CHECK(total.snapshots > 0);
+    CHECK(total.torn == 0);
+    CHECK(total.backwards == 0);
+
+    // The counter itself: odd while a write is open, and any write started
+    // after a read began makes that read retry.
+    seqlock_t s = {0};
+    const unsigned begin = seqlock_read_begin(&s);
+    CHECK(!seqlock_read_retry(&s, begin));
+    seqlock_write_begin(&s);
+    CHECK(seqlock_read_retry(&s, begin));
+    CHECK(seqlock_read_retry(&s, seqlock_read_begin(&s)));
+    seqlock_write_end(&s);
+    CHECK(seqlock_read_retry(&s, begin));
+    CHECK(!seqlock_read_retry(&s, seqlock_read_begin(&s)));
+    return test_finish("test_seqlock");
+}
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: MIT
+// Tests for the single-producer single-consumer ring that carries received
+// lines from io_task to loop_task: empty and full edges, records wrapping
+// the end of the buffer, free-running counters wrapping around SIZE_MAX, and
+// a two-thread stress run checking every record arrives whole and in order.
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+#include "test_util.h"
+
+#define TEST_RING_BYTES 256
+#define TEST_STRESS_RECORDS 300000
+#define TEST_MAX_RECORD 200
+
+static void fill_record(uint8_t *buf, size_t len, uint32_t seq) {
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = (uint8_t)(seq * 31u + i * 7u);
+    }
+}
+
+static size_t record_len(uint32_t seq) {
+    // Mostly short lines, some empty, some long enough to wrap every time.
+    return seq % 13 == 0 ? 0 : (seq * 2654435761u >> 16) % (seq % 5 == 0 ? TEST_MAX_RECORD : 40);
+}
+
+static void test_init(void) {
+    uint8_t buf[TEST_RING_BYTES];
+    spsc_ring_t r;
+    CHECK(!spsc_ring_init(&r, NULL, sizeof(buf)));
+    CHECK(!spsc_ring_init(&r, buf, 2));
+    CHECK(!spsc_ring_init(&r, buf, 100));
+    CHECK(spsc_ring_init(&r, buf, sizeof(buf)));
+    CHECK(spsc_ring_used(&r) == 0);
+}
+
+static void test_empty_full(void) {
+    uint8_t buf[TEST_RING_BYTES];
+    spsc_ring_t r;
+    spsc_ring_init(&r, buf, sizeof(buf));
+    uint8_t out[TEST_RING_BYTES];
+    size_t len = 99;
+    CHECK(!spsc_ring_pop(&r, out, sizeof(out), &len));
+    CHECK(len == 99);
+
+    // A record exactly filling the ring fits; one byte more does not, and a
+    // refusal leaves the ring as it was.
+    uint8_t data[TEST_RING_BYTES];
+    fill_record(data, sizeof(data), 1);
+    CHECK(!spsc_ring_push(&r, data, TEST_RING_BYTES - SPSC_RING_HEADER + 1));
+    CHECK(r.full == 1 && spsc_ring_used(&r) == 0);
+    CHECK(spsc_ring_push(&r, data, TEST_RING_BYTES - SPSC_RING_HEADER));
+    CHECK(spsc_ring_used(&r) == TEST_RING_BYTES && r.peak == TEST_RING_BYTES);
+    CHECK(!spsc_ring_push(&r, data, 0));
+    CHECK(r.full == 2);
+    CHECK(spsc_ring_pop(&r, out, sizeof(out), &len));
+    CHECK(len == TEST_RING_BYTES - SPSC_RING_HEADER && memcmp(out, data, len) == 0);
+    CHECK(spsc_ring_used(&r) == 0);
+    CHECK(!spsc_ring_pop(&r, out, sizeof(out), &len));
+
+    // Empty records take only their header, so a ring holds size / header
+    // of them.
+    for (size_t i = 0; i < TEST_RING_BYTES / SPSC_RING_HEADER; ++i) {
+        CHECK(spsc_ring_push(&r, data, 0));
+    }
+    CHECK(!spsc_ring_push(&r, data, 0));
+    for (size_t i = 0; i < TEST_RING_BYTES / SPSC_RING_HEADER; ++i) {
+        CHECK(spsc_ring_pop(&r, out, sizeof(out), &len) && len == 0);
+    }
+    CHECK(!spsc_ring_pop(&r, out, sizeof(out), &len));
+
+    // Records over the 16-bit length are refused outright.
+    static uint8_t big_buf[1u << 17];
+    static uint8_t big_data[UINT16_MAX + 1];
+    spsc_ring_t big;
+    spsc_ring_init(&big, big_buf, sizeof(big_buf));
+    CHECK(!spsc_ring_push(&big, big_data, UINT16_MAX + 1));
+    CHECK(spsc_ring_push(&big, big_data, UINT16_MAX));
+}
+
+static void test_truncating_pop(void) {
+    uint8_t buf[TEST_RING_BYTES];
+    spsc_ring_t r;
+    spsc_ring_init(&r, buf, sizeof(buf));
+    uint8_t data[50];
+    fill_record(data, sizeof(data), 7);
+    CHECK(spsc_ring_push(&r, data, sizeof(data)));
+    CHECK(spsc_ring_push(&r, data, 3));
+    // The excess of a record is dropped, and the next record starts clean.
+    uint8_t out[10];
+    size_t len;
+    CHECK(spsc_ring_pop(&r, out, sizeof(out), &len));
+    CHECK(len == sizeof(out) && memcmp(out, data, sizeof(out)) == 0);
+    CHECK(spsc_ring_pop(&r, out, sizeof(out), &len));
+    CHECK(len == 3 && memcmp(out, data, 3) == 0);
+    CHECK(spsc_ring_used(&r) == 0);
+}
+
+// Walks records of every length through every offset of the buffer, with
+// the free-running counters started just short of wrapping.
+static void test_wraparound(void) {
+    uint8_t buf[TEST_RING_BYTES];
+    spsc_ring_t r;
+    spsc_ring_init(&r, buf, sizeof(buf));
+    atomic_store(&r.head, SIZE_MAX - 3 * TEST_RING_BYTES);
+    atomic_store(&r.tail, SIZE_MAX - 3 * TEST_RING_BYTES);
+
+    uint8_t data[TEST_RING_BYTES];
+    uint8_t out[TEST_RING_BYTES];
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    for (int round = 0; round < 20000; ++round) {
+        // Keep a few records in flight so heads and tails land everywhere.
+        const size_t len = (size_t)(round * 37) % (TEST_RING_BYTES / 2);
+        fill_record(data, len, pushed);
+        if (spsc_ring_push(&r, data, len)) {
+            ++pushed;
+        } else {
+            CHECK(spsc_ring_used(&r) + SPSC_RING_HEADER + len > TEST_RING_BYTES);
+        }
+        CHECK(spsc_ring_used(&r) <= TEST_RING_BYTES);
+        if (round % 3 != 0 || pushed - popped > 2) {
+            size_t got;
+            if (spsc_ring_pop(&r, out, sizeof(out), &got)) {
+                fill_record(data, got, popped);
+                if (memcmp(out, data, got) != 0) {
+                    fprintf(stderr, "record %u corrupted after wrapping\n", popped);
+                    CHECK(false);
+                    return;
+                }
+                ++popped;
+            }
+        }
+    }
+    size_t got;
+    while (spsc_ring_pop(&r, out, sizeof(out), &got)) {
+        ++popped;
+    }
+    CHECK(pushed == popped && pushed > 10000);
+    CHECK(atomic_load(&r.tail) < SIZE_MAX - 3 * TEST_RING_BYTES);
+    CHECK(spsc_ring_used(&r) == 0);
+}
+
+static uint8_t g_stress_buf[TEST_RING_BYTES];
+static spsc_ring_t g_stress;
+static unsigned long g_producer_full;
+
+static void *producer(void *arg) {
+    (void)arg;
+    uint8_t data[TEST_MAX_RECORD];
+    for (uint32_t seq = 0; seq < TEST_STRESS_RECORDS; ++seq) {
+        const size_t len = record_len(seq);
+        fill_record(data, len, seq);
+        // Sequence number up front where there is room for it.
+        if (len >= 4) {
+            memcpy(data, &seq, 4);
+        }
+        while (!spsc_ring_push(&g_stress, data, len)) {
+            ++g_producer_full;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void stress(void) {
+    spsc_ring_init(&g_stress, g_stress_buf, sizeof(g_stress_buf));
+    pthread_t p;
+    CHECK(pthread_create(&p, NULL, producer, NULL) == 0);
+    uint8_t out[TEST_MAX_RECORD];
+    uint8_t want[TEST_MAX_RECORD];
+    unsigned long bad = 0;
+    for (uint32_t seq = 0; seq < TEST_STRESS_RECORDS;) {
+        size_t len;
+        if (!spsc_ring_pop(&g_stress, out, sizeof(out), &len)) {
+            sched_yield();
+            continue;
+        }
+        const size_t want_len = record_len(seq);
+        fill_record(want, want_len, seq);
+        if (want_len >= 4) {
+            memcpy(want, &seq, 4);
+        }
+        if (len != want_len || memcmp(out, want, len) != 0) {
+            if (bad++ < 5) {
+                fprintf(stderr, "record %u: got %zu bytes, want %zu\n", seq, len, want_len);
+            }
+        }
+        ++seq;
+    }
+    pthread_join(p, NULL);
+    size_t len;
+    CHECK(!spsc_ring_pop(&g_stress, out, sizeof(out), &len));
+    printf("%d records, producer found the ring full %lu times, peak %zu bytes\n", TEST_STRESS_RECORDS,
+           g_producer_full, g_stress.peak);
+    CHECK(bad == 0);
+    CHECK(g_stress.peak <= TEST_RING_BYTES);
+}
+
+int main(void) {
+    test_init();
+    test_empty_full();
+    test_truncating_pop();
+    test_wraparound();
+    stress();
+    return test_finish("test_spsc_ring");
+}
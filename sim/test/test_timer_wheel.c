@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: MIT
+// Randomized harness for the timer wheel: arms, re-arms and cancels timers
+// with deadlines near and far (past the last level's reach included), from
+// outside and from inside callbacks, and advances by steps from one tick to
+// millions. A plain model of each timer's deadline checks that every timer
+// fires exactly on its tick, in deadline order, once, and that next_tick
+// never promises a wakeup later than the earliest deadline.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test_util.h"
+#include "timer_wheel.h"
+
+#define TEST_TIMERS 48
+#define TEST_OPS 300000
+
+typedef struct {
+    bool armed;
+    // Tick it fires on, and the deadline a periodic timer counts on from,
+    // which is behind `due` when it was armed with one already passed.
+    uint64_t due;
+    uint64_t expires;
+    uint32_t period;
+    unsigned fires;
+} model_t;
+
+static timer_wheel_t g_wheel;
+static wheel_timer_t g_timers[TEST_TIMERS];
+static model_t g_model[TEST_TIMERS];
+static uint64_t g_last_fire;
+static unsigned long g_fires;
+static unsigned long g_errors_reported;
+static uint64_t g_rng = 0xD1B54A32D192ED03ULL;
+
+static uint64_t rnd(uint64_t n) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng % n;
+}
+
+static void report(const char *what, size_t i) {
+    if (g_errors_reported++ < 10) {
+        fprintf(stderr, "timer %zu at tick %llu: %s (due %llu)\n", i, (unsigned long long)g_wheel.now, what,
+                (unsigned long long)g_model[i].due);
+    }
+    CHECK(false);
+}
+
+// A deadline from just behind `now` to well past the wheel's 2^24-tick reach.
+static uint64_t random_deadline(uint64_t now) {
+    switch (rnd(6)) {
+        case 0: return now > 8 ? now - rnd(8) : now;
+        case 1: return now + rnd(TIMER_WHEEL_SLOTS + 2);
+        case 2: return now + rnd(5000);
+        case 3: return now + rnd(1u << 18);
+        case 4: return now + (1ULL << 24) - 2 + rnd(4);
+        default: return now + rnd(1ULL << 27);
+    }
+}
+
+static void arm(size_t i) {
+    const uint64_t expires = random_deadline(g_wheel.now);
+    const uint32_t period = rnd(3) ? 0 : (uint32_t)(1 + (rnd(2) ? rnd(100) : rnd(1u << 25)));
+    timer_wheel_arm(&g_wheel, &g_timers[i], expires, period);
+    g_model[i].armed = true;
+    g_model[i].due = expires > g_wheel.now ? expires : g_wheel.now + 1;
+    g_model[i].expires = expires;
+    g_model[i].period = period;
+}
+
+static void cancel(size_t i) {
+    CHECK(timer_wheel_cancel(&g_wheel, &g_timers[i]) == g_model[i].armed);
+    g_model[i].armed = false;
+}
+
+static void on_fire(wheel_timer_t *t, void *ctx) {
+    const size_t i = (size_t)(uintptr_t)ctx;
+    CHECK(t == &g_timers[i]);
+    model_t *m = &g_model[i];
+    if (!m->armed) {
+        report("fired while not armed", i);
+        return;
+    }
+    if (g_wheel.now != m->due) {
+        report("fired off its deadline", i);
+    }
+    if (g_wheel.now < g_last_fire) {
+        report("fired out of order", i);
+    }
+    g_last_fire = g_wheel.now;
+    ++m->fires;
+    ++g_fires;
+    if (m->period) {
+        // Periods already missed are skipped.
+        m->expires += m->period;
+        while (m->expires <= g_wheel.now) {
+            m->expires += m->period;
+        }
+        m->due = m->expires;
+        CHECK(wheel_timer_armed(t));
+    } else {
+        m->armed = false;
+        CHECK(!wheel_timer_armed(t));
+    }
+
+    // Callbacks may arm and cancel any timer, themselves included.
+    const size_t j = (size_t)rnd(TEST_TIMERS);
+    switch (rnd(8)) {
+        case 0: arm(j); break;
+        case 1: cancel(j); break;
+        case 2: arm(i); break;
+        default: break;
+    }
+}
+
+static uint64_t model_next(void) {
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < TEST_TIMERS; ++i) {
+        if (g_model[i].armed && g_model[i].due < next) {
+            next = g_model[i].due;
+        }
+    }
+    return next;
+}
+
+static void check_consistent(void) {
+    for (size_t i = 0; i < TEST_TIMERS; ++i) {
+        if (wheel_timer_armed(&g_timers[i]) != g_model[i].armed) {
+            report("armed state differs from the model", i);
+        }
+        if (g_model[i].armed && g_model[i].due <= g_wheel.now) {
+            report("overdue", i);
+        }
+    }
+    // A timer still on a higher level makes next_tick the tick it cascades
+    // on, which may come before any deadline; it must never come after one.
+    const uint64_t want = model_next();
+    const uint64_t next = timer_wheel_next_tick(&g_wheel);
+    const bool ok = want == UINT64_MAX ? next == UINT64_MAX : next > g_wheel.now && next <= want;
+    if (!ok && g_errors_reported++ < 10) {
+        fprintf(stderr, "at tick %llu: next_tick %llu, earliest deadline %llu\n", (unsigned long long)g_wheel.now,
+                (unsigned long long)next, (unsigned long long)want);
+    }
+    CHECK(ok);
+}
+
+static void count_fire(wheel_timer_t *t, void *ctx) {
+    (void)t;
+    ++*(unsigned *)ctx;
+}
+
+// Timers armed within TIMER_WHEEL_SLOTS ticks sit on the lowest level, where
+// next_tick is exact.
+static void test_next_tick_exact(void) {
+    timer_wheel_t w;
+    timer_wheel_init(&w, 1000);
+    unsigned fires = 0;
+    wheel_timer_t t;
+    wheel_timer_init(&t, count_fire, &fires);
+    for (uint64_t ahead = 1; ahead < TIMER_WHEEL_SLOTS; ++ahead) {
+        timer_wheel_arm(&w, &t, w.now + ahead, 0);
+        CHECK(timer_wheel_next_tick(&w) == w.now + ahead);
+        timer_wheel_advance(&w, w.now + ahead - 1);
+        CHECK(fires == ahead - 1);
+        timer_wheel_advance(&w, w.now + 1);
+        CHECK(fires == ahead && !wheel_timer_armed(&t));
+    }
+}
+
+int main(int argc, char **argv) {
+    const unsigned long ops = argc > 1 ? strtoul(argv[1], NULL, 10) : TEST_OPS;
+    test_next_tick_exact();
+    for (size_t i = 0; i < TEST_TIMERS; ++i) {
+        wheel_timer_init(&g_timers[i], on_fire, (void *)(uintptr_t)i);
+    }
+
+    // Start where the low levels are about to carry, not at zero.
+    timer_wheel_init(&g_wheel, (1ULL << 24) - 100);
+    g_last_fire = g_wheel.now;
+    CHECK(timer_wheel_next_tick(&g_wheel) == UINT64_MAX);
+    CHECK(!timer_wheel_cancel(&g_wheel, &g_timers[0]));
+
+    for (unsigned long op = 0; op < ops; ++op) {
+        const size_t i = (size_t)rnd(TEST_TIMERS);
+        switch (rnd(10)) {
+            case 0:
+            case 1:
+            case 2: arm(i); break;
+            case 3: cancel(i); break;
+            default: {
+                // Mostly short hops, as the loop makes; sometimes to the
+                // next deadline exactly, sometimes far past several.
+                uint64_t to;
+                switch (rnd(4)) {
+                    case 0: to = g_wheel.now + 1 + rnd(3); break;
+                    case 1: to = g_wheel.now + rnd(200); break;
+                    case 2: {
+                        const uint64_t next = timer_wheel_next_tick(&g_wheel);
+                        to = next == UINT64_MAX ? g_wheel.now + 1 : next;
+                        break;
+                    }
+                    default: to = g_wheel.now + rnd(1ULL << 26); break;
+                }
+                timer_wheel_advance(&g_wheel, to);
+                CHECK(g_wheel.now == to);
+                break;
+            }
+        }
+        check_consistent();
+        if (g_errors_reported > 10) {
+            break;
+        }
+    }
+
+    // Drop the periodic timers and run the one-shots still armed out.
+    for (size_t i = 0; i < TEST_TIMERS; ++i) {
+        if (g_model[i].period) {
+            cancel(i);
+        }
+    }
+    const uint64_t end = model_next();
+    if (end != UINT64_MAX) {
+        timer_wheel_advance(&g_wheel, end);
+    }
+    check_consistent();
+
+    unsigned long model_fires = 0;
+    for (size_t i = 0; i < TEST_TIMERS; ++i) {
+        model_fires += g_model[i].fires;
+    }
+    CHECK(model_fires == g_fires && g_wheel.fired == (uint32_t)g_fires);
+    printf("%lu fires, %lu cascaded, tick %llu\n", g_fires, (unsigned long)g_wheel.cascaded,
+           (unsigned long long)g_wheel.now);
+    return test_finish("test_timer_wheel");
+}
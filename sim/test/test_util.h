@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+// Checks shared by the host tests. A failed check reports its location and
+// the test carries on; test_finish turns the count into the exit status.
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+static int g_test_failures;
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            ++g_test_failures;                                                                                         \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                  \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_STR(got, want)                                                                                           \
+    do {                                                                                                               \
+        const char *got_ = (got);                                                                                      \
+        const char *want_ = (want);                                                                                    \
+        if (strcmp(got_, want_) != 0) {                                                                                \
+            ++g_test_failures;                                                                                         \
+            fprintf(stderr, "%s:%d: %s is \"%s\", want \"%s\"\n", __FILE__, __LINE__, #got, got_, want_);              \
+        }                                                                                                              \
+    } while (0)
+
+static inline int test_finish(const char *name) {
+    if (g_test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, g_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: MIT
+// Tests for the threshold watches: the exact alerts raised as a value
+// crosses rising and falling thresholds and wanders inside the hysteresis
+// band, watches that start out active, unknown battery readings, alerts left
+// due until reported, and the alert value formatted with the field's
+// decimals as loop_task sends it.
+#include <stdio.h>
+#include <string.h>
+
+#include "json_writer.h"
+#include "telemetry.h"
+#include "test_util.h"
+#include "watch.h"
+
+static supervisor_state_t base_state(void) {
+    return (supervisor_state_t){
+        .battery_pct = 50,
+        .pack_mv = 3700,
+        .pack_ma = -300,
+        .time_to_empty_min = -1,
+        .time_to_full_min = -1,
+        .mcu_temp_c = 30.0f,
+    };
+}
+
+// Updates the table and returns the alerts due, formatted as send_alert_event
+// would and separated by spaces; each is marked reported when `report`.
+static const char *update(watch_table_t *t, const supervisor_state_t *state, bool report) {
+    static char out[512];
+    size_t len = 0;
+    out[0] = '\0';
+    for (watch_mask_t due = watch_table_update(t, state); due; due &= due - 1) {
+        const int slot = __builtin_ctz(due);
+        const watch_t *w = &t->watches[slot];
+        char line[128];
+        json_writer_t jw;
+        json_writer_init(&jw, line, sizeof(line));
+        json_writer_begin_object(&jw);
+        json_writer_add_int(&jw, "watch", slot);
+        json_writer_add_string(&jw, "field", watch_field_name(w->field));
+        json_writer_add_bool(&jw, "active", w->active);
+        json_writer_add_float(&jw, "value", watch_field_value(w->field, state), watch_field_decimals(w->field));
+        json_writer_end_object(&jw);
+        CHECK(!jw.overflow);
+        len += (size_t)snprintf(out + len, sizeof(out) - len, "%s%.*s", len ? " " : "", (int)jw.len, line);
+        if (report) {
+            watch_table_mark_reported(t, slot);
+        }
+    }
+    return out;
+}
+
+static const char *set_pct(watch_table_t *t, supervisor_state_t *s, int pct) {
+    s->battery_pct = pct;
+    return update(t, s, true);
+}
+
+static const char *set_mv(watch_table_t *t, supervisor_state_t *s, int mv) {
+    s->pack_mv = mv;
+    return update(t, s, true);
+}
+
+static void test_rising(void) {
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_BATTERY_PCT, WATCH_ABOVE, 80.0f, 5.0f, &s) == 0);
+    CHECK_STR(update(&t, &s, true), "");
+    CHECK_STR(set_pct(&t, &s, 80), "");
+    CHECK_STR(set_pct(&t, &s, 81), "{\"watch\":0,\"field\":\"battery_pct\",\"active\":true,\"value\":81}");
+    CHECK_STR(set_pct(&t, &s, 90), "");
+    // Inside the band below the threshold the watch stays active...
+    CHECK_STR(set_pct(&t, &s, 79), "");
+    CHECK_STR(set_pct(&t, &s, 76), "");
+    CHECK_STR(set_pct(&t, &s, 81), "");
+    // ...and clears only once hysteresis past it.
+    CHECK_STR(set_pct(&t, &s, 75), "{\"watch\":0,\"field\":\"battery_pct\",\"active\":false,\"value\":75}");
+    // Back in the band from below does not re-arm it; the threshold does.
+    CHECK_STR(set_pct(&t, &s, 79), "");
+    CHECK_STR(set_pct(&t, &s, 80), "");
+    CHECK_STR(set_pct(&t, &s, 81), "{\"watch\":0,\"field\":\"battery_pct\",\"active\":true,\"value\":81}");
+}
+
+static void test_falling(void) {
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, 100.0f, &s) == 0);
+    CHECK_STR(set_mv(&t, &s, 3300), "");
+    CHECK_STR(set_mv(&t, &s, 3299), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3299}");
+    CHECK_STR(set_mv(&t, &s, 3350), "");
+    CHECK_STR(set_mv(&t, &s, 3399), "");
+    CHECK_STR(set_mv(&t, &s, 3400), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":false,\"value\":3400}");
+    CHECK_STR(set_mv(&t, &s, 3301), "");
+    CHECK_STR(set_mv(&t, &s, 3000), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3000}");
+
+    // Zero hysteresis alerts on every crossing.
+    watch_table_init(&t);
+    s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, 0.0f, &s) == 0);
+    CHECK_STR(set_mv(&t, &s, 3299), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3299}");
+    CHECK_STR(set_mv(&t, &s, 3300), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":false,\"value\":3300}");
+}
+
+static void test_starts_active(void) {
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    s.pack_mv = 3200;
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, 50.0f, &s) == 0);
+    CHECK(t.watches[0].active);
+    CHECK_STR(update(&t, &s, true), "");
+    CHECK_STR(set_mv(&t, &s, 3100), "");
+    // Clearing is still reported.
+    CHECK_STR(set_mv(&t, &s, 3350), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":false,\"value\":3350}");
+
+    // A watch added on an unknown battery reading starts inactive, and keeps
+    // its state while the reading is unknown.
+    watch_table_init(&t);
+    s = base_state();
+    s.battery_pct = -1;
+    CHECK(watch_table_add(&t, WATCH_FIELD_BATTERY_PCT, WATCH_BELOW, 20.0f, 2.0f, &s) == 0);
+    CHECK(!t.watches[0].active);
+    CHECK_STR(update(&t, &s, true), "");
+    CHECK_STR(set_pct(&t, &s, 10), "{\"watch\":0,\"field\":\"battery_pct\",\"active\":true,\"value\":10}");
+    CHECK_STR(set_pct(&t, &s, -1), "");
+    CHECK_STR(set_pct(&t, &s, 10), "");
+    CHECK_STR(set_pct(&t, &s, 22), "{\"watch\":0,\"field\":\"battery_pct\",\"active\":false,\"value\":22}");
+}
+
+static void test_unreported(void) {
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, 100.0f, &s) == 0);
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MA, WATCH_BELOW, -1000.0f, 0.0f, &s) == 1);
+    s.pack_mv = 3250;
+    s.pack_ma = -1500;
+    // Both due in slot order; an alert that could not be sent stays due.
+    CHECK_STR(update(&t, &s, false), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3250} "
+                                     "{\"watch\":1,\"field\":\"pack_ma\",\"active\":true,\"value\":-1500}");
+    CHECK_STR(update(&t, &s, false), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3250} "
+                                     "{\"watch\":1,\"field\":\"pack_ma\",\"active\":true,\"value\":-1500}");
+    watch_table_mark_reported(&t, 1);
+    CHECK_STR(update(&t, &s, true), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":true,\"value\":3250}");
+    CHECK_STR(update(&t, &s, true), "");
+
+    // Crossing back before the alert went out leaves nothing to report.
+    s.pack_mv = 3500;
+    CHECK_STR(update(&t, &s, false), "{\"watch\":0,\"field\":\"pack_mv\",\"active\":false,\"value\":3500}");
+    s.pack_mv = 3200;
+    CHECK_STR(update(&t, &s, false), "");
+}
+
+static void test_decimals(void) {
+    CHECK(watch_field_decimals(WATCH_FIELD_MCU_TEMP_C) == TELEMETRY_TEMP_DECIMALS);
+    CHECK(watch_field_decimals(WATCH_FIELD_BATTERY_PCT) == 0);
+    CHECK(watch_field_decimals(WATCH_FIELD_PACK_MV) == 0);
+    CHECK(watch_field_decimals(WATCH_FIELD_PACK_MA) == 0);
+    CHECK(watch_field_decimals(WATCH_FIELD_UNREAD_EXT) == 0);
+
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_MCU_TEMP_C, WATCH_ABOVE, 45.0f, 1.5f, &s) == 0);
+    CHECK(watch_table_add(&t, WATCH_FIELD_UNREAD_EXT, WATCH_ABOVE, 0.0f, 0.0f, &s) == 1);
+    s.mcu_temp_c = 45.26f;
+    CHECK_STR(update(&t, &s, true), "{\"watch\":0,\"field\":\"mcu_temp_c\",\"active\":true,\"value\":45.3}");
+    s.mcu_temp_c = 43.6f;
+    CHECK_STR(update(&t, &s, true), "");
+    s.mcu_temp_c = 43.5f;
+    CHECK_STR(update(&t, &s, true), "{\"watch\":0,\"field\":\"mcu_temp_c\",\"active\":false,\"value\":43.5}");
+    s.mcu_temp_c = 50.0f;
+    s.unread_ext = 3;
+    CHECK_STR(update(&t, &s, true), "{\"watch\":0,\"field\":\"mcu_temp_c\",\"active\":true,\"value\":50} "
+                                    "{\"watch\":1,\"field\":\"unread_ext\",\"active\":true,\"value\":3}");
+}
+
+static void test_table(void) {
+    watch_field_t f;
+    watch_op_t op;
+    for (int i = 0; i < WATCH_FIELD_COUNT; ++i) {
+        CHECK(watch_field_from_name(watch_field_name((watch_field_t)i), &f) && f == (watch_field_t)i);
+    }
+    CHECK(!watch_field_from_name("pack", &f) && !watch_field_from_name(NULL, &f));
+    CHECK(watch_op_from_name("<", &op) && op == WATCH_BELOW);
+    CHECK(watch_op_from_name(">", &op) && op == WATCH_ABOVE);
+    CHECK(!watch_op_from_name("<=", &op));
+
+    watch_table_t t;
+    watch_table_init(&t);
+    supervisor_state_t s = base_state();
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, -1.0f, &s) == -1);
+    CHECK(watch_table_add(&t, WATCH_FIELD_COUNT, WATCH_BELOW, 3300.0f, 0.0f, &s) == -1);
+    for (int i = 0; i < WATCH_MAX; ++i) {
+        CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3000.0f + (float)i, 0.0f, &s) == i);
+    }
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MV, WATCH_BELOW, 3300.0f, 0.0f, &s) == -1);
+    CHECK(watch_table_remove(&t, 3) && !watch_table_remove(&t, 3) && !watch_table_remove(&t, WATCH_MAX));
+    CHECK(watch_table_add(&t, WATCH_FIELD_PACK_MA, WATCH_BELOW, 0.0f, 0.0f, &s) == 3);
+
+    // Only watches on fields that changed are evaluated.
+    update(&t, &s, true);
+    const uint32_t evaluations = t.evaluations;
+    update(&t, &s, true);
+    CHECK(t.evaluations == evaluations);
+    s.pack_ma = -400;
+    update(&t, &s, true);
+    CHECK(t.evaluations == evaluations + 1);
+    s.pack_mv = 3600;
+    update(&t, &s, true);
+    CHECK(t.evaluations == evaluations + 1 + WATCH_MAX - 1);
+
+    watch_table_clear(&t);
+    CHECK(t.updates == 4 && t.evaluations == evaluations + WATCH_MAX);
+    for (int i = 0; i < WATCH_MAX; ++i) {
+        CHECK(!t.watches[i].in_use);
+    }
+}
+
+int main(void) {
+    test_rising();
+    test_falling();
+    test_starts_active();
+    test_unreported();
+    test_decimals();
+    test_table();
+    return test_finish("test_watch");
+}
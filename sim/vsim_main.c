@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: MIT
+// Virtual-time simulator: runs the firmware against a scripted timeline on a
+// simulated clock and prints a timestamped transcript of the supervisor
+// UART. Days of firmware time run in seconds and a given script and seed
+// always produce the same transcript.
+//
+// Timeline script, one event per line ('#' starts a comment):
+//
+//   at <time> rx <text>        deliver <text> plus a newline on the UART
+//   at <time> mark <text>      copy <text> into the transcript
+//   at <time> gpio <pin> 0|1|toggle  drive an input pin
+//   every <period> [from <time>] [jitter <time>] rx|mark|gpio ...
+//
+// Times are integers with an optional unit (us, ms, s, m, h, d; default ms)
+// measured from boot. Jitter delays each repetition by a seeded random amount
+// up to the given time. Output pin changes are shown as "> gpio <pin> <level>"
+// and one-shot input changes as "< gpio <pin> <level>"; repeating ones (a
+// heartbeat, say) are left out of the transcript.
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "sim_port.h"
+
+#define VSIM_SUPV_UART UART_NUM_1
+#define VSIM_TEXT_MAX 512
+
+void app_main(void);
+
+typedef enum {
+    ACTION_RX,
+    ACTION_MARK,
+    ACTION_GPIO,
+} action_t;
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t period_us;
+    uint64_t jitter_us;
+    action_t action;
+    // ACTION_GPIO: the pin and its new level, -1 to toggle.
+    int gpio_num;
+    int level;
+    size_t line_no;
+    char text[VSIM_TEXT_MAX];
+    size_t len;
+} timeline_event_t;
+
+static timeline_event_t *g_events;
+static size_t g_event_count;
+static size_t g_next_once;
+static uint64_t g_rng;
+static bool g_show_tx = true;
+static uint64_t g_tx_frames;
+static uint64_t g_tx_bytes;
+
+static void print_time(void) {
+    const uint64_t now = sim_virtual_now_us();
+    printf("%10llu.%03llu ", (unsigned long long)(now / 1000000ULL), (unsigned long long)(now / 1000ULL % 1000ULL));
+}
+
+static void tx_hook(const uint8_t *data, size_t len, void *ctx) {
+    (void)ctx;
+    ++g_tx_frames;
+    g_tx_bytes += len;
+    if (!g_show_tx) {
+        return;
+    }
+    size_t shown = len;
+    while (shown > 0 && data[shown - 1] == '\n') {
+        --shown;
+    }
+    bool printable = true;
+    for (size_t i = 0; i < shown; ++i) {
+        printable &= isprint(data[i]) != 0;
+    }
+    print_time();
+    if (printable) {
+        printf("> %.*s\n", (int)shown, (const char *)data);
+        return;
+    }
+    printf("> bin");
+    for (size_t i = 0; i < len; ++i) {
+        printf(" %02x", data[i]);
+    }
+    printf("\n");
+}
+
+static void gpio_hook(gpio_num_t gpio_num, int level, void *ctx) {
+    (void)ctx;
+    print_time();
+    printf("> gpio %d %d\n", (int)gpio_num, level);
+}
+
+static void fire(const timeline_event_t *ev) {
+    if (ev->action == ACTION_GPIO) {
+        const int level = ev->level < 0 ? !gpio_get_level(ev->gpio_num) : ev->level;
+        if (ev->period_us == 0) {
+            print_time();
+            printf("< gpio %d %d\n", ev->gpio_num, level);
+        }
+        sim_gpio_drive(ev->gpio_num, level);
+        return;
+    }
+    print_time();
+    if (ev->action == ACTION_MARK) {
+        printf("# %s\n", ev->text);
+        return;
+    }
+    printf("< %s\n", ev->text);
+    char line[VSIM_TEXT_MAX + 1];
+    memcpy(line, ev->text, ev->len);
+    line[ev->len] = '\n';
+    sim_uart_inject(VSIM_SUPV_UART, line, ev->len + 1);
+}
+
+static uint64_t next_random(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static uint64_t with_jitter(const timeline_event_t *ev, uint64_t at_us) {
+    return ev->jitter_us ? at_us + next_random() % (ev->jitter_us + 1) : at_us;
+}
+
+// One-shot events are sorted and walked by a single callout; each repeating
+// event keeps its own.
+static void once_callout(void *arg) {
+    (void)arg;
+    const uint64_t now = sim_virtual_now_us();
+    while (g_next_once < g_event_count && g_events[g_next_once].period_us == 0 &&
+           g_events[g_next_once].at_us <= now) {
+        fire(&g_events[g_next_once++]);
+    }
+    if (g_next_once < g_event_count && g_events[g_next_once].period_us == 0) {
+        sim_virtual_call_at(g_events[g_next_once].at_us, once_callout, NULL);
+    }
+}
+
+static void every_callout(void *arg) {
+    timeline_event_t *ev = arg;
+    fire(ev);
+    ev->at_us += ev->period_us;
+    sim_virtual_call_at(with_jitter(ev, ev->at_us), every_callout, ev);
+}
+
+static bool parse_time(const char *s, uint64_t *out) {
+    char *end;
+    const unsigned long long v = strtoull(s, &end, 10);
+    if (end == s) {
+        return false;
+    }
+    static const struct {
+        const char *suffix;
+        uint64_t scale;
+    } units[] = {{"", 1000}, {"us", 1}, {"ms", 1000}, {"s", 1000000}, {"m", 60000000ULL},
+                 {"h", 3600000000ULL}, {"d", 86400000000ULL}};
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i) {
+        if (strcmp(end, units[i].suffix) == 0) {
+            *out = v * units[i].scale;
+            return true;
+        }
+    }
+    return false;
+}
+
+static char *next_word(char **cursor) {
+    char *s = *cursor;
+    while (*s == ' ' || *s == '\t') {
+        ++s;
+    }
+    if (*s == '\0') {
+        return NULL;
+    }
+    char *word = s;
+    while (*s && *s != ' ' && *s != '\t') {
+        ++s;
+    }
+    if (*s) {
+        *s++ = '\0';
+    }
+    *cursor = s;
+    return word;
+}
+
+static bool parse_line(char *line, timeline_event_t *ev) {
+    char *cursor = line;
+    const char *kind = next_word(&cursor);
+    const char *when = next_word(&cursor);
+    *ev = (timeline_event_t){0};
+    if (!kind || !when) {
+        return false;
+    }
+    const char *word;
+    if (strcmp(kind, "at") == 0) {
+        if (!parse_time(when, &ev->at_us)) {
+            return false;
+        }
+        word = next_word(&cursor);
+    } else if (strcmp(kind, "every") == 0) {
+        if (!parse_time(when, &ev->period_us) || ev->period_us == 0) {
+            return false;
+        }
+        ev->at_us = ev->period_us;
+        word = next_word(&cursor);
+        while (word && (strcmp(word, "from") == 0 || strcmp(word, "jitter") == 0)) {
+            const char *value = next_word(&cursor);
+            if (!value || !parse_time(value, strcmp(word, "from") == 0 ? &ev->at_us : &ev->jitter_us)) {
+                return false;
+            }
+            word = next_word(&cursor);
+        }
+    } else {
+        return false;
+    }
+    if (!word) {
+        return false;
+    }
+    if (strcmp(word, "rx") == 0) {
+        ev->action = ACTION_RX;
+    } else if (strcmp(word, "mark") == 0) {
+        ev->action = ACTION_MARK;
+    } else if (strcmp(word, "gpio") == 0) {
+        ev->action = ACTION_GPIO;
+        const char *pin = next_word(&cursor);
+        const char *level = next_word(&cursor);
+        char *end = NULL;
+        ev->gpio_num = pin ? (int)strtol(pin, &end, 10) : -1;
+        if (!pin || *end != '\0' || ev->gpio_num < 0 || ev->gpio_num >= GPIO_NUM_MAX || !level) {
+            return false;
+        }
+        if (strcmp(level, "toggle") == 0) {
+            ev->level = -1;
+        } else if (strcmp(level, "0") == 0 || strcmp(level, "1") == 0) {
+            ev->level = level[0] - '0';
+        } else {
+            return false;
+        }
+        return next_word(&cursor) == NULL;
+    } else {
+        return false;
+    }
+    while (*cursor == ' ' || *cursor == '\t') {
+        ++cursor;
+    }
+    ev->len = strlen(cursor);
+    if (ev->len == 0 || ev->len >= VSIM_TEXT_MAX) {
+        return false;
+    }
+    memcpy(ev->text, cursor, ev->len + 1);
+    return true;
+}
+
+static int compare_events(const void *a, const void *b) {
+    const timeline_event_t *x = a;
+    const timeline_event_t *y = b;
+    // Repeating events last; one-shots by time, then by position in the file.
+    if ((x->period_us != 0) != (y->period_us != 0)) {
+        return x->period_us != 0 ? 1 : -1;
+    }
+    if (x->at_us != y->at_us) {
+        return x->at_us < y->at_us ? -1 : 1;
+    }
+    return x->line_no < y->line_no ? -1 : x->line_no > y->line_no;
+}
+
+static bool load_timeline(const char *path) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[VSIM_TEXT_MAX + 64];
+    size_t line_no = 0;
+    size_t cap = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        ++line_no;
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *p = line + strspn(line, " \t");
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        if (g_event_count == cap) {
+            cap = cap ? cap * 2 : 32;
+            g_events = realloc(g_events, cap * sizeof(*g_events));
+            if (!g_events) {
+                ok = false;
+                break;
+            }
+        }
+        if (!parse_line(line, &g_events[g_event_count])) {
+            fprintf(stderr, "%s:%zu: cannot parse timeline event\n", path, line_no);
+            ok = false;
+            break;
+        }
+        g_events[g_event_count++].line_no = line_no;
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+    if (ok && g_event_count > 1) {
+        qsort(g_events, g_event_count, sizeof(*g_events), compare_events);
+    }
+    return ok;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--script FILE] [--duration TIME] [--seed N] [--no-wire-timing] [--no-tx] [--adc]\n"
+            "          [--log-level 0-5]\n"
+            "  --script FILE    timeline script ('-' for stdin; default: none)\n"
+            "  --duration TIME  firmware time to simulate, e.g. 90s or 7d (default 60s)\n"
+            "  --seed N         seed for scheduling ties and jitter (default 1)\n"
+            "  --no-wire-timing do not model 115200 baud transmit time\n"
+            "  --no-tx          leave transmitted frames out of the transcript\n"
+            "  --adc            sample a steady pack at the full ADC rate (slow; otherwise\n"
+            "                   the pack ADC is absent, pack_mv/pack_ma read 0 and\n"
+            "                   battery_pct is unknown)\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *script = NULL;
+    uint64_t duration_us = 60000000ULL;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script = argv[++i];
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            if (!parse_time(argv[++i], &duration_us)) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--no-wire-timing") == 0) {
+            sim_uart_set_wire_timing(false);
+        } else if (strcmp(argv[i], "--no-tx") == 0) {
+            g_show_tx = false;
+        } else if (strcmp(argv[i], "--adc") == 0) {
+            sim_adc_set_pack(11750, -420);
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            sim_log_set_level((esp_log_level_t)strtol(argv[++i], NULL, 10));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (script && !load_timeline(script)) {
+        return 1;
+    }
+
+    g_rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    sim_virtual_time_enable(seed);
+    sim_uart_set_tx_hook(VSIM_SUPV_UART, tx_hook, NULL);
+    sim_gpio_set_output_hook(gpio_hook, NULL);
+    if (g_event_count > 0 && g_events[0].period_us == 0) {
+        sim_virtual_call_at(g_events[0].at_us, once_callout, NULL);
+    }
+    for (size_t i = 0; i < g_event_count; ++i) {
+        if (g_events[i].period_us != 0 &&
+            !sim_virtual_call_at(with_jitter(&g_events[i], g_events[i].at_us), every_callout, &g_events[i])) {
+            fprintf(stderr, "too many repeating timeline events\n");
+            return 1;
+        }
+    }
+
+    struct timespec wall_start;
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    const uint64_t end_us = sim_virtual_run(app_main, duration_us);
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    fflush(stdout);
+
+    const double wall_s =
+        (double)(wall_end.tv_sec - wall_start.tv_sec) + (double)(wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    size_t tasks = 0;
+    size_t stack_bytes = 0;
+    sim_task_footprint(&tasks, &stack_bytes);
+    fprintf(stderr,
+            "reached t=%.3f s in %.3f s wall (%.0fx), %llu context switches, %llu frames / %llu bytes sent, "
+            "%zu tasks / %zu bytes of stack\n",
+            (double)end_us / 1e6, wall_s, wall_s > 0 ? (double)end_us / 1e6 / wall_s : 0.0,
+            (unsigned long long)sim_virtual_context_switches(), (unsigned long long)g_tx_frames,
+            (unsigned long long)g_tx_bytes, tasks, stack_bytes);
+    return 0;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+#include "adc_filter.h"
+
+#include <string.h>
+
+bool adc_filter_init(adc_filter_t *f, const adc_filter_config_t *cfg) {
+    const unsigned n = cfg->oversample;
+    if (n == 0 || n > ADC_FILTER_MAX_OVERSAMPLE || (n & (n - 1)) != 0 || cfg->iir_shift >= 16) {
+        return false;
+    }
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    f->oversample_log2 = (uint8_t)__builtin_ctz(n);
+    return true;
+}
+
+static int32_t median3(int32_t a, int32_t b, int32_t c) {
+    if (a > b) {
+        const int32_t t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : c > b ? b : c;
+}
+
+bool adc_filter_push(adc_filter_t *f, uint16_t raw) {
+    f->sum += raw;
+    if (++f->count < f->cfg.oversample) {
+        return false;
+    }
+    // ADC codes are at most 13 bits wide, so the block mean fits Q16.16.
+    const int32_t mean = (int32_t)(f->sum << (16 - f->oversample_log2));
+    f->sum = 0;
+    f->count = 0;
+
+    f->window[f->next] = mean;
+    f->next = f->next == 2 ? 0 : f->next + 1;
+    if (f->filled < 3) {
+        ++f->filled;
+    }
+    const int32_t x = f->filled >= 3 ? median3(f->window[0], f->window[1], f->window[2]) : mean;
+    if (f->outputs == 0) {
+        f->y_q16 = x;
+    } else {
+        f->y_q16 += (x - f->y_q16) >> f->cfg.iir_shift;
+    }
+    ++f->outputs;
+    return true;
+}
+
+int32_t adc_filter_value_q16(const adc_filter_t *f) {
+    return f->y_q16;
+}
+
+int adc_filter_raw(const adc_filter_t *f) {
+    return (int)((f->y_q16 + 0x8000) >> 16);
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-point filter for one channel of continuous ADC samples. Raw codes are
+// averaged in blocks of `oversample` (a power of two), a median of the last
+// three block means drops isolated spikes, and a first-order IIR,
+// y += (x - y) / 2^iir_shift, smooths the result. Values are kept as raw
+// codes in Q16.16 so the resolution gained by oversampling survives until
+// calibration. Free of ESP-IDF dependencies.
+#define ADC_FILTER_MAX_OVERSAMPLE 64
+
+typedef struct {
+    uint8_t oversample;
+    uint8_t iir_shift;
+} adc_filter_config_t;
+
+typedef struct {
+    adc_filter_config_t cfg;
+    uint8_t oversample_log2;
+    uint32_t sum;
+    uint32_t count;
+    int32_t window[3];
+    uint8_t next;
+    uint8_t filled;
+    int32_t y_q16;
+    // Block means that went through the median and IIR stages.
+    uint32_t outputs;
+} adc_filter_t;
+
+// Fails unless `oversample` is a power of two up to ADC_FILTER_MAX_OVERSAMPLE
+// and `iir_shift` is below 16.
+bool adc_filter_init(adc_filter_t *f, const adc_filter_config_t *cfg);
+
+// Adds one raw sample; returns true when it completed a block and the output
+// moved.
+bool adc_filter_push(adc_filter_t *f, uint16_t raw);
+
+// Filtered value in raw codes, Q16.16 and rounded to a whole code.
+int32_t adc_filter_value_q16(const adc_filter_t *f);
+int adc_filter_raw(const adc_filter_t *f);
+
+static inline bool adc_filter_ready(const adc_filter_t *f) {
+    return f->outputs > 0;
+}
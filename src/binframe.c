@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: MIT
+#include "binframe.h"
+
+#include <string.h>
+
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t pos;
+    size_t code_pos;
+    uint8_t code;
+    bool overflow;
+} cobs_writer_t;
+
+static bool cobs_reserve(cobs_writer_t *c, size_t *slot) {
+    if (c->pos >= c->cap) {
+        c->overflow = true;
+        return false;
+    }
+    *slot = c->pos++;
+    return true;
+}
+
+static void cobs_begin(cobs_writer_t *c, uint8_t *out, size_t cap) {
+    *c = (cobs_writer_t){.out = out, .cap = cap};
+    c->code = 1;
+    cobs_reserve(c, &c->code_pos);
+}
+
+static void cobs_close_block(cobs_writer_t *c) {
+    if (c->overflow) {
+        return;
+    }
+    c->out[c->code_pos] = c->code;
+    c->code = 1;
+    cobs_reserve(c, &c->code_pos);
+}
+
+static void cobs_put(cobs_writer_t *c, uint8_t b) {
+    if (c->overflow) {
+        return;
+    }
+    if (b == 0) {
+        cobs_close_block(c);
+        return;
+    }
+    size_t slot;
+    if (!cobs_reserve(c, &slot)) {
+        return;
+    }
+    c->out[slot] = b;
+    if (++c->code == 0xFF) {
+        cobs_close_block(c);
+    }
+}
+
+static size_t cobs_finish(cobs_writer_t *c) {
+    if (c->overflow) {
+        return 0;
+    }
+    c->out[c->code_pos] = c->code;
+    size_t slot;
+    if (!cobs_reserve(c, &slot)) {
+        return 0;
+    }
+    c->out[slot] = 0;
+    return c->pos;
+}
+
+static uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t binframe_crc16(const uint8_t *data, size_t len) {
+    return crc16_update(0xFFFF, data, len);
+}
+
+size_t binframe_encode(binframe_type_t type, const uint8_t *payload, size_t len, uint8_t *out, size_t cap) {
+    if (len > BINFRAME_MAX_PAYLOAD) {
+        return 0;
+    }
+    const uint8_t type_byte = (uint8_t)type;
+    const uint16_t crc = crc16_update(binframe_crc16(&type_byte, 1), payload, len);
+    cobs_writer_t c;
+    cobs_begin(&c, out, cap);
+    cobs_put(&c, type_byte);
+    for (size_t i = 0; i < len; ++i) {
+        cobs_put(&c, payload[i]);
+    }
+    cobs_put(&c, (uint8_t)(crc & 0xFF));
+    cobs_put(&c, (uint8_t)(crc >> 8));
+    return cobs_finish(&c);
+}
+
+bool binframe_decode(uint8_t *frame, size_t len, uint8_t *type, const uint8_t **payload, size_t *payload_len) {
+    if (len > 0 && frame[len - 1] == 0) {
+        --len;
+    }
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        const uint8_t code = frame[in++];
+        if (code == 0 || in + code - 1u > len) {
+            return false;
+        }
+        for (uint8_t i = 1; i < code; ++i) {
+            const uint8_t b = frame[in++];
+            if (b == 0) {
+                return false;
+            }
+            frame[out++] = b;
+        }
+        if (code != 0xFF && in < len) {
+            frame[out++] = 0;
+        }
+    }
+    if (out < 3) {
+        return false;
+    }
+    const uint16_t crc = (uint16_t)(frame[out - 2] | (frame[out - 1] << 8));
+    if (binframe_crc16(frame, out - 2) != crc) {
+        return false;
+    }
+    *type = frame[0];
+    *payload = frame + 1;
+    *payload_len = out - 3;
+    return true;
+}
+
+uint8_t binframe_switch_bits(const supervisor_switch_state_t *sw) {
+    uint8_t bits = 0;
+    bits |= sw->lte ? BINFRAME_SWITCH_LTE : 0;
+    bits |= sw->wifi ? BINFRAME_SWITCH_WIFI : 0;
+    bits |= sw->bt ? BINFRAME_SWITCH_BT : 0;
+    bits |= sw->bridge_enable ? BINFRAME_SWITCH_BRIDGE_ENABLE : 0;
+    bits |= sw->lid_open ? BINFRAME_SWITCH_LID_OPEN : 0;
+    bits |= sw->charger_online ? BINFRAME_SWITCH_CHARGER_ONLINE : 0;
+    return bits;
+}
+
+supervisor_switch_state_t binframe_switch_from_bits(uint8_t bits) {
+    return (supervisor_switch_state_t){
+        .lte = (bits & BINFRAME_SWITCH_LTE) != 0,
+        .wifi = (bits & BINFRAME_SWITCH_WIFI) != 0,
+        .bt = (bits & BINFRAME_SWITCH_BT) != 0,
+        .bridge_enable = (bits & BINFRAME_SWITCH_BRIDGE_ENABLE) != 0,
+        .lid_open = (bits & BINFRAME_SWITCH_LID_OPEN) != 0,
+        .charger_online = (bits & BINFRAME_SWITCH_CHARGER_ONLINE) != 0,
+    };
+}
+
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} tlv_writer_t;
+
+static void tlv_put(tlv_writer_t *t, const void *data, size_t n) {
+    if (t->overflow || n > t->cap - t->len) {
+        t->overflow = true;
+        return;
+    }
+    memcpy(t->out + t->len, data, n);
+    t->len += n;
+}
+
+static void tlv_varint(tlv_writer_t *t, uint8_t id, uint64_t v) {
+    uint8_t tmp[11];
+    size_t n = 0;
+    tmp[n++] = id;
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        tmp[n++] = v ? (uint8_t)(b | 0x80) : b;
+    } while (v);
+    tlv_put(t, tmp, n);
+}
+
+static void tlv_sint(tlv_writer_t *t, uint8_t id, int v) {
+    const uint32_t zz = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    tlv_varint(t, id, zz);
+}
+
+static void tlv_string(tlv_writer_t *t, uint8_t id, const char *s, size_t max) {
+    const size_t n = strnlen(s, max);
+    const uint8_t hdr[2] = {id, (uint8_t)n};
+    tlv_put(t, hdr, sizeof(hdr));
+    tlv_put(t, s, n);
+}
+
+size_t binframe_encode_telemetry(const supervisor_state_t *state, uint64_t now_us, telemetry_mask_t mask,
+                                 uint8_t *out, size_t cap) {
+    tlv_writer_t t = {.out = out, .cap = cap};
+    if (mask & TELEMETRY_FIELD_BATTERY_PCT) {
+        tlv_sint(&t, BINFRAME_FIELD_BATTERY_PCT, state->battery_pct);
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MV) {
+        tlv_sint(&t, BINFRAME_FIELD_PACK_MV, state->pack_mv);
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MA) {
+        tlv_sint(&t, BINFRAME_FIELD_PACK_MA, state->pack_ma);
+    }
+    if (mask & TELEMETRY_FIELD_MCU_TEMP_C) {
+        uint32_t bits;
+        memcpy(&bits, &state->mcu_temp_c, sizeof(bits));
+        const uint8_t rec[5] = {BINFRAME_FIELD_MCU_TEMP_C, (uint8_t)bits, (uint8_t)(bits >> 8),
+                                (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+        tlv_put(&t, rec, sizeof(rec));
+    }
+    if (mask & TELEMETRY_FIELD_UNREAD_EXT) {
+        tlv_sint(&t, BINFRAME_FIELD_UNREAD_EXT, state->unread_ext);
+    }
+    if (mask & TELEMETRY_FIELD_LAST_MSG_AGE_S) {
+        tlv_sint(&t, BINFRAME_FIELD_LAST_MSG_AGE_S, telemetry_last_msg_age(state, now_us));
+    }
+    if (mask & TELEMETRY_FIELD_HELTEC) {
+        tlv_string(&t, BINFRAME_FIELD_HELTEC, state->heltec, sizeof(state->heltec));
+    }
+    if (mask & TELEMETRY_FIELD_MCU) {
+        tlv_string(&t, BINFRAME_FIELD_MCU, state->mcu, sizeof(state->mcu));
+    }
+    if (mask & TELEMETRY_FIELD_UPTIME_S) {
+        tlv_varint(&t, BINFRAME_FIELD_UPTIME_S, now_us / 1000000ULL);
+    }
+    if (mask & TELEMETRY_FIELD_SWITCH) {
+        const uint8_t rec[2] = {BINFRAME_FIELD_SWITCH, binframe_switch_bits(&state->switches)};
+        tlv_put(&t, rec, sizeof(rec));
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_EMPTY_MIN) {
+        tlv_sint(&t, BINFRAME_FIELD_TIME_TO_EMPTY_MIN, state->time_to_empty_min);
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_FULL_MIN) {
+        tlv_sint(&t, BINFRAME_FIELD_TIME_TO_FULL_MIN, state->time_to_full_min);
+    }
+    return t.overflow ? 0 : t.len;
+}
+
+static bool read_varint(const uint8_t *p, size_t len, size_t *pos, uint64_t *out) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        const uint8_t b = p[(*pos)++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_sint(const uint8_t *p, size_t len, size_t *pos, int *out) {
+    uint64_t zz;
+    if (!read_varint(p, len, pos, &zz) || zz > UINT32_MAX) {
+        return false;
+    }
+    *out = (int)((uint32_t)(zz >> 1) ^ (uint32_t)-(int32_t)(zz & 1));
+    return true;
+}
+
+static bool read_string(const uint8_t *p, size_t len, size_t *pos, char *out, size_t cap) {
+    if (*pos >= len) {
+        return false;
+    }
+    const size_t n = p[(*pos)++];
+    if (n >= cap || n > len - *pos) {
+        return false;
+    }
+    memcpy(out, p + *pos, n);
+    out[n] = '\0';
+    *pos += n;
+    return true;
+}
+
+bool binframe_decode_telemetry(const uint8_t *payload, size_t len, binframe_telemetry_t *out) {
+    memset(out, 0, sizeof(*out));
+    size_t pos = 0;
+    while (pos < len) {
+        const uint8_t id = payload[pos++];
+        bool ok;
+        switch (id) {
+            case BINFRAME_FIELD_BATTERY_PCT: ok = read_sint(payload, len, &pos, &out->battery_pct); break;
+            case BINFRAME_FIELD_PACK_MV: ok = read_sint(payload, len, &pos, &out->pack_mv); break;
+            case BINFRAME_FIELD_PACK_MA: ok = read_sint(payload, len, &pos, &out->pack_ma); break;
+            case BINFRAME_FIELD_MCU_TEMP_C: {
+                ok = len - pos >= 4;
+                if (ok) {
+                    const uint32_t bits = (uint32_t)payload[pos] | ((uint32_t)payload[pos + 1] << 8) |
+                                          ((uint32_t)payload[pos + 2] << 16) | ((uint32_t)payload[pos + 3] << 24);
+                    memcpy(&out->mcu_temp_c, &bits, sizeof(bits));
+                    pos += 4;
+                }
+                break;
+            }
+            case BINFRAME_FIELD_UNREAD_EXT: ok = read_sint(payload, len, &pos, &out->unread_ext); break;
+            case BINFRAME_FIELD_LAST_MSG_AGE_S: ok = read_sint(payload, len, &pos, &out->last_msg_age_s); break;
+            case BINFRAME_FIELD_HELTEC: ok = read_string(payload, len, &pos, out->heltec, sizeof(out->heltec)); break;
+            case BINFRAME_FIELD_MCU: ok = read_string(payload, len, &pos, out->mcu, sizeof(out->mcu)); break;
+            case BINFRAME_FIELD_UPTIME_S: ok = read_varint(payload, len, &pos, &out->uptime_s); break;
+            case BINFRAME_FIELD_SWITCH:
+                ok = pos < len;
+                if (ok) {
+                    out->switches = binframe_switch_from_bits(payload[pos++]);
+                }
+                break;
+            case BINFRAME_FIELD_TIME_TO_EMPTY_MIN: ok = read_sint(payload, len, &pos, &out->time_to_empty_min); break;
+            case BINFRAME_FIELD_TIME_TO_FULL_MIN: ok = read_sint(payload, len, &pos, &out->time_to_full_min); break;
+            default:
+                // Field IDs are append-only, so an unknown ID cannot be skipped.
+                return false;
+        }
+        if (!ok) {
+            return false;
+        }
+        out->mask |= (telemetry_mask_t)1u << id;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supervisor_state.h"
+#include "telemetry.h"
+
+// Compact binary framing, negotiated with the set_framing command.
+//
+// On the wire each frame is COBS(type | payload | crc16_le) followed by a
+// single 0x00 delimiter. The CRC is CRC-16/CCITT-FALSE over type and payload.
+// Pure C and free of ESP-IDF dependencies so the Pi-side tooling and host
+// tests can link the same encoder and decoder.
+#define BINFRAME_MAX_PAYLOAD 512
+// type + payload + crc, plus one COBS overhead byte per 254 and the delimiter.
+#define BINFRAME_MAX_WIRE (1 + BINFRAME_MAX_PAYLOAD + 2 + (1 + BINFRAME_MAX_PAYLOAD + 2) / 254 + 2)
+
+typedef enum {
+    BINFRAME_TYPE_JSON = 0x01,      // payload: one JSON message, no newline
+    BINFRAME_TYPE_TELEMETRY = 0x02, // payload: telemetry TLV records
+    BINFRAME_TYPE_SWITCH = 0x03,    // payload: one switch bitmask byte
+} binframe_type_t;
+
+// Telemetry TLV field IDs are the bit positions of telemetry_field_t, so a
+// telemetry_mask_t maps directly onto the records present in a frame.
+typedef enum {
+    BINFRAME_FIELD_BATTERY_PCT = 0, // zigzag varint
+    BINFRAME_FIELD_PACK_MV = 1,     // zigzag varint
+    BINFRAME_FIELD_PACK_MA = 2,     // zigzag varint
+    BINFRAME_FIELD_MCU_TEMP_C = 3,  // IEEE-754 float32, little endian
+    BINFRAME_FIELD_UNREAD_EXT = 4,  // zigzag varint
+    BINFRAME_FIELD_LAST_MSG_AGE_S = 5, // zigzag varint
+    BINFRAME_FIELD_HELTEC = 6,      // length byte + bytes
+    BINFRAME_FIELD_MCU = 7,         // length byte + bytes
+    BINFRAME_FIELD_UPTIME_S = 8,    // varint
+    BINFRAME_FIELD_SWITCH = 9,      // switch bitmask byte
+    BINFRAME_FIELD_TIME_TO_EMPTY_MIN = 10, // zigzag varint
+    BINFRAME_FIELD_TIME_TO_FULL_MIN = 11,  // zigzag varint
+    BINFRAME_FIELD_COUNT,
+} binframe_field_t;
+
+// Bit order of the switch bitmask byte.
+#define BINFRAME_SWITCH_LTE 0x01
+#define BINFRAME_SWITCH_WIFI 0x02
+#define BINFRAME_SWITCH_BT 0x04
+#define BINFRAME_SWITCH_BRIDGE_ENABLE 0x08
+#define BINFRAME_SWITCH_LID_OPEN 0x10
+#define BINFRAME_SWITCH_CHARGER_ONLINE 0x20
+
+// Decoded form of a telemetry frame; only fields in `mask` are meaningful.
+typedef struct {
+    telemetry_mask_t mask;
+    int battery_pct;
+    int pack_mv;
+    int pack_ma;
+    float mcu_temp_c;
+    int unread_ext;
+    int last_msg_age_s;
+    char heltec[16];
+    char mcu[16];
+    uint64_t uptime_s;
+    supervisor_switch_state_t switches;
+    int time_to_empty_min;
+    int time_to_full_min;
+} binframe_telemetry_t;
+
+uint16_t binframe_crc16(const uint8_t *data, size_t len);
+
+// Wraps `payload` into a delimited wire frame. Returns the number of bytes
+// written to `out`, or 0 if it does not fit.
+size_t binframe_encode(binframe_type_t type, const uint8_t *payload, size_t len, uint8_t *out, size_t cap);
+
+// Decodes one wire frame (with or without its trailing 0x00) in place.
+// On success `*type`, `*payload` and `*payload_len` describe the contents.
+bool binframe_decode(uint8_t *frame, size_t len, uint8_t *type, const uint8_t **payload, size_t *payload_len);
+
+uint8_t binframe_switch_bits(const supervisor_switch_state_t *sw);
+supervisor_switch_state_t binframe_switch_from_bits(uint8_t bits);
+
+// Encodes the fields selected by `mask` as TLV records. Returns the payload
+// length, or 0 if it does not fit.
+size_t binframe_encode_telemetry(const supervisor_state_t *state, uint64_t now_us, telemetry_mask_t mask,
+                                 uint8_t *out, size_t cap);
+bool binframe_decode_telemetry(const uint8_t *payload, size_t len, binframe_telemetry_t *out);
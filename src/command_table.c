@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MIT
+#include "command_table.h"
+
+#include <string.h>
+
+static const command_def_t *g_defs;
+static size_t g_def_count;
+// Open-addressed index of def positions + 1 (0 marks an empty slot).
+static uint8_t g_index[COMMAND_INDEX_SLOTS];
+static uint8_t g_name_len[COMMAND_MAX_COMMANDS];
+static const char *g_keys[COMMAND_MAX_KEYS];
+static size_t g_key_count;
+static uint8_t g_arg_key[COMMAND_MAX_COMMANDS][COMMAND_MAX_ARGS];
+static command_stats_t g_stats[COMMAND_MAX_COMMANDS];
+static uint32_t g_unknown_count;
+
+_Static_assert((COMMAND_INDEX_SLOTS & (COMMAND_INDEX_SLOTS - 1)) == 0, "index size must be a power of two");
+_Static_assert(COMMAND_INDEX_SLOTS >= 2 * COMMAND_MAX_COMMANDS, "index load factor must stay <= 0.5");
+
+// Length plus first and last byte separates every command name in use with no
+// collisions, so a lookup costs one slot probe and one memcmp.
+static size_t hash_name(const char *name, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    const unsigned first = (unsigned char)name[0];
+    const unsigned last = (unsigned char)name[len - 1];
+    return ((unsigned)len * 7u + first * 31u + last) & (COMMAND_INDEX_SLOTS - 1);
+}
+
+static int intern_key(const char *key) {
+    for (size_t i = 0; i < g_key_count; ++i) {
+        if (strcmp(g_keys[i], key) == 0) {
+            return (int)i;
+        }
+    }
+    if (g_key_count >= COMMAND_MAX_KEYS) {
+        return -1;
+    }
+    g_keys[g_key_count] = key;
+    return (int)g_key_count++;
+}
+
+bool command_table_init(const command_def_t *defs, size_t count) {
+    if (!defs || count > COMMAND_MAX_COMMANDS) {
+        return false;
+    }
+    memset(g_index, 0, sizeof(g_index));
+    memset(g_stats, 0, sizeof(g_stats));
+    g_key_count = 0;
+    g_unknown_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t len = strlen(defs[i].name);
+        if (len == 0 || len > UINT8_MAX) {
+            return false;
+        }
+        size_t slot = hash_name(defs[i].name, len);
+        while (g_index[slot]) {
+            slot = (slot + 1) & (COMMAND_INDEX_SLOTS - 1);
+        }
+        g_index[slot] = (uint8_t)(i + 1);
+        g_name_len[i] = (uint8_t)len;
+        for (size_t a = 0; a < COMMAND_MAX_ARGS && defs[i].args[a].name; ++a) {
+            const int key = intern_key(defs[i].args[a].name);
+            if (key < 0) {
+                return false;
+            }
+            g_arg_key[i][a] = (uint8_t)key;
+        }
+    }
+    g_defs = defs;
+    g_def_count = count;
+    return true;
+}
+
+static int lookup_index(const char *name, size_t len) {
+    if (!g_defs || !name) {
+        return -1;
+    }
+    size_t slot = hash_name(name, len);
+    while (g_index[slot]) {
+        const size_t i = g_index[slot] - 1u;
+        if (g_name_len[i] == len && memcmp(g_defs[i].name, name, len) == 0) {
+            return (int)i;
+        }
+        slot = (slot + 1) & (COMMAND_INDEX_SLOTS - 1);
+    }
+    return -1;
+}
+
+const command_def_t *command_table_lookup(const char *name, size_t len) {
+    const int i = lookup_index(name, len);
+    return i < 0 ? NULL : &g_defs[i];
+}
+
+size_t command_table_count(void) {
+    return g_def_count;
+}
+
+const command_def_t *command_table_at(size_t i) {
+    return i < g_def_count ? &g_defs[i] : NULL;
+}
+
+json_read_error_t command_table_parse(char *line, size_t len, command_line_t *out, size_t *error_offset) {
+    json_field_t fields[2 + COMMAND_MAX_KEYS];
+    fields[0] = (json_field_t){"cmd", &out->cmd};
+    fields[1] = (json_field_t){"id", &out->id};
+    for (size_t i = 0; i < g_key_count; ++i) {
+        fields[2 + i] = (json_field_t){g_keys[i], &out->keys[i]};
+    }
+    return json_read_object(line, len, fields, 2 + g_key_count, error_offset);
+}
+
+command_result_t command_table_dispatch(const command_line_t *line, command_request_t *req) {
+    memset(req, 0, sizeof(*req));
+    req->id = json_value_is_string(&line->id) ? line->id.ptr : NULL;
+    if (!json_value_is_string(&line->cmd)) {
+        return COMMAND_NO_CMD;
+    }
+    req->cmd = line->cmd.ptr;
+    const int i = lookup_index(line->cmd.ptr, line->cmd.len);
+    if (i < 0) {
+        ++g_unknown_count;
+        return COMMAND_UNKNOWN;
+    }
+    const command_def_t *def = &g_defs[i];
+    for (size_t a = 0; a < COMMAND_MAX_ARGS && def->args[a].name; ++a) {
+        const json_value_t *value = &line->keys[g_arg_key[i][a]];
+        if (value->type == JSON_TYPE_NONE) {
+            if (def->args[a].required) {
+                ++g_stats[i].rejected;
+                return COMMAND_BAD_ARGS;
+            }
+            continue;
+        }
+        if (value->type != def->args[a].type) {
+            ++g_stats[i].rejected;
+            return COMMAND_BAD_ARGS;
+        }
+        req->args[a] = *value;
+    }
+    ++g_stats[i].dispatched;
+    def->handler(req);
+    return COMMAND_DISPATCHED;
+}
+
+const command_stats_t *command_table_stats(const char *name) {
+    const int i = lookup_index(name, name ? strlen(name) : 0);
+    return i < 0 ? NULL : &g_stats[i];
+}
+
+void command_table_note_reply(const char *name, size_t bytes) {
+    const int i = lookup_index(name, name ? strlen(name) : 0);
+    if (i >= 0 && bytes > g_stats[i].reply_peak) {
+        g_stats[i].reply_peak = (uint32_t)bytes;
+    }
+}
+
+uint32_t command_table_unknown_count(void) {
+    return g_unknown_count;
+}
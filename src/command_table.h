@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_reader.h"
+
+// Registration-based command dispatch. Each command is one command_def_t
+// entry; lookup goes through a hash index built once by command_table_init.
+#define COMMAND_MAX_COMMANDS 16
+#define COMMAND_MAX_ARGS 4
+#define COMMAND_MAX_KEYS 16
+#define COMMAND_INDEX_SLOTS 32
+
+typedef struct {
+    const char *name;
+    json_type_t type;
+    bool required;
+} command_arg_t;
+
+// What a handler sees: `id` is NULL when absent or not a string, and
+// args[i] holds the value for the command's i-th schema entry
+// (type JSON_TYPE_NONE if an optional argument was omitted).
+typedef struct {
+    const char *cmd;
+    const char *id;
+    json_value_t args[COMMAND_MAX_ARGS];
+} command_request_t;
+
+typedef void (*command_handler_t)(const command_request_t *req);
+
+typedef struct {
+    const char *name;
+    command_handler_t handler;
+    command_arg_t args[COMMAND_MAX_ARGS];
+} command_def_t;
+
+// Every key any registered command understands, captured by one parse.
+typedef struct {
+    json_value_t cmd;
+    json_value_t id;
+    json_value_t keys[COMMAND_MAX_KEYS];
+} command_line_t;
+
+typedef enum {
+    COMMAND_DISPATCHED,
+    COMMAND_NO_CMD,
+    COMMAND_UNKNOWN,
+    COMMAND_BAD_ARGS,
+} command_result_t;
+
+typedef struct {
+    uint32_t dispatched;
+    uint32_t rejected;
+    // Longest reply encoded for the command, in bytes of its TX frame.
+    uint32_t reply_peak;
+} command_stats_t;
+
+// `defs` must outlive the table. Returns false if the table does not fit the
+// compile-time limits above.
+bool command_table_init(const command_def_t *defs, size_t count);
+
+json_read_error_t command_table_parse(char *line, size_t len, command_line_t *out, size_t *error_offset);
+
+// Resolves the command, checks its argument schema and runs its handler.
+// `req` is filled in as far as possible so callers can reply on failure.
+command_result_t command_table_dispatch(const command_line_t *line, command_request_t *req);
+
+const command_def_t *command_table_lookup(const char *name, size_t len);
+// The registered commands in registration order; NULL past the end.
+size_t command_table_count(void);
+const command_def_t *command_table_at(size_t i);
+const command_stats_t *command_table_stats(const char *name);
+// Records that a reply to `name` took `bytes`; unknown names are ignored.
+void command_table_note_reply(const char *name, size_t bytes);
+uint32_t command_table_unknown_count(void);
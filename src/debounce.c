@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+#include "debounce.h"
+
+#include <string.h>
+
+void debounce_init(debouncer_t *d, uint32_t settle_ms, debounce_mask_t levels) {
+    memset(d, 0, sizeof(*d));
+    d->settle_ms = settle_ms;
+    d->stable = levels;
+}
+
+uint64_t debounce_interrupts(debouncer_t *d, debounce_mask_t inputs, uint64_t now_us) {
+    d->interrupts += (uint32_t)__builtin_popcount(inputs & ~d->masked);
+    d->masked |= inputs;
+    if (inputs && d->deadline_us == 0) {
+        d->deadline_us = now_us + (uint64_t)d->settle_ms * 1000ULL;
+    }
+    return d->deadline_us;
+}
+
+debounce_mask_t debounce_settle(debouncer_t *d, debounce_mask_t levels, uint64_t now_us, debounce_mask_t *unmask) {
+    *unmask = 0;
+    if (d->deadline_us == 0 || now_us < d->deadline_us) {
+        return 0;
+    }
+    const debounce_mask_t changed = levels ^ d->stable;
+    d->stable = levels;
+    *unmask = d->masked;
+    d->masked = 0;
+    d->deadline_us = 0;
+    ++d->windows;
+    if (changed) {
+        ++d->changes;
+    }
+    return changed;
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdint.h>
+
+// Debounces up to 32 digital inputs, a bit each. The first interrupt on an
+// input masks that interrupt and opens a settle window unless one is already
+// open; interrupts on other inputs fold into the same window. When it closes
+// the inputs are sampled once, their interrupts unmasked, and every input
+// whose level differs from the last debounced one is reported in a single
+// change mask. Nothing runs while the inputs are stable. Free of ESP-IDF
+// dependencies; the caller owns locking.
+typedef uint32_t debounce_mask_t;
+
+typedef struct {
+    uint32_t settle_ms;
+    debounce_mask_t stable;
+    // Inputs whose interrupt stays masked until the window closes.
+    debounce_mask_t masked;
+    // When the open window closes, or 0.
+    uint64_t deadline_us;
+    uint32_t interrupts;
+    uint32_t windows;
+    uint32_t changes;
+} debouncer_t;
+
+void debounce_init(debouncer_t *d, uint32_t settle_ms, debounce_mask_t levels);
+
+// Records interrupts taken on `inputs`, which the ISR has masked. Returns the
+// deadline of the window they fall into.
+uint64_t debounce_interrupts(debouncer_t *d, debounce_mask_t inputs, uint64_t now_us);
+
+// Closes the window if it is due, given the current raw `levels`: sets
+// `unmask` to the inputs whose interrupt may be re-enabled and returns the
+// inputs whose debounced level changed.
+debounce_mask_t debounce_settle(debouncer_t *d, debounce_mask_t levels, uint64_t now_us, debounce_mask_t *unmask);
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+#include "fuel_gauge.h"
+
+#include <string.h>
+
+#define MAMS_PER_MAH 3600000LL
+#define MS_PER_MIN 60000LL
+
+bool fuel_gauge_init(fuel_gauge_t *g, const fuel_gauge_config_t *cfg) {
+    if (cfg->capacity_mah == 0 || !cfg->ocv || cfg->ocv_count == 0 || cfg->ocv_shift >= 16 ||
+        cfg->rate_shift >= 16) {
+        return false;
+    }
+    memset(g, 0, sizeof(*g));
+    g->cfg = *cfg;
+    g->capacity_mams = (int64_t)cfg->capacity_mah * MAMS_PER_MAH;
+    return true;
+}
+
+static int64_t clamp_charge(const fuel_gauge_t *g, int64_t charge) {
+    return charge < 0 ? 0 : charge > g->capacity_mams ? g->capacity_mams : charge;
+}
+
+void fuel_gauge_restore(fuel_gauge_t *g, int64_t charge_mams) {
+    g->charge_mams = clamp_charge(g, charge_mams);
+    g->seeded = true;
+}
+
+int32_t fuel_gauge_ocv_permille(const fuel_gauge_config_t *cfg, int32_t ocv_mv) {
+    const fuel_gauge_ocv_point_t *t = cfg->ocv;
+    if (ocv_mv <= t[0].mv) {
+        return t[0].permille;
+    }
+    for (size_t i = 1; i < cfg->ocv_count; ++i) {
+        if (ocv_mv < t[i].mv) {
+            return t[i - 1].permille +
+                   (t[i].permille - t[i - 1].permille) * (ocv_mv - t[i - 1].mv) / (t[i].mv - t[i - 1].mv);
+        }
+    }
+    return t[cfg->ocv_count - 1].permille;
+}
+
+// Charge implied by the voltage the pack would show with no current flowing.
+static int64_t ocv_charge(const fuel_gauge_t *g, int32_t pack_mv, int32_t pack_ma) {
+    const int32_t ocv_mv = pack_mv - (int32_t)((int64_t)pack_ma * g->cfg.r_internal_mohm / 1000);
+    return g->capacity_mams * fuel_gauge_ocv_permille(&g->cfg, ocv_mv) / 1000;
+}
+
+void fuel_gauge_update(fuel_gauge_t *g, int32_t pack_mv, int32_t pack_ma, uint64_t now_us) {
+    ++g->updates;
+    if (!g->seeded) {
+        g->charge_mams = ocv_charge(g, pack_mv, pack_ma);
+        g->seeded = true;
+    }
+    if (!g->primed) {
+        g->primed = true;
+        g->last_us = now_us;
+        g->last_ma = pack_ma;
+        g->rate_ma_q8 = pack_ma * 256;
+        return;
+    }
+
+    // Whole milliseconds only; the remainder carries into the next update.
+    const int64_t dt_ms = now_us > g->last_us ? (int64_t)((now_us - g->last_us) / 1000) : 0;
+    g->last_us += (uint64_t)dt_ms * 1000;
+    g->charge_mams = clamp_charge(g, g->charge_mams + ((int64_t)g->last_ma + pack_ma) * dt_ms / 2);
+    g->last_ma = pack_ma;
+    g->rate_ma_q8 += (pack_ma * 256 - g->rate_ma_q8) / (1 << g->cfg.rate_shift);
+
+    const bool resting = pack_ma <= g->cfg.rest_ma && pack_ma >= -g->cfg.rest_ma;
+    if (resting && !g->resting) {
+        g->rest_since_us = now_us;
+    }
+    g->resting = resting;
+    if (resting && now_us - g->rest_since_us >= (uint64_t)g->cfg.rest_ms * 1000ULL) {
+        const int64_t target = ocv_charge(g, pack_mv, pack_ma);
+        g->charge_mams = clamp_charge(g, g->charge_mams + (target - g->charge_mams) / (1 << g->cfg.ocv_shift));
+        ++g->ocv_updates;
+    }
+}
+
+int32_t fuel_gauge_permille(const fuel_gauge_t *g) {
+    return (int32_t)(g->charge_mams * 1000 / g->capacity_mams);
+}
+
+int fuel_gauge_pct(const fuel_gauge_t *g) {
+    return (int)((g->charge_mams * 100 + g->capacity_mams / 2) / g->capacity_mams);
+}
+
+static int32_t minutes_at_rate(int64_t charge_mams, int32_t rate_ma_q8) {
+    const int64_t minutes = charge_mams * 256 / rate_ma_q8 / MS_PER_MIN;
+    return minutes > INT32_MAX ? INT32_MAX : (int32_t)minutes;
+}
+
+int32_t fuel_gauge_time_to_empty_min(const fuel_gauge_t *g) {
+    if (!g->seeded || g->rate_ma_q8 >= -g->cfg.rest_ma * 256) {
+        return -1;
+    }
+    return minutes_at_rate(g->charge_mams, -g->rate_ma_q8);
+}
+
+int32_t fuel_gauge_time_to_full_min(const fuel_gauge_t *g) {
+    if (!g->seeded || g->rate_ma_q8 <= g->cfg.rest_ma * 256) {
+        return -1;
+    }
+    return minutes_at_rate(g->capacity_mams - g->charge_mams, g->rate_ma_q8);
+}
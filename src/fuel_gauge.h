@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// State-of-charge estimator for the pack. Charge is counted by integrating
+// pack current between updates and, once the pack has rested (current within
+// `rest_ma`) for `rest_ms`, is pulled towards the charge its open-circuit
+// voltage implies. The first update without a restored estimate seeds the
+// charge from the voltage, corrected for the internal resistance. All
+// integer; free of ESP-IDF dependencies.
+typedef struct {
+    int32_t mv;
+    int32_t permille;
+} fuel_gauge_ocv_point_t;
+
+typedef struct {
+    uint32_t capacity_mah;
+    uint32_t r_internal_mohm;
+    int32_t rest_ma;
+    uint32_t rest_ms;
+    // While rested, each update moves the charge 1/2^ocv_shift of the way to
+    // the open-circuit estimate.
+    uint8_t ocv_shift;
+    // Time estimates use current averaged over about 2^rate_shift updates.
+    uint8_t rate_shift;
+    // Pack voltage against charge at rest, by ascending voltage.
+    const fuel_gauge_ocv_point_t *ocv;
+    size_t ocv_count;
+} fuel_gauge_config_t;
+
+typedef struct {
+    fuel_gauge_config_t cfg;
+    int64_t capacity_mams;
+    // Remaining charge in mA*ms, within [0, capacity_mams] once seeded.
+    int64_t charge_mams;
+    bool seeded;
+    bool primed;
+    uint64_t last_us;
+    int32_t last_ma;
+    int32_t rate_ma_q8;
+    bool resting;
+    uint64_t rest_since_us;
+    uint32_t updates;
+    uint32_t ocv_updates;
+} fuel_gauge_t;
+
+// Fails on a zero capacity, an empty table or a shift of 16 or more.
+bool fuel_gauge_init(fuel_gauge_t *g, const fuel_gauge_config_t *cfg);
+
+// Continues from a charge saved before a reset instead of seeding from the
+// first voltage.
+void fuel_gauge_restore(fuel_gauge_t *g, int64_t charge_mams);
+
+void fuel_gauge_update(fuel_gauge_t *g, int32_t pack_mv, int32_t pack_ma, uint64_t now_us);
+
+// Charge implied by an open-circuit voltage, interpolated from the table.
+int32_t fuel_gauge_ocv_permille(const fuel_gauge_config_t *cfg, int32_t ocv_mv);
+
+int32_t fuel_gauge_permille(const fuel_gauge_t *g);
+// Rounded to whole percent.
+int fuel_gauge_pct(const fuel_gauge_t *g);
+
+// Minutes until empty while discharging, or until full while charging, at the
+// averaged current; -1 when the pack is not going that way or not seeded.
+int32_t fuel_gauge_time_to_empty_min(const fuel_gauge_t *g);
+int32_t fuel_gauge_time_to_full_min(const fuel_gauge_t *g);
+
+static inline bool fuel_gauge_ready(const fuel_gauge_t *g) {
+    return g->seeded;
+}
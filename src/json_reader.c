@@ -0,0 +1,464 @@
+// SPDX-License-Identifier: MIT
+#include "json_reader.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char *pos;
+    char *end;
+    json_read_error_t err;
+} reader_t;
+
+static bool fail(reader_t *r, json_read_error_t err) {
+    if (r->err == JSON_READ_OK) {
+        r->err = err;
+    }
+    return false;
+}
+
+static void skip_ws(reader_t *r) {
+    while (r->pos < r->end && (*r->pos == ' ' || *r->pos == '\t' || *r->pos == '\r' || *r->pos == '\n')) {
+        ++r->pos;
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool read_hex4(reader_t *r, uint32_t *out) {
+    if (r->end - r->pos < 4) {
+        return fail(r, JSON_READ_BAD_ESCAPE);
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        const int h = hex_value(r->pos[i]);
+        if (h < 0) {
+            return fail(r, JSON_READ_BAD_ESCAPE);
+        }
+        v = (v << 4) | (uint32_t)h;
+    }
+    r->pos += 4;
+    *out = v;
+    return true;
+}
+
+static char *put_utf8(char *dst, uint32_t cp) {
+    if (cp < 0x80) {
+        *dst++ = (char)cp;
+    } else if (cp < 0x800) {
+        *dst++ = (char)(0xC0 | (cp >> 6));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *dst++ = (char)(0xE0 | (cp >> 12));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *dst++ = (char)(0xF0 | (cp >> 18));
+        *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
+
+// Expects r->pos at the opening quote. With `decode` set the unescaped bytes
+// are written back over the source and NUL-terminated; the decoded form is
+// never longer than the escaped one, so this cannot overrun.
+static bool read_string(reader_t *r, bool decode, json_value_t *out) {
+    ++r->pos;
+    char *const start = r->pos;
+    char *dst = start;
+    while (r->pos < r->end) {
+        const char c = *r->pos;
+        if (c == '"') {
+            if (out) {
+                out->type = JSON_TYPE_STRING;
+                out->ptr = start;
+                out->len = decode ? (size_t)(dst - start) : (size_t)(r->pos - start);
+            }
+            if (decode) {
+                *dst = '\0';
+            }
+            ++r->pos;
+            return true;
+        }
+        if ((unsigned char)c < 0x20) {
+            return fail(r, JSON_READ_BAD_STRING);
+        }
+        if (c != '\\') {
+            if (decode) {
+                *dst++ = c;
+            }
+            ++r->pos;
+            continue;
+        }
+        if (++r->pos >= r->end) {
+            break;
+        }
+        const char esc = *r->pos++;
+        char plain;
+        switch (esc) {
+            case '"': plain = '"'; break;
+            case '\\': plain = '\\'; break;
+            case '/': plain = '/'; break;
+            case 'b': plain = '\b'; break;
+            case 'f': plain = '\f'; break;
+            case 'n': plain = '\n'; break;
+            case 'r': plain = '\r'; break;
+            case 't': plain = '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!read_hex4(r, &cp)) {
+                    return false;
+                }
+                if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return fail(r, JSON_READ_BAD_ESCAPE);
+                }
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t lo;
+                    if (r->end - r->pos < 2 || r->pos[0] != '\\' || r->pos[1] != 'u') {
+                        return fail(r, JSON_READ_BAD_ESCAPE);
+                    }
+                    r->pos += 2;
+                    if (!read_hex4(r, &lo)) {
+                        return false;
+                    }
+                    if (lo < 0xDC00 || lo > 0xDFFF) {
+                        return fail(r, JSON_READ_BAD_ESCAPE);
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                if (decode) {
+                    dst = put_utf8(dst, cp);
+                }
+                continue;
+            }
+            default:
+                --r->pos;
+                return fail(r, JSON_READ_BAD_ESCAPE);
+        }
+        if (decode) {
+            *dst++ = plain;
+        }
+    }
+    return fail(r, JSON_READ_BAD_STRING);
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool read_digits(reader_t *r) {
+    if (r->pos >= r->end || !is_digit(*r->pos)) {
+        return fail(r, JSON_READ_BAD_NUMBER);
+    }
+    while (r->pos < r->end && is_digit(*r->pos)) {
+        ++r->pos;
+    }
+    return true;
+}
+
+static bool read_number(reader_t *r, json_value_t *out) {
+    char *const start = r->pos;
+    if (*r->pos == '-') {
+        ++r->pos;
+    }
+    if (r->pos < r->end && *r->pos == '0') {
+        ++r->pos;
+    } else if (!read_digits(r)) {
+        return false;
+    }
+    if (r->pos < r->end && *r->pos == '.') {
+        ++r->pos;
+        if (!read_digits(r)) {
+            return false;
+        }
+    }
+    if (r->pos < r->end && (*r->pos == 'e' || *r->pos == 'E')) {
+        ++r->pos;
+        if (r->pos < r->end && (*r->pos == '+' || *r->pos == '-')) {
+            ++r->pos;
+        }
+        if (!read_digits(r)) {
+            return false;
+        }
+    }
+    if (out) {
+        out->type = JSON_TYPE_NUMBER;
+        out->ptr = start;
+        out->len = (size_t)(r->pos - start);
+    }
+    return true;
+}
+
+static bool read_literal(reader_t *r, const char *word, json_type_t type, json_value_t *out) {
+    const size_t n = strlen(word);
+    if ((size_t)(r->end - r->pos) < n || memcmp(r->pos, word, n) != 0) {
+        return fail(r, JSON_READ_BAD_LITERAL);
+    }
+    if (out) {
+        out->type = type;
+        out->ptr = r->pos;
+        out->len = n;
+    }
+    r->pos += n;
+    return true;
+}
+
+static bool read_value(reader_t *r, json_value_t *out, int depth);
+
+// Validates a nested object or array without modifying it.
+static bool read_container(reader_t *r, json_value_t *out, int depth) {
+    if (depth >= JSON_READ_MAX_DEPTH) {
+        return fail(r, JSON_READ_TOO_DEEP);
+    }
+    char *const start = r->pos;
+    const bool is_object = *r->pos == '{';
+    const char close = is_object ? '}' : ']';
+    ++r->pos;
+    skip_ws(r);
+    if (r->pos < r->end && *r->pos == close) {
+        ++r->pos;
+    } else {
+        while (true) {
+            skip_ws(r);
+            if (is_object) {
+                if (r->pos >= r->end || *r->pos != '"') {
+                    return fail(r, JSON_READ_EXPECTED_KEY);
+                }
+                if (!read_string(r, false, NULL)) {
+                    return false;
+                }
+                skip_ws(r);
+                if (r->pos >= r->end || *r->pos != ':') {
+                    return fail(r, JSON_READ_EXPECTED_COLON);
+                }
+                ++r->pos;
+            }
+            if (!read_value(r, NULL, depth + 1)) {
+                return false;
+            }
+            skip_ws(r);
+            if (r->pos < r->end && *r->pos == ',') {
+                ++r->pos;
+                continue;
+            }
+            if (r->pos < r->end && *r->pos == close) {
+                ++r->pos;
+                break;
+            }
+            return fail(r, JSON_READ_EXPECTED_COMMA);
+        }
+    }
+    if (out) {
+        out->type = is_object ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY;
+        out->ptr = start;
+        out->len = (size_t)(r->pos - start);
+    }
+    return true;
+}
+
+static bool read_value(reader_t *r, json_value_t *out, int depth) {
+    skip_ws(r);
+    if (r->pos >= r->end) {
+        return fail(r, JSON_READ_EXPECTED_VALUE);
+    }
+    switch (*r->pos) {
+        case '"': return read_string(r, out != NULL, out);
+        case '{':
+        case '[': return read_container(r, out, depth);
+        case 't': return read_literal(r, "true", JSON_TYPE_BOOL, out);
+        case 'f': return read_literal(r, "false", JSON_TYPE_BOOL, out);
+        case 'n': return read_literal(r, "null", JSON_TYPE_NULL, out);
+        default:
+            if (*r->pos == '-' || is_digit(*r->pos)) {
+                return read_number(r, out);
+            }
+            return fail(r, JSON_READ_EXPECTED_VALUE);
+    }
+}
+
+static json_value_t *find_field(const json_field_t *fields, size_t field_count, const json_value_t *key) {
+    for (size_t i = 0; i < field_count; ++i) {
+        if (strlen(fields[i].key) == key->len && memcmp(fields[i].key, key->ptr, key->len) == 0) {
+            return fields[i].out;
+        }
+    }
+    return NULL;
+}
+
+static bool read_members(reader_t *r, const json_field_t *fields, size_t field_count) {
+    ++r->pos;
+    skip_ws(r);
+    if (r->pos < r->end && *r->pos == '}') {
+        ++r->pos;
+        return true;
+    }
+    while (true) {
+        skip_ws(r);
+        if (r->pos >= r->end || *r->pos != '"') {
+            return fail(r, JSON_READ_EXPECTED_KEY);
+        }
+        json_value_t key;
+        if (!read_string(r, true, &key)) {
+            return false;
+        }
+        skip_ws(r);
+        if (r->pos >= r->end || *r->pos != ':') {
+            return fail(r, JSON_READ_EXPECTED_COLON);
+        }
+        ++r->pos;
+        json_value_t *slot = find_field(fields, field_count, &key);
+        if (slot && slot->type != JSON_TYPE_NONE) {
+            slot = NULL;
+        }
+        if (!read_value(r, slot, 1)) {
+            return false;
+        }
+        skip_ws(r);
+        if (r->pos < r->end && *r->pos == ',') {
+            ++r->pos;
+            continue;
+        }
+        if (r->pos < r->end && *r->pos == '}') {
+            ++r->pos;
+            return true;
+        }
+        return fail(r, JSON_READ_EXPECTED_COMMA);
+    }
+}
+
+json_read_error_t json_read_object(char *text, size_t len, const json_field_t *fields, size_t field_count,
+                                   size_t *error_offset) {
+    for (size_t i = 0; i < field_count; ++i) {
+        *fields[i].out = (json_value_t){0};
+    }
+    reader_t r = {.pos = text, .end = text + len, .err = JSON_READ_OK};
+    skip_ws(&r);
+    if (r.pos >= r.end) {
+        r.err = JSON_READ_EMPTY;
+    } else if (*r.pos != '{') {
+        r.err = JSON_READ_NOT_OBJECT;
+    } else if (read_members(&r, fields, field_count)) {
+        skip_ws(&r);
+        if (r.pos < r.end) {
+            r.err = JSON_READ_TRAILING_DATA;
+        }
+    }
+    if (error_offset) {
+        *error_offset = r.err == JSON_READ_OK ? 0 : (size_t)(r.pos - text);
+    }
+    return r.err;
+}
+
+json_read_error_t json_read_array(char *text, size_t len, json_value_t *out, size_t *error_offset) {
+    *out = (json_value_t){0};
+    reader_t r = {.pos = text, .end = text + len, .err = JSON_READ_OK};
+    skip_ws(&r);
+    if (r.pos >= r.end) {
+        r.err = JSON_READ_EMPTY;
+    } else if (*r.pos != '[') {
+        r.err = JSON_READ_NOT_OBJECT;
+    } else if (read_container(&r, out, 0)) {
+        skip_ws(&r);
+        if (r.pos < r.end) {
+            r.err = JSON_READ_TRAILING_DATA;
+        }
+    }
+    if (error_offset) {
+        *error_offset = r.err == JSON_READ_OK ? 0 : (size_t)(r.pos - text);
+    }
+    return r.err;
+}
+
+void json_array_iter_init(json_array_iter_t *it, const json_value_t *array) {
+    if (!array || array->type != JSON_TYPE_ARRAY || array->len < 2) {
+        it->pos = it->end = NULL;
+        return;
+    }
+    it->pos = array->ptr + 1;
+    it->end = array->ptr + array->len - 1;
+}
+
+bool json_array_next(json_array_iter_t *it, json_value_t *out) {
+    reader_t r = {.pos = it->pos, .end = it->end, .err = JSON_READ_OK};
+    skip_ws(&r);
+    if (r.pos < r.end && *r.pos == ',') {
+        ++r.pos;
+    }
+    skip_ws(&r);
+    if (r.pos >= r.end || !read_value(&r, out, 1)) {
+        it->pos = it->end;
+        return false;
+    }
+    it->pos = r.pos;
+    return true;
+}
+
+bool json_value_to_u32(const json_value_t *v, uint32_t *out) {
+    if (!v || v->type != JSON_TYPE_NUMBER || v->len == 0) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < v->len; ++i) {
+        if (!is_digit(v->ptr[i])) {
+            return false;
+        }
+        value = value * 10 + (uint64_t)(v->ptr[i] - '0');
+        if (value > UINT32_MAX) {
+            return false;
+        }
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+bool json_value_to_float(const json_value_t *v, float *out) {
+    // Number slices are not NUL-terminated; anything longer than this is not
+    // a value worth keeping in a float anyway.
+    char text[32];
+    if (!v || v->type != JSON_TYPE_NUMBER || v->len == 0 || v->len >= sizeof(text)) {
+        return false;
+    }
+    memcpy(text, v->ptr, v->len);
+    text[v->len] = '\0';
+    char *end;
+    const float value = strtof(text, &end);
+    if (end != text + v->len || !isfinite(value)) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+const char *json_read_error_name(json_read_error_t err) {
+    switch (err) {
+        case JSON_READ_OK: return "ok";
+        case JSON_READ_EMPTY: return "empty";
+        case JSON_READ_NOT_OBJECT: return "not_object";
+        case JSON_READ_EXPECTED_KEY: return "expected_key";
+        case JSON_READ_EXPECTED_COLON: return "expected_colon";
+        case JSON_READ_EXPECTED_VALUE: return "expected_value";
+        case JSON_READ_EXPECTED_COMMA: return "expected_comma";
+        case JSON_READ_BAD_STRING: return "bad_string";
+        case JSON_READ_BAD_ESCAPE: return "bad_escape";
+        case JSON_READ_BAD_NUMBER: return "bad_number";
+        case JSON_READ_BAD_LITERAL: return "bad_literal";
+        case JSON_READ_TOO_DEEP: return "too_deep";
+        case JSON_READ_TRAILING_DATA: return "trailing_data";
+    }
+    return "unknown";
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// In-place JSON object reader for received lines. Scans the buffer once,
+// captures the values of caller-listed keys as slices into that buffer and
+// validates-and-skips everything else. Never allocates.
+#define JSON_READ_MAX_DEPTH 16
+
+typedef enum {
+    JSON_TYPE_NONE = 0,
+    JSON_TYPE_STRING,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NULL,
+    JSON_TYPE_OBJECT,
+    JSON_TYPE_ARRAY,
+} json_type_t;
+
+// For strings `ptr` is the unescaped, NUL-terminated contents (decoded in
+// place). For every other type it is the raw, unmodified source text.
+typedef struct {
+    json_type_t type;
+    char *ptr;
+    size_t len;
+} json_value_t;
+
+typedef enum {
+    JSON_READ_OK = 0,
+    JSON_READ_EMPTY,
+    JSON_READ_NOT_OBJECT,
+    JSON_READ_EXPECTED_KEY,
+    JSON_READ_EXPECTED_COLON,
+    JSON_READ_EXPECTED_VALUE,
+    JSON_READ_EXPECTED_COMMA,
+    JSON_READ_BAD_STRING,
+    JSON_READ_BAD_ESCAPE,
+    JSON_READ_BAD_NUMBER,
+    JSON_READ_BAD_LITERAL,
+    JSON_READ_TOO_DEEP,
+    JSON_READ_TRAILING_DATA,
+} json_read_error_t;
+
+typedef struct {
+    const char *key;
+    json_value_t *out;
+} json_field_t;
+
+// Parses the object spanning text[0..len). Each `fields[i].out` is reset and
+// then filled with the first occurrence of its key. On failure `error_offset`
+// (if non-NULL) receives the byte offset where parsing stopped.
+json_read_error_t json_read_object(char *text, size_t len, const json_field_t *fields, size_t field_count,
+                                   size_t *error_offset);
+
+// Validates that text[0..len) is a single array and returns its slice in
+// `out`, for walking with json_array_next. JSON_READ_NOT_OBJECT means it was
+// not an array.
+json_read_error_t json_read_array(char *text, size_t len, json_value_t *out, size_t *error_offset);
+
+const char *json_read_error_name(json_read_error_t err);
+
+// Walks the elements of an array captured by json_read_object. String
+// elements are decoded in place like captured strings, so an array can only
+// be walked once.
+typedef struct {
+    char *pos;
+    char *end;
+} json_array_iter_t;
+
+void json_array_iter_init(json_array_iter_t *it, const json_value_t *array);
+// Returns false after the last element, or if `array` was not an array.
+bool json_array_next(json_array_iter_t *it, json_value_t *out);
+
+// Converts a number that is a plain non-negative integer (no fraction or
+// exponent) fitting in 32 bits.
+bool json_value_to_u32(const json_value_t *v, uint32_t *out);
+// Converts any number; fails if it does not fit a finite float.
+bool json_value_to_float(const json_value_t *v, float *out);
+
+static inline bool json_value_is_string(const json_value_t *v) {
+    return v && v->type == JSON_TYPE_STRING;
+}
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: MIT
+#include "json_writer.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void put_bytes(json_writer_t *w, const char *data, size_t n) {
+    if (w->overflow) {
+        return;
+    }
+    // Always keep one byte spare for the terminating NUL.
+    if (n >= w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_char(json_writer_t *w, char c) {
+    put_bytes(w, &c, 1);
+}
+
+static void begin_value(json_writer_t *w) {
+    if (w->need_comma) {
+        put_char(w, ',');
+    }
+    w->need_comma = true;
+}
+
+static void put_escaped(json_writer_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s; ++s) {
+        const unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put_bytes(w, run, (size_t)(s - run));
+        run = s + 1;
+        char esc[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t esc_len = 2;
+        switch (c) {
+            case '"': esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = hex[c >> 4];
+                esc[5] = hex[c & 0x0f];
+                esc_len = 6;
+                break;
+        }
+        put_bytes(w, esc, esc_len);
+    }
+    put_bytes(w, run, (size_t)(s - run));
+    put_char(w, '"');
+}
+
+static const char k_digit_pairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                                   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                                   "8081828384858687888990919293949596979899";
+
+static const uint32_t k_pow10[] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u,
+};
+
+// Writes `value` ending just before `end`, two digits per divide, and returns
+// where it starts. At least `min_digits` digits are written, zero padded.
+static char *format_uint32(char *end, uint32_t value, unsigned min_digits) {
+    char *p = end;
+    while (value >= 100) {
+        const uint32_t pair = value % 100;
+        value /= 100;
+        p -= 2;
+        memcpy(p, &k_digit_pairs[pair * 2], 2);
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, &k_digit_pairs[value * 2], 2);
+    } else {
+        *--p = (char)('0' + value);
+    }
+    while ((unsigned)(end - p) < min_digits) {
+        *--p = '0';
+    }
+    return p;
+}
+
+static void put_uint32(json_writer_t *w, uint32_t value) {
+    char tmp[10];
+    const char *start = format_uint32(tmp + sizeof(tmp), value, 1);
+    put_bytes(w, start, (size_t)(tmp + sizeof(tmp) - start));
+}
+
+// The ESP32 has no 64-bit divide, so split into 32-bit chunks of nine digits
+// and leave the values that fit 32 bits to put_uint32.
+static void put_uint64(json_writer_t *w, uint64_t value) {
+    if (value <= UINT32_MAX) {
+        put_uint32(w, (uint32_t)value);
+        return;
+    }
+    char tmp[20];
+    char *end = tmp + sizeof(tmp);
+    char *p = format_uint32(end, (uint32_t)(value % 1000000000u), 9);
+    value /= 1000000000u;
+    if (value > UINT32_MAX) {
+        p = format_uint32(p, (uint32_t)(value % 1000000000u), 9);
+        value /= 1000000000u;
+    }
+    p = format_uint32(p, (uint32_t)value, 1);
+    put_bytes(w, p, (size_t)(end - p));
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = cap == 0;
+    if (cap) {
+        buf[0] = '\0';
+    }
+}
+
+void json_writer_begin_object(json_writer_t *w) {
+    begin_value(w);
+    put_char(w, '{');
+    w->need_comma = false;
+}
+
+void json_writer_end_object(json_writer_t *w) {
+    put_char(w, '}');
+    w->need_comma = true;
+}
+
+void json_writer_begin_array(json_writer_t *w) {
+    begin_value(w);
+    put_char(w, '[');
+    w->need_comma = false;
+}
+
+void json_writer_end_array(json_writer_t *w) {
+    put_char(w, ']');
+    w->need_comma = true;
+}
+
+void json_writer_key(json_writer_t *w, const char *key) {
+    begin_value(w);
+    put_escaped(w, key);
+    put_char(w, ':');
+    w->need_comma = false;
+}
+
+void json_writer_string(json_writer_t *w, const char *value) {
+    begin_value(w);
+    if (!value) {
+        put_bytes(w, "null", 4);
+        return;
+    }
+    put_escaped(w, value);
+}
+
+void json_writer_bool(json_writer_t *w, bool value) {
+    begin_value(w);
+    if (value) {
+        put_bytes(w, "true", 4);
+    } else {
+        put_bytes(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w) {
+    begin_value(w);
+    put_bytes(w, "null", 4);
+}
+
+void json_writer_int(json_writer_t *w, int value) {
+    begin_value(w);
+    if (value < 0) {
+        put_char(w, '-');
+        put_uint32(w, 0u - (uint32_t)value);
+    } else {
+        put_uint32(w, (uint32_t)value);
+    }
+}
+
+void json_writer_uint64(json_writer_t *w, uint64_t value) {
+    begin_value(w);
+    put_uint64(w, value);
+}
+
+// Mirrors cJSON's print_number: integral values that fit an int print as %d,
+// everything else as the shortest of %1.15g / %1.17g that round-trips.
+void json_writer_number(json_writer_t *w, double value) {
+    begin_value(w);
+    if (isnan(value) || isinf(value)) {
+        put_bytes(w, "null", 4);
+        return;
+    }
+    int as_int;
+    if (value >= INT_MAX) {
+        as_int = INT_MAX;
+    } else if (value <= (double)INT_MIN) {
+        as_int = INT_MIN;
+    } else {
+        as_int = (int)value;
+    }
+    char tmp[26];
+    int n;
+    if (value == (double)as_int) {
+        n = snprintf(tmp, sizeof(tmp), "%d", as_int);
+    } else {
+        n = snprintf(tmp, sizeof(tmp), "%1.15g", value);
+        const double test = strtod(tmp, NULL);
+        const double max_abs = fabs(test) > fabs(value) ? fabs(test) : fabs(value);
+        if (!(fabs(test - value) <= max_abs * DBL_EPSILON)) {
+            n = snprintf(tmp, sizeof(tmp), "%1.17g", value);
+        }
+    }
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        w->overflow = true;
+        return;
+    }
+    put_bytes(w, tmp, (size_t)n);
+}
+
+// Prints `value` / 10^decimals as %g would print that decimal: trailing zeros
+// and a bare point dropped, and never "-0".
+void json_writer_fixed(json_writer_t *w, int32_t value, unsigned decimals) {
+    begin_value(w);
+    if (decimals > JSON_WRITER_MAX_DECIMALS) {
+        decimals = JSON_WRITER_MAX_DECIMALS;
+    }
+    const uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    const uint32_t whole = mag / k_pow10[decimals];
+    uint32_t frac = mag % k_pow10[decimals];
+    while (decimals && frac % 10 == 0) {
+        frac /= 10;
+        --decimals;
+    }
+    char tmp[22];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+    if (decimals) {
+        p = format_uint32(p, frac, decimals);
+        *--p = '.';
+    }
+    p = format_uint32(p, whole, 1);
+    if (value < 0 && (whole || decimals)) {
+        *--p = '-';
+    }
+    put_bytes(w, p, (size_t)(end - p));
+}
+
+void json_writer_float(json_writer_t *w, float value, unsigned decimals) {
+    if (decimals > JSON_WRITER_MAX_DECIMALS) {
+        decimals = JSON_WRITER_MAX_DECIMALS;
+    }
+    if (isnan(value) || isinf(value)) {
+        json_writer_null(w);
+        return;
+    }
+    const float scaled = value * (float)k_pow10[decimals];
+    // The largest float below 2^31, so the rounded value always fits.
+    if (!(scaled > -2147483520.0f && scaled < 2147483520.0f)) {
+        json_writer_number(w, value);
+        return;
+    }
+    json_writer_fixed(w, (int32_t)roundf(scaled), decimals);
+}
+
+void json_writer_add_string(json_writer_t *w, const char *key, const char *value) {
+    json_writer_key(w, key);
+    json_writer_string(w, value);
+}
+
+void json_writer_add_bool(json_writer_t *w, const char *key, bool value) {
+    json_writer_key(w, key);
+    json_writer_bool(w, value);
+}
+
+void json_writer_add_null(json_writer_t *w, const char *key) {
+    json_writer_key(w, key);
+    json_writer_null(w);
+}
+
+void json_writer_add_int(json_writer_t *w, const char *key, int value) {
+    json_writer_key(w, key);
+    json_writer_int(w, value);
+}
+
+void json_writer_add_uint64(json_writer_t *w, const char *key, uint64_t value) {
+    json_writer_key(w, key);
+    json_writer_uint64(w, value);
+}
+
+void json_writer_add_number(json_writer_t *w, const char *key, double value) {
+    json_writer_key(w, key);
+    json_writer_number(w, value);
+}
+
+void json_writer_add_fixed(json_writer_t *w, const char *key, int32_t value, unsigned decimals) {
+    json_writer_key(w, key);
+    json_writer_fixed(w, value, decimals);
+}
+
+void json_writer_add_float(json_writer_t *w, const char *key, float value, unsigned decimals) {
+    json_writer_key(w, key);
+    json_writer_float(w, value, decimals);
+}
+
+size_t json_writer_end_line(json_writer_t *w) {
+    put_char(w, '\n');
+    if (w->overflow) {
+        if (w->cap) {
+            w->buf[0] = '\0';
+        }
+        return 0;
+    }
+    w->buf[w->len] = '\0';
+    return w->len;
+}
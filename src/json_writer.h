@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON writer over a caller-owned buffer. Never allocates; once the
+// buffer is exhausted the writer latches `overflow` and ignores further output.
+// Output is byte-identical to cJSON_PrintUnformatted for the same object.
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool need_comma;
+    bool overflow;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+void json_writer_begin_object(json_writer_t *w);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w);
+void json_writer_end_array(json_writer_t *w);
+void json_writer_key(json_writer_t *w, const char *key);
+
+void json_writer_string(json_writer_t *w, const char *value);
+void json_writer_bool(json_writer_t *w, bool value);
+void json_writer_null(json_writer_t *w);
+void json_writer_int(json_writer_t *w, int value);
+void json_writer_uint64(json_writer_t *w, uint64_t value);
+void json_writer_number(json_writer_t *w, double value);
+
+#define JSON_WRITER_MAX_DECIMALS 9
+
+// Fixed-point numbers, printed without floating point: json_writer_fixed
+// writes value / 10^decimals, json_writer_float rounds `value` to `decimals`
+// places first (NaN and infinities print as null). For magnitudes of 1e-4 and
+// up both match what json_writer_number prints for a double holding the same
+// decimal.
+// `decimals` is clamped to JSON_WRITER_MAX_DECIMALS.
+void json_writer_fixed(json_writer_t *w, int32_t value, unsigned decimals);
+void json_writer_float(json_writer_t *w, float value, unsigned decimals);
+
+void json_writer_add_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_add_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_add_null(json_writer_t *w, const char *key);
+void json_writer_add_int(json_writer_t *w, const char *key, int value);
+void json_writer_add_uint64(json_writer_t *w, const char *key, uint64_t value);
+void json_writer_add_number(json_writer_t *w, const char *key, double value);
+void json_writer_add_fixed(json_writer_t *w, const char *key, int32_t value, unsigned decimals);
+void json_writer_add_float(json_writer_t *w, const char *key, float value, unsigned decimals);
+
+// Appends the '\n' line terminator and NUL. Returns the line length including
+// the newline, or 0 if anything was truncated.
+size_t json_writer_end_line(json_writer_t *w);
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+#include "line_splitter.h"
+
+#include <string.h>
+
+void line_splitter_init(line_splitter_t *s, char *buf, size_t cap, line_handler_t on_line, void *ctx) {
+    s->buf = buf;
+    s->cap = cap;
+    s->len = 0;
+    s->discarding = false;
+    s->overflows = 0;
+    s->on_line = on_line;
+    s->ctx = ctx;
+}
+
+void line_splitter_reset(line_splitter_t *s) {
+    s->len = 0;
+    s->discarding = false;
+}
+
+static void emit(line_splitter_t *s, char *line, size_t len) {
+    if (len > 0 && line[len - 1] == '\r') {
+        --len;
+    }
+    line[len] = '\0';
+    if (len > 0) {
+        s->on_line(line, len, s->ctx);
+    }
+}
+
+static void append(line_splitter_t *s, const char *data, size_t len) {
+    if (s->discarding) {
+        return;
+    }
+    if (len >= s->cap - s->len) {
+        ++s->overflows;
+        s->discarding = true;
+        s->len = 0;
+        return;
+    }
+    memcpy(s->buf + s->len, data, len);
+    s->len += len;
+}
+
+void line_splitter_feed(line_splitter_t *s, char *data, size_t len) {
+    while (len > 0) {
+        char *nl = memchr(data, '\n', len);
+        if (!nl) {
+            append(s, data, len);
+            return;
+        }
+        const size_t seg = (size_t)(nl - data);
+        if (s->discarding) {
+            s->discarding = false;
+        } else if (s->len == 0) {
+            if (seg < s->cap) {
+                emit(s, data, seg);
+            } else {
+                ++s->overflows;
+            }
+        } else {
+            append(s, data, seg);
+            if (!s->discarding) {
+                emit(s, s->buf, s->len);
+            }
+            s->discarding = false;
+            s->len = 0;
+        }
+        data = nl + 1;
+        len -= seg + 1;
+    }
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Splits a received byte stream into '\n'-terminated lines. Chunks are
+// scanned with memchr; lines that arrive whole inside one chunk are handed
+// out in place, only fragments spanning chunk boundaries are copied.
+typedef void (*line_handler_t)(char *line, size_t len, void *ctx);
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool discarding;
+    uint32_t overflows;
+    line_handler_t on_line;
+    void *ctx;
+} line_splitter_t;
+
+// Lines longer than cap - 1 bytes are dropped whole and counted in
+// `overflows`. Handed-out lines are NUL-terminated, have any trailing '\r'
+// removed and are never empty.
+void line_splitter_init(line_splitter_t *s, char *buf, size_t cap, line_handler_t on_line, void *ctx);
+
+// `data` must be writable: terminators are replaced with NUL in place.
+void line_splitter_feed(line_splitter_t *s, char *data, size_t len);
+
+// Forgets any partially received line (e.g. after an RX FIFO overflow).
+void line_splitter_reset(line_splitter_t *s);
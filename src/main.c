@@ -1,102 +1,424 @@
 // SPDX-License-Identifier: MIT
-#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-#include "cJSON.h"
+#include "adc_filter.h"
+#include "binframe.h"
+#include "command_table.h"
+#include "debounce.h"
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_attr.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "fuel_gauge.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "line_splitter.h"
+#include "pending.h"
+#include "poweroff.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include "subscription.h"
+#include "supervisor_config.h"
+#include "supervisor_state.h"
+#include "telemetry.h"
+#include "timer_wheel.h"
+#include "tx_queue.h"
+#include "watch.h"
 
 #define SUPV_UART_PORT UART_NUM_1
 #define SUPV_UART_TXD GPIO_NUM_17
 #define SUPV_UART_RXD GPIO_NUM_16
 #define SUPV_UART_BAUD 115200
-#define SUPV_RX_BUF_SIZE 1024
-#define SUPV_LINE_BUF 512
+#define SUPV_TX_REPLY_WAIT_MS 100
+// How much of a line that fails to parse is logged.
+#define SUPV_PARSE_LOG_BYTES 96
 
-#define TELEMETRY_PERIOD_MS 2000
+#define TELEMETRY_PERIOD_MS 500
+#define TELEMETRY_KEYFRAME_MS 10000
+#define TELEMETRY_DEADBAND_PACK_MV 20
+#define TELEMETRY_DEADBAND_PACK_MA 50
+#define TELEMETRY_DEADBAND_TEMP_C 0.5f
+#define TELEMETRY_DEADBAND_RUNTIME_MIN 5
+
+// Fastest rate at which state is polled for subscribed topics.
+#define SUPV_EVENT_POLL_MIN_MS 100
+// How soon a watch alert the TX queue had no room for is tried again.
+#define SUPV_ALERT_RETRY_MS 10
+
+// Time to stop the chargers and let the rails settle before arm_poweroff is
+// answered, and how long the Pi is kept waiting at most.
+#define SUPV_POWEROFF_PREP_MS 250
+#define SUPV_POWEROFF_REPLY_TIMEOUT_MS 5000
+// After the reply: how long the Pi has to raise poweroff_ok, how long its
+// heartbeat must stay quiet before the rail is cut, and the cut-off for a halt
+// that never finishes.
+#define SUPV_POWEROFF_OK_TIMEOUT_MS 10000
+#define SUPV_POWEROFF_HEARTBEAT_LOSS_MS 3000
+#define SUPV_POWEROFF_HALT_TIMEOUT_MS 60000
+#define SUPV_POWEROFF_MIN_BATTERY_PCT 3
+
+// The Pi's power rail and the chargers are enabled high. The Pi raises
+// poweroff_ok once it is shutting down and toggles its heartbeat while it runs.
+#define SUPV_GPIO_PI_RAIL GPIO_NUM_25
+#define SUPV_GPIO_CHARGER_EN GPIO_NUM_26
+#define SUPV_GPIO_POWEROFF_OK GPIO_NUM_27
+#define SUPV_GPIO_HEARTBEAT GPIO_NUM_14
+
+// How long a switch input is left alone after its first edge before it is
+// read; bounces inside the window never reach the Pi.
+#define SUPV_SWITCH_SETTLE_MS 30
+
+// Pack voltage through a 100k/22k divider and pack current through a
+// bidirectional shunt amplifier (10 mOhm, gain 50, biased at 1650 mV), both
+// sampled continuously on ADC1 by DMA. The ISR wakes the loop once per
+// SUPV_ADC_FRAMES_PER_WAKE frames, about every 50 ms, and the filtered values
+// are published every SUPV_ADC_PUBLISH_MS.
+#define SUPV_ADC_PACK_MV_CHANNEL ADC_CHANNEL_6 // GPIO34
+#define SUPV_ADC_PACK_MA_CHANNEL ADC_CHANNEL_7 // GPIO35
+#define SUPV_ADC_ATTEN ADC_ATTEN_DB_12
+#define SUPV_ADC_SAMPLE_HZ 20000
+#define SUPV_ADC_FRAMES_PER_WAKE 8
+#define SUPV_ADC_OVERSAMPLE 32
+#define SUPV_ADC_IIR_SHIFT 4
+#define SUPV_ADC_PUBLISH_MS 200
+#define SUPV_PACK_DIVIDER_NUM 122
+#define SUPV_PACK_DIVIDER_DEN 22
+#define SUPV_PACK_SHUNT_REF_MV 1650
+#define SUPV_PACK_MA_PER_MV 2
+
+// The pack is 3S2P 18650 cells. Its charge is counted on every ADC wake
+// and, after ten minutes at rest, pulled towards k_pack_ocv with a time
+// constant of about a minute. Time estimates average the current over about
+// 13 s.
+#define SUPV_GAUGE_CAPACITY_MAH 5000
+#define SUPV_GAUGE_R_INTERNAL_MOHM 120
+#define SUPV_GAUGE_REST_MA 50
+#define SUPV_GAUGE_REST_MS 600000
+#define SUPV_GAUGE_OCV_SHIFT 10
+#define SUPV_GAUGE_RATE_SHIFT 8
+#define SUPV_GAUGE_SAVED_MAGIC 0x53544f43u
+
+_Static_assert(SUPV_ADC_POOL_BYTES >= 2 * SUPV_ADC_FRAMES_PER_WAKE * SUPV_ADC_FRAME_BYTES,
+               "the ADC pool must hold two wakes' worth of frames");
+
+_Static_assert(TX_FRAME_SIZE >= SUPV_LINE_BUF, "TX frames must hold a full line");
+_Static_assert(BINFRAME_MAX_PAYLOAD >= TX_FRAME_SIZE, "binary frames must hold a full TX frame");
+
+// loop_task sleeps in RTOS ticks until the wheel's next millisecond deadline.
+_Static_assert(configTICK_RATE_HZ >= 1000, "a coarser RTOS tick makes wheel timers late by up to a tick");
 
 static const char *TAG = "supervisor";
 
+// Switch inputs, active low against the internal pull-ups. Debounced as bit
+// `i` for entry `i`.
 typedef struct {
-    bool lte;
-    bool wifi;
-    bool bt;
-    bool bridge_enable;
-    bool lid_open;
-    bool charger_online;
-} supervisor_switch_state_t;
+    gpio_num_t gpio;
+    uint8_t bit;
+} switch_input_t;
 
-typedef struct {
-    int battery_pct;
-    int pack_mv;
-    int pack_ma;
-    float mcu_temp_c;
-    int unread_ext;
-    char heltec[16];
-    char mcu[16];
-    bool poweroff_armed;
-    uint64_t last_mesh_event_us;
-    supervisor_switch_state_t switches;
-} supervisor_state_t;
+static const switch_input_t k_switch_inputs[] = {
+    {GPIO_NUM_32, BINFRAME_SWITCH_LTE},
+    {GPIO_NUM_33, BINFRAME_SWITCH_WIFI},
+    {GPIO_NUM_18, BINFRAME_SWITCH_BT},
+    {GPIO_NUM_19, BINFRAME_SWITCH_BRIDGE_ENABLE},
+    {GPIO_NUM_21, BINFRAME_SWITCH_LID_OPEN},
+    {GPIO_NUM_22, BINFRAME_SWITCH_CHARGER_ONLINE},
+};
+#define SWITCH_INPUT_COUNT (sizeof(k_switch_inputs) / sizeof(k_switch_inputs[0]))
 
+// Pack open-circuit voltage against charge, from the cell datasheet curve.
+static const fuel_gauge_ocv_point_t k_pack_ocv[] = {
+    {9810, 0},    {10830, 50},  {11070, 100}, {11310, 200}, {11460, 300},  {11580, 400},
+    {11700, 500}, {11850, 600}, {12030, 700}, {12210, 800}, {12390, 900}, {12600, 1000},
+};
+
+// g_state is published through a seqlock: readers never block and retry if a
+// write overlapped their copy. Writers serialize on g_state_lock and run the
+// update inside a critical section, so a reader can never spin on a writer
+// preempted mid-update on its own core.
 static supervisor_state_t g_state;
-static SemaphoreHandle_t g_state_mutex;
+static seqlock_t g_state_seq;
+static portMUX_TYPE g_state_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t g_uart_queue;
+
+// Time each task has spent handling what woke it, summed by the core it is
+// pinned to, for get_stats; `last` is where the previous get_stats left off.
+typedef struct {
+    uint64_t busy_us;
+    uint32_t wakes;
+} core_load_t;
+
+static core_load_t g_core_load[portNUM_PROCESSORS];
+static core_load_t g_core_load_last[portNUM_PROCESSORS];
+static uint64_t g_core_load_last_us;
+static portMUX_TYPE g_load_lock = portMUX_INITIALIZER_UNLOCKED;
+// Most events ever found waiting in g_loop_queue, counting the one taken.
+static UBaseType_t g_loop_queue_peak;
+
+// Sources loop_task dispatches, each to its entry in k_loop_handlers. Only
+// poweroff events carry data; the others are wakeups, queued at most once at
+// a time.
+typedef enum {
+    // Lines are waiting in g_rx_ring.
+    LOOP_EVENT_RX,
+    // State or subscriptions changed: emit what is due.
+    LOOP_EVENT_STATE,
+    LOOP_EVENT_POWEROFF,
+    LOOP_EVENT_SWITCH,
+    LOOP_EVENT_ADC,
+    LOOP_EVENT_COUNT,
+} loop_event_type_t;
+
+typedef struct {
+    loop_event_type_t type;
+    poweroff_event_t poweroff;
+} loop_event_t;
+
+// Posts from interrupts and io_task reach loop_task through its queue, and
+// every deadline it keeps is a timer on its wheel, ticking in milliseconds.
+static uint8_t g_loop_queue_storage[SUPV_LOOP_QUEUE_LEN * sizeof(loop_event_t)];
+static StaticQueue_t g_loop_queue_buf;
+static QueueHandle_t g_loop_queue;
+// Bit per loop_event_type_t queued and not yet handled.
+static atomic_uint g_loop_posted;
+// Only touched by loop_task.
+static timer_wheel_t g_wheel;
+
+// Received lines, pushed by io_task and popped by loop_task. An empty record
+// stands for a break on the line; the splitter never hands out empty lines.
+static uint8_t g_rx_ring_buf[SUPV_RX_RING_BYTES];
+static spsc_ring_t g_rx_ring;
+// Where loop_task takes each line out to run it.
+static char g_rx_loop_line[SUPV_LINE_BUF];
+// Set by io_task while it waits for room in g_rx_ring; whoever clears it
+// or commits a frame meanwhile notifies g_io_task.
+static atomic_bool g_rx_ring_waiting;
+static TaskHandle_t g_io_task;
+// Lines io_task had to wait for ring room for, once per line; g_rx_ring.full
+// counts every refused push, retries included.
+static uint32_t g_rx_stalls;
+
+// Outbound frames go through g_tx_queue and are written only by io_task, so
+// producers never block on the UART. g_tx_ready is given on every commit and
+// shares io_task's queue set with the UART events.
+static tx_queue_t g_tx_queue;
+static portMUX_TYPE g_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static StaticSemaphore_t g_tx_free_buf;
+static SemaphoreHandle_t g_tx_free;
+static StaticSemaphore_t g_tx_ready_buf;
+static SemaphoreHandle_t g_tx_ready;
+// The one kernel object on the heap: this FreeRTOS has no static queue sets.
+// It is created at boot with the rest.
+static QueueSetHandle_t g_io_set;
+// A frame as written, wrapped when binary framing is on.
+static uint8_t g_tx_wire[BINFRAME_MAX_WIRE];
+// Set by set_framing; frames committed while set go out as binframe frames.
+static atomic_bool g_binary_framing;
+
+// Event subscriptions, changed by the subscribe commands and consumed by the
+// event emitter, which is woken so that changes take effect immediately. Only
+// loop_task touches them, apart from the reset app_main does before it starts,
+// so they take no lock.
+static subscription_set_t g_subs;
+
+// What the event emitter keeps between passes, and the poll that runs a pass
+// when nothing else does.
+typedef struct {
+    telemetry_delta_config_t cfg;
+    telemetry_delta_t delta;
+    telemetry_mask_t carry;
+    uint32_t force;
+    uint64_t last_us[SUBSCRIPTION_TOPIC_COUNT];
+    // What the change-only topics last reported.
+    supervisor_state_t sent;
+} event_emitter_t;
+
+static event_emitter_t g_emitter;
+static wheel_timer_t g_events_timer;
+
+// Requests answered later; g_pending_timer times them out and the handlers
+// owning each kind complete the rest. All of these run on loop_task.
+static pending_table_t g_pending;
+static wheel_timer_t g_pending_timer;
+
+// The poweroff handshake, fed by commands, GPIO interrupts and its timer.
+static poweroff_fsm_t g_poweroff;
+static wheel_timer_t g_poweroff_timer;
+
+// Switch inputs that interrupted since they were last debounced, bit per
+// k_switch_inputs entry; their interrupts stay disabled until they settle.
+static atomic_uint g_switch_irqs;
+static debouncer_t g_debouncer;
+static wheel_timer_t g_switch_timer;
+
+// Continuous ADC acquisition, drained on every ADC wakeup into the filters
+// and the charge estimate. The latest measurement is published by
+// g_adc_publish_timer.
+static adc_continuous_handle_t g_adc;
+static adc_cali_handle_t g_adc_cali;
+static adc_filter_t g_pack_volts;
+static adc_filter_t g_pack_amps;
+static int g_pack_mv;
+static int g_pack_ma;
+static fuel_gauge_t g_gauge;
+static uint8_t g_adc_frame[SUPV_ADC_FRAME_BYTES];
+static wheel_timer_t g_adc_publish_timer;
+
+// The charge estimate, kept in RTC memory so that it survives software,
+// watchdog and brownout resets. A power cycle loses it and the estimate is
+// seeded from the pack voltage again.
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity_mah;
+    int64_t charge_mams;
+    uint32_t check;
+} gauge_saved_t;
+static RTC_NOINIT_ATTR gauge_saved_t g_gauge_saved;
+
+// Threshold watches, registered by the watch commands and evaluated by the
+// event emitter whenever the state changes, both on loop_task.
+static watch_table_t g_watches;
+
+// What the Pi gets after boot or a line break, and the intervals a subscribe
+// without explicit ones uses.
+static const subscription_t k_subscription_defaults[SUBSCRIPTION_TOPIC_COUNT] = {
+    [SUBSCRIPTION_TELEMETRY] = {.enabled = true,
+                                .min_interval_ms = TELEMETRY_PERIOD_MS,
+                                .max_interval_ms = TELEMETRY_KEYFRAME_MS},
+    [SUBSCRIPTION_SWITCH] = {.enabled = true},
+    [SUBSCRIPTION_HELTEC] = {.enabled = false},
+    [SUBSCRIPTION_UNREAD] = {.enabled = false, .min_interval_ms = 1000},
+    [SUBSCRIPTION_WATCHDOG] = {.enabled = false, .max_interval_ms = 60000},
+};
 
 static uint64_t uptime_seconds(void) {
     return esp_timer_get_time() / 1000000ULL;
 }
 
+// Queues a wakeup for loop_task unless one of `type` is already waiting.
+static void loop_wake(loop_event_type_t type) {
+    if (!g_loop_queue || (atomic_fetch_or(&g_loop_posted, 1u << type) & (1u << type))) {
+        return;
+    }
+    const loop_event_t ev = {.type = type};
+    if (xQueueSend(g_loop_queue, &ev, 0) != pdTRUE) {
+        atomic_fetch_and(&g_loop_posted, ~(1u << type));
+    }
+}
+
+static void IRAM_ATTR loop_wake_from_isr(loop_event_type_t type, BaseType_t *woken) {
+    if (atomic_fetch_or(&g_loop_posted, 1u << type) & (1u << type)) {
+        return;
+    }
+    const loop_event_t ev = {.type = type};
+    if (xQueueSendFromISR(g_loop_queue, &ev, woken) != pdTRUE) {
+        atomic_fetch_and(&g_loop_posted, ~(1u << type));
+    }
+}
+
+static uint64_t loop_now_ms(void) {
+    return esp_timer_get_time() / 1000ULL;
+}
+
+// Arms `t` for the first tick at or after `deadline_us`, or disarms it when
+// `deadline_us` is 0.
+static void loop_timer_at(wheel_timer_t *t, uint64_t deadline_us) {
+    if (deadline_us == 0) {
+        timer_wheel_cancel(&g_wheel, t);
+        return;
+    }
+    timer_wheel_arm(&g_wheel, t, (deadline_us + 999) / 1000, 0);
+}
+
+static void supervisor_state_write_begin(void) {
+    portENTER_CRITICAL(&g_state_lock);
+    seqlock_write_begin(&g_state_seq);
+}
+
+static void supervisor_state_write_end(void) {
+    seqlock_write_end(&g_state_seq);
+    portEXIT_CRITICAL(&g_state_lock);
+    loop_wake(LOOP_EVENT_STATE);
+}
+
 static void supervisor_state_snapshot(supervisor_state_t *out) {
     if (!out) {
         return;
     }
-    xSemaphoreTake(g_state_mutex, portMAX_DELAY);
-    *out = g_state;
-    xSemaphoreGive(g_state_mutex);
+    unsigned begin;
+    do {
+        begin = seqlock_read_begin(&g_state_seq);
+        *out = g_state;
+    } while (seqlock_read_retry(&g_state_seq, begin));
 }
 
 static supervisor_switch_state_t supervisor_switch_snapshot(void) {
-    supervisor_switch_state_t snapshot;
-    xSemaphoreTake(g_state_mutex, portMAX_DELAY);
-    snapshot = g_state.switches;
-    xSemaphoreGive(g_state_mutex);
-    return snapshot;
+    supervisor_state_t snapshot;
+    supervisor_state_snapshot(&snapshot);
+    return snapshot.switches;
 }
 
 static void supervisor_state_init(void) {
-    g_state_mutex = xSemaphoreCreateMutex();
-    if (!g_state_mutex) {
-        ESP_LOGE(TAG, "Failed to allocate state mutex");
-        abort();
-    }
     memset(&g_state, 0, sizeof(g_state));
-    g_state.battery_pct = 78;
-    g_state.pack_mv = 11750;
-    g_state.pack_ma = -420;
+    // pack_mv and pack_ma stay 0 until the ADC has measured them.
+    g_state.battery_pct = -1;
+    g_state.time_to_empty_min = -1;
+    g_state.time_to_full_min = -1;
     g_state.mcu_temp_c = 36.5f;
     g_state.unread_ext = 0;
-    g_state.switches = (supervisor_switch_state_t){
-        .lte = true,
-        .wifi = false,
-        .bt = true,
-        .bridge_enable = true,
-        .lid_open = false,
-        .charger_online = true,
-    };
     snprintf(g_state.heltec, sizeof(g_state.heltec), "ok");
     snprintf(g_state.mcu, sizeof(g_state.mcu), "proto-0.1");
+    // The boot watchdog is not implemented yet.
+    snprintf(g_state.watchdog, sizeof(g_state.watchdog), "disabled");
     g_state.last_mesh_event_us = esp_timer_get_time();
 }
 
+static void subscriptions_set(subscription_topic_t topic, const subscription_t *sub) {
+    g_subs.topics[topic] = *sub;
+    if (sub->enabled) {
+        g_subs.force |= 1u << topic;
+    }
+    loop_wake(LOOP_EVENT_STATE);
+}
+
+// Restores the defaults and resends every default topic, as after boot.
+static void subscriptions_reset(void) {
+    g_subs.force = 0;
+    for (int i = 0; i < SUBSCRIPTION_TOPIC_COUNT; ++i) {
+        g_subs.topics[i] = k_subscription_defaults[i];
+        if (g_subs.topics[i].enabled) {
+            g_subs.force |= 1u << i;
+        }
+    }
+    loop_wake(LOOP_EVENT_STATE);
+}
+
+// Copies the current subscriptions and claims their pending force bits.
+static void subscriptions_take(subscription_set_t *out) {
+    *out = g_subs;
+    g_subs.force = 0;
+}
+
+static void supervisor_tx_init(void) {
+    tx_queue_init(&g_tx_queue);
+    g_tx_free = xSemaphoreCreateCountingStatic(TX_QUEUE_FRAMES, TX_QUEUE_FRAMES, &g_tx_free_buf);
+    g_tx_ready = xSemaphoreCreateBinaryStatic(&g_tx_ready_buf);
+}
+
 static void supervisor_uart_init(void) {
     const uart_config_t cfg = {
         .baud_rate = SUPV_UART_BAUD,
@@ -109,274 +431,1647 @@ static void supervisor_uart_init(void) {
     ESP_ERROR_CHECK(uart_param_config(SUPV_UART_PORT, &cfg));
     ESP_ERROR_CHECK(
         uart_set_pin(SUPV_UART_PORT, SUPV_UART_TXD, SUPV_UART_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    ESP_ERROR_CHECK(uart_driver_install(SUPV_UART_PORT, SUPV_RX_BUF_SIZE, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(SUPV_UART_PORT, SUPV_RX_BUF_SIZE, 0, SUPV_UART_QUEUE_LEN, &g_uart_queue, 0));
 }
 
-static int compute_last_msg_age(const supervisor_state_t *state, uint64_t now_us) {
-    if (!state || state->last_mesh_event_us == 0 || now_us < state->last_mesh_event_us) {
-        return 0;
+static tx_frame_t *supervisor_tx_acquire(tx_prio_t prio) {
+    const bool is_reply = prio == TX_PRIO_REPLY || prio == TX_PRIO_POWEROFF;
+    const TickType_t wait = is_reply ? pdMS_TO_TICKS(SUPV_TX_REPLY_WAIT_MS) : 0;
+    tx_frame_t *frame = NULL;
+    const bool reserved = xSemaphoreTake(g_tx_free, wait) == pdTRUE;
+    portENTER_CRITICAL(&g_tx_lock);
+    if (reserved) {
+        frame = tx_queue_acquire(&g_tx_queue);
+    } else {
+        tx_queue_note_drop(&g_tx_queue, prio);
     }
-    const uint64_t delta = now_us - state->last_mesh_event_us;
-    const uint64_t seconds = delta / 1000000ULL;
-    return seconds > (uint64_t)INT_MAX ? INT_MAX : (int)seconds;
+    portEXIT_CRITICAL(&g_tx_lock);
+    return frame;
 }
 
-static cJSON *build_switch_object(const supervisor_switch_state_t *sw) {
-    cJSON *obj = cJSON_CreateObject();
-    if (!obj || !sw) {
-        return obj;
-    }
-    cJSON_AddBoolToObject(obj, "lte", sw->lte);
-    cJSON_AddBoolToObject(obj, "wifi", sw->wifi);
-    cJSON_AddBoolToObject(obj, "bt", sw->bt);
-    cJSON_AddBoolToObject(obj, "bridge_enable", sw->bridge_enable);
-    cJSON_AddBoolToObject(obj, "lid_open", sw->lid_open);
-    cJSON_AddBoolToObject(obj, "charger_online", sw->charger_online);
-    return obj;
+static void supervisor_tx_release(tx_frame_t *frame) {
+    portENTER_CRITICAL(&g_tx_lock);
+    tx_queue_release(&g_tx_queue, frame);
+    portEXIT_CRITICAL(&g_tx_lock);
+    xSemaphoreGive(g_tx_free);
 }
 
-static void append_telemetry_fields(cJSON *obj, const supervisor_state_t *state, uint64_t now_us, bool include_switch) {
-    if (!obj || !state) {
-        return;
+static void supervisor_tx_commit(tx_frame_t *frame, tx_prio_t prio, uint32_t tag) {
+    const uint64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&g_tx_lock);
+    const bool replaced = tx_queue_commit(&g_tx_queue, frame, prio, tag, now_us);
+    portEXIT_CRITICAL(&g_tx_lock);
+    if (replaced) {
+        xSemaphoreGive(g_tx_free);
+    }
+    xSemaphoreGive(g_tx_ready);
+    if (atomic_load(&g_rx_ring_waiting)) {
+        xTaskNotifyGive(g_io_task);
     }
-    cJSON_AddNumberToObject(obj, "battery_pct", state->battery_pct);
-    cJSON_AddNumberToObject(obj, "pack_mv", state->pack_mv);
-    cJSON_AddNumberToObject(obj, "pack_ma", state->pack_ma);
-    cJSON_AddNumberToObject(obj, "mcu_temp_c", state->mcu_temp_c);
-    cJSON_AddNumberToObject(obj, "unread_ext", state->unread_ext);
-    cJSON_AddNumberToObject(obj, "last_msg_age_s", compute_last_msg_age(state, now_us));
-    cJSON_AddStringToObject(obj, "heltec", state->heltec);
-    cJSON_AddStringToObject(obj, "mcu", state->mcu);
-    cJSON_AddNumberToObject(obj, "uptime_s", now_us / 1000000ULL);
-    if (include_switch) {
-        cJSON_AddItemToObject(obj, "switch", build_switch_object(&state->switches));
+}
+
+static bool supervisor_tx_withdraw(tx_prio_t prio, uint32_t *tag) {
+    portENTER_CRITICAL(&g_tx_lock);
+    const bool withdrawn = tx_queue_withdraw(&g_tx_queue, prio, tag);
+    portEXIT_CRITICAL(&g_tx_lock);
+    if (withdrawn) {
+        xSemaphoreGive(g_tx_free);
     }
+    return withdrawn;
 }
 
-static void send_json_object(cJSON *root) {
-    if (!root) {
+typedef struct {
+    tx_frame_t *frame;
+    tx_prio_t prio;
+    json_writer_t w;
+} tx_msg_t;
+
+// While a batch line is dispatched, replies are encoded into `element` and
+// collected into one array reply instead of a frame each. Only used by
+// loop_task, which runs every command handler.
+typedef struct {
+    bool active;
+    tx_frame_t *frame;
+    size_t count;
+    char element[TX_FRAME_SIZE];
+} batch_reply_t;
+
+static batch_reply_t g_batch;
+// Largest reply encoded by the command being dispatched, for its
+// command_stats_t reply_peak.
+static size_t g_reply_bytes;
+
+static void batch_open(void) {
+    g_batch.count = 0;
+    g_batch.frame = supervisor_tx_acquire(TX_PRIO_REPLY);
+    if (!g_batch.frame) {
+        ESP_LOGW(TAG, "TX queue full, dropping batch reply");
         return;
     }
-    char *payload = cJSON_PrintUnformatted(root);
-    if (!payload) {
-        ESP_LOGE(TAG, "Failed to encode JSON");
-        cJSON_Delete(root);
+    g_batch.frame->wire_type = atomic_load(&g_binary_framing) ? BINFRAME_TYPE_JSON : 0;
+    g_batch.frame->data[0] = '[';
+    g_batch.frame->len = 1;
+}
+
+static void batch_flush(void) {
+    tx_frame_t *frame = g_batch.frame;
+    if (!frame) {
         return;
     }
-    const size_t len = strnlen(payload, SUPV_LINE_BUF * 4);
-    if (len > 0) {
-        uart_write_bytes(SUPV_UART_PORT, payload, len);
-        uart_write_bytes(SUPV_UART_PORT, "\n", 1);
+    frame->data[frame->len++] = ']';
+    frame->data[frame->len++] = '\n';
+    supervisor_tx_commit(frame, TX_PRIO_REPLY, 0);
+    g_batch.frame = NULL;
+}
+
+// Replies that do not fit the current array line start another one.
+static bool batch_append(const json_writer_t *w) {
+    if (w->overflow) {
+        ESP_LOGE(TAG, "Encoded JSON exceeds %d byte line buffer", SUPV_LINE_BUF);
+        return false;
+    }
+    // A separating comma, the element and the closing "]\n".
+    const size_t need = w->len + 3;
+    if (g_batch.frame && g_batch.count > 0 && g_batch.frame->len + need > sizeof(g_batch.frame->data)) {
+        batch_flush();
+        batch_open();
+    }
+    tx_frame_t *frame = g_batch.frame;
+    if (!frame || frame->len + need > sizeof(frame->data)) {
+        return false;
+    }
+    if (g_batch.count++ > 0) {
+        frame->data[frame->len++] = ',';
     }
-    cJSON_free(payload);
-    cJSON_Delete(root);
+    memcpy(frame->data + frame->len, w->buf, w->len);
+    frame->len += w->len;
+    return true;
 }
 
-static void send_error_reply(const char *id, const char *error) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        return;
+static bool tx_msg_begin(tx_msg_t *m, tx_prio_t prio) {
+    m->prio = prio;
+    if (prio == TX_PRIO_REPLY && g_batch.active) {
+        m->frame = NULL;
+        json_writer_init(&m->w, g_batch.element, sizeof(g_batch.element));
+        json_writer_begin_object(&m->w);
+        return true;
+    }
+    m->frame = supervisor_tx_acquire(prio);
+    if (!m->frame) {
+        ESP_LOGW(TAG, "TX queue full, dropping frame (prio %d)", (int)prio);
+        return false;
+    }
+    m->frame->wire_type = atomic_load(&g_binary_framing) ? BINFRAME_TYPE_JSON : 0;
+    json_writer_init(&m->w, m->frame->data, sizeof(m->frame->data));
+    json_writer_begin_object(&m->w);
+    return true;
+}
+
+// Deferred replies use their own class (and never join a batch reply), since
+// they are sent after the command that asked for them.
+static bool begin_reply_as(tx_msg_t *m, tx_prio_t prio, const char *id, bool ok) {
+    if (!tx_msg_begin(m, prio)) {
+        return false;
     }
     if (id) {
-        cJSON_AddStringToObject(root, "id", id);
+        json_writer_add_string(&m->w, "id", id);
+    }
+    json_writer_add_bool(&m->w, "ok", ok);
+    return true;
+}
+
+static bool begin_reply(tx_msg_t *m, const char *id, bool ok) {
+    return begin_reply_as(m, TX_PRIO_REPLY, id, ok);
+}
+
+static bool tx_msg_send(tx_msg_t *m, uint32_t tag) {
+    json_writer_end_object(&m->w);
+    if (m->prio == TX_PRIO_REPLY && m->w.len > g_reply_bytes) {
+        g_reply_bytes = m->w.len;
+    }
+    if (!m->frame) {
+        return batch_append(&m->w);
+    }
+    const size_t len = json_writer_end_line(&m->w);
+    if (len == 0) {
+        ESP_LOGE(TAG, "Encoded JSON exceeds %d byte line buffer", SUPV_LINE_BUF);
+        supervisor_tx_release(m->frame);
+        return false;
+    }
+    m->frame->len = len;
+    supervisor_tx_commit(m->frame, m->prio, tag);
+    return true;
+}
+
+static void send_error_reply(const char *id, const char *error) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, false)) {
+        return;
     }
-    cJSON_AddBoolToObject(root, "ok", false);
-    cJSON_AddStringToObject(root, "error", error ? error : "unknown_error");
-    send_json_object(root);
+    json_writer_add_string(&m.w, "error", error ? error : "unknown_error");
+    tx_msg_send(&m, 0);
 }
 
 static void send_basic_ok(const char *id) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
         return;
     }
-    if (id) {
-        cJSON_AddStringToObject(root, "id", id);
+    tx_msg_send(&m, 0);
+}
+
+static void send_status_response(const char *id, const supervisor_state_t *state, uint64_t now_us,
+                                 telemetry_mask_t fields) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
+        return;
     }
-    cJSON_AddBoolToObject(root, "ok", true);
-    send_json_object(root);
+    json_writer_key(&m.w, "status");
+    json_writer_begin_object(&m.w);
+    telemetry_encode_fields(&m.w, state, now_us, fields);
+    json_writer_end_object(&m.w);
+    tx_msg_send(&m, 0);
 }
 
-static void send_status_response(const char *id, const supervisor_state_t *state, uint64_t now_us) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static void send_switch_response(const char *id, const supervisor_switch_state_t *sw) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
         return;
     }
-    if (id) {
-        cJSON_AddStringToObject(root, "id", id);
+    json_writer_key(&m.w, "switch");
+    telemetry_encode_switch(&m.w, sw);
+    tx_msg_send(&m, 0);
+}
+
+static void send_ping_reply(const char *id) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
+        return;
     }
-    cJSON_AddBoolToObject(root, "ok", true);
-    cJSON *status = cJSON_CreateObject();
-    if (status) {
-        append_telemetry_fields(status, state, now_us, true);
-        cJSON_AddItemToObject(root, "status", status);
+    json_writer_add_uint64(&m.w, "uptime_s", uptime_seconds());
+    tx_msg_send(&m, 0);
+}
+
+static bool send_binary_event(binframe_type_t type, const supervisor_state_t *state, uint64_t now_us,
+                              telemetry_mask_t mask, tx_prio_t prio) {
+    tx_frame_t *frame = supervisor_tx_acquire(prio);
+    if (!frame) {
+        ESP_LOGW(TAG, "TX queue full, dropping frame (prio %d)", (int)prio);
+        return false;
+    }
+    uint8_t *payload = (uint8_t *)frame->data;
+    if (type == BINFRAME_TYPE_SWITCH) {
+        payload[0] = binframe_switch_bits(&state->switches);
+        frame->len = 1;
+    } else {
+        frame->len = binframe_encode_telemetry(state, now_us, mask, payload, sizeof(frame->data));
+    }
+    if (frame->len == 0) {
+        supervisor_tx_release(frame);
+        return false;
     }
-    send_json_object(root);
+    frame->wire_type = (uint8_t)type;
+    supervisor_tx_commit(frame, prio, mask);
+    return true;
 }
 
-static void send_switch_response(const char *id, const supervisor_switch_state_t *sw) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static bool send_telemetry_event(const supervisor_state_t *state, uint64_t now_us, telemetry_mask_t mask) {
+    if (atomic_load(&g_binary_framing)) {
+        return send_binary_event(BINFRAME_TYPE_TELEMETRY, state, now_us, mask, TX_PRIO_TELEMETRY);
+    }
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_TELEMETRY)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "telemetry");
+    telemetry_encode_fields(&m.w, state, now_us, mask);
+    return tx_msg_send(&m, mask);
+}
+
+static bool send_switch_event(const supervisor_switch_state_t *sw) {
+    if (atomic_load(&g_binary_framing)) {
+        const supervisor_state_t state = {.switches = *sw};
+        return send_binary_event(BINFRAME_TYPE_SWITCH, &state, 0, 0, TX_PRIO_SWITCH);
+    }
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_SWITCH)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "switch");
+    json_writer_key(&m.w, "switch");
+    telemetry_encode_switch(&m.w, sw);
+    return tx_msg_send(&m, 0);
+}
+
+static bool send_heltec_event(const supervisor_state_t *state) {
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_EVENT)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "heltec");
+    json_writer_add_string(&m.w, "heltec", state->heltec);
+    return tx_msg_send(&m, 0);
+}
+
+static bool send_unread_event(const supervisor_state_t *state, uint64_t now_us) {
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_EVENT)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "unread");
+    json_writer_add_int(&m.w, "unread_ext", state->unread_ext);
+    json_writer_add_int(&m.w, "last_msg_age_s", telemetry_last_msg_age(state, now_us));
+    return tx_msg_send(&m, 0);
+}
+
+static bool send_watchdog_event(const supervisor_state_t *state, uint64_t now_us) {
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_EVENT)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "watchdog");
+    json_writer_add_string(&m.w, "state", state->watchdog);
+    json_writer_add_uint64(&m.w, "uptime_s", now_us / 1000000ULL);
+    return tx_msg_send(&m, 0);
+}
+
+static bool send_alert_event(int slot, watch_field_t field, bool active, float value) {
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_EVENT)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "alert");
+    json_writer_add_int(&m.w, "watch", slot);
+    json_writer_add_string(&m.w, "field", watch_field_name(field));
+    json_writer_add_bool(&m.w, "active", active);
+    json_writer_add_float(&m.w, "value", value, watch_field_decimals(field));
+    return tx_msg_send(&m, 0);
+}
+
+static void send_subscription_reply(const char *id, subscription_topic_t topic, const subscription_t *sub) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
         return;
     }
-    if (id) {
-        cJSON_AddStringToObject(root, "id", id);
+    json_writer_add_string(&m.w, "topic", subscription_topic_name(topic));
+    if (sub) {
+        json_writer_add_uint64(&m.w, "min_ms", sub->min_interval_ms);
+        json_writer_add_uint64(&m.w, "max_ms", sub->max_interval_ms);
+    }
+    tx_msg_send(&m, 0);
+}
+
+static void send_watch_reply(const char *id, int slot, bool active) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
+        return;
+    }
+    json_writer_add_int(&m.w, "watch", slot);
+    json_writer_add_bool(&m.w, "active", active);
+    tx_msg_send(&m, 0);
+}
+
+// Core loads cover the time since the previous get_stats (or boot); the
+// depth peaks are since boot.
+static void send_stats_reply(const char *id) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
+        return;
+    }
+    core_load_t load[portNUM_PROCESSORS];
+    const uint64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&g_load_lock);
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+        load[core].busy_us = g_core_load[core].busy_us - g_core_load_last[core].busy_us;
+        load[core].wakes = g_core_load[core].wakes - g_core_load_last[core].wakes;
+        g_core_load_last[core] = g_core_load[core];
     }
-    cJSON_AddBoolToObject(root, "ok", true);
-    cJSON_AddItemToObject(root, "switch", build_switch_object(sw));
-    send_json_object(root);
+    const uint64_t window_us = now_us - g_core_load_last_us;
+    g_core_load_last_us = now_us;
+    portEXIT_CRITICAL(&g_load_lock);
+    portENTER_CRITICAL(&g_tx_lock);
+    const size_t tx_queued = g_tx_queue.queued;
+    const size_t tx_peak = g_tx_queue.peak_queued;
+    tx_class_stats_t tx_stats[TX_PRIO_COUNT];
+    memcpy(tx_stats, g_tx_queue.stats, sizeof(tx_stats));
+    portEXIT_CRITICAL(&g_tx_lock);
+
+    json_writer_add_uint64(&m.w, "window_us", window_us);
+    for (int core = 0; core < portNUM_PROCESSORS; ++core) {
+        char key[8];
+        snprintf(key, sizeof(key), "core%d", core);
+        json_writer_key(&m.w, key);
+        json_writer_begin_object(&m.w);
+        json_writer_add_uint64(&m.w, "busy_us", load[core].busy_us);
+        json_writer_add_uint64(&m.w, "wakes", load[core].wakes);
+        json_writer_add_int(&m.w, "load_pct", window_us ? (int)(load[core].busy_us * 100 / window_us) : 0);
+        json_writer_end_object(&m.w);
+    }
+    json_writer_key(&m.w, "rx_ring");
+    json_writer_begin_object(&m.w);
+    json_writer_add_int(&m.w, "size", (int)g_rx_ring.size);
+    json_writer_add_int(&m.w, "used", (int)spsc_ring_used(&g_rx_ring));
+    json_writer_add_int(&m.w, "peak", (int)g_rx_ring.peak);
+    json_writer_add_uint64(&m.w, "stalls", g_rx_stalls);
+    json_writer_end_object(&m.w);
+    json_writer_key(&m.w, "loop_queue");
+    json_writer_begin_object(&m.w);
+    json_writer_add_int(&m.w, "size", SUPV_LOOP_QUEUE_LEN);
+    json_writer_add_int(&m.w, "peak", (int)g_loop_queue_peak);
+    json_writer_end_object(&m.w);
+    json_writer_key(&m.w, "tx_queue");
+    json_writer_begin_object(&m.w);
+    json_writer_add_int(&m.w, "size", TX_QUEUE_FRAMES);
+    json_writer_add_int(&m.w, "queued", (int)tx_queued);
+    json_writer_add_int(&m.w, "peak", (int)tx_peak);
+    // Per class, in priority order: frames written, the longest any waited
+    // in the queue, and frames dropped for want of room.
+    json_writer_key(&m.w, "sent");
+    json_writer_begin_array(&m.w);
+    for (int prio = 0; prio < TX_PRIO_COUNT; ++prio) {
+        json_writer_uint64(&m.w, tx_stats[prio].sent);
+    }
+    json_writer_end_array(&m.w);
+    json_writer_key(&m.w, "wait_max_us");
+    json_writer_begin_array(&m.w);
+    for (int prio = 0; prio < TX_PRIO_COUNT; ++prio) {
+        json_writer_uint64(&m.w, tx_stats[prio].max_latency_us);
+    }
+    json_writer_end_array(&m.w);
+    json_writer_key(&m.w, "dropped");
+    json_writer_begin_array(&m.w);
+    for (int prio = 0; prio < TX_PRIO_COUNT; ++prio) {
+        json_writer_uint64(&m.w, tx_stats[prio].dropped);
+    }
+    json_writer_end_array(&m.w);
+    json_writer_end_object(&m.w);
+    tx_msg_send(&m, 0);
 }
 
-static void send_telemetry_event(const supervisor_state_t *state, uint64_t now_us) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static void send_framing_reply(const char *id, const char *mode) {
+    tx_msg_t m;
+    if (!begin_reply(&m, id, true)) {
         return;
     }
-    cJSON_AddStringToObject(root, "event", "telemetry");
-    append_telemetry_fields(root, state, now_us, true);
-    send_json_object(root);
+    json_writer_add_string(&m.w, "framing", mode);
+    tx_msg_send(&m, 0);
 }
 
-static void send_switch_event(const supervisor_switch_state_t *sw) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static void send_poweroff_reply(const pending_entry_t *req) {
+    tx_msg_t m;
+    if (!begin_reply_as(&m, TX_PRIO_POWEROFF, req->has_id ? req->id : NULL, true)) {
         return;
     }
-    cJSON_AddStringToObject(root, "event", "switch");
-    cJSON_AddItemToObject(root, "switch", build_switch_object(sw));
-    send_json_object(root);
+    json_writer_add_bool(&m.w, "poweroff_ok", true);
+    tx_msg_send(&m, 0);
 }
 
-static void send_poweroff_reply(const char *id) {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
+static void send_deferred_error(const pending_entry_t *req, const char *error) {
+    tx_msg_t m;
+    if (!begin_reply_as(&m, TX_PRIO_POWEROFF, req->has_id ? req->id : NULL, false)) {
         return;
     }
-    if (id) {
-        cJSON_AddStringToObject(root, "id", id);
+    json_writer_add_string(&m.w, "error", error);
+    tx_msg_send(&m, 0);
+}
+
+static bool send_poweroff_event(poweroff_state_t state, const char *reason, uint64_t now_us) {
+    tx_msg_t m;
+    if (!tx_msg_begin(&m, TX_PRIO_POWEROFF)) {
+        return false;
+    }
+    json_writer_add_string(&m.w, "event", "poweroff");
+    json_writer_add_string(&m.w, "state", poweroff_state_name(state));
+    if (reason) {
+        json_writer_add_string(&m.w, "reason", reason);
     }
-    cJSON_AddBoolToObject(root, "ok", true);
-    cJSON_AddBoolToObject(root, "poweroff_ok", true);
-    send_json_object(root);
+    json_writer_add_uint64(&m.w, "uptime_s", now_us / 1000000ULL);
+    return tx_msg_send(&m, 0);
 }
 
-static void handle_clear_unread(void) {
-    xSemaphoreTake(g_state_mutex, portMAX_DELAY);
+static void handle_clear_unread(const char *source) {
+    if (source) {
+        ESP_LOGD(TAG, "clear_unread from %s", source);
+    }
+    const uint64_t now_us = esp_timer_get_time();
+    supervisor_state_write_begin();
     g_state.unread_ext = 0;
-    g_state.last_mesh_event_us = esp_timer_get_time();
-    xSemaphoreGive(g_state_mutex);
+    g_state.last_mesh_event_us = now_us;
+    supervisor_state_write_end();
 }
 
-static void handle_arm_poweroff(void) {
-    xSemaphoreTake(g_state_mutex, portMAX_DELAY);
-    g_state.poweroff_armed = true;
-    xSemaphoreGive(g_state_mutex);
+static bool poweroff_post(const poweroff_event_t *ev) {
+    const loop_event_t loop_ev = {.type = LOOP_EVENT_POWEROFF, .poweroff = *ev};
+    return g_loop_queue && xQueueSend(g_loop_queue, &loop_ev, 0) == pdTRUE;
 }
 
-static void process_command(cJSON *root) {
-    if (!root) {
+// Parks the request until `kind` completes, or answers it with a timeout
+// after `timeout_ms`. Fails when too many requests are already waiting.
+static bool defer_reply(const command_request_t *req, pending_kind_t kind, uint32_t timeout_ms) {
+    const uint64_t deadline_us = esp_timer_get_time() + (uint64_t)timeout_ms * 1000ULL;
+    const bool added = pending_add(&g_pending, kind, req->id, deadline_us);
+    const uint64_t next_us = pending_next_deadline(&g_pending);
+    loop_timer_at(&g_pending_timer, next_us);
+    return added;
+}
+
+static void cmd_get_status(const command_request_t *req) {
+    telemetry_mask_t fields = TELEMETRY_FIELDS_ALL;
+    if (req->args[0].type != JSON_TYPE_NONE && !telemetry_fields_parse(&req->args[0], &fields)) {
+        send_error_reply(req->id, "bad_fields");
         return;
     }
-    cJSON *cmd_item = cJSON_GetObjectItemCaseSensitive(root, "cmd");
-    if (!cJSON_IsString(cmd_item)) {
-        ESP_LOGW(TAG, "Received JSON without cmd");
+    supervisor_state_t snapshot;
+    const uint64_t now_us = esp_timer_get_time();
+    supervisor_state_snapshot(&snapshot);
+    send_status_response(req->id, &snapshot, now_us, fields);
+}
+
+static void cmd_get_switches(const command_request_t *req) {
+    supervisor_switch_state_t sw = supervisor_switch_snapshot();
+    send_switch_response(req->id, &sw);
+}
+
+static void cmd_clear_unread(const command_request_t *req) {
+    handle_clear_unread(json_value_is_string(&req->args[0]) ? req->args[0].ptr : NULL);
+    send_basic_ok(req->id);
+}
+
+// Answered by the poweroff handshake once it is safe to cut power.
+static void cmd_arm_poweroff(const command_request_t *req) {
+    if (!defer_reply(req, PENDING_POWEROFF, SUPV_POWEROFF_REPLY_TIMEOUT_MS)) {
+        send_error_reply(req->id, "busy");
         return;
     }
-    const char *cmd = cmd_item->valuestring;
-    cJSON *id_item = cJSON_GetObjectItemCaseSensitive(root, "id");
-    const char *id = cJSON_IsString(id_item) ? id_item->valuestring : NULL;
     supervisor_state_t snapshot;
-    uint64_t now_us = esp_timer_get_time();
-    if (strcmp(cmd, "get_status") == 0) {
-        supervisor_state_snapshot(&snapshot);
-        send_status_response(id, &snapshot, now_us);
-    } else if (strcmp(cmd, "get_switches") == 0) {
-        supervisor_switch_state_t sw = supervisor_switch_snapshot();
-        send_switch_response(id, &sw);
-    } else if (strcmp(cmd, "clear_unread") == 0) {
-        handle_clear_unread();
-        send_basic_ok(id);
-    } else if (strcmp(cmd, "arm_poweroff") == 0) {
-        handle_arm_poweroff();
-        send_poweroff_reply(id);
-    } else if (strcmp(cmd, "ping") == 0) {
-        cJSON *root_reply = cJSON_CreateObject();
-        if (root_reply) {
-            if (id) {
-                cJSON_AddStringToObject(root_reply, "id", id);
-            }
-            cJSON_AddBoolToObject(root_reply, "ok", true);
-            cJSON_AddNumberToObject(root_reply, "uptime_s", uptime_seconds());
-            send_json_object(root_reply);
-        }
-    } else {
-        send_error_reply(id, "unknown_cmd");
+    supervisor_state_snapshot(&snapshot);
+    const poweroff_event_t ev = {.type = POWEROFF_EVENT_ARM, .battery_pct = snapshot.battery_pct};
+    if (!poweroff_post(&ev)) {
+        // Left to time out.
+        ESP_LOGW(TAG, "Loop queue full, arm_poweroff dropped");
     }
 }
 
-static void process_line(const char *line) {
-    if (!line || line[0] == '\0') {
+static void cmd_cancel_poweroff(const command_request_t *req) {
+    const poweroff_event_t ev = {.type = POWEROFF_EVENT_CANCEL};
+    if (!poweroff_post(&ev)) {
+        send_error_reply(req->id, "busy");
         return;
     }
-    cJSON *root = cJSON_Parse(line);
-    if (!root) {
-        ESP_LOGW(TAG, "Failed to parse JSON: %s", line);
+    send_basic_ok(req->id);
+}
+
+static void cmd_ping(const command_request_t *req) {
+    send_ping_reply(req->id);
+}
+
+static void cmd_get_stats(const command_request_t *req) {
+    send_stats_reply(req->id);
+}
+
+// The reply is committed before the switch, so it still uses the old framing.
+// Refused inside a batch, whose reply frames must all share one framing.
+static void cmd_set_framing(const command_request_t *req) {
+    if (g_batch.active) {
+        send_error_reply(req->id, "in_batch");
         return;
     }
-    if (cJSON_GetObjectItem(root, "cmd")) {
-        process_command(root);
+    const char *mode = req->args[0].ptr;
+    bool binary;
+    if (strcmp(mode, "binary") == 0) {
+        binary = true;
+    } else if (strcmp(mode, "json") == 0) {
+        binary = false;
     } else {
+        send_error_reply(req->id, "bad_args");
+        return;
+    }
+    send_framing_reply(req->id, mode);
+    atomic_store(&g_binary_framing, binary);
+}
+
+// Intervals left out keep the topic's defaults; a max that would end up
+// below the requested min is raised to it.
+static void cmd_subscribe(const command_request_t *req) {
+    subscription_topic_t topic;
+    if (!subscription_topic_from_name(req->args[0].ptr, &topic)) {
+        send_error_reply(req->id, "unknown_topic");
+        return;
+    }
+    subscription_t sub = k_subscription_defaults[topic];
+    sub.enabled = true;
+    const bool has_min = req->args[1].type != JSON_TYPE_NONE;
+    const bool has_max = req->args[2].type != JSON_TYPE_NONE;
+    if ((has_min && !json_value_to_u32(&req->args[1], &sub.min_interval_ms)) ||
+        (has_max && !json_value_to_u32(&req->args[2], &sub.max_interval_ms))) {
+        send_error_reply(req->id, "bad_interval");
+        return;
+    }
+    if (req->args[3].type != JSON_TYPE_NONE) {
+        telemetry_mask_t fields;
+        if (topic != SUBSCRIPTION_TELEMETRY || !telemetry_fields_parse(&req->args[3], &fields)) {
+            send_error_reply(req->id, "bad_fields");
+            return;
+        }
+        sub.fields = fields;
+    }
+    if (!has_max && sub.max_interval_ms != 0 && sub.max_interval_ms < sub.min_interval_ms) {
+        sub.max_interval_ms = sub.min_interval_ms;
+    }
+    if (!subscription_valid(&sub)) {
+        send_error_reply(req->id, "bad_interval");
+        return;
+    }
+    send_subscription_reply(req->id, topic, &sub);
+    subscriptions_set(topic, &sub);
+}
+
+static void cmd_unsubscribe(const command_request_t *req) {
+    const subscription_t off = {.enabled = false};
+    if (strcmp(req->args[0].ptr, "all") == 0) {
+        for (int i = 0; i < SUBSCRIPTION_TOPIC_COUNT; ++i) {
+            subscriptions_set((subscription_topic_t)i, &off);
+        }
+        send_basic_ok(req->id);
+        return;
+    }
+    subscription_topic_t topic;
+    if (!subscription_topic_from_name(req->args[0].ptr, &topic)) {
+        send_error_reply(req->id, "unknown_topic");
+        return;
+    }
+    subscriptions_set(topic, &off);
+    send_subscription_reply(req->id, topic, NULL);
+}
+
+static void cmd_reset_subscriptions(const command_request_t *req) {
+    send_basic_ok(req->id);
+    subscriptions_reset();
+}
+
+static void cmd_watch(const command_request_t *req) {
+    watch_field_t field;
+    watch_op_t op;
+    float threshold;
+    float hysteresis = 0.0f;
+    if (!watch_field_from_name(req->args[0].ptr, &field)) {
+        send_error_reply(req->id, "unknown_field");
+        return;
+    }
+    if (!watch_op_from_name(req->args[1].ptr, &op)) {
+        send_error_reply(req->id, "bad_op");
+        return;
+    }
+    if (!json_value_to_float(&req->args[2], &threshold) ||
+        (req->args[3].type != JSON_TYPE_NONE && (!json_value_to_float(&req->args[3], &hysteresis) || hysteresis < 0.0f))) {
+        send_error_reply(req->id, "bad_value");
+        return;
+    }
+    supervisor_state_t snapshot;
+    supervisor_state_snapshot(&snapshot);
+    const int slot = watch_table_add(&g_watches, field, op, threshold, hysteresis, &snapshot);
+    const bool active = slot >= 0 && g_watches.watches[slot].active;
+    if (slot < 0) {
+        send_error_reply(req->id, "too_many_watches");
+        return;
+    }
+    send_watch_reply(req->id, slot, active);
+}
+
+static void cmd_unwatch(const command_request_t *req) {
+    uint32_t slot;
+    bool removed = false;
+    if (json_value_to_u32(&req->args[0], &slot) && slot < WATCH_MAX) {
+        removed = watch_table_remove(&g_watches, (int)slot);
+    }
+    if (!removed) {
+        send_error_reply(req->id, "unknown_watch");
+        return;
+    }
+    send_basic_ok(req->id);
+}
+
+static const command_def_t g_command_table[] = {
+    {.name = "get_status", .handler = cmd_get_status, .args = {{"fields", JSON_TYPE_ARRAY, false}}},
+    {.name = "get_switches", .handler = cmd_get_switches},
+    {.name = "clear_unread", .handler = cmd_clear_unread, .args = {{"source", JSON_TYPE_STRING, false}}},
+    {.name = "arm_poweroff", .handler = cmd_arm_poweroff},
+    {.name = "cancel_poweroff", .handler = cmd_cancel_poweroff},
+    {.name = "ping", .handler = cmd_ping},
+    {.name = "get_stats", .handler = cmd_get_stats},
+    {.name = "set_framing", .handler = cmd_set_framing, .args = {{"mode", JSON_TYPE_STRING, true}}},
+    {.name = "subscribe",
+     .handler = cmd_subscribe,
+     .args = {{"topic", JSON_TYPE_STRING, true},
+              {"min_ms", JSON_TYPE_NUMBER, false},
+              {"max_ms", JSON_TYPE_NUMBER, false},
+              {"fields", JSON_TYPE_ARRAY, false}}},
+    {.name = "unsubscribe", .handler = cmd_unsubscribe, .args = {{"topic", JSON_TYPE_STRING, true}}},
+    {.name = "reset_subscriptions", .handler = cmd_reset_subscriptions},
+    {.name = "watch",
+     .handler = cmd_watch,
+     .args = {{"field", JSON_TYPE_STRING, true},
+              {"op", JSON_TYPE_STRING, true},
+              {"value", JSON_TYPE_NUMBER, true},
+              {"hysteresis", JSON_TYPE_NUMBER, false}}},
+    {.name = "unwatch", .handler = cmd_unwatch, .args = {{"watch", JSON_TYPE_NUMBER, true}}},
+};
+
+// The reader decodes strings in place, so a line that fails to parse is
+// logged from a copy of its head taken beforehand.
+typedef struct {
+    char text[SUPV_PARSE_LOG_BYTES];
+    size_t len;
+    size_t line_len;
+} line_head_t;
+
+static void line_head_keep(line_head_t *head, const char *line, size_t len) {
+    head->len = len < sizeof(head->text) ? len : sizeof(head->text);
+    head->line_len = len;
+    memcpy(head->text, line, head->len);
+}
+
+static void log_parse_failure(const line_head_t *head, json_read_error_t err, size_t error_offset) {
+    ESP_LOGW(TAG, "Failed to parse JSON (%s at byte %u): %.*s%s", json_read_error_name(err), (unsigned)error_offset,
+             (int)head->len, head->text, head->len < head->line_len ? "..." : "");
+}
+
+static void process_command(char *line, size_t len) {
+    command_line_t parsed;
+    size_t error_offset = 0;
+    line_head_t head;
+    line_head_keep(&head, line, len);
+    const json_read_error_t err = command_table_parse(line, len, &parsed, &error_offset);
+    if (err != JSON_READ_OK) {
+        log_parse_failure(&head, err, error_offset);
+        return;
+    }
+    if (parsed.cmd.type == JSON_TYPE_NONE) {
         ESP_LOGI(TAG, "Ignoring JSON without cmd field");
+        return;
+    }
+    command_request_t req;
+    g_reply_bytes = 0;
+    switch (command_table_dispatch(&parsed, &req)) {
+        case COMMAND_DISPATCHED:
+            command_table_note_reply(req.cmd, g_reply_bytes);
+            break;
+        case COMMAND_NO_CMD:
+            ESP_LOGW(TAG, "Received JSON without cmd");
+            break;
+        case COMMAND_UNKNOWN:
+            send_error_reply(req.id, "unknown_cmd");
+            break;
+        case COMMAND_BAD_ARGS:
+            send_error_reply(req.id, "bad_args");
+            break;
+    }
+}
+
+// A line holding an array of commands runs them in order and answers with
+// one array of their replies.
+static void process_batch(char *line, size_t len) {
+    json_value_t array;
+    size_t error_offset = 0;
+    line_head_t head;
+    line_head_keep(&head, line, len);
+    const json_read_error_t err = json_read_array(line, len, &array, &error_offset);
+    if (err != JSON_READ_OK) {
+        log_parse_failure(&head, err, error_offset);
+        return;
+    }
+    batch_open();
+    g_batch.active = true;
+    json_array_iter_t it;
+    json_array_iter_init(&it, &array);
+    json_value_t item;
+    while (json_array_next(&it, &item)) {
+        if (item.type != JSON_TYPE_OBJECT) {
+            ESP_LOGI(TAG, "Ignoring batch entry that is not an object");
+            continue;
+        }
+        process_command(item.ptr, item.len);
+    }
+    g_batch.active = false;
+    batch_flush();
+}
+
+static void process_line(char *line, size_t len) {
+    if (!line || len == 0) {
+        return;
+    }
+    const size_t skip = strspn(line, " \t\r");
+    if (skip < len && line[skip] == '[') {
+        process_batch(line, len);
+    } else {
+        process_command(line, len);
+    }
+}
+
+static void core_load_add(int core, uint64_t since_us) {
+    const uint64_t busy = esp_timer_get_time() - since_us;
+    portENTER_CRITICAL(&g_load_lock);
+    g_core_load[core].busy_us += busy;
+    ++g_core_load[core].wakes;
+    portEXIT_CRITICAL(&g_load_lock);
+}
+
+// Writes out every frame due. Runs on io_task only.
+static void tx_drain(void) {
+    while (true) {
+        const uint64_t now_us = esp_timer_get_time();
+        portENTER_CRITICAL(&g_tx_lock);
+        tx_frame_t *frame = tx_queue_pop(&g_tx_queue, now_us);
+        portEXIT_CRITICAL(&g_tx_lock);
+        if (!frame) {
+            break;
+        }
+        if (frame->wire_type == 0) {
+            uart_write_bytes(SUPV_UART_PORT, frame->data, frame->len);
+        } else {
+            size_t len = frame->len;
+            if (frame->wire_type == BINFRAME_TYPE_JSON && len > 0 && frame->data[len - 1] == '\n') {
+                --len;
+            }
+            const size_t wire_len = binframe_encode((binframe_type_t)frame->wire_type, (const uint8_t *)frame->data,
+                                                    len, g_tx_wire, sizeof(g_tx_wire));
+            if (wire_len > 0) {
+                uart_write_bytes(SUPV_UART_PORT, g_tx_wire, wire_len);
+            }
+        }
+        supervisor_tx_release(frame);
     }
-    cJSON_Delete(root);
 }
 
-static void uart_reader_task(void *arg) {
+// Hands a record to loop_task, blocking while it is behind until it pops a
+// record. Frames it commits meanwhile wake this wait too and are written, so
+// a reply waiting for TX room never deadlocks against it; the UART driver
+// buffers what arrives.
+static void rx_ring_put(const char *data, size_t len) {
+    bool stalled = false;
+    while (!spsc_ring_push(&g_rx_ring, data, len)) {
+        if (!stalled) {
+            stalled = true;
+            ++g_rx_stalls;
+        }
+        // Flag first and retry after, so a pop in between is not missed.
+        atomic_store(&g_rx_ring_waiting, true);
+        loop_wake(LOOP_EVENT_RX);
+        tx_drain();
+        if (spsc_ring_push(&g_rx_ring, data, len)) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    atomic_store(&g_rx_ring_waiting, false);
+    loop_wake(LOOP_EVENT_RX);
+}
+
+static void on_uart_line(char *line, size_t len, void *ctx) {
+    (void)ctx;
+    rx_ring_put(line, len);
+}
+
+static char g_rx_chunk[SUPV_RX_CHUNK];
+static char g_rx_line[SUPV_LINE_BUF];
+static line_splitter_t g_rx_splitter;
+
+static void on_uart_event(const uart_event_t *event) {
+    switch (event->type) {
+        case UART_DATA: {
+            size_t pending = 0;
+            uart_get_buffered_data_len(SUPV_UART_PORT, &pending);
+            while (pending > 0) {
+                const size_t want = pending < sizeof(g_rx_chunk) ? pending : sizeof(g_rx_chunk);
+                const int read = uart_read_bytes(SUPV_UART_PORT, g_rx_chunk, want, 0);
+                if (read <= 0) {
+                    break;
+                }
+                const uint32_t overflows = g_rx_splitter.overflows;
+                line_splitter_feed(&g_rx_splitter, g_rx_chunk, (size_t)read);
+                if (g_rx_splitter.overflows != overflows) {
+                    ESP_LOGW(TAG, "UART line overflow, dropping");
+                }
+                pending -= (size_t)read;
+            }
+            break;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // The queue is part of io_task's queue set and cannot be reset;
+            // data events still queued find nothing left to read.
+            ESP_LOGW(TAG, "UART RX overflow, flushing");
+            uart_flush_input(SUPV_UART_PORT);
+            line_splitter_reset(&g_rx_splitter);
+            break;
+        case UART_BREAK:
+            // Queued behind the lines before it; loop_task resets the
+            // subscriptions when it gets there.
+            line_splitter_reset(&g_rx_splitter);
+            rx_ring_put("", 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// Owns the UART: waits on the queue set for driver events and committed
+// frames, and handles whichever arrived.
+static void io_task(void *arg) {
     (void)arg;
-    uint8_t byte;
-    char line[SUPV_LINE_BUF];
-    size_t len = 0;
     while (true) {
-        const int read = uart_read_bytes(SUPV_UART_PORT, &byte, 1, pdMS_TO_TICKS(100));
-        if (read <= 0) {
-            continue;
+        const QueueSetMemberHandle_t member = xQueueSelectFromSet(g_io_set, portMAX_DELAY);
+        const uint64_t woke_us = esp_timer_get_time();
+        if (member == g_uart_queue) {
+            uart_event_t event;
+            if (xQueueReceive(g_uart_queue, &event, 0) == pdTRUE) {
+                on_uart_event(&event);
+            }
+        } else if (member == g_tx_ready) {
+            xSemaphoreTake(g_tx_ready, 0);
+            tx_drain();
         }
-        if (byte == '\r') {
-            continue;
+        core_load_add(SUPV_IO_CORE, woke_us);
+    }
+}
+
+// Sends the alerts due after `snapshot`. One that cannot be queued stays due;
+// returns false so the caller retries it.
+static bool send_watch_alerts(const supervisor_state_t *snapshot) {
+    const watch_mask_t mask = watch_table_update(&g_watches, snapshot);
+    for (watch_mask_t bits = mask; bits; bits &= bits - 1) {
+        const int slot = __builtin_ctz(bits);
+        const watch_t *w = &g_watches.watches[slot];
+        if (!send_alert_event(slot, w->field, w->active, watch_field_value(w->field, snapshot))) {
+            return false;
+        }
+        watch_table_mark_reported(&g_watches, slot);
+    }
+    return true;
+}
+
+static bool topic_due(const subscription_set_t *subs, uint32_t force, subscription_topic_t topic,
+                      const uint64_t *last_us, bool changed, uint64_t now_us) {
+    const subscription_t *sub = &subs->topics[topic];
+    return sub->enabled && ((force & (1u << topic)) || subscription_due(sub, last_us[topic], changed, now_us));
+}
+
+static void events_init(void) {
+    event_emitter_t *e = &g_emitter;
+    memset(e, 0, sizeof(*e));
+    e->cfg = (telemetry_delta_config_t){
+        .pack_mv_deadband = TELEMETRY_DEADBAND_PACK_MV,
+        .pack_ma_deadband = TELEMETRY_DEADBAND_PACK_MA,
+        .runtime_deadband_min = TELEMETRY_DEADBAND_RUNTIME_MIN,
+        .mcu_temp_deadband_c = TELEMETRY_DEADBAND_TEMP_C,
+        .keyframe_interval_ms = TELEMETRY_KEYFRAME_MS,
+    };
+    telemetry_delta_init(&e->delta, &e->cfg);
+}
+
+// Emits every subscribed topic and watch alert that is due. Runs whenever
+// state or subscriptions change, and otherwise polls at the fastest rate any
+// enabled topic asks for (not at all when the Pi has unsubscribed from
+// everything), or every SUPV_ALERT_RETRY_MS while an alert is stuck behind a
+// full TX queue.
+static void events_run(void) {
+    event_emitter_t *e = &g_emitter;
+    subscription_set_t subs;
+    subscriptions_take(&subs);
+    e->force |= subs.force;
+    supervisor_state_t snapshot;
+    supervisor_state_snapshot(&snapshot);
+    const uint64_t now_us = esp_timer_get_time();
+    const bool alerts_sent = send_watch_alerts(&snapshot);
+
+    const bool switch_changed = binframe_switch_bits(&snapshot.switches) != binframe_switch_bits(&e->sent.switches);
+    if (topic_due(&subs, e->force, SUBSCRIPTION_SWITCH, e->last_us, switch_changed, now_us) &&
+        send_switch_event(&snapshot.switches)) {
+        e->sent.switches = snapshot.switches;
+        e->last_us[SUBSCRIPTION_SWITCH] = now_us;
+        e->force &= ~(1u << SUBSCRIPTION_SWITCH);
+    }
+
+    const subscription_t *telemetry = &subs.topics[SUBSCRIPTION_TELEMETRY];
+    if (!telemetry->enabled) {
+        e->carry = 0;
+    } else if (e->force & (1u << SUBSCRIPTION_TELEMETRY)) {
+        // (Re)subscribed: start over with a keyframe at the new interval.
+        e->cfg.keyframe_interval_ms = telemetry->max_interval_ms;
+        e->cfg.fields = telemetry->fields;
+        telemetry_delta_init(&e->delta, &e->cfg);
+        e->carry = 0;
+        e->force &= ~(1u << SUBSCRIPTION_TELEMETRY);
+        e->last_us[SUBSCRIPTION_TELEMETRY] = 0;
+    }
+    if (telemetry->enabled && (e->last_us[SUBSCRIPTION_TELEMETRY] == 0 ||
+                               now_us - e->last_us[SUBSCRIPTION_TELEMETRY] >=
+                                   (uint64_t)telemetry->min_interval_ms * 1000ULL)) {
+        telemetry_mask_t mask = telemetry_delta_update(&e->delta, &snapshot, now_us) | e->carry;
+        uint32_t unsent = 0;
+        if (supervisor_tx_withdraw(TX_PRIO_TELEMETRY, &unsent)) {
+            // The previous frame never left; fold its fields into this one.
+            mask |= unsent & (e->delta.cfg.fields | TELEMETRY_FIELD_UPTIME_S);
+        }
+        e->carry = 0;
+        if (mask && !send_telemetry_event(&snapshot, now_us, mask)) {
+            e->carry = mask;
+        }
+        e->last_us[SUBSCRIPTION_TELEMETRY] = now_us;
+    }
+
+    const bool heltec_changed = strncmp(snapshot.heltec, e->sent.heltec, sizeof(e->sent.heltec)) != 0;
+    if (topic_due(&subs, e->force, SUBSCRIPTION_HELTEC, e->last_us, heltec_changed, now_us) &&
+        send_heltec_event(&snapshot)) {
+        memcpy(e->sent.heltec, snapshot.heltec, sizeof(e->sent.heltec));
+        e->last_us[SUBSCRIPTION_HELTEC] = now_us;
+        e->force &= ~(1u << SUBSCRIPTION_HELTEC);
+    }
+
+    const bool unread_changed =
+        snapshot.unread_ext != e->sent.unread_ext || snapshot.last_mesh_event_us != e->sent.last_mesh_event_us;
+    if (topic_due(&subs, e->force, SUBSCRIPTION_UNREAD, e->last_us, unread_changed, now_us) &&
+        send_unread_event(&snapshot, now_us)) {
+        e->sent.unread_ext = snapshot.unread_ext;
+        e->sent.last_mesh_event_us = snapshot.last_mesh_event_us;
+        e->last_us[SUBSCRIPTION_UNREAD] = now_us;
+        e->force &= ~(1u << SUBSCRIPTION_UNREAD);
+    }
+
+    const bool watchdog_changed = strncmp(snapshot.watchdog, e->sent.watchdog, sizeof(e->sent.watchdog)) != 0;
+    if (topic_due(&subs, e->force, SUBSCRIPTION_WATCHDOG, e->last_us, watchdog_changed, now_us) &&
+        send_watchdog_event(&snapshot, now_us)) {
+        memcpy(e->sent.watchdog, snapshot.watchdog, sizeof(e->sent.watchdog));
+        e->last_us[SUBSCRIPTION_WATCHDOG] = now_us;
+        e->force &= ~(1u << SUBSCRIPTION_WATCHDOG);
+    }
+
+    // Forced sends of topics unsubscribed meanwhile are moot.
+    for (int i = 0; i < SUBSCRIPTION_TOPIC_COUNT; ++i) {
+        if (!subs.topics[i].enabled) {
+            e->force &= ~(1u << i);
+        }
+    }
+    uint32_t poll_ms = subscription_poll_ms(&subs, SUPV_EVENT_POLL_MIN_MS, TELEMETRY_PERIOD_MS);
+    if (!alerts_sent && (!poll_ms || poll_ms > SUPV_ALERT_RETRY_MS)) {
+        poll_ms = SUPV_ALERT_RETRY_MS;
+    }
+    if (poll_ms) {
+        timer_wheel_arm(&g_wheel, &g_events_timer, loop_now_ms() + poll_ms, 0);
+    } else {
+        timer_wheel_cancel(&g_wheel, &g_events_timer);
+    }
+}
+
+static void on_events_timer(wheel_timer_t *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    events_run();
+}
+
+// Times out deferred requests that could not be completed in time.
+static void on_pending_timer(wheel_timer_t *t, void *ctx) {
+    (void)ctx;
+    const uint64_t now_us = esp_timer_get_time();
+    pending_entry_t req;
+    while (pending_take_expired(&g_pending, now_us, &req)) {
+        ESP_LOGW(TAG, "Deferred request %s timed out", req.id);
+        send_deferred_error(&req, "timeout");
+    }
+    loop_timer_at(t, pending_next_deadline(&g_pending));
+}
+
+// poweroff_ok and heartbeat edges; `arg` is the event type. The loop reads
+// the level itself, so a dropped edge is caught up by the next one.
+static void IRAM_ATTR poweroff_gpio_isr(void *arg) {
+    const loop_event_t ev = {.type = LOOP_EVENT_POWEROFF, .poweroff.type = (poweroff_event_type_t)(uintptr_t)arg};
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(g_loop_queue, &ev, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void supervisor_poweroff_init(void) {
+    const gpio_config_t outputs = {
+        .pin_bit_mask = (1ULL << SUPV_GPIO_PI_RAIL) | (1ULL << SUPV_GPIO_CHARGER_EN),
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    ESP_ERROR_CHECK(gpio_config(&outputs));
+    ESP_ERROR_CHECK(gpio_set_level(SUPV_GPIO_PI_RAIL, 1));
+    ESP_ERROR_CHECK(gpio_set_level(SUPV_GPIO_CHARGER_EN, 1));
+    const gpio_config_t poweroff_ok = {
+        .pin_bit_mask = 1ULL << SUPV_GPIO_POWEROFF_OK,
+        .mode = GPIO_MODE_INPUT,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&poweroff_ok));
+    // The heartbeat only matters while halting. Adding its handler enables
+    // the interrupt, so it stays without a trigger until poweroff_apply
+    // gives it one.
+    const gpio_config_t heartbeat = {
+        .pin_bit_mask = 1ULL << SUPV_GPIO_HEARTBEAT,
+        .mode = GPIO_MODE_INPUT,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&heartbeat));
+    ESP_ERROR_CHECK(
+        gpio_isr_handler_add(SUPV_GPIO_POWEROFF_OK, poweroff_gpio_isr, (void *)POWEROFF_EVENT_POWEROFF_OK));
+    ESP_ERROR_CHECK(
+        gpio_isr_handler_add(SUPV_GPIO_HEARTBEAT, poweroff_gpio_isr, (void *)POWEROFF_EVENT_HEARTBEAT));
+}
+
+static debounce_mask_t switch_levels(void) {
+    debounce_mask_t levels = 0;
+    for (size_t i = 0; i < SWITCH_INPUT_COUNT; ++i) {
+        if (gpio_get_level(k_switch_inputs[i].gpio)) {
+            levels |= 1u << i;
+        }
+    }
+    return levels;
+}
+
+static void switch_intr_set(debounce_mask_t inputs, bool enabled) {
+    for (; inputs; inputs &= inputs - 1) {
+        const gpio_num_t gpio = k_switch_inputs[__builtin_ctz(inputs)].gpio;
+        if (enabled) {
+            gpio_intr_enable(gpio);
+        } else {
+            gpio_intr_disable(gpio);
+        }
+    }
+}
+
+static void switches_publish(debounce_mask_t levels) {
+    uint8_t bits = 0;
+    for (size_t i = 0; i < SWITCH_INPUT_COUNT; ++i) {
+        if (!(levels & (1u << i))) {
+            bits |= k_switch_inputs[i].bit;
+        }
+    }
+    const supervisor_switch_state_t sw = binframe_switch_from_bits(bits);
+    supervisor_state_write_begin();
+    g_state.switches = sw;
+    supervisor_state_write_end();
+}
+
+// First edge of a window: masks the input until the loop has read it.
+static void IRAM_ATTR switch_isr(void *arg) {
+    const size_t input = (size_t)(uintptr_t)arg;
+    gpio_intr_disable(k_switch_inputs[input].gpio);
+    atomic_fetch_or(&g_switch_irqs, 1u << input);
+    BaseType_t woken = pdFALSE;
+    loop_wake_from_isr(LOOP_EVENT_SWITCH, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void supervisor_switch_init(void) {
+    uint64_t pins = 0;
+    for (size_t i = 0; i < SWITCH_INPUT_COUNT; ++i) {
+        pins |= 1ULL << k_switch_inputs[i].gpio;
+    }
+    const gpio_config_t cfg = {
+        .pin_bit_mask = pins,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&cfg));
+    for (size_t i = 0; i < SWITCH_INPUT_COUNT; ++i) {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(k_switch_inputs[i].gpio, switch_isr, (void *)(uintptr_t)i));
+    }
+}
+
+// Debounces the switch inputs and publishes their state, which the event
+// emitter turns into a switch event. Runs on a switch interrupt and when
+// g_switch_timer ends a settle window; idle while no input moves.
+static void switches_service(void) {
+    debouncer_t *deb = &g_debouncer;
+    const uint64_t now_us = esp_timer_get_time();
+    debounce_interrupts(deb, atomic_exchange(&g_switch_irqs, 0), now_us);
+    debounce_mask_t unmask;
+    if (debounce_settle(deb, switch_levels(), now_us, &unmask)) {
+        switches_publish(deb->stable);
+    }
+    if (unmask) {
+        switch_intr_set(unmask, true);
+        // An edge between sampling and unmasking raised no interrupt.
+        const debounce_mask_t moved = (switch_levels() ^ deb->stable) & unmask;
+        if (moved) {
+            switch_intr_set(moved, false);
+            debounce_interrupts(deb, moved, now_us);
         }
-        if (byte == '\n') {
-            line[len] = '\0';
-            if (len > 0) {
-                process_line(line);
+    }
+    loop_timer_at(&g_switch_timer, deb->deadline_us);
+}
+
+static void on_switch_timer(wheel_timer_t *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    switches_service();
+}
+
+// DMA end-of-frame interrupt; wakes the loop once per batch of frames.
+static bool IRAM_ATTR adc_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                    void *user_data) {
+    (void)handle;
+    (void)edata;
+    (void)user_data;
+    static uint32_t frames;
+    if (++frames < SUPV_ADC_FRAMES_PER_WAKE) {
+        return false;
+    }
+    frames = 0;
+    BaseType_t woken = pdFALSE;
+    loop_wake_from_isr(LOOP_EVENT_ADC, &woken);
+    return woken == pdTRUE;
+}
+
+// The supervisor still runs without pack measurements, so a failure here
+// is logged rather than fatal.
+static bool supervisor_adc_init(void) {
+    const adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = SUPV_ADC_POOL_BYTES,
+        .conv_frame_size = SUPV_ADC_FRAME_BYTES,
+    };
+    esp_err_t err = adc_continuous_new_handle(&handle_cfg, &g_adc);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Pack ADC unavailable: %s", esp_err_to_name(err));
+        return false;
+    }
+    adc_digi_pattern_config_t pattern[2];
+    const adc_channel_t channels[2] = {SUPV_ADC_PACK_MV_CHANNEL, SUPV_ADC_PACK_MA_CHANNEL};
+    for (int i = 0; i < 2; ++i) {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = SUPV_ADC_ATTEN,
+            .channel = channels[i],
+            .unit = ADC_UNIT_1,
+            .bit_width = ADC_BITWIDTH_12,
+        };
+    }
+    const adc_continuous_config_t cfg = {
+        .pattern_num = 2,
+        .adc_pattern = pattern,
+        .sample_freq_hz = SUPV_ADC_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    const adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .atten = SUPV_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_12,
+        .default_vref = 1100,
+    };
+    const adc_continuous_evt_cbs_t cbs = {.on_conv_done = adc_conv_done};
+    ESP_ERROR_CHECK(adc_continuous_config(g_adc, &cfg));
+    ESP_ERROR_CHECK(adc_cali_create_scheme_line_fitting(&cali_cfg, &g_adc_cali));
+    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(g_adc, &cbs, NULL));
+    return true;
+}
+
+static uint32_t gauge_saved_check(const gauge_saved_t *s) {
+    return ~(s->magic ^ s->capacity_mah ^ (uint32_t)s->charge_mams ^ (uint32_t)((uint64_t)s->charge_mams >> 32));
+}
+
+static void gauge_save(const fuel_gauge_t *gauge) {
+    g_gauge_saved.magic = SUPV_GAUGE_SAVED_MAGIC;
+    g_gauge_saved.capacity_mah = SUPV_GAUGE_CAPACITY_MAH;
+    g_gauge_saved.charge_mams = gauge->charge_mams;
+    g_gauge_saved.check = gauge_saved_check(&g_gauge_saved);
+}
+
+static void gauge_restore(fuel_gauge_t *gauge) {
+    if (g_gauge_saved.magic != SUPV_GAUGE_SAVED_MAGIC || g_gauge_saved.capacity_mah != SUPV_GAUGE_CAPACITY_MAH ||
+        g_gauge_saved.check != gauge_saved_check(&g_gauge_saved)) {
+        return;
+    }
+    fuel_gauge_restore(gauge, g_gauge_saved.charge_mams);
+    ESP_LOGI(TAG, "Pack charge restored at %d%%", fuel_gauge_pct(gauge));
+}
+
+static void pack_measure(const adc_filter_t *volts, const adc_filter_t *amps, int *pack_mv, int *pack_ma) {
+    int volts_mv = 0;
+    int amps_mv = 0;
+    adc_cali_raw_to_voltage(g_adc_cali, adc_filter_raw(volts), &volts_mv);
+    adc_cali_raw_to_voltage(g_adc_cali, adc_filter_raw(amps), &amps_mv);
+    *pack_mv = volts_mv * SUPV_PACK_DIVIDER_NUM / SUPV_PACK_DIVIDER_DEN;
+    *pack_ma = (amps_mv - SUPV_PACK_SHUNT_REF_MV) * SUPV_PACK_MA_PER_MV;
+}
+
+static void pack_publish(int pack_mv, int pack_ma, const fuel_gauge_t *gauge) {
+    supervisor_state_write_begin();
+    g_state.pack_mv = pack_mv;
+    g_state.pack_ma = pack_ma;
+    g_state.battery_pct = fuel_gauge_pct(gauge);
+    g_state.time_to_empty_min = fuel_gauge_time_to_empty_min(gauge);
+    g_state.time_to_full_min = fuel_gauge_time_to_full_min(gauge);
+    supervisor_state_write_end();
+}
+
+static void adc_start(void) {
+    const adc_filter_config_t filter_cfg = {.oversample = SUPV_ADC_OVERSAMPLE, .iir_shift = SUPV_ADC_IIR_SHIFT};
+    adc_filter_init(&g_pack_volts, &filter_cfg);
+    adc_filter_init(&g_pack_amps, &filter_cfg);
+    const fuel_gauge_config_t gauge_cfg = {
+        .capacity_mah = SUPV_GAUGE_CAPACITY_MAH,
+        .r_internal_mohm = SUPV_GAUGE_R_INTERNAL_MOHM,
+        .rest_ma = SUPV_GAUGE_REST_MA,
+        .rest_ms = SUPV_GAUGE_REST_MS,
+        .ocv_shift = SUPV_GAUGE_OCV_SHIFT,
+        .rate_shift = SUPV_GAUGE_RATE_SHIFT,
+        .ocv = k_pack_ocv,
+        .ocv_count = sizeof(k_pack_ocv) / sizeof(k_pack_ocv[0]),
+    };
+    fuel_gauge_init(&g_gauge, &gauge_cfg);
+    gauge_restore(&g_gauge);
+    ESP_ERROR_CHECK(adc_continuous_start(g_adc));
+    timer_wheel_arm(&g_wheel, &g_adc_publish_timer, loop_now_ms() + SUPV_ADC_PUBLISH_MS, SUPV_ADC_PUBLISH_MS);
+}
+
+// Drains the DMA pool, filters both pack channels and, once both filters have
+// settled, measures the pack and feeds the charge estimate.
+static void adc_drain(void) {
+    uint32_t len = 0;
+    while (adc_continuous_read(g_adc, g_adc_frame, sizeof(g_adc_frame), &len, 0) == ESP_OK) {
+        const adc_digi_output_data_t *results = (const adc_digi_output_data_t *)g_adc_frame;
+        for (uint32_t i = 0; i < len / sizeof(adc_digi_output_data_t); ++i) {
+            if (results[i].type1.channel == SUPV_ADC_PACK_MV_CHANNEL) {
+                adc_filter_push(&g_pack_volts, results[i].type1.data);
+            } else if (results[i].type1.channel == SUPV_ADC_PACK_MA_CHANNEL) {
+                adc_filter_push(&g_pack_amps, results[i].type1.data);
             }
-            len = 0;
-            continue;
         }
-        if (len + 1 >= sizeof(line)) {
-            ESP_LOGW(TAG, "UART line overflow, dropping");
-            len = 0;
+    }
+    if (!adc_filter_ready(&g_pack_volts) || !adc_filter_ready(&g_pack_amps)) {
+        return;
+    }
+    pack_measure(&g_pack_volts, &g_pack_amps, &g_pack_mv, &g_pack_ma);
+    fuel_gauge_update(&g_gauge, g_pack_mv, g_pack_ma, esp_timer_get_time());
+    gauge_save(&g_gauge);
+}
+
+static void on_adc_publish_timer(wheel_timer_t *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    // Nothing to publish before the first measurement.
+    if (g_gauge.updates > 0) {
+        pack_publish(g_pack_mv, g_pack_ma, &g_gauge);
+    }
+}
+
+static void complete_poweroff_requests(const char *error) {
+    pending_entry_t req;
+    while (pending_take(&g_pending, PENDING_POWEROFF, &req)) {
+        if (error) {
+            send_deferred_error(&req, error);
+        } else {
+            send_poweroff_reply(&req);
+        }
+    }
+}
+
+static void poweroff_apply(const poweroff_output_t *out) {
+    if (out->actions & POWEROFF_ACTION_CHARGERS_OFF) {
+        gpio_set_level(SUPV_GPIO_CHARGER_EN, 0);
+    }
+    if (out->actions & POWEROFF_ACTION_CHARGERS_ON) {
+        gpio_set_level(SUPV_GPIO_CHARGER_EN, 1);
+    }
+    if (out->actions & POWEROFF_ACTION_HEARTBEAT_ON) {
+        gpio_set_intr_type(SUPV_GPIO_HEARTBEAT, GPIO_INTR_ANYEDGE);
+        gpio_intr_enable(SUPV_GPIO_HEARTBEAT);
+    }
+    if (out->actions & POWEROFF_ACTION_HEARTBEAT_OFF) {
+        gpio_intr_disable(SUPV_GPIO_HEARTBEAT);
+        gpio_set_intr_type(SUPV_GPIO_HEARTBEAT, GPIO_INTR_DISABLE);
+    }
+    if (out->actions & POWEROFF_ACTION_CUT_RAIL) {
+        gpio_set_level(SUPV_GPIO_PI_RAIL, 0);
+    }
+    if (out->actions & POWEROFF_ACTION_REPLY_OK) {
+        complete_poweroff_requests(NULL);
+    }
+    if (out->actions & POWEROFF_ACTION_REPLY_ERROR) {
+        complete_poweroff_requests(out->reason);
+    }
+}
+
+static void poweroff_start(void) {
+    const poweroff_config_t cfg = {
+        .prepare_ms = SUPV_POWEROFF_PREP_MS,
+        .poweroff_ok_timeout_ms = SUPV_POWEROFF_OK_TIMEOUT_MS,
+        .heartbeat_loss_ms = SUPV_POWEROFF_HEARTBEAT_LOSS_MS,
+        .halt_timeout_ms = SUPV_POWEROFF_HALT_TIMEOUT_MS,
+        .min_battery_pct = SUPV_POWEROFF_MIN_BATTERY_PCT,
+    };
+    poweroff_init(&g_poweroff, &cfg, gpio_get_level(SUPV_GPIO_POWEROFF_OK) != 0);
+}
+
+// Runs the poweroff handshake: feeds command, GPIO and timer events to the
+// state machine, carries out its actions and reports every transition.
+// g_poweroff_timer covers every timeout.
+static void poweroff_feed(poweroff_event_t *ev) {
+    if (ev->type == POWEROFF_EVENT_POWEROFF_OK) {
+        ev->level = gpio_get_level(SUPV_GPIO_POWEROFF_OK);
+    }
+    const uint64_t now_us = esp_timer_get_time();
+    const poweroff_state_t from = g_poweroff.state;
+    const poweroff_output_t out = poweroff_handle(&g_poweroff, ev, now_us);
+    poweroff_apply(&out);
+    if (out.transitioned) {
+        ESP_LOGI(TAG, "Poweroff %s -> %s%s%s", poweroff_state_name(from), poweroff_state_name(g_poweroff.state),
+                 out.reason ? ": " : "", out.reason ? out.reason : "");
+        supervisor_state_write_begin();
+        g_state.poweroff_armed = g_poweroff.state != POWEROFF_IDLE;
+        supervisor_state_write_end();
+        send_poweroff_event(g_poweroff.state, out.reason, now_us);
+    }
+    loop_timer_at(&g_poweroff_timer, out.deadline_us);
+}
+
+static void on_poweroff_timer(wheel_timer_t *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    poweroff_event_t ev = {.type = POWEROFF_EVENT_TIMER};
+    poweroff_feed(&ev);
+}
+
+static void on_state_event(const loop_event_t *ev) {
+    (void)ev;
+    events_run();
+}
+
+static void on_poweroff_event(const loop_event_t *ev) {
+    poweroff_event_t poweroff = ev->poweroff;
+    poweroff_feed(&poweroff);
+}
+
+static void on_switch_event(const loop_event_t *ev) {
+    (void)ev;
+    switches_service();
+}
+
+static void on_adc_event(const loop_event_t *ev) {
+    (void)ev;
+    adc_drain();
+}
+
+// Runs the lines io_task has framed, in order. An empty record marks a
+// break: the Pi side held the line low, as it does when it reboots or the
+// adapter is replugged, so whoever connects next starts from defaults.
+static void on_rx_event(const loop_event_t *ev) {
+    (void)ev;
+    char *line = g_rx_loop_line;
+    size_t len;
+    while (spsc_ring_pop(&g_rx_ring, line, sizeof(g_rx_loop_line) - 1, &len)) {
+        if (atomic_exchange(&g_rx_ring_waiting, false)) {
+            xTaskNotifyGive(g_io_task);
+        }
+        if (len == 0) {
+            ESP_LOGI(TAG, "UART break, restoring default subscriptions");
+            watch_table_clear(&g_watches);
+            subscriptions_reset();
             continue;
         }
-        line[len++] = (char)byte;
+        line[len] = '\0';
+        process_line(line, len);
     }
 }
 
-static void telemetry_task(void *arg) {
-    (void)arg;
+typedef void (*loop_handler_t)(const loop_event_t *ev);
+
+static const loop_handler_t k_loop_handlers[LOOP_EVENT_COUNT] = {
+    [LOOP_EVENT_RX] = on_rx_event,
+    [LOOP_EVENT_STATE] = on_state_event,
+    [LOOP_EVENT_POWEROFF] = on_poweroff_event,
+    [LOOP_EVENT_SWITCH] = on_switch_event,
+    [LOOP_EVENT_ADC] = on_adc_event,
+};
+
+static StackType_t g_io_stack[SUPV_IO_STACK];
+static StaticTask_t g_io_tcb;
+static StackType_t g_loop_stack[SUPV_LOOP_STACK];
+static StaticTask_t g_loop_tcb;
+
+// Static RAM by subsystem, held to its budget in supervisor_config.h. Driver
+// buffers allocated by ESP-IDF at boot and RTC memory are not counted.
+#define SUPV_RAM_TASKS (sizeof(g_io_stack) + sizeof(g_io_tcb) + sizeof(g_loop_stack) + sizeof(g_loop_tcb))
+#define SUPV_RAM_UART_RX                                                                                              \
+    (sizeof(g_rx_chunk) + sizeof(g_rx_line) + sizeof(g_rx_splitter) + sizeof(g_rx_ring_buf) + sizeof(g_rx_ring) +    \
+     sizeof(g_rx_loop_line))
+#define SUPV_RAM_UART_TX                                                                                              \
+    (sizeof(g_tx_queue) + sizeof(g_tx_wire) + sizeof(g_tx_free_buf) + sizeof(g_tx_ready_buf) + sizeof(g_batch))
+#define SUPV_RAM_LOOP                                                                                                 \
+    (sizeof(g_loop_queue_storage) + sizeof(g_loop_queue_buf) + sizeof(g_wheel) + sizeof(g_events_timer) +            \
+     sizeof(g_pending_timer) + sizeof(g_poweroff_timer) + sizeof(g_switch_timer) + sizeof(g_adc_publish_timer) +     \
+     sizeof(g_core_load) + sizeof(g_core_load_last))
+#define SUPV_RAM_STATE                                                                                                \
+    (sizeof(g_state) + sizeof(g_subs) + sizeof(g_emitter) + sizeof(g_pending) + sizeof(g_poweroff) +                 \
+     sizeof(g_watches) + sizeof(g_debouncer))
+#define SUPV_RAM_ADC (sizeof(g_adc_frame) + sizeof(g_pack_volts) + sizeof(g_pack_amps) + sizeof(g_gauge))
+
+_Static_assert(SUPV_RAM_TASKS <= SUPV_RAM_BUDGET_TASKS, "task stacks exceed their RAM budget");
+_Static_assert(SUPV_RAM_UART_RX <= SUPV_RAM_BUDGET_UART_RX, "UART RX buffers exceed their RAM budget");
+_Static_assert(SUPV_RAM_UART_TX <= SUPV_RAM_BUDGET_UART_TX, "UART TX buffers exceed their RAM budget");
+_Static_assert(SUPV_RAM_LOOP <= SUPV_RAM_BUDGET_LOOP, "the event loop exceeds its RAM budget");
+_Static_assert(SUPV_RAM_STATE <= SUPV_RAM_BUDGET_STATE, "supervisor state exceeds its RAM budget");
+_Static_assert(SUPV_RAM_ADC <= SUPV_RAM_BUDGET_ADC, "ADC buffers exceed their RAM budget");
+
+typedef struct {
+    const char *name;
+    size_t bytes;
+    size_t budget;
+} ram_use_t;
+
+static const ram_use_t k_ram_use[] = {
+    {"tasks", SUPV_RAM_TASKS, SUPV_RAM_BUDGET_TASKS},
+    {"uart_rx", SUPV_RAM_UART_RX, SUPV_RAM_BUDGET_UART_RX},
+    {"uart_tx", SUPV_RAM_UART_TX, SUPV_RAM_BUDGET_UART_TX},
+    {"loop", SUPV_RAM_LOOP, SUPV_RAM_BUDGET_LOOP},
+    {"state", SUPV_RAM_STATE, SUPV_RAM_BUDGET_STATE},
+    {"adc", SUPV_RAM_ADC, SUPV_RAM_BUDGET_ADC},
+};
+
+static void ram_report(void) {
+    char line[256];
+    size_t len = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+    for (size_t i = 0; i < sizeof(k_ram_use) / sizeof(k_ram_use[0]) && len < sizeof(line); ++i) {
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "%s %u/%u, ", k_ram_use[i].name,
+                                (unsigned)k_ram_use[i].bytes, (unsigned)k_ram_use[i].budget);
+        bytes += k_ram_use[i].bytes;
+        budget += k_ram_use[i].budget;
+    }
+    ESP_LOGI(TAG, "Static RAM: %stotal %u/%u bytes", line, (unsigned)bytes, (unsigned)budget);
+}
+
+// Once loop_task has started nothing may allocate: every allocation the heap
+// reports after that is counted, and loop_task logs the count whenever it
+// grows, or aborts on the first one with SUPV_HEAP_STRICT. Needs
+// CONFIG_HEAP_USE_HOOKS.
+static atomic_bool g_heap_sealed;
+static atomic_uint g_heap_steady_allocs;
+static unsigned g_heap_allocs_logged;
+
+#if CONFIG_HEAP_USE_HOOKS
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    (void)ptr;
+    (void)size;
+    (void)caps;
+    if (atomic_load_explicit(&g_heap_sealed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&g_heap_steady_allocs, 1, memory_order_relaxed);
+    }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+    (void)ptr;
+}
+#endif
+
+static void heap_check(void) {
+    const unsigned allocs = atomic_load(&g_heap_steady_allocs);
+    if (allocs == g_heap_allocs_logged) {
+        return;
+    }
+    ESP_LOGE(TAG, "Heap allocated %u times after boot", allocs);
+    if (SUPV_HEAP_STRICT) {
+        abort();
+    }
+    g_heap_allocs_logged = allocs;
+}
+
+// A queue holding events cannot join a set, and bytes may already have
+// arrived. Those events are dropped for one data event that reads everything
+// buffered.
+static bool io_set_add_uart(void) {
+    while (xQueueAddToSet(g_uart_queue, g_io_set) != pdPASS) {
+        if (uxQueueMessagesWaiting(g_uart_queue) == 0) {
+            return false;
+        }
+        xQueueReset(g_uart_queue);
+    }
+    size_t pending = 0;
+    uart_get_buffered_data_len(SUPV_UART_PORT, &pending);
+    if (pending > 0) {
+        const uart_event_t event = {.type = UART_DATA, .size = pending};
+        xQueueSend(g_uart_queue, &event, 0);
+    }
+    return true;
+}
+
+static void supervisor_loop_init(void) {
+    g_loop_queue =
+        xQueueCreateStatic(SUPV_LOOP_QUEUE_LEN, sizeof(loop_event_t), g_loop_queue_storage, &g_loop_queue_buf);
+    g_io_set = xQueueCreateSet(SUPV_UART_QUEUE_LEN + 1);
+    if (!g_loop_queue || !g_io_set || !io_set_add_uart() ||
+        xQueueAddToSet(g_tx_ready, g_io_set) != pdPASS ||
+        !spsc_ring_init(&g_rx_ring, g_rx_ring_buf, sizeof(g_rx_ring_buf))) {
+        ESP_LOGE(TAG, "Failed to set up the event loop");
+        abort();
+    }
+    timer_wheel_init(&g_wheel, loop_now_ms());
+    wheel_timer_init(&g_events_timer, on_events_timer, NULL);
+    wheel_timer_init(&g_pending_timer, on_pending_timer, NULL);
+    wheel_timer_init(&g_poweroff_timer, on_poweroff_timer, NULL);
+    wheel_timer_init(&g_switch_timer, on_switch_timer, NULL);
+    wheel_timer_init(&g_adc_publish_timer, on_adc_publish_timer, NULL);
+    line_splitter_init(&g_rx_splitter, g_rx_line, sizeof(g_rx_line), on_uart_line, NULL);
+    events_init();
+}
+
+// Runs every handler and timer: waits on its queue until the wheel's next
+// tick, dispatches whatever arrived, then fires the timers now due.
+static void loop_task(void *arg) {
+    const bool adc = (bool)(uintptr_t)arg;
+    poweroff_start();
+    debounce_init(&g_debouncer, SUPV_SWITCH_SETTLE_MS, switch_levels());
+    switches_publish(g_debouncer.stable);
+    if (adc) {
+        adc_start();
+    }
+    events_run();
+    atomic_store(&g_heap_sealed, true);
+    uint64_t woke_us = esp_timer_get_time();
     while (true) {
-        supervisor_state_t snapshot;
-        supervisor_state_snapshot(&snapshot);
-        const uint64_t now_us = esp_timer_get_time();
-        send_telemetry_event(&snapshot, now_us);
-        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_PERIOD_MS));
+        heap_check();
+        const uint64_t now_ms = loop_now_ms();
+        timer_wheel_advance(&g_wheel, now_ms);
+        const uint64_t next_ms = timer_wheel_next_tick(&g_wheel);
+        core_load_add(SUPV_APP_CORE, woke_us);
+        // Rounded up a tick, so the loop never wakes just short of a deadline.
+        const TickType_t wait = next_ms == UINT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS(next_ms - now_ms) + 1;
+        loop_event_t ev;
+        const bool received = xQueueReceive(g_loop_queue, &ev, wait) == pdTRUE;
+        woke_us = esp_timer_get_time();
+        if (received) {
+            const UBaseType_t depth = uxQueueMessagesWaiting(g_loop_queue) + 1;
+            if (depth > g_loop_queue_peak) {
+                g_loop_queue_peak = depth;
+            }
+            atomic_fetch_and(&g_loop_posted, ~(1u << ev.type));
+            k_loop_handlers[ev.type](&ev);
+        }
     }
 }
 
 void app_main(void) {
     supervisor_state_init();
+    subscriptions_reset();
+    if (!command_table_init(g_command_table, sizeof(g_command_table) / sizeof(g_command_table[0]))) {
+        ESP_LOGE(TAG, "Command table exceeds dispatch limits");
+        abort();
+    }
     supervisor_uart_init();
-    xTaskCreate(uart_reader_task, "uart_reader", 4096, NULL, 10, NULL);
-    xTaskCreate(telemetry_task, "telemetry", 4096, NULL, 5, NULL);
-    supervisor_switch_state_t sw = supervisor_switch_snapshot();
-    send_switch_event(&sw);
+    supervisor_tx_init();
+    supervisor_loop_init();
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    supervisor_poweroff_init();
+    supervisor_switch_init();
+    const bool adc = supervisor_adc_init();
+    ram_report();
+    g_io_task = xTaskCreateStaticPinnedToCore(io_task, "io", SUPV_IO_STACK, NULL, SUPV_IO_PRIO, g_io_stack,
+                                              &g_io_tcb, SUPV_IO_CORE);
+    xTaskCreateStaticPinnedToCore(loop_task, "loop", SUPV_LOOP_STACK, (void *)(uintptr_t)adc, SUPV_LOOP_PRIO,
+                                  g_loop_stack, &g_loop_tcb, SUPV_APP_CORE);
 }
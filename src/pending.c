@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+#include "pending.h"
+
+#include <string.h>
+
+void pending_init(pending_table_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+bool pending_add(pending_table_t *t, pending_kind_t kind, const char *id, uint64_t deadline_us) {
+    const size_t id_len = id ? strlen(id) : 0;
+    if (id_len >= PENDING_ID_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < PENDING_MAX; ++i) {
+        pending_entry_t *e = &t->entries[i];
+        if (e->in_use) {
+            continue;
+        }
+        *e = (pending_entry_t){
+            .in_use = true,
+            .has_id = id != NULL,
+            .kind = kind,
+            .seq = t->next_seq++,
+            .deadline_us = deadline_us,
+        };
+        memcpy(e->id, id ? id : "", id_len + 1);
+        return true;
+    }
+    return false;
+}
+
+static bool take(pending_entry_t *e, pending_entry_t *out) {
+    if (!e) {
+        return false;
+    }
+    *out = *e;
+    e->in_use = false;
+    return true;
+}
+
+bool pending_take(pending_table_t *t, pending_kind_t kind, pending_entry_t *out) {
+    pending_entry_t *oldest = NULL;
+    for (size_t i = 0; i < PENDING_MAX; ++i) {
+        pending_entry_t *e = &t->entries[i];
+        // Sequence numbers wrap; compare by distance.
+        if (e->in_use && e->kind == kind && (!oldest || (int32_t)(e->seq - oldest->seq) < 0)) {
+            oldest = e;
+        }
+    }
+    return take(oldest, out);
+}
+
+bool pending_take_expired(pending_table_t *t, uint64_t now_us, pending_entry_t *out) {
+    for (size_t i = 0; i < PENDING_MAX; ++i) {
+        pending_entry_t *e = &t->entries[i];
+        if (e->in_use && e->deadline_us <= now_us) {
+            return take(e, out);
+        }
+    }
+    return false;
+}
+
+uint64_t pending_next_deadline(const pending_table_t *t) {
+    uint64_t next = 0;
+    for (size_t i = 0; i < PENDING_MAX; ++i) {
+        const pending_entry_t *e = &t->entries[i];
+        if (e->in_use && (next == 0 || e->deadline_us < next)) {
+            next = e->deadline_us;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Requests whose reply is sent later by a worker rather than by the handler
+// that received them. A bounded table: each entry remembers the request id
+// and the time by which it must be answered. Free of ESP-IDF dependencies;
+// the caller owns locking.
+#define PENDING_MAX 4
+#define PENDING_ID_MAX 32
+
+typedef enum {
+    PENDING_POWEROFF = 0,
+} pending_kind_t;
+
+typedef struct {
+    bool in_use;
+    // Whether the request had an id; `id` is empty otherwise.
+    bool has_id;
+    pending_kind_t kind;
+    uint32_t seq;
+    uint64_t deadline_us;
+    char id[PENDING_ID_MAX];
+} pending_entry_t;
+
+typedef struct {
+    pending_entry_t entries[PENDING_MAX];
+    uint32_t next_seq;
+} pending_table_t;
+
+void pending_init(pending_table_t *t);
+
+// Fails when the table is full or `id` does not fit.
+bool pending_add(pending_table_t *t, pending_kind_t kind, const char *id, uint64_t deadline_us);
+
+// Removes the oldest request of `kind` into `out`.
+bool pending_take(pending_table_t *t, pending_kind_t kind, pending_entry_t *out);
+
+// Removes a request whose deadline has passed into `out`.
+bool pending_take_expired(pending_table_t *t, uint64_t now_us, pending_entry_t *out);
+
+// Earliest deadline of any request, or 0 when none is pending.
+uint64_t pending_next_deadline(const pending_table_t *t);
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+#include "poweroff.h"
+
+#include <string.h>
+
+static const char *const k_state_names[POWEROFF_STATE_COUNT] = {
+    [POWEROFF_IDLE] = "idle",
+    [POWEROFF_PREPARING] = "preparing",
+    [POWEROFF_ARMED] = "armed",
+    [POWEROFF_HALTING] = "halting",
+    [POWEROFF_OFF] = "off",
+};
+
+const char *poweroff_state_name(poweroff_state_t state) {
+    return state < POWEROFF_STATE_COUNT ? k_state_names[state] : "unknown";
+}
+
+void poweroff_init(poweroff_fsm_t *fsm, const poweroff_config_t *cfg, bool poweroff_ok) {
+    memset(fsm, 0, sizeof(*fsm));
+    fsm->cfg = *cfg;
+    fsm->poweroff_ok = poweroff_ok;
+}
+
+static uint64_t after_ms(uint64_t now_us, uint32_t ms) {
+    return now_us + (uint64_t)ms * 1000ULL;
+}
+
+static void enter(poweroff_fsm_t *fsm, poweroff_output_t *out, poweroff_state_t state, const char *reason) {
+    fsm->state = state;
+    ++fsm->transitions;
+    out->transitioned = true;
+    out->reason = reason;
+}
+
+// Back to idle from any active state.
+static void abort_to_idle(poweroff_fsm_t *fsm, poweroff_output_t *out, const char *reason) {
+    if (fsm->state == POWEROFF_PREPARING) {
+        out->actions |= POWEROFF_ACTION_REPLY_ERROR;
+    }
+    if (fsm->state == POWEROFF_HALTING) {
+        out->actions |= POWEROFF_ACTION_HEARTBEAT_OFF;
+    }
+    out->actions |= POWEROFF_ACTION_CHARGERS_ON;
+    fsm->deadline_us = 0;
+    enter(fsm, out, POWEROFF_IDLE, reason);
+}
+
+static void start_halting(poweroff_fsm_t *fsm, poweroff_output_t *out, uint64_t now_us) {
+    fsm->heartbeat_deadline_us = after_ms(now_us, fsm->cfg.heartbeat_loss_ms);
+    fsm->halt_deadline_us = after_ms(now_us, fsm->cfg.halt_timeout_ms);
+    out->actions |= POWEROFF_ACTION_HEARTBEAT_ON;
+    enter(fsm, out, POWEROFF_HALTING, NULL);
+}
+
+static void on_timer(poweroff_fsm_t *fsm, poweroff_output_t *out, uint64_t now_us) {
+    if (fsm->deadline_us == 0 || now_us < fsm->deadline_us) {
+        return;
+    }
+    switch (fsm->state) {
+        case POWEROFF_PREPARING:
+            out->actions |= POWEROFF_ACTION_REPLY_OK;
+            if (fsm->poweroff_ok) {
+                start_halting(fsm, out, now_us);
+            } else {
+                fsm->deadline_us = after_ms(now_us, fsm->cfg.poweroff_ok_timeout_ms);
+                enter(fsm, out, POWEROFF_ARMED, NULL);
+            }
+            break;
+        case POWEROFF_ARMED: abort_to_idle(fsm, out, "poweroff_ok_timeout"); break;
+        case POWEROFF_HALTING:
+            if (now_us >= fsm->heartbeat_deadline_us || now_us >= fsm->halt_deadline_us) {
+                out->actions |= POWEROFF_ACTION_HEARTBEAT_OFF | POWEROFF_ACTION_CUT_RAIL;
+                enter(fsm, out, POWEROFF_OFF,
+                      now_us >= fsm->heartbeat_deadline_us ? "heartbeat_lost" : "halt_timeout");
+            }
+            break;
+        default: break;
+    }
+}
+
+poweroff_output_t poweroff_handle(poweroff_fsm_t *fsm, const poweroff_event_t *ev, uint64_t now_us) {
+    poweroff_output_t out = {0};
+    switch (ev->type) {
+        case POWEROFF_EVENT_ARM:
+            if (fsm->state == POWEROFF_IDLE) {
+                if (ev->battery_pct >= 0 && ev->battery_pct < fsm->cfg.min_battery_pct) {
+                    out.actions |= POWEROFF_ACTION_REPLY_ERROR;
+                    out.reason = "battery_low";
+                    break;
+                }
+                out.actions |= POWEROFF_ACTION_CHARGERS_OFF;
+                fsm->deadline_us = after_ms(now_us, fsm->cfg.prepare_ms);
+                enter(fsm, &out, POWEROFF_PREPARING, NULL);
+            } else if (fsm->state != POWEROFF_PREPARING) {
+                // Already safe; answered as soon as it was asked.
+                out.actions |= POWEROFF_ACTION_REPLY_OK;
+            }
+            break;
+        case POWEROFF_EVENT_CANCEL:
+            if (fsm->state != POWEROFF_IDLE && fsm->state != POWEROFF_OFF) {
+                abort_to_idle(fsm, &out, "cancelled");
+            }
+            break;
+        case POWEROFF_EVENT_TIMER: on_timer(fsm, &out, now_us); break;
+        case POWEROFF_EVENT_POWEROFF_OK:
+            fsm->poweroff_ok = ev->level != 0;
+            if (fsm->state == POWEROFF_ARMED && fsm->poweroff_ok) {
+                start_halting(fsm, &out, now_us);
+            } else if (fsm->state == POWEROFF_HALTING && !fsm->poweroff_ok) {
+                abort_to_idle(fsm, &out, "poweroff_ok_dropped");
+            }
+            break;
+        case POWEROFF_EVENT_HEARTBEAT:
+            if (fsm->state == POWEROFF_HALTING) {
+                fsm->heartbeat_deadline_us = after_ms(now_us, fsm->cfg.heartbeat_loss_ms);
+            }
+            break;
+    }
+    if (fsm->state == POWEROFF_HALTING) {
+        fsm->deadline_us = fsm->heartbeat_deadline_us < fsm->halt_deadline_us ? fsm->heartbeat_deadline_us
+                                                                               : fsm->halt_deadline_us;
+    } else if (fsm->state == POWEROFF_OFF) {
+        fsm->deadline_us = 0;
+    }
+    out.deadline_us = fsm->deadline_us;
+    return out;
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The poweroff handshake with the Pi as a state machine:
+//
+//   idle -arm-> preparing -prepare_ms-> armed -poweroff_ok high-> halting
+//        -heartbeat lost-> off
+//
+// Preparing stops the chargers; arm_poweroff is answered on entering armed.
+// Halting ends once the heartbeat GPIO has been quiet for heartbeat_loss_ms,
+// or after halt_timeout_ms regardless, and the rail is cut. A cancel, the
+// poweroff_ok timeout or poweroff_ok dropping again returns to idle. Inputs
+// arrive as events and outputs are returned as actions for the caller to
+// carry out, together with the next time a timer event is due. Free of
+// ESP-IDF dependencies; the caller owns locking.
+typedef enum {
+    POWEROFF_IDLE = 0,
+    POWEROFF_PREPARING,
+    POWEROFF_ARMED,
+    POWEROFF_HALTING,
+    POWEROFF_OFF,
+    POWEROFF_STATE_COUNT,
+} poweroff_state_t;
+
+typedef enum {
+    // arm_poweroff received; `battery_pct` is the current charge, -1 if it
+    // is not known (which does not hold the shutdown up).
+    POWEROFF_EVENT_ARM = 0,
+    POWEROFF_EVENT_CANCEL,
+    // The timer requested through poweroff_output_t.deadline_us expired.
+    // Early or stale timer events are ignored.
+    POWEROFF_EVENT_TIMER,
+    // The poweroff_ok GPIO changed; `level` is its new level.
+    POWEROFF_EVENT_POWEROFF_OK,
+    POWEROFF_EVENT_HEARTBEAT,
+} poweroff_event_type_t;
+
+typedef struct {
+    poweroff_event_type_t type;
+    int level;
+    int battery_pct;
+} poweroff_event_t;
+
+typedef struct {
+    uint32_t prepare_ms;
+    // How long the Pi has to raise poweroff_ok after the reply.
+    uint32_t poweroff_ok_timeout_ms;
+    uint32_t heartbeat_loss_ms;
+    uint32_t halt_timeout_ms;
+    // Below this the pack may brown out before the Pi has halted, so
+    // arm_poweroff is refused.
+    int min_battery_pct;
+} poweroff_config_t;
+
+enum {
+    POWEROFF_ACTION_CHARGERS_OFF = 1u << 0,
+    POWEROFF_ACTION_CHARGERS_ON = 1u << 1,
+    POWEROFF_ACTION_HEARTBEAT_ON = 1u << 2,
+    POWEROFF_ACTION_HEARTBEAT_OFF = 1u << 3,
+    POWEROFF_ACTION_CUT_RAIL = 1u << 4,
+    // Answer every waiting arm_poweroff with poweroff_ok...
+    POWEROFF_ACTION_REPLY_OK = 1u << 5,
+    // ...or with the error `reason`.
+    POWEROFF_ACTION_REPLY_ERROR = 1u << 6,
+};
+
+typedef struct {
+    uint32_t actions;
+    bool transitioned;
+    // Why the state changed or the request was refused; NULL otherwise.
+    const char *reason;
+    // When to deliver the next timer event, or 0 for none.
+    uint64_t deadline_us;
+} poweroff_output_t;
+
+typedef struct {
+    poweroff_config_t cfg;
+    poweroff_state_t state;
+    bool poweroff_ok;
+    uint64_t deadline_us;
+    // While halting: the heartbeat deadline and the overall cut-off.
+    uint64_t heartbeat_deadline_us;
+    uint64_t halt_deadline_us;
+    uint32_t transitions;
+} poweroff_fsm_t;
+
+void poweroff_init(poweroff_fsm_t *fsm, const poweroff_config_t *cfg, bool poweroff_ok);
+poweroff_output_t poweroff_handle(poweroff_fsm_t *fsm, const poweroff_event_t *ev, uint64_t now_us);
+const char *poweroff_state_name(poweroff_state_t state);
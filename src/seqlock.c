@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: MIT
+#include "seqlock.h"
+
+void seqlock_write_begin(seqlock_t *s) {
+    atomic_store_explicit(&s->seq, atomic_load_explicit(&s->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void seqlock_write_end(seqlock_t *s) {
+    atomic_store_explicit(&s->seq, atomic_load_explicit(&s->seq, memory_order_relaxed) + 1, memory_order_release);
+}
+
+unsigned seqlock_read_begin(const seqlock_t *s) {
+    return atomic_load_explicit(&s->seq, memory_order_acquire);
+}
+
+bool seqlock_read_retry(const seqlock_t *s, unsigned begin) {
+    atomic_thread_fence(memory_order_acquire);
+    return (begin & 1u) || atomic_load_explicit(&s->seq, memory_order_relaxed) != begin;
+}
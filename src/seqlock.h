@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Sequence counter for data with one writer at a time and readers that must
+// never block. The writer bumps it to odd before touching the data and back
+// to even after; a reader copies the data between seqlock_read_begin and
+// seqlock_read_retry and starts over if the count was odd or moved. Writers
+// serialize among themselves. Free of ESP-IDF dependencies.
+typedef struct {
+    atomic_uint seq;
+} seqlock_t;
+
+void seqlock_write_begin(seqlock_t *s);
+void seqlock_write_end(seqlock_t *s);
+
+unsigned seqlock_read_begin(const seqlock_t *s);
+// True if a write overlapped the copy taken since `begin`.
+bool seqlock_read_retry(const seqlock_t *s, unsigned begin);
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+#include "spsc_ring.h"
+
+#include <string.h>
+
+bool spsc_ring_init(spsc_ring_t *r, uint8_t *buf, size_t size) {
+    if (!buf || size < 4 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->size = size;
+    return true;
+}
+
+static void copy_in(spsc_ring_t *r, size_t pos, const uint8_t *src, size_t len) {
+    const size_t at = pos & (r->size - 1);
+    const size_t first = len < r->size - at ? len : r->size - at;
+    memcpy(r->buf + at, src, first);
+    memcpy(r->buf, src + first, len - first);
+}
+
+static void copy_out(const spsc_ring_t *r, size_t pos, uint8_t *dst, size_t len) {
+    const size_t at = pos & (r->size - 1);
+    const size_t first = len < r->size - at ? len : r->size - at;
+    memcpy(dst, r->buf + at, first);
+    memcpy(dst + first, r->buf, len - first);
+}
+
+bool spsc_ring_push(spsc_ring_t *r, const void *data, size_t len) {
+    const size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    const size_t used = tail - head;
+    if (len > UINT16_MAX || SPSC_RING_HEADER + len > r->size - used) {
+        ++r->full;
+        return false;
+    }
+    const uint8_t header[SPSC_RING_HEADER] = {(uint8_t)len, (uint8_t)(len >> 8)};
+    copy_in(r, tail, header, SPSC_RING_HEADER);
+    copy_in(r, tail + SPSC_RING_HEADER, data, len);
+    atomic_store_explicit(&r->tail, tail + SPSC_RING_HEADER + len, memory_order_release);
+    if (used + SPSC_RING_HEADER + len > r->peak) {
+        r->peak = used + SPSC_RING_HEADER + len;
+    }
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *r, void *out, size_t cap, size_t *len) {
+    const size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    uint8_t header[SPSC_RING_HEADER];
+    copy_out(r, head, header, SPSC_RING_HEADER);
+    const size_t record = (size_t)header[0] | (size_t)header[1] << 8;
+    *len = record < cap ? record : cap;
+    copy_out(r, head + SPSC_RING_HEADER, out, *len);
+    atomic_store_explicit(&r->head, head + SPSC_RING_HEADER + record, memory_order_release);
+    return true;
+}
+
+size_t spsc_ring_used(const spsc_ring_t *r) {
+    // Head first: it never passes a tail read after it.
+    const size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free ring of variable-length records between exactly one producer and
+// one consumer, which may run on different cores. Each record is a 16-bit
+// length followed by its bytes, wrapping around the end of the buffer; empty
+// records are allowed. Only `tail` is written by the producer and only `head`
+// by the consumer, so neither side ever waits on the other. Free of ESP-IDF
+// dependencies.
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    // Free-running byte counts; tail - head bytes are in use.
+    atomic_size_t head;
+    atomic_size_t tail;
+    // Producer-side: most bytes ever in use, and pushes refused for room.
+    size_t peak;
+    uint32_t full;
+} spsc_ring_t;
+
+#define SPSC_RING_HEADER 2
+
+// `size` must be a power of two of at least 4 bytes.
+bool spsc_ring_init(spsc_ring_t *r, uint8_t *buf, size_t size);
+
+// Appends a record, or returns false without touching the ring when it does
+// not fit. Producer only.
+bool spsc_ring_push(spsc_ring_t *r, const void *data, size_t len);
+
+// Moves the oldest record into `out` and stores its length in `len`; bytes
+// beyond `cap` are dropped. Returns false when the ring is empty. Consumer
+// only.
+bool spsc_ring_pop(spsc_ring_t *r, void *out, size_t cap, size_t *len);
+
+// Bytes in use, headers included; a snapshot when read by the other side.
+size_t spsc_ring_used(const spsc_ring_t *r);
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: MIT
+#include "subscription.h"
+
+#include <string.h>
+
+static const char *const k_topic_names[SUBSCRIPTION_TOPIC_COUNT] = {
+    [SUBSCRIPTION_TELEMETRY] = "telemetry",
+    [SUBSCRIPTION_SWITCH] = "switch",
+    [SUBSCRIPTION_HELTEC] = "heltec",
+    [SUBSCRIPTION_UNREAD] = "unread",
+    [SUBSCRIPTION_WATCHDOG] = "watchdog",
+};
+
+bool subscription_topic_from_name(const char *name, subscription_topic_t *out) {
+    if (!name) {
+        return false;
+    }
+    for (int i = 0; i < SUBSCRIPTION_TOPIC_COUNT; ++i) {
+        if (strcmp(name, k_topic_names[i]) == 0) {
+            *out = (subscription_topic_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *subscription_topic_name(subscription_topic_t topic) {
+    return topic < SUBSCRIPTION_TOPIC_COUNT ? k_topic_names[topic] : "unknown";
+}
+
+bool subscription_valid(const subscription_t *sub) {
+    if (sub->min_interval_ms > SUBSCRIPTION_MAX_INTERVAL_MS || sub->max_interval_ms > SUBSCRIPTION_MAX_INTERVAL_MS) {
+        return false;
+    }
+    return sub->max_interval_ms == 0 || sub->max_interval_ms >= sub->min_interval_ms;
+}
+
+bool subscription_due(const subscription_t *sub, uint64_t last_sent_us, bool changed, uint64_t now_us) {
+    if (!sub->enabled) {
+        return false;
+    }
+    if (last_sent_us == 0) {
+        return changed || sub->max_interval_ms != 0;
+    }
+    const uint64_t since_us = now_us > last_sent_us ? now_us - last_sent_us : 0;
+    if (changed && since_us >= (uint64_t)sub->min_interval_ms * 1000ULL) {
+        return true;
+    }
+    return sub->max_interval_ms != 0 && since_us >= (uint64_t)sub->max_interval_ms * 1000ULL;
+}
+
+uint32_t subscription_poll_ms(const subscription_set_t *set, uint32_t floor_ms, uint32_t ceiling_ms) {
+    uint32_t poll = 0;
+    for (int i = 0; i < SUBSCRIPTION_TOPIC_COUNT; ++i) {
+        const subscription_t *sub = &set->topics[i];
+        if (!sub->enabled) {
+            continue;
+        }
+        uint32_t want = sub->min_interval_ms < ceiling_ms ? sub->min_interval_ms : ceiling_ms;
+        want = want > floor_ms ? want : floor_ms;
+        if (poll == 0 || want < poll) {
+            poll = want;
+        }
+    }
+    return poll;
+}
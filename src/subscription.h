@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-topic event subscriptions requested by the Pi. An enabled topic is sent
+// when its value changes, but no more often than `min_interval_ms`, and is
+// re-sent at least every `max_interval_ms` even without a change (0: only on
+// change). Free of ESP-IDF dependencies; the caller owns locking.
+#define SUBSCRIPTION_MAX_INTERVAL_MS 86400000u
+
+typedef enum {
+    SUBSCRIPTION_TELEMETRY = 0,
+    SUBSCRIPTION_SWITCH,
+    SUBSCRIPTION_HELTEC,
+    SUBSCRIPTION_UNREAD,
+    SUBSCRIPTION_WATCHDOG,
+    SUBSCRIPTION_TOPIC_COUNT,
+} subscription_topic_t;
+
+typedef struct {
+    bool enabled;
+    uint32_t min_interval_ms;
+    uint32_t max_interval_ms;
+    // Payload projection for topics that support one (telemetry: a
+    // telemetry_mask_t); 0 selects everything.
+    uint32_t fields;
+} subscription_t;
+
+typedef struct {
+    subscription_t topics[SUBSCRIPTION_TOPIC_COUNT];
+    // Topics to send once right away, whatever changed (bit per topic).
+    uint32_t force;
+} subscription_set_t;
+
+bool subscription_topic_from_name(const char *name, subscription_topic_t *out);
+const char *subscription_topic_name(subscription_topic_t topic);
+
+// Intervals are within SUBSCRIPTION_MAX_INTERVAL_MS and max is 0 or >= min.
+bool subscription_valid(const subscription_t *sub);
+
+// Whether a topic last sent at `last_sent_us` (0: never) goes out now.
+bool subscription_due(const subscription_t *sub, uint64_t last_sent_us, bool changed, uint64_t now_us);
+
+// How often the enabled topics need their sources polled: the smallest
+// min_interval_ms, clamped to [floor_ms, ceiling_ms]. 0 when nothing is
+// enabled.
+uint32_t subscription_poll_ms(const subscription_set_t *set, uint32_t floor_ms, uint32_t ceiling_ms);
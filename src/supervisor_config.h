@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+// Sizes of everything the firmware keeps for its lifetime. All of it is
+// static: the tasks, their queues and semaphores and every buffer are placed
+// at link time, so the heap is only used by ESP-IDF drivers while booting.
+// main.c checks each subsystem against its SUPV_RAM_BUDGET_* at build time
+// and logs the figures at boot.
+
+// UART: the driver's RX buffer and event queue (allocated by the driver at
+// install), the chunk io_task reads at a time and the longest line accepted.
+#define SUPV_RX_BUF_SIZE 1024
+#define SUPV_UART_QUEUE_LEN 16
+#define SUPV_RX_CHUNK 256
+#define SUPV_LINE_BUF 512
+// Received lines waiting for loop_task; a power of two.
+#define SUPV_RX_RING_BYTES 2048
+// Outbound frames (see tx_queue.h), each holding one line.
+#define TX_FRAME_SIZE 512
+#define TX_QUEUE_FRAMES 8
+
+// Task placement. io_task owns the UART: it reads and splits received lines,
+// and wraps and writes outbound frames. It is pinned to the core app_main runs
+// on, which installs the UART driver and so takes its interrupt. loop_task
+// decodes and runs commands, encodes every reply and event and handles the
+// switches, the ADC and the poweroff handshake, pinned to the other core.
+// Building with SUPV_SINGLE_CORE=1, or for a single-core FreeRTOS, pins both
+// tasks to the I/O core instead. Stacks are in bytes.
+#ifndef SUPV_SINGLE_CORE
+#define SUPV_SINGLE_CORE 0
+#endif
+#define SUPV_IO_CORE 0
+#if SUPV_SINGLE_CORE || CONFIG_FREERTOS_UNICORE
+#define SUPV_APP_CORE SUPV_IO_CORE
+#else
+#define SUPV_APP_CORE 1
+#endif
+#define SUPV_IO_STACK 3072
+#define SUPV_IO_PRIO 9
+#define SUPV_LOOP_STACK 4096
+#define SUPV_LOOP_PRIO 10
+#define SUPV_LOOP_QUEUE_LEN 16
+
+// Nothing may allocate once loop_task runs. Allocations seen after that are
+// logged as their count grows; building with SUPV_HEAP_STRICT=1 aborts on
+// the first one instead, which the host builds do.
+#ifndef SUPV_HEAP_STRICT
+#define SUPV_HEAP_STRICT 0
+#endif
+
+// ADC: one DMA frame as read by loop_task, and the driver's pool of them.
+#define SUPV_ADC_FRAME_BYTES 256
+#define SUPV_ADC_POOL_BYTES 4096
+
+// Static RAM per subsystem, in bytes.
+#define SUPV_RAM_BUDGET_TASKS 8192
+#define SUPV_RAM_BUDGET_UART_RX 4096
+#define SUPV_RAM_BUDGET_UART_TX 7168
+#define SUPV_RAM_BUDGET_LOOP 4096
+#define SUPV_RAM_BUDGET_STATE 2048
+#define SUPV_RAM_BUDGET_ADC 1024
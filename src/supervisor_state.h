@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    bool lte;
+    bool wifi;
+    bool bt;
+    bool bridge_enable;
+    bool lid_open;
+    bool charger_online;
+} supervisor_switch_state_t;
+
+// battery_pct and the time estimates read -1 while unknown.
+typedef struct {
+    int battery_pct;
+    int pack_mv;
+    int pack_ma;
+    int time_to_empty_min;
+    int time_to_full_min;
+    float mcu_temp_c;
+    int unread_ext;
+    char heltec[16];
+    char mcu[16];
+    char watchdog[16];
+    bool poweroff_armed;
+    uint64_t last_mesh_event_us;
+    supervisor_switch_state_t switches;
+} supervisor_state_t;
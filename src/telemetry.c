@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: MIT
+#include "telemetry.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Indexed by field bit position.
+static const char *const k_field_names[] = {
+    "battery_pct", "pack_mv", "pack_ma", "mcu_temp_c", "unread_ext",
+    "last_msg_age_s", "heltec", "mcu", "uptime_s", "switch",
+    "time_to_empty_min", "time_to_full_min",
+};
+_Static_assert(TELEMETRY_FIELDS_ALL == (1u << sizeof(k_field_names) / sizeof(k_field_names[0])) - 1,
+               "every telemetry field needs a name");
+
+bool telemetry_fields_parse(const json_value_t *list, telemetry_mask_t *out) {
+    json_array_iter_t it;
+    json_array_iter_init(&it, list);
+    telemetry_mask_t mask = 0;
+    json_value_t item;
+    while (json_array_next(&it, &item)) {
+        if (!json_value_is_string(&item)) {
+            return false;
+        }
+        size_t i = 0;
+        while (i < sizeof(k_field_names) / sizeof(k_field_names[0]) && strcmp(item.ptr, k_field_names[i]) != 0) {
+            ++i;
+        }
+        if (i == sizeof(k_field_names) / sizeof(k_field_names[0])) {
+            return false;
+        }
+        mask |= 1u << i;
+    }
+    if (mask == 0) {
+        return false;
+    }
+    *out = mask;
+    return true;
+}
+
+int telemetry_last_msg_age(const supervisor_state_t *state, uint64_t now_us) {
+    if (!state || state->last_mesh_event_us == 0 || now_us < state->last_mesh_event_us) {
+        return 0;
+    }
+    const uint64_t delta = now_us - state->last_mesh_event_us;
+    const uint64_t seconds = delta / 1000000ULL;
+    return seconds > (uint64_t)INT_MAX ? INT_MAX : (int)seconds;
+}
+
+void telemetry_encode_switch(json_writer_t *w, const supervisor_switch_state_t *sw) {
+    json_writer_begin_object(w);
+    if (sw) {
+        json_writer_add_bool(w, "lte", sw->lte);
+        json_writer_add_bool(w, "wifi", sw->wifi);
+        json_writer_add_bool(w, "bt", sw->bt);
+        json_writer_add_bool(w, "bridge_enable", sw->bridge_enable);
+        json_writer_add_bool(w, "lid_open", sw->lid_open);
+        json_writer_add_bool(w, "charger_online", sw->charger_online);
+    }
+    json_writer_end_object(w);
+}
+
+// Unknown values (-1) are sent as null.
+static void add_estimate(json_writer_t *w, const char *key, int value) {
+    if (value < 0) {
+        json_writer_add_null(w, key);
+    } else {
+        json_writer_add_int(w, key, value);
+    }
+}
+
+void telemetry_encode_fields(json_writer_t *w, const supervisor_state_t *state, uint64_t now_us,
+                             telemetry_mask_t mask) {
+    if (!state) {
+        return;
+    }
+    if (mask & TELEMETRY_FIELD_BATTERY_PCT) {
+        add_estimate(w, "battery_pct", state->battery_pct);
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MV) {
+        json_writer_add_int(w, "pack_mv", state->pack_mv);
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MA) {
+        json_writer_add_int(w, "pack_ma", state->pack_ma);
+    }
+    if (mask & TELEMETRY_FIELD_MCU_TEMP_C) {
+        json_writer_add_float(w, "mcu_temp_c", state->mcu_temp_c, TELEMETRY_TEMP_DECIMALS);
+    }
+    if (mask & TELEMETRY_FIELD_UNREAD_EXT) {
+        json_writer_add_int(w, "unread_ext", state->unread_ext);
+    }
+    if (mask & TELEMETRY_FIELD_LAST_MSG_AGE_S) {
+        json_writer_add_int(w, "last_msg_age_s", telemetry_last_msg_age(state, now_us));
+    }
+    if (mask & TELEMETRY_FIELD_HELTEC) {
+        json_writer_add_string(w, "heltec", state->heltec);
+    }
+    if (mask & TELEMETRY_FIELD_MCU) {
+        json_writer_add_string(w, "mcu", state->mcu);
+    }
+    if (mask & TELEMETRY_FIELD_UPTIME_S) {
+        json_writer_add_uint64(w, "uptime_s", now_us / 1000000ULL);
+    }
+    if (mask & TELEMETRY_FIELD_SWITCH) {
+        json_writer_key(w, "switch");
+        telemetry_encode_switch(w, &state->switches);
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_EMPTY_MIN) {
+        add_estimate(w, "time_to_empty_min", state->time_to_empty_min);
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_FULL_MIN) {
+        add_estimate(w, "time_to_full_min", state->time_to_full_min);
+    }
+}
+
+void telemetry_delta_init(telemetry_delta_t *d, const telemetry_delta_config_t *cfg) {
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    if (d->cfg.fields == 0) {
+        d->cfg.fields = TELEMETRY_FIELDS_ALL;
+    }
+}
+
+static bool switches_equal(const supervisor_switch_state_t *a, const supervisor_switch_state_t *b) {
+    return a->lte == b->lte && a->wifi == b->wifi && a->bt == b->bt && a->bridge_enable == b->bridge_enable &&
+           a->lid_open == b->lid_open && a->charger_online == b->charger_online;
+}
+
+// Estimates also count as moved when they become known or unknown.
+static bool estimate_moved(int value, int sent, int deadband) {
+    return (value < 0) != (sent < 0) || abs(value - sent) > deadband;
+}
+
+static telemetry_mask_t changed_fields(const telemetry_delta_t *d, const supervisor_state_t *s) {
+    const supervisor_state_t *sent = &d->sent;
+    telemetry_mask_t mask = 0;
+    if (s->battery_pct != sent->battery_pct) {
+        mask |= TELEMETRY_FIELD_BATTERY_PCT;
+    }
+    if (abs(s->pack_mv - sent->pack_mv) > d->cfg.pack_mv_deadband) {
+        mask |= TELEMETRY_FIELD_PACK_MV;
+    }
+    if (abs(s->pack_ma - sent->pack_ma) > d->cfg.pack_ma_deadband) {
+        mask |= TELEMETRY_FIELD_PACK_MA;
+    }
+    const float dt = s->mcu_temp_c - sent->mcu_temp_c;
+    if (dt > d->cfg.mcu_temp_deadband_c || -dt > d->cfg.mcu_temp_deadband_c) {
+        mask |= TELEMETRY_FIELD_MCU_TEMP_C;
+    }
+    if (s->unread_ext != sent->unread_ext) {
+        mask |= TELEMETRY_FIELD_UNREAD_EXT;
+    }
+    // last_msg_age_s ticks on its own; it is only news when a new mesh event
+    // resets it. The receiver ages it locally between reports.
+    if (s->last_mesh_event_us != sent->last_mesh_event_us) {
+        mask |= TELEMETRY_FIELD_LAST_MSG_AGE_S;
+    }
+    if (strncmp(s->heltec, sent->heltec, sizeof(s->heltec)) != 0) {
+        mask |= TELEMETRY_FIELD_HELTEC;
+    }
+    if (strncmp(s->mcu, sent->mcu, sizeof(s->mcu)) != 0) {
+        mask |= TELEMETRY_FIELD_MCU;
+    }
+    if (!switches_equal(&s->switches, &sent->switches)) {
+        mask |= TELEMETRY_FIELD_SWITCH;
+    }
+    if (estimate_moved(s->time_to_empty_min, sent->time_to_empty_min, d->cfg.runtime_deadband_min)) {
+        mask |= TELEMETRY_FIELD_TIME_TO_EMPTY_MIN;
+    }
+    if (estimate_moved(s->time_to_full_min, sent->time_to_full_min, d->cfg.runtime_deadband_min)) {
+        mask |= TELEMETRY_FIELD_TIME_TO_FULL_MIN;
+    }
+    return mask;
+}
+
+static void record_sent(telemetry_delta_t *d, const supervisor_state_t *s, telemetry_mask_t mask) {
+    supervisor_state_t *sent = &d->sent;
+    if (mask & TELEMETRY_FIELD_BATTERY_PCT) {
+        sent->battery_pct = s->battery_pct;
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MV) {
+        sent->pack_mv = s->pack_mv;
+    }
+    if (mask & TELEMETRY_FIELD_PACK_MA) {
+        sent->pack_ma = s->pack_ma;
+    }
+    if (mask & TELEMETRY_FIELD_MCU_TEMP_C) {
+        sent->mcu_temp_c = s->mcu_temp_c;
+    }
+    if (mask & TELEMETRY_FIELD_UNREAD_EXT) {
+        sent->unread_ext = s->unread_ext;
+    }
+    if (mask & TELEMETRY_FIELD_LAST_MSG_AGE_S) {
+        sent->last_mesh_event_us = s->last_mesh_event_us;
+    }
+    if (mask & TELEMETRY_FIELD_HELTEC) {
+        memcpy(sent->heltec, s->heltec, sizeof(sent->heltec));
+    }
+    if (mask & TELEMETRY_FIELD_MCU) {
+        memcpy(sent->mcu, s->mcu, sizeof(sent->mcu));
+    }
+    if (mask & TELEMETRY_FIELD_SWITCH) {
+        sent->switches = s->switches;
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_EMPTY_MIN) {
+        sent->time_to_empty_min = s->time_to_empty_min;
+    }
+    if (mask & TELEMETRY_FIELD_TIME_TO_FULL_MIN) {
+        sent->time_to_full_min = s->time_to_full_min;
+    }
+}
+
+telemetry_mask_t telemetry_delta_update(telemetry_delta_t *d, const supervisor_state_t *state, uint64_t now_us) {
+    telemetry_mask_t mask;
+    if (!d->primed || (d->cfg.keyframe_interval_ms != 0 &&
+                       now_us - d->last_keyframe_us >= (uint64_t)d->cfg.keyframe_interval_ms * 1000ULL)) {
+        mask = d->cfg.fields | TELEMETRY_FIELD_UPTIME_S;
+        d->primed = true;
+        d->last_keyframe_us = now_us;
+    } else {
+        mask = changed_fields(d, state) & d->cfg.fields;
+        if (mask) {
+            mask |= TELEMETRY_FIELD_UPTIME_S;
+        }
+    }
+    record_sent(d, state, mask);
+    return mask;
+}
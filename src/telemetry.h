@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "json_reader.h"
+#include "json_writer.h"
+#include "supervisor_state.h"
+
+// One bit per telemetry field, in wire order.
+typedef enum {
+    TELEMETRY_FIELD_BATTERY_PCT = 1u << 0,
+    TELEMETRY_FIELD_PACK_MV = 1u << 1,
+    TELEMETRY_FIELD_PACK_MA = 1u << 2,
+    TELEMETRY_FIELD_MCU_TEMP_C = 1u << 3,
+    TELEMETRY_FIELD_UNREAD_EXT = 1u << 4,
+    TELEMETRY_FIELD_LAST_MSG_AGE_S = 1u << 5,
+    TELEMETRY_FIELD_HELTEC = 1u << 6,
+    TELEMETRY_FIELD_MCU = 1u << 7,
+    TELEMETRY_FIELD_UPTIME_S = 1u << 8,
+    TELEMETRY_FIELD_SWITCH = 1u << 9,
+    TELEMETRY_FIELD_TIME_TO_EMPTY_MIN = 1u << 10,
+    TELEMETRY_FIELD_TIME_TO_FULL_MIN = 1u << 11,
+} telemetry_field_t;
+
+typedef uint32_t telemetry_mask_t;
+
+#define TELEMETRY_FIELDS_ALL ((telemetry_mask_t)0xFFF)
+
+// Decimal places mcu_temp_c is sent with in JSON.
+#define TELEMETRY_TEMP_DECIMALS 1
+
+// Resolves a JSON array of field names (as in telemetry_encode_fields) to a
+// mask. Fails on an empty list, a non-string or an unknown name.
+bool telemetry_fields_parse(const json_value_t *list, telemetry_mask_t *out);
+
+int telemetry_last_msg_age(const supervisor_state_t *state, uint64_t now_us);
+
+void telemetry_encode_switch(json_writer_t *w, const supervisor_switch_state_t *sw);
+// Appends the fields selected by `mask` as members of the currently open object.
+void telemetry_encode_fields(json_writer_t *w, const supervisor_state_t *state, uint64_t now_us,
+                             telemetry_mask_t mask);
+
+// Change detector for the telemetry event. A field is reported when it moved
+// by more than its deadband since it was last sent; every
+// `keyframe_interval_ms` (if non-zero) all fields are reported regardless.
+// The first update after init is always a keyframe. Only `fields` (0: all)
+// are ever reported.
+typedef struct {
+    int pack_mv_deadband;
+    int pack_ma_deadband;
+    int runtime_deadband_min;
+    float mcu_temp_deadband_c;
+    uint32_t keyframe_interval_ms;
+    telemetry_mask_t fields;
+} telemetry_delta_config_t;
+
+typedef struct {
+    telemetry_delta_config_t cfg;
+    bool primed;
+    uint64_t last_keyframe_us;
+    supervisor_state_t sent;
+} telemetry_delta_t;
+
+void telemetry_delta_init(telemetry_delta_t *d, const telemetry_delta_config_t *cfg);
+
+// Returns the fields to emit now (0 for nothing) and records them as sent.
+// Non-empty deltas always carry uptime_s so the receiver can timestamp them.
+telemetry_mask_t telemetry_delta_update(telemetry_delta_t *d, const supervisor_state_t *state, uint64_t now_us);
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: MIT
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#define SLOT_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SPAN(level) (1ULL << (TIMER_WHEEL_SLOT_BITS * (level)))
+
+_Static_assert(TIMER_WHEEL_SLOTS == 64, "occupancy bitmaps are 64 bits wide");
+
+void timer_wheel_init(timer_wheel_t *w, uint64_t now) {
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+}
+
+void wheel_timer_init(wheel_timer_t *t, wheel_timer_fn_t fn, void *ctx) {
+    *t = (wheel_timer_t){.fn = fn, .ctx = ctx};
+}
+
+static void link_timer(timer_wheel_t *w, wheel_timer_t *t, unsigned level, unsigned slot) {
+    wheel_timer_t **head = &w->slots[level][slot];
+    t->next = *head;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    *head = t;
+    t->pprev = head;
+    t->slot = (uint16_t)(level * TIMER_WHEEL_SLOTS + slot);
+    w->occupied[level] |= 1ULL << slot;
+}
+
+static void unlink_timer(timer_wheel_t *w, wheel_timer_t *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    const unsigned level = t->slot / TIMER_WHEEL_SLOTS;
+    const unsigned slot = t->slot % TIMER_WHEEL_SLOTS;
+    if (!w->slots[level][slot]) {
+        w->occupied[level] &= ~(1ULL << slot);
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+// Files `t` on the lowest level whose range reaches its deadline, counted
+// from w->now; deadlines before `earliest` are treated as `earliest`.
+static void place(timer_wheel_t *w, wheel_timer_t *t, uint64_t earliest) {
+    uint64_t at = t->expires > earliest ? t->expires : earliest;
+    const uint64_t delta = at - w->now;
+    unsigned level = 0;
+    while (level + 1 < TIMER_WHEEL_LEVELS && delta >= LEVEL_SPAN(level + 1)) {
+        ++level;
+    }
+    if (delta >= LEVEL_SPAN(TIMER_WHEEL_LEVELS)) {
+        // Out of range: wait in the last slot reachable and be placed again
+        // from there.
+        at = w->now + LEVEL_SPAN(TIMER_WHEEL_LEVELS) - 1;
+    }
+    link_timer(w, t, level, (unsigned)((at >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK));
+}
+
+void timer_wheel_arm(timer_wheel_t *w, wheel_timer_t *t, uint64_t expires, uint32_t period) {
+    if (wheel_timer_armed(t)) {
+        unlink_timer(w, t);
+    }
+    t->expires = expires;
+    t->period = period;
+    place(w, t, w->now + 1);
+}
+
+bool timer_wheel_cancel(timer_wheel_t *w, wheel_timer_t *t) {
+    if (!wheel_timer_armed(t)) {
+        return false;
+    }
+    unlink_timer(w, t);
+    return true;
+}
+
+static void process_tick(timer_wheel_t *w, uint64_t tick) {
+    w->now = tick;
+    // Higher levels first, so that what they hand down is handed down again
+    // within this tick.
+    unsigned top = 0;
+    while (top + 1 < TIMER_WHEEL_LEVELS && (tick & (LEVEL_SPAN(top + 1) - 1)) == 0) {
+        ++top;
+    }
+    for (unsigned level = top; level >= 1; --level) {
+        const unsigned slot = (unsigned)((tick >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+        wheel_timer_t *list = w->slots[level][slot];
+        w->slots[level][slot] = NULL;
+        w->occupied[level] &= ~(1ULL << slot);
+        while (list) {
+            wheel_timer_t *t = list;
+            list = t->next;
+            t->next = NULL;
+            t->pprev = NULL;
+            place(w, t, tick);
+            ++w->cascaded;
+        }
+    }
+
+    wheel_timer_t *t;
+    while ((t = w->slots[0][tick & SLOT_MASK]) != NULL) {
+        unlink_timer(w, t);
+        if (t->period) {
+            // Missed periods are skipped rather than fired in a burst.
+            uint64_t next = t->expires + t->period;
+            if (next <= tick) {
+                next += ((tick - next) / t->period + 1) * t->period;
+            }
+            t->expires = next;
+            place(w, t, tick + 1);
+        }
+        ++w->fired;
+        t->fn(t, t->ctx);
+    }
+}
+
+static uint64_t rotate_right(uint64_t bits, unsigned n) {
+    return n ? (bits >> n) | (bits << (64 - n)) : bits;
+}
+
+uint64_t timer_wheel_next_tick(const timer_wheel_t *w) {
+    uint64_t best = UINT64_MAX;
+    for (unsigned level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (!w->occupied[level]) {
+            continue;
+        }
+        // Slots come up in order from the one after the current position.
+        const unsigned shift = TIMER_WHEEL_SLOT_BITS * level;
+        const uint64_t first = (w->now >> shift) + 1;
+        const uint64_t pending = rotate_right(w->occupied[level], (unsigned)(first & SLOT_MASK));
+        const uint64_t tick = (first + (uint64_t)__builtin_ctzll(pending)) << shift;
+        if (tick < best) {
+            best = tick;
+        }
+    }
+    return best;
+}
+
+void timer_wheel_advance(timer_wheel_t *w, uint64_t now) {
+    while (w->now < now) {
+        const uint64_t next = timer_wheel_next_tick(w);
+        if (next > now) {
+            w->now = now;
+            break;
+        }
+        process_tick(w, next);
+    }
+}
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hierarchical timer wheel over a free-running tick count. Each of the
+// TIMER_WHEEL_LEVELS levels has TIMER_WHEEL_SLOTS slots, each 64 times the
+// span of the one below: level 0 resolves single ticks for the next 64,
+// level 3 reaches 2^24 ticks (4.6 h at 1 ms) ahead, and later deadlines wait
+// in the last level until they come into range. Timers are caller-owned and
+// linked in place, so arming and cancelling never allocate and take constant
+// time; a timer on a higher level is moved down as its slot comes up.
+// Periodic timers are re-armed from their previous deadline, so they do not
+// drift however late they are serviced. Free of ESP-IDF dependencies; the
+// caller owns locking.
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+typedef struct wheel_timer wheel_timer_t;
+typedef void (*wheel_timer_fn_t)(wheel_timer_t *timer, void *ctx);
+
+struct wheel_timer {
+    wheel_timer_t *next;
+    // Link pointing at this timer; NULL while not armed.
+    wheel_timer_t **pprev;
+    // level * TIMER_WHEEL_SLOTS + slot while armed.
+    uint16_t slot;
+    uint64_t expires;
+    uint32_t period;
+    wheel_timer_fn_t fn;
+    void *ctx;
+};
+
+typedef struct {
+    // Last tick processed.
+    uint64_t now;
+    wheel_timer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    // Bit per non-empty slot, for each level.
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    uint32_t fired;
+    uint32_t cascaded;
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *w, uint64_t now);
+void wheel_timer_init(wheel_timer_t *t, wheel_timer_fn_t fn, void *ctx);
+
+// (Re)arms `t` to fire at tick `expires`, then every `period` ticks after
+// that if `period` is non-zero. A deadline that has already passed fires on
+// the next tick.
+void timer_wheel_arm(timer_wheel_t *w, wheel_timer_t *t, uint64_t expires, uint32_t period);
+// Returns false if `t` was not armed.
+bool timer_wheel_cancel(timer_wheel_t *w, wheel_timer_t *t);
+
+static inline bool wheel_timer_armed(const wheel_timer_t *t) {
+    return t->pprev != 0;
+}
+
+// Processes every tick up to `now`, firing each timer due on the way in
+// deadline order. Callbacks may arm and cancel any timer.
+void timer_wheel_advance(timer_wheel_t *w, uint64_t now);
+
+// The next tick at which advancing does any work (UINT64_MAX when nothing
+// is armed). Exact for timers due within TIMER_WHEEL_SLOTS ticks and never
+// later than the real deadline otherwise, so sleeping until then is safe.
+uint64_t timer_wheel_next_tick(const timer_wheel_t *w);
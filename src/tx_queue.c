@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+#include "tx_queue.h"
+
+#include <string.h>
+
+void tx_queue_init(tx_queue_t *q) {
+    memset(q, 0, sizeof(*q));
+    for (size_t i = 0; i < TX_QUEUE_FRAMES; ++i) {
+        q->frames[i].next = q->free_list;
+        q->free_list = &q->frames[i];
+    }
+}
+
+tx_frame_t *tx_queue_acquire(tx_queue_t *q) {
+    tx_frame_t *frame = q->free_list;
+    if (frame) {
+        q->free_list = frame->next;
+        frame->next = NULL;
+        frame->wire_type = 0;
+        frame->len = 0;
+    }
+    return frame;
+}
+
+void tx_queue_release(tx_queue_t *q, tx_frame_t *frame) {
+    if (!frame) {
+        return;
+    }
+    frame->next = q->free_list;
+    q->free_list = frame;
+}
+
+static tx_frame_t *unlink_head(tx_queue_t *q, tx_prio_t prio) {
+    tx_frame_t *frame = q->head[prio];
+    if (frame) {
+        q->head[prio] = frame->next;
+        if (!q->head[prio]) {
+            q->tail[prio] = NULL;
+        }
+        frame->next = NULL;
+    }
+    return frame;
+}
+
+bool tx_queue_commit(tx_queue_t *q, tx_frame_t *frame, tx_prio_t prio, uint32_t tag, uint64_t now_us) {
+    bool replaced = false;
+    if (prio == TX_PRIO_TELEMETRY) {
+        tx_frame_t *stale = unlink_head(q, prio);
+        if (stale) {
+            ++q->stats[prio].coalesced;
+            tx_queue_release(q, stale);
+            --q->queued;
+            replaced = true;
+        }
+    }
+    frame->prio = prio;
+    frame->tag = tag;
+    frame->enqueued_us = now_us;
+    frame->next = NULL;
+    if (q->tail[prio]) {
+        q->tail[prio]->next = frame;
+    } else {
+        q->head[prio] = frame;
+    }
+    q->tail[prio] = frame;
+    if (++q->queued > q->peak_queued) {
+        q->peak_queued = q->queued;
+    }
+    return replaced;
+}
+
+bool tx_queue_withdraw(tx_queue_t *q, tx_prio_t prio, uint32_t *tag) {
+    tx_frame_t *frame = unlink_head(q, prio);
+    if (!frame) {
+        return false;
+    }
+    if (tag) {
+        *tag = frame->tag;
+    }
+    ++q->stats[prio].coalesced;
+    tx_queue_release(q, frame);
+    --q->queued;
+    return true;
+}
+
+tx_frame_t *tx_queue_pop(tx_queue_t *q, uint64_t now_us) {
+    for (int prio = 0; prio < TX_PRIO_COUNT; ++prio) {
+        tx_frame_t *frame = unlink_head(q, (tx_prio_t)prio);
+        if (!frame) {
+            continue;
+        }
+        --q->queued;
+        tx_class_stats_t *st = &q->stats[prio];
+        const uint64_t waited = now_us > frame->enqueued_us ? now_us - frame->enqueued_us : 0;
+        ++st->sent;
+        st->total_latency_us += waited;
+        if (waited > st->max_latency_us) {
+            st->max_latency_us = waited > UINT32_MAX ? UINT32_MAX : (uint32_t)waited;
+        }
+        return frame;
+    }
+    return NULL;
+}
+
+void tx_queue_note_drop(tx_queue_t *q, tx_prio_t prio) {
+    ++q->stats[prio].dropped;
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supervisor_config.h"
+
+// Bounded, prioritized queue of outbound frames drained by a single writer.
+// Frames come from a fixed pool of TX_QUEUE_FRAMES frames of TX_FRAME_SIZE
+// bytes: producers acquire one, encode into it and commit it; the writer pops
+// the highest-priority frame and releases it once written. Not thread-safe by
+// itself; callers serialize access.
+
+// Lower value is sent first.
+typedef enum {
+    TX_PRIO_REPLY = 0,
+    TX_PRIO_SWITCH,
+    TX_PRIO_POWEROFF,
+    TX_PRIO_EVENT,
+    TX_PRIO_TELEMETRY,
+    TX_PRIO_COUNT,
+} tx_prio_t;
+
+typedef struct tx_frame {
+    struct tx_frame *next;
+    tx_prio_t prio;
+    uint32_t tag;
+    // 0 sends `data` as-is; otherwise the binframe_type_t to wrap it in.
+    uint8_t wire_type;
+    uint64_t enqueued_us;
+    size_t len;
+    char data[TX_FRAME_SIZE];
+} tx_frame_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} tx_class_stats_t;
+
+typedef struct {
+    tx_frame_t frames[TX_QUEUE_FRAMES];
+    tx_frame_t *free_list;
+    tx_frame_t *head[TX_PRIO_COUNT];
+    tx_frame_t *tail[TX_PRIO_COUNT];
+    tx_class_stats_t stats[TX_PRIO_COUNT];
+    // Frames committed and not yet popped or withdrawn, and the most ever.
+    size_t queued;
+    size_t peak_queued;
+} tx_queue_t;
+
+void tx_queue_init(tx_queue_t *q);
+
+// Returns NULL when the pool is exhausted.
+tx_frame_t *tx_queue_acquire(tx_queue_t *q);
+void tx_queue_release(tx_queue_t *q, tx_frame_t *frame);
+
+// Telemetry is coalescing: committing a telemetry frame replaces any
+// telemetry frame still waiting, so only the freshest one is ever queued.
+// Returns true if a stale frame was released back to the pool.
+bool tx_queue_commit(tx_queue_t *q, tx_frame_t *frame, tx_prio_t prio, uint32_t tag, uint64_t now_us);
+
+// Removes a still-queued frame of class `prio` and returns its tag, so a
+// producer can fold what it carried into a replacement frame.
+bool tx_queue_withdraw(tx_queue_t *q, tx_prio_t prio, uint32_t *tag);
+
+// Returns the next frame to write, or NULL if the queue is empty.
+tx_frame_t *tx_queue_pop(tx_queue_t *q, uint64_t now_us);
+
+void tx_queue_note_drop(tx_queue_t *q, tx_prio_t prio);
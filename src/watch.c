@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: MIT
+#include "watch.h"
+
+#include <string.h>
+
+#include "telemetry.h"
+
+static const char *const k_field_names[WATCH_FIELD_COUNT] = {
+    [WATCH_FIELD_BATTERY_PCT] = "battery_pct",
+    [WATCH_FIELD_PACK_MV] = "pack_mv",
+    [WATCH_FIELD_PACK_MA] = "pack_ma",
+    [WATCH_FIELD_MCU_TEMP_C] = "mcu_temp_c",
+    [WATCH_FIELD_UNREAD_EXT] = "unread_ext",
+};
+
+bool watch_field_from_name(const char *name, watch_field_t *out) {
+    if (!name) {
+        return false;
+    }
+    for (int i = 0; i < WATCH_FIELD_COUNT; ++i) {
+        if (strcmp(name, k_field_names[i]) == 0) {
+            *out = (watch_field_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *watch_field_name(watch_field_t field) {
+    return field < WATCH_FIELD_COUNT ? k_field_names[field] : "unknown";
+}
+
+bool watch_op_from_name(const char *name, watch_op_t *out) {
+    if (!name) {
+        return false;
+    }
+    if (strcmp(name, "<") == 0) {
+        *out = WATCH_BELOW;
+        return true;
+    }
+    if (strcmp(name, ">") == 0) {
+        *out = WATCH_ABOVE;
+        return true;
+    }
+    return false;
+}
+
+float watch_field_value(watch_field_t field, const supervisor_state_t *state) {
+    switch (field) {
+        case WATCH_FIELD_BATTERY_PCT: return (float)state->battery_pct;
+        case WATCH_FIELD_PACK_MV: return (float)state->pack_mv;
+        case WATCH_FIELD_PACK_MA: return (float)state->pack_ma;
+        case WATCH_FIELD_MCU_TEMP_C: return state->mcu_temp_c;
+        case WATCH_FIELD_UNREAD_EXT: return (float)state->unread_ext;
+        default: return 0.0f;
+    }
+}
+
+unsigned watch_field_decimals(watch_field_t field) {
+    return field == WATCH_FIELD_MCU_TEMP_C ? TELEMETRY_TEMP_DECIMALS : 0;
+}
+
+// Watches on an unknown battery_pct keep their state until it is known.
+static bool field_known(watch_field_t field, const supervisor_state_t *state) {
+    return field != WATCH_FIELD_BATTERY_PCT || state->battery_pct >= 0;
+}
+
+static bool evaluate(const watch_t *w, float value) {
+    if (w->op == WATCH_BELOW) {
+        return w->active ? value < w->threshold + w->hysteresis : value < w->threshold;
+    }
+    return w->active ? value > w->threshold - w->hysteresis : value > w->threshold;
+}
+
+void watch_table_init(watch_table_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+int watch_table_add(watch_table_t *t, watch_field_t field, watch_op_t op, float threshold, float hysteresis,
+                    const supervisor_state_t *state) {
+    if (field >= WATCH_FIELD_COUNT || !(hysteresis >= 0.0f)) {
+        return -1;
+    }
+    for (int i = 0; i < WATCH_MAX; ++i) {
+        watch_t *w = &t->watches[i];
+        if (w->in_use) {
+            continue;
+        }
+        *w = (watch_t){.in_use = true, .field = field, .op = op, .threshold = threshold, .hysteresis = hysteresis};
+        w->active = field_known(field, state) && evaluate(w, watch_field_value(field, state));
+        w->reported = w->active;
+        t->by_field[field] |= 1u << i;
+        return i;
+    }
+    return -1;
+}
+
+bool watch_table_remove(watch_table_t *t, int slot) {
+    if (slot < 0 || slot >= WATCH_MAX || !t->watches[slot].in_use) {
+        return false;
+    }
+    t->by_field[t->watches[slot].field] &= ~(1u << slot);
+    t->watches[slot] = (watch_t){0};
+    return true;
+}
+
+void watch_table_clear(watch_table_t *t) {
+    const uint32_t updates = t->updates;
+    const uint32_t evaluations = t->evaluations;
+    watch_table_init(t);
+    t->updates = updates;
+    t->evaluations = evaluations;
+}
+
+watch_mask_t watch_table_update(watch_table_t *t, const supervisor_state_t *state) {
+    ++t->updates;
+    watch_mask_t due = 0;
+    for (int f = 0; f < WATCH_FIELD_COUNT; ++f) {
+        const float value = watch_field_value((watch_field_t)f, state);
+        const bool changed = (!t->primed || value != t->last[f]) && field_known((watch_field_t)f, state);
+        t->last[f] = value;
+        for (uint32_t bits = changed ? t->by_field[f] : 0; bits; bits &= bits - 1) {
+            watch_t *w = &t->watches[__builtin_ctz(bits)];
+            w->active = evaluate(w, value);
+            ++t->evaluations;
+        }
+    }
+    t->primed = true;
+    for (int i = 0; i < WATCH_MAX; ++i) {
+        const watch_t *w = &t->watches[i];
+        if (w->in_use && w->active != w->reported) {
+            due |= 1u << i;
+        }
+    }
+    return due;
+}
+
+void watch_table_mark_reported(watch_table_t *t, int slot) {
+    if (slot >= 0 && slot < WATCH_MAX) {
+        t->watches[slot].reported = t->watches[slot].active;
+    }
+}
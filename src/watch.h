@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "supervisor_state.h"
+
+// Threshold watches registered by the Pi. Each watch is a predicate
+// `field < threshold` or `field > threshold` with hysteresis: it becomes
+// active when the predicate holds and inactive again only once the value is
+// `hysteresis` past the threshold the other way. Updates re-evaluate just the
+// watches on fields whose value changed. Free of ESP-IDF dependencies; the
+// caller owns locking.
+#define WATCH_MAX 8
+
+typedef enum {
+    WATCH_FIELD_BATTERY_PCT = 0,
+    WATCH_FIELD_PACK_MV,
+    WATCH_FIELD_PACK_MA,
+    WATCH_FIELD_MCU_TEMP_C,
+    WATCH_FIELD_UNREAD_EXT,
+    WATCH_FIELD_COUNT,
+} watch_field_t;
+
+typedef enum {
+    WATCH_BELOW = 0,
+    WATCH_ABOVE,
+} watch_op_t;
+
+typedef struct {
+    bool in_use;
+    watch_field_t field;
+    watch_op_t op;
+    float threshold;
+    float hysteresis;
+    bool active;
+    // What the Pi was last told; an alert is due while it differs from active.
+    bool reported;
+} watch_t;
+
+typedef struct {
+    watch_t watches[WATCH_MAX];
+    // Bit per watch slot, for each field.
+    uint32_t by_field[WATCH_FIELD_COUNT];
+    float last[WATCH_FIELD_COUNT];
+    bool primed;
+    uint32_t updates;
+    uint32_t evaluations;
+} watch_table_t;
+
+// Bit per watch slot.
+typedef uint32_t watch_mask_t;
+
+bool watch_field_from_name(const char *name, watch_field_t *out);
+const char *watch_field_name(watch_field_t field);
+bool watch_op_from_name(const char *name, watch_op_t *out);
+float watch_field_value(watch_field_t field, const supervisor_state_t *state);
+// Decimals the field is reported with, as in telemetry.
+unsigned watch_field_decimals(watch_field_t field);
+
+void watch_table_init(watch_table_t *t);
+
+// Registers a watch and evaluates it against `state` right away; a watch
+// that starts out active raises no alert. Returns its slot, or -1 when the
+// table is full or hysteresis is negative.
+int watch_table_add(watch_table_t *t, watch_field_t field, watch_op_t op, float threshold, float hysteresis,
+                    const supervisor_state_t *state);
+bool watch_table_remove(watch_table_t *t, int slot);
+void watch_table_clear(watch_table_t *t);
+
+// Evaluates the watches on fields that changed since the previous update and
+// returns the watches with an alert due.
+watch_mask_t watch_table_update(watch_table_t *t, const supervisor_state_t *state);
+void watch_table_mark_reported(watch_table_t *t, int slot);